@@ -0,0 +1,1060 @@
+/*  This file, arrowio.c, contains routines that convert the columns of a  */
+/*  FITS binary table to and from the Apache Arrow C Data Interface.       */
+
+/*  The Arrow structures are defined in fitsio.h.  Each exported array     */
+/*  owns its buffers, which are freed by the release callback; the caller  */
+/*  must call schema->release(schema) and array->release(array) when it is */
+/*  finished with them, as required by the Arrow specification.            */
+
+#include <string.h>
+#include <stdlib.h>
+#include "fitsio2.h"
+
+#define ARW_FIXED    1   /* fixed width numeric column                     */
+#define ARW_NULLED   2   /* fixed width column with undefined values       */
+#define ARW_BIT      3   /* 'X' bit column                                 */
+#define ARW_STRING   4   /* 'A' string column                              */
+#define ARW_VLA      5   /* 'P' or 'Q' variable length column              */
+
+typedef struct {    /* private data of an exported ArrowSchema */
+    char format[FLEN_VALUE];
+    char name[FLEN_VALUE];
+} ArwSchemaData;
+
+typedef struct {    /* private data of an exported ArrowArray */
+    void *buffers[3];
+} ArwArrayData;
+
+typedef struct {    /* how one table column is mapped to an Arrow field */
+    int colnum;
+    int kind;       /* one of the ARW_xxx codes above */
+    int datatype;   /* CFITSIO datatype used to read the values */
+    int esize;      /* size in bytes of each value */
+    LONGLONG repeat;
+    struct ArrowArray *values;  /* array that holds the values */
+} ArwColumn;
+
+static void arw_release_schema(struct ArrowSchema *schema);
+static void arw_release_array(struct ArrowArray *array);
+static int arw_init_schema(struct ArrowSchema *schema, const char *format,
+           const char *name, int nchildren, int *status);
+static int arw_init_array(struct ArrowArray *array, LONGLONG length,
+           int nbuffers, int nchildren, int *status);
+static const char *arw_format(int datatype, int *esize);
+static int arw_datatype(const char *format, int *esize, char *tcode);
+static void *arw_alloc_buffer(struct ArrowArray *array, int ibuf,
+           LONGLONG nbytes, int *status);
+static int arw_write_nulls(fitsfile *fptr, int colnum, LONGLONG nrows,
+           LONGLONG nper, const unsigned char *validity, LONGLONG offset,
+           int *status);
+static int arw_pick_tnull(char tcode, const char *data, LONGLONG nelem,
+           const unsigned char *validity, LONGLONG offset, LONGLONG *tnull,
+           int *status);
+static int arw_cmp_raw(const void *a, const void *b);
+
+/*--------------------------------------------------------------------------*/
+int ffgarw(fitsfile *fptr,     /* I - FITS file pointer                      */
+           int ncols,          /* I - number of columns (0 = all columns)    */
+           int *colnum,        /* I - column numbers to export               */
+           LONGLONG firstrow,  /* I - first row to export (1 = 1st row)      */
+           LONGLONG nrows,     /* I - number of rows to export               */
+           struct ArrowSchema *schema, /* O - Arrow schema of the table      */
+           struct ArrowArray *array,   /* O - Arrow struct array of the rows */
+           int *status)        /* IO - error status                          */
+/*
+  Export columns of the current binary table as an Arrow struct array with
+  one child per column.  Numeric scalar and fixed length vector columns are
+  all read in a single pass through the table (see ffgcvn) directly into the
+  Arrow buffers.  Vector columns are exported as fixed size lists, 'X'
+  columns as boolean arrays, 'A' columns as utf8 strings (with trailing
+  blanks removed) and variable length columns as large lists (using ffgcvv).
+  Undefined values of integer (TNULLn) and logical columns are flagged in
+  the Arrow validity bitmaps.  Floating point nulls remain as NaN values.
+*/
+{
+    ArwColumn *cols = 0;
+    int ii, nfast = 0, typecode, *fastnum = 0, *fasttype = 0;
+    int anynul;
+    long width;
+    LONGLONG jj, kk, kbit, repeat, lwidth, nbytes, nelem, *offsets;
+    void **fastarray = 0, **fastnull = 0;
+    unsigned char *validity, *raw, *bits;
+    char *nularray, ttype[FLEN_VALUE], keyname[FLEN_KEYWORD];
+    char format[FLEN_VALUE];
+    const char *fmt;
+    struct ArrowArray *child;
+    tcolumn *colptr;
+
+    if (*status > 0)
+        return(*status);
+
+    memset(schema, 0, sizeof(struct ArrowSchema));
+    memset(array, 0, sizeof(struct ArrowArray));
+
+    /* reset position to the correct HDU if necessary */
+    if (fptr->HDUposition != (fptr->Fptr)->curhdu)
+        ffmahd(fptr, (fptr->HDUposition) + 1, NULL, status);
+    else if ((fptr->Fptr)->datastart == DATA_UNDEFINED)
+        if ( ffrdef(fptr, status) > 0)               /* rescan header */
+            return(*status);
+
+    if ((fptr->Fptr)->hdutype != BINARY_TBL)
+    {
+        ffpmsg("Only binary tables can be exported to Arrow (ffgarw)");
+        return(*status = NOT_BTABLE);
+    }
+
+    if (ncols <= 0)
+        ncols = (fptr->Fptr)->tfield;
+
+    if (firstrow < 1 || nrows < 0 ||
+        firstrow + nrows - 1 > (fptr->Fptr)->numrows)
+    {
+        ffpmsg("Attempt to export rows beyond end of table (ffgarw)");
+        return(*status = BAD_ROW_NUM);
+    }
+
+    cols = (ArwColumn *) calloc(ncols, sizeof(ArwColumn));
+    fastnum = (int *) calloc(ncols, sizeof(int));
+    fasttype = (int *) calloc(ncols, sizeof(int));
+    fastarray = (void **) calloc(ncols, sizeof(void *));
+    fastnull = (void **) calloc(ncols, sizeof(void *));
+    if (!cols || !fastnum || !fasttype || !fastarray || !fastnull)
+    {
+        ffpmsg("malloc failed for column arrays (ffgarw)");
+        *status = MEMORY_ALLOCATION;
+        goto cleanup;
+    }
+
+    if (arw_init_schema(schema, "+s", "", ncols, status) > 0 ||
+        arw_init_array(array, nrows, 1, ncols, status) > 0)
+        goto cleanup;
+
+    /*-----------------------------------------------------------------*/
+    /*  Set up the schema of each column and allocate its buffers.     */
+    /*-----------------------------------------------------------------*/
+    for (ii = 0; ii < ncols; ii++)
+    {
+        cols[ii].colnum = colnum ? colnum[ii] : ii + 1;
+        if (cols[ii].colnum < 1 || cols[ii].colnum > (fptr->Fptr)->tfield)
+        {
+            *status = BAD_COL_NUM;
+            goto cleanup;
+        }
+
+        colptr = (fptr->Fptr)->tableptr + (cols[ii].colnum - 1);
+        strcpy(ttype, colptr->ttype);
+        if (ttype[0] == '\0')
+        {
+            ffkeyn("COL", cols[ii].colnum, keyname, status);
+            strcpy(ttype, keyname);
+        }
+
+        ffeqtyll(fptr, cols[ii].colnum, &typecode, &repeat, &lwidth, status);
+        width = (long) lwidth;
+        cols[ii].repeat = repeat;
+        child = array->children[ii];
+
+        if (typecode < 0)                        /* variable length column */
+        {
+            fmt = arw_format(-typecode, &cols[ii].esize);
+            if (!fmt || -typecode == TLOGICAL)
+                goto badcol;
+
+            cols[ii].kind = ARW_VLA;
+            cols[ii].datatype = -typecode;
+            if (-typecode == TLONG)
+                cols[ii].datatype = TINT;    /* Arrow "i" is always 32-bit */
+            else if (-typecode == TULONG)
+                cols[ii].datatype = TUINT;
+            arw_init_schema(schema->children[ii], "+L", ttype, 1, status);
+            arw_init_schema(schema->children[ii]->children[0], fmt, "item",
+                            0, status);
+            arw_init_array(child, nrows, 2, 1, status);
+            arw_alloc_buffer(child, 1, (nrows + 1) * sizeof(LONGLONG), status);
+            cols[ii].values = child->children[0];
+        }
+        else if (typecode == TBIT)
+        {
+            cols[ii].kind = ARW_BIT;
+            cols[ii].datatype = TBYTE;
+            if (repeat == 1)
+            {
+                arw_init_schema(schema->children[ii], "b", ttype, 0, status);
+                cols[ii].values = child;
+            }
+            else
+            {
+                snprintf(format, FLEN_VALUE, "+w:%.0f", (double) repeat);
+                arw_init_schema(schema->children[ii], format, ttype, 1,
+                                status);
+                arw_init_schema(schema->children[ii]->children[0], "b",
+                                "item", 0, status);
+                arw_init_array(child, nrows, 1, 1, status);
+                cols[ii].values = child->children[0];
+            }
+            arw_init_array(cols[ii].values, nrows * repeat, 2, 0, status);
+            arw_alloc_buffer(cols[ii].values, 1, (nrows * repeat + 7) / 8,
+                             status);
+        }
+        else if (typecode == TSTRING)
+        {
+            if (width < repeat)
+            {
+                ffpmsg("Cannot export vectors of strings to Arrow (ffgarw)");
+                goto badcol;
+            }
+            cols[ii].kind = ARW_STRING;
+            cols[ii].datatype = TSTRING;
+            cols[ii].values = child;
+            arw_init_schema(schema->children[ii], "U", ttype, 0, status);
+            arw_init_array(child, nrows, 3, 0, status);
+            arw_alloc_buffer(child, 1, (nrows + 1) * sizeof(LONGLONG), status);
+        }
+        else
+        {
+            fmt = arw_format(typecode, &cols[ii].esize);
+            if (!fmt)
+                goto badcol;
+
+            cols[ii].datatype = typecode;
+            if (typecode == TLONG)
+                cols[ii].datatype = TINT;    /* Arrow "i" is always 32-bit */
+            else if (typecode == TULONG)
+                cols[ii].datatype = TUINT;
+
+            /* integer and logical columns may contain undefined values */
+            if (typecode == TLOGICAL ||
+                (colptr->tnull != NULL_UNDEFINED &&
+                 typecode != TFLOAT && typecode != TDOUBLE))
+                cols[ii].kind = ARW_NULLED;
+            else
+                cols[ii].kind = ARW_FIXED;
+
+            if (repeat == 1)
+            {
+                arw_init_schema(schema->children[ii], fmt, ttype, 0, status);
+                cols[ii].values = child;
+            }
+            else
+            {
+                snprintf(format, FLEN_VALUE, "+w:%.0f", (double) repeat);
+                arw_init_schema(schema->children[ii], format, ttype, 1,
+                                status);
+                arw_init_schema(schema->children[ii]->children[0], fmt,
+                                "item", 0, status);
+                arw_init_array(child, nrows, 1, 1, status);
+                cols[ii].values = child->children[0];
+            }
+            arw_init_array(cols[ii].values, nrows * repeat, 2, 0, status);
+
+            if (typecode == TLOGICAL)   /* unpacked into a bitmap below */
+                arw_alloc_buffer(cols[ii].values, 1,
+                                 (nrows * repeat + 7) / 8, status);
+            else
+                arw_alloc_buffer(cols[ii].values, 1,
+                                 nrows * repeat * cols[ii].esize, status);
+
+            if (cols[ii].kind == ARW_FIXED && *status <= 0)
+            {
+                /* read in the single pass over the table, below */
+                fastnum[nfast] = cols[ii].colnum;
+                fasttype[nfast] = cols[ii].datatype;
+                fastarray[nfast] = (void *) cols[ii].values->buffers[1];
+                nfast++;
+            }
+        }
+
+        if (*status > 0)
+            goto cleanup;
+        continue;
+
+badcol:
+        snprintf(format, FLEN_VALUE,
+                 "Cannot export column %d to Arrow (ffgarw)", cols[ii].colnum);
+        ffpmsg(format);
+        *status = BAD_TFORM;
+        goto cleanup;
+    }
+
+    if (nrows == 0)
+        goto cleanup;
+
+    /*-----------------------------------------------------------------*/
+    /*  Read all the plain fixed width columns in one pass.            */
+    /*-----------------------------------------------------------------*/
+    if (nfast > 0)
+    {
+        if (ffgcvn(fptr, nfast, fasttype, fastnum, firstrow, nrows, fastnull,
+                   fastarray, NULL, status) > 0)
+            goto cleanup;
+    }
+
+    /*-----------------------------------------------------------------*/
+    /*  Now read the remaining columns one at a time.                  */
+    /*-----------------------------------------------------------------*/
+    for (ii = 0; ii < ncols; ii++)
+    {
+        child = cols[ii].values;
+        nelem = nrows * cols[ii].repeat;
+
+        if (cols[ii].kind == ARW_NULLED)
+        {
+            nularray = (char *) malloc((size_t) nelem);
+            if (!nularray)
+            {
+                *status = MEMORY_ALLOCATION;
+                goto cleanup;
+            }
+
+            if (cols[ii].datatype == TLOGICAL)
+                raw = (unsigned char *) malloc((size_t) nelem);
+            else
+                raw = (unsigned char *) child->buffers[1];
+
+            if (raw)
+                ffgcf(fptr, cols[ii].datatype, cols[ii].colnum, firstrow, 1,
+                      nelem, raw, nularray, &anynul, status);
+            else
+                *status = MEMORY_ALLOCATION;
+
+            if (cols[ii].datatype == TLOGICAL && raw)
+            {
+                bits = (unsigned char *) child->buffers[1];
+                for (jj = 0; jj < nelem; jj++)
+                    if (raw[jj])
+                        bits[jj >> 3] |= (unsigned char) (1 << (jj & 7));
+                free(raw);
+            }
+
+            if (*status <= 0 && anynul)
+            {
+                validity = (unsigned char *) arw_alloc_buffer(child, 0,
+                           (nelem + 7) / 8, status);
+                if (validity)
+                {
+                    child->null_count = 0;
+                    for (jj = 0; jj < nelem; jj++)
+                    {
+                        if (nularray[jj])
+                            child->null_count++;
+                        else
+                            validity[jj >> 3] |= (unsigned char) (1 << (jj & 7));
+                    }
+                }
+            }
+            free(nularray);
+        }
+        else if (cols[ii].kind == ARW_BIT)
+        {
+            /* read the raw bytes, then repack them as an Arrow bitmap; */
+            /* FITS stores the first bit in the most significant bit.   */
+            nbytes = (cols[ii].repeat + 7) / 8;
+            raw = (unsigned char *) malloc((size_t) (nrows * nbytes));
+            if (!raw)
+            {
+                *status = MEMORY_ALLOCATION;
+                goto cleanup;
+            }
+
+            ffgcv(fptr, TBYTE, cols[ii].colnum, firstrow, 1, nrows * nbytes,
+                  NULL, raw, &anynul, status);
+
+            bits = (unsigned char *) child->buffers[1];
+            for (jj = 0, kk = 0; jj < nrows; jj++)
+            {
+                for (kbit = 0; kbit < cols[ii].repeat; kbit++, kk++)
+                {
+                    if (raw[jj * nbytes + kbit / 8] & (0x80 >> (kbit % 8)))
+                        bits[kk >> 3] |= (unsigned char) (1 << (kk & 7));
+                }
+            }
+            free(raw);
+        }
+        else if (cols[ii].kind == ARW_STRING)
+        {
+            colptr = (fptr->Fptr)->tableptr + (cols[ii].colnum - 1);
+            width = (long) colptr->twidth;
+
+            /* read the strings straight into the packed value buffer */
+            offsets = (LONGLONG *) child->buffers[1];
+            bits = (unsigned char *) arw_alloc_buffer(child, 2,
+                    (LONGLONG) nrows * width + 1, status);
+            if (bits)
+                ffgcsp(fptr, cols[ii].colnum, firstrow, 1, nrows, (char *) bits,
+                       offsets, NULL, &anynul, status);
+        }
+        else if (cols[ii].kind == ARW_VLA)
+        {
+            offsets = (LONGLONG *) array->children[ii]->buffers[1];
+
+            /* get the offsets first, to find the size of the values */
+            if (ffgcvv(fptr, cols[ii].datatype, cols[ii].colnum, firstrow,
+                       nrows, NULL, offsets, NULL, &anynul, status) > 0)
+                goto cleanup;
+
+            arw_init_array(child, offsets[nrows], 2, 0, status);
+            if (arw_alloc_buffer(child, 1,
+                    maxvalue(offsets[nrows], 1) * cols[ii].esize, status))
+                ffgcvv(fptr, cols[ii].datatype, cols[ii].colnum, firstrow,
+                       nrows, NULL, offsets, (void *) child->buffers[1],
+                       &anynul, status);
+        }
+
+        if (*status > 0)
+        {
+            snprintf(format, FLEN_VALUE,
+                     "Error exporting column %d to Arrow (ffgarw)",
+                     cols[ii].colnum);
+            ffpmsg(format);
+            goto cleanup;
+        }
+    }
+
+cleanup:
+    if (*status > 0)
+    {
+        if (schema->release)
+            schema->release(schema);
+        if (array->release)
+            array->release(array);
+    }
+
+    free(cols);
+    free(fastnum);
+    free(fasttype);
+    free(fastarray);
+    free(fastnull);
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+int ffparw(fitsfile *fptr,     /* I - FITS file pointer                      */
+           const char *extname, /* I - EXTNAME of the new table, or NULL     */
+           struct ArrowSchema *schema, /* I - Arrow schema of the table      */
+           struct ArrowArray *array,   /* I - Arrow struct array of the rows */
+           int *status)        /* IO - error status                          */
+/*
+  Append a new binary table extension to the file, containing the columns
+  of an Arrow struct array.  Primitive fields become scalar columns, fixed
+  size lists become vector columns, large or regular lists become variable
+  length columns, and utf8 fields become 'A' columns as wide as the longest
+  string.  Null values are written as undefined values (TNULLn is defined
+  for integer columns that contain nulls).  The Arrow structures are not
+  released by this routine.
+*/
+{
+    int ii, ncols, esize, datatype, nulltype;
+    char **ttype = 0, **tform = 0, tcode, keyname[FLEN_KEYWORD];
+    char message[FLEN_ERRMSG], *cbuff = 0, *lbuff;
+    const char *fmt, *data;
+    const unsigned char *validity;
+    LONGLONG nrows, jj, start, end, maxlen, lrepeat, base, *offsets;
+    const int *offsets32;
+    const LONGLONG *offsets64;
+    struct ArrowSchema *field, *item;
+    struct ArrowArray *col, *values;
+
+    if (*status > 0)
+        return(*status);
+
+    if (!schema || !array || !schema->format || strcmp(schema->format, "+s"))
+    {
+        ffpmsg("Arrow schema is not a struct of columns (ffparw)");
+        return(*status = BAD_DATATYPE);
+    }
+
+    ncols = (int) schema->n_children;
+    nrows = array->length;
+
+    ttype = (char **) calloc(maxvalue(ncols, 1), sizeof(char *));
+    tform = (char **) calloc(maxvalue(ncols, 1), sizeof(char *));
+    cbuff = (char *) calloc(maxvalue(ncols, 1), 2 * FLEN_VALUE);
+    if (!ttype || !tform || !cbuff)
+    {
+        ffpmsg("malloc failed for column arrays (ffparw)");
+        *status = MEMORY_ALLOCATION;
+        goto cleanup;
+    }
+
+    /*-----------------------------------------------------------------*/
+    /*  Work out the TTYPEn and TFORMn of each field.                  */
+    /*-----------------------------------------------------------------*/
+    for (ii = 0; ii < ncols; ii++)
+    {
+        field = schema->children[ii];
+        col = array->children[ii];
+        fmt = field->format;
+        ttype[ii] = cbuff + ii * 2 * FLEN_VALUE;
+        tform[ii] = ttype[ii] + FLEN_VALUE;
+
+        if (field->name && field->name[0])
+            strncat(ttype[ii], field->name, FLEN_VALUE - 1);
+        else
+            ffkeyn("COL", ii + 1, ttype[ii], status);
+
+        if (!strcmp(fmt, "u") || !strcmp(fmt, "U"))
+        {
+            /* find the length of the longest string */
+            maxlen = 1;
+            for (jj = 0; jj < nrows; jj++)
+            {
+                if (fmt[0] == 'u')
+                {
+                    offsets32 = (const int *) col->buffers[1];
+                    start = offsets32[col->offset + array->offset + jj];
+                    end = offsets32[col->offset + array->offset + jj + 1];
+                }
+                else
+                {
+                    offsets64 = (const LONGLONG *) col->buffers[1];
+                    start = offsets64[col->offset + array->offset + jj];
+                    end = offsets64[col->offset + array->offset + jj + 1];
+                }
+                maxlen = maxvalue(maxlen, end - start);
+            }
+            snprintf(tform[ii], FLEN_VALUE, "%.0fA", (double) maxlen);
+        }
+        else if (!strncmp(fmt, "+w:", 3) || !strcmp(fmt, "+l") ||
+                 !strcmp(fmt, "+L"))
+        {
+            item = field->children[0];
+            if (arw_datatype(item->format, &esize, &tcode) == 0)
+                goto badfield;
+
+            if (fmt[1] == 'w')
+            {
+                lrepeat = atol(fmt + 3);
+                snprintf(tform[ii], FLEN_VALUE, "%.0f%c", (double) lrepeat,
+                         tcode);
+            }
+            else if (tcode == 'L')
+                goto badfield;      /* no variable length logical arrays */
+            else
+                snprintf(tform[ii], FLEN_VALUE, "1%c%c",
+                         fmt[2] == 'L' ? 'Q' : 'P', tcode);
+        }
+        else
+        {
+            if (arw_datatype(fmt, &esize, &tcode) == 0)
+                goto badfield;
+            snprintf(tform[ii], FLEN_VALUE, "1%c", tcode);
+        }
+        continue;
+
+badfield:
+        snprintf(message, FLEN_ERRMSG,
+           "Arrow field %d has unsupported format '%s' (ffparw)", ii + 1, fmt);
+        ffpmsg(message);
+        *status = BAD_TFORM;
+        goto cleanup;
+    }
+
+    if (ffcrtb(fptr, BINARY_TBL, nrows, ncols, ttype, tform, NULL,
+               extname, status) > 0)
+        goto cleanup;
+
+    /*-----------------------------------------------------------------*/
+    /*  Write the values of each column.                               */
+    /*-----------------------------------------------------------------*/
+    for (ii = 0; ii < ncols && nrows > 0; ii++)
+    {
+        field = schema->children[ii];
+        col = array->children[ii];
+        fmt = field->format;
+        base = array->offset + col->offset;   /* index of the first row */
+
+        if (!strcmp(fmt, "u") || !strcmp(fmt, "U"))
+        {
+            data = (const char *) col->buffers[2];
+            if (fmt[0] == 'U')
+            {
+                ffpcsp(fptr, ii + 1, 1, 1, nrows, (char *) data,
+                       (LONGLONG *) col->buffers[1] + base, status);
+            }
+            else
+            {
+                /* widen the 32-bit offsets */
+                offsets = (LONGLONG *) malloc((size_t) (nrows + 1) * sizeof(LONGLONG));
+                if (!offsets)
+                {
+                    *status = MEMORY_ALLOCATION;
+                    goto cleanup;
+                }
+                for (jj = 0; jj <= nrows; jj++)
+                    offsets[jj] = ((const int *) col->buffers[1])[base + jj];
+
+                ffpcsp(fptr, ii + 1, 1, 1, nrows, (char *) data, offsets, status);
+                free(offsets);
+            }
+        }
+        else if (!strcmp(fmt, "+l") || !strcmp(fmt, "+L"))
+        {
+            values = col->children[0];
+            datatype = arw_datatype(field->children[0]->format, &esize, &tcode);
+            data = (const char *) values->buffers[1] + values->offset * esize;
+
+            for (jj = 0; jj < nrows && *status <= 0; jj++)
+            {
+                if (fmt[2] == 'l')
+                {
+                    start = ((const int *) col->buffers[1])[base + jj];
+                    end = ((const int *) col->buffers[1])[base + jj + 1];
+                }
+                else
+                {
+                    start = ((const LONGLONG *) col->buffers[1])[base + jj];
+                    end = ((const LONGLONG *) col->buffers[1])[base + jj + 1];
+                }
+
+                if (end > start)
+                    ffpcl(fptr, datatype, ii + 1, jj + 1, 1, end - start,
+                          (void *) (data + start * esize), status);
+                else
+                    ffpdes(fptr, ii + 1, jj + 1, 0, 0, status);
+            }
+        }
+        else
+        {
+            lrepeat = 1;
+            values = col;
+            item = field;
+            if (!strncmp(fmt, "+w:", 3))
+            {
+                lrepeat = atol(fmt + 3);
+                values = col->children[0];
+                item = field->children[0];
+                base = base * lrepeat + values->offset;
+            }
+
+            datatype = arw_datatype(item->format, &esize, &tcode);
+
+            if (datatype == TLOGICAL)
+            {
+                /* unpack the bitmap into one logical value per byte */
+                data = (const char *) values->buffers[1];
+                lbuff = (char *) malloc((size_t) (nrows * lrepeat));
+                if (!lbuff)
+                {
+                    *status = MEMORY_ALLOCATION;
+                    goto cleanup;
+                }
+                for (jj = 0; jj < nrows * lrepeat; jj++)
+                    lbuff[jj] = (char)
+                     ((data[(base + jj) >> 3] >> ((base + jj) & 7)) & 1);
+
+                ffpcl(fptr, TLOGICAL, ii + 1, 1, 1, nrows * lrepeat,
+                      lbuff, status);
+                free(lbuff);
+            }
+            else
+            {
+                data = (const char *) values->buffers[1] + base * esize;
+                ffpcl(fptr, datatype, ii + 1, 1, 1, nrows * lrepeat,
+                      (void *) data, status);
+            }
+
+            /* flag the null values as undefined in the FITS column */
+            validity = (const unsigned char *) values->buffers[0];
+            if (validity && values->null_count != 0 && *status <= 0)
+            {
+                nulltype = datatype != TLOGICAL && datatype != TFLOAT &&
+                           datatype != TDOUBLE;
+                if (nulltype)
+                {
+                    /* TNULLn must be a raw value which no valid element has */
+                    if (arw_pick_tnull(tcode, data, nrows * lrepeat,
+                        validity, base, &jj, status) > 0)
+                        goto cleanup;
+
+                    ffkeyn("TNULL", ii + 1, keyname, status);
+                    ffpkyj(fptr, keyname, jj, "undefined value", status);
+                    fftnul(fptr, ii + 1, jj, status);
+                }
+
+                arw_write_nulls(fptr, ii + 1, nrows,
+                    values == col ? 1 : lrepeat, validity, base, status);
+            }
+        }
+
+        if (*status > 0)
+        {
+            snprintf(message, FLEN_ERRMSG,
+                "Error writing Arrow field %d to column %d (ffparw)", ii + 1,
+                ii + 1);
+            ffpmsg(message);
+            goto cleanup;
+        }
+    }
+
+cleanup:
+    free(ttype);
+    free(tform);
+    free(cbuff);
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+static int arw_write_nulls(fitsfile *fptr, /* I - FITS file pointer          */
+           int colnum,                  /* I - column number                 */
+           LONGLONG nrows,              /* I - number of rows                */
+           LONGLONG nper,               /* I - number of elements per row    */
+           const unsigned char *validity, /* I - Arrow validity bitmap       */
+           LONGLONG offset,             /* I - bitmap index of 1st element   */
+           int *status)                 /* IO - error status                 */
+/*
+  Write runs of undefined values in a column wherever the validity bitmap
+  flags an element as null.
+*/
+{
+    LONGLONG jj, first, nelem = nrows * nper;
+
+    for (jj = 0; jj < nelem && *status <= 0; )
+    {
+        if ((validity[(offset + jj) >> 3] >> ((offset + jj) & 7)) & 1)
+        {
+            jj++;
+            continue;
+        }
+
+        /* found a null; extend the run to the end of the row */
+        first = jj;
+        do
+            jj++;
+        while (jj < nelem && jj % nper != 0 &&
+               !((validity[(offset + jj) >> 3] >> ((offset + jj) & 7)) & 1));
+
+        ffpclu(fptr, colnum, first / nper + 1, first % nper + 1, jj - first,
+               status);
+    }
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+static int arw_pick_tnull(char tcode,   /* I - TFORMn datatype letter        */
+           const char *data,            /* I - values of the first row       */
+           LONGLONG nelem,              /* I - number of values              */
+           const unsigned char *validity, /* I - Arrow validity bitmap       */
+           LONGLONG offset,             /* I - bitmap index of 1st element   */
+           LONGLONG *tnull,             /* O - raw value to use for TNULLn   */
+           int *status)                 /* IO - error status                 */
+/*
+  choose the TNULLn value of an integer column: a raw stored value which
+  none of the valid elements has.  The lowest raw value (or, for byte
+  columns, the highest) is used if it is free, so that usually the choice
+  does not depend on the data.
+*/
+{
+    LONGLONG *raw, jj, nvalid = 0, minraw, maxraw, value;
+    int down, found;
+    char message[FLEN_ERRMSG];
+
+    if (*status > 0)
+        return(*status);
+
+    switch (tcode)
+    {
+        case 'B':
+        case 'S': minraw = 0;                      maxraw = 255;        break;
+        case 'I':
+        case 'U': minraw = -32768;                 maxraw = 32767;      break;
+        case 'J':
+        case 'V': minraw = -2147483647 - 1;        maxraw = 2147483647; break;
+        default:  minraw = LONGLONG_MIN;           maxraw = LONGLONG_MAX;
+    }
+    down = (tcode == 'B' || tcode == 'S');
+
+    raw = (LONGLONG *) malloc((size_t) maxvalue(nelem, 1) * sizeof(LONGLONG));
+    if (!raw)
+    {
+        ffpmsg("Could not allocate memory for null value search (ffparw)");
+        return(*status = MEMORY_ALLOCATION);
+    }
+
+    /* the raw stored value of each valid element */
+    for (jj = 0; jj < nelem; jj++)
+    {
+        if (!((validity[(offset + jj) >> 3] >> ((offset + jj) & 7)) & 1))
+            continue;
+
+        switch (tcode)
+        {
+            case 'B': value = ((const unsigned char *) data)[jj];       break;
+            case 'S': value = ((const signed char *) data)[jj] + 128;   break;
+            case 'I': value = ((const short *) data)[jj];               break;
+            case 'U': value = ((const unsigned short *) data)[jj] - 32768; break;
+            case 'J': value = ((const int *) data)[jj];                 break;
+            case 'V': value = (LONGLONG) ((const unsigned int *) data)[jj]
+                              - 2147483648LL;                            break;
+            case 'K': value = ((const LONGLONG *) data)[jj];            break;
+            default:  value = ((LONGLONG) ((const ULONGLONG *) data)[jj]) ^
+                              0x8000000000000000;
+        }
+        raw[nvalid++] = value;
+    }
+
+    qsort(raw, (size_t) nvalid, sizeof(LONGLONG), arw_cmp_raw);
+
+    /* step past the values in use from one end of the range */
+    found = 1;
+    if (down)
+    {
+        *tnull = maxraw;
+        for (jj = nvalid - 1; jj >= 0 && raw[jj] >= *tnull; jj--)
+        {
+            if (raw[jj] > *tnull)       /* a repeat of a value passed */
+                continue;
+            if (*tnull == minraw)
+            {
+                found = 0;
+                break;
+            }
+            (*tnull)--;
+        }
+    }
+    else
+    {
+        *tnull = minraw;
+        for (jj = 0; jj < nvalid && raw[jj] <= *tnull; jj++)
+        {
+            if (raw[jj] < *tnull)       /* a repeat of a value passed */
+                continue;
+            if (*tnull == maxraw)
+            {
+                found = 0;
+                break;
+            }
+            (*tnull)++;
+        }
+    }
+    free(raw);
+
+    if (!found)
+    {
+        snprintf(message, FLEN_ERRMSG,
+            "Every %c value occurs, so no TNULLn value is free (ffparw)",
+            tcode);
+        ffpmsg(message);
+        return(*status = NO_NULL);
+    }
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+static int arw_cmp_raw(const void *a, const void *b)
+{
+    LONGLONG va = *(const LONGLONG *) a, vb = *(const LONGLONG *) b;
+
+    return(va < vb ? -1 : va > vb);
+}
+/*--------------------------------------------------------------------------*/
+static const char *arw_format(int datatype, /* I - CFITSIO equivalent type  */
+           int *esize)                      /* O - size of each value       */
+/*
+  return the Arrow format string of a numeric or logical column, or NULL
+  if the column type can not be represented by an Arrow primitive type
+*/
+{
+    switch (datatype)
+    {
+        case TBYTE:      *esize = 1; return("C");
+        case TSBYTE:     *esize = 1; return("c");
+        case TLOGICAL:   *esize = 1; return("b");
+        case TSHORT:     *esize = 2; return("s");
+        case TUSHORT:    *esize = 2; return("S");
+        case TINT:
+        case TLONG:      *esize = 4; return("i");
+        case TUINT:
+        case TULONG:     *esize = 4; return("I");
+        case TLONGLONG:  *esize = 8; return("l");
+        case TULONGLONG: *esize = 8; return("L");
+        case TFLOAT:     *esize = 4; return("f");
+        case TDOUBLE:    *esize = 8; return("g");
+    }
+    return(NULL);
+}
+/*--------------------------------------------------------------------------*/
+static int arw_datatype(const char *format, /* I - Arrow format string      */
+           int *esize,                      /* O - size of each value       */
+           char *tcode)                     /* O - TFORMn datatype letter   */
+/*
+  return the CFITSIO datatype for an Arrow primitive format string, or 0
+  if the format is not supported
+*/
+{
+    if (!format || strlen(format) != 1)
+        return(0);
+
+    switch (format[0])
+    {
+        case 'C': *esize = 1; *tcode = 'B'; return(TBYTE);
+        case 'c': *esize = 1; *tcode = 'S'; return(TSBYTE);
+        case 'b': *esize = 1; *tcode = 'L'; return(TLOGICAL);
+        case 's': *esize = 2; *tcode = 'I'; return(TSHORT);
+        case 'S': *esize = 2; *tcode = 'U'; return(TUSHORT);
+        case 'i': *esize = 4; *tcode = 'J'; return(TINT);
+        case 'I': *esize = 4; *tcode = 'V'; return(TUINT);
+        case 'l': *esize = 8; *tcode = 'K'; return(TLONGLONG);
+        case 'L': *esize = 8; *tcode = 'W'; return(TULONGLONG);
+        case 'f': *esize = 4; *tcode = 'E'; return(TFLOAT);
+        case 'g': *esize = 8; *tcode = 'D'; return(TDOUBLE);
+    }
+    return(0);
+}
+/*--------------------------------------------------------------------------*/
+static int arw_init_schema(struct ArrowSchema *schema, /* O - schema        */
+           const char *format,          /* I - Arrow format string           */
+           const char *name,            /* I - field name                    */
+           int nchildren,               /* I - number of child fields        */
+           int *status)                 /* IO - error status                 */
+/*
+  initialize an exported ArrowSchema, allocating its (empty) children
+*/
+{
+    ArwSchemaData *priv;
+    int ii;
+
+    if (*status > 0)
+        return(*status);
+
+    memset(schema, 0, sizeof(struct ArrowSchema));
+    priv = (ArwSchemaData *) calloc(1, sizeof(ArwSchemaData));
+    if (!priv)
+        return(*status = MEMORY_ALLOCATION);
+
+    strncat(priv->format, format, FLEN_VALUE - 1);
+    snprintf(priv->name, FLEN_VALUE, "%s", name);
+    schema->format = priv->format;
+    schema->name = priv->name;
+    schema->flags = ARROW_FLAG_NULLABLE;
+    schema->private_data = priv;
+    schema->release = arw_release_schema;
+
+    if (nchildren > 0)
+    {
+        schema->children = (struct ArrowSchema **)
+                           calloc(nchildren, sizeof(struct ArrowSchema *));
+        if (!schema->children)
+            return(*status = MEMORY_ALLOCATION);
+
+        for (ii = 0; ii < nchildren; ii++)
+        {
+            schema->children[ii] = (struct ArrowSchema *)
+                                   calloc(1, sizeof(struct ArrowSchema));
+            if (!schema->children[ii])
+                return(*status = MEMORY_ALLOCATION);
+            schema->n_children++;
+        }
+    }
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+static int arw_init_array(struct ArrowArray *array, /* O - array            */
+           LONGLONG length,             /* I - number of elements            */
+           int nbuffers,                /* I - number of buffers             */
+           int nchildren,               /* I - number of child arrays        */
+           int *status)                 /* IO - error status                 */
+/*
+  initialize an exported ArrowArray, allocating its (empty) children.
+  The buffers themselves are allocated later with arw_alloc_buffer.
+*/
+{
+    ArwArrayData *priv;
+    int ii;
+
+    if (*status > 0)
+        return(*status);
+
+    if (array->release)   /* re-initializing, e.g. after sizing a list */
+        array->release(array);
+
+    memset(array, 0, sizeof(struct ArrowArray));
+    priv = (ArwArrayData *) calloc(1, sizeof(ArwArrayData));
+    if (!priv)
+        return(*status = MEMORY_ALLOCATION);
+
+    array->length = length;
+    array->n_buffers = nbuffers;
+    array->buffers = (const void **) priv->buffers;
+    array->private_data = priv;
+    array->release = arw_release_array;
+
+    if (nchildren > 0)
+    {
+        array->children = (struct ArrowArray **)
+                          calloc(nchildren, sizeof(struct ArrowArray *));
+        if (!array->children)
+            return(*status = MEMORY_ALLOCATION);
+
+        for (ii = 0; ii < nchildren; ii++)
+        {
+            array->children[ii] = (struct ArrowArray *)
+                                  calloc(1, sizeof(struct ArrowArray));
+            if (!array->children[ii])
+                return(*status = MEMORY_ALLOCATION);
+            array->n_children++;
+        }
+    }
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+static void *arw_alloc_buffer(struct ArrowArray *array, /* IO - array       */
+           int ibuf,                    /* I - number of the buffer          */
+           LONGLONG nbytes,             /* I - size of the buffer in bytes   */
+           int *status)                 /* IO - error status                 */
+/*
+  allocate one zero-filled buffer of an exported array.  Buffers are padded
+  to a multiple of 8 bytes and are never shorter than 8 bytes.
+*/
+{
+    ArwArrayData *priv;
+
+    if (*status > 0)
+        return(NULL);
+
+    priv = (ArwArrayData *) array->private_data;
+    priv->buffers[ibuf] = calloc((size_t) ((nbytes + 15) / 8), 8);
+    if (!priv->buffers[ibuf])
+    {
+        ffpmsg("malloc failed for Arrow buffer");
+        *status = MEMORY_ALLOCATION;
+    }
+    return(priv->buffers[ibuf]);
+}
+/*--------------------------------------------------------------------------*/
+static void arw_release_schema(struct ArrowSchema *schema)
+/*
+  release callback of the exported schemas
+*/
+{
+    LONGLONG ii;
+
+    for (ii = 0; ii < schema->n_children; ii++)
+    {
+        if (schema->children[ii]->release)
+            schema->children[ii]->release(schema->children[ii]);
+        free(schema->children[ii]);
+    }
+    free(schema->children);
+    free(schema->private_data);
+    schema->release = NULL;
+}
+/*--------------------------------------------------------------------------*/
+static void arw_release_array(struct ArrowArray *array)
+/*
+  release callback of the exported arrays
+*/
+{
+    ArwArrayData *priv;
+    LONGLONG ii;
+
+    for (ii = 0; ii < array->n_children; ii++)
+    {
+        if (array->children[ii]->release)
+            array->children[ii]->release(array->children[ii]);
+        free(array->children[ii]);
+    }
+    free(array->children);
+
+    priv = (ArwArrayData *) array->private_data;
+    for (ii = 0; ii < 3; ii++)
+        free(priv->buffers[ii]);
+    free(priv);
+    array->release = NULL;
+}
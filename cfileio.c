@@ -42,8 +42,60 @@ typedef struct    /* structure containing pointers to I/O driver functions */
 
 fitsdriver driverTable[MAX_DRIVERS];  /* allocate driver tables */
 
-FITSfile *FptrTable[NMAXFILES];  /* this table of Fptr pointers is */
-                                 /* used by fits_already_open */
+/*
+   The registry of open files, used by fits_already_open.  The entry of
+   each open FITSfile holds the parsed components of its filename, with
+   the root file name already standardized, so that a file being opened
+   is only compared with the files that have the same root name.  The
+   entries are chained in a hash table of openTableSize buckets that
+   grows with the number of open files.
+*/
+typedef struct FFopenfile {
+    FITSfile *Fptr;           /* the open file */
+    unsigned long hash;       /* hash of the standardized root file name */
+    char *urltype;            /* file type, e.g. "file://" */
+    char *infile;             /* standardized root file name */
+    char *extspec;            /* extension specifier */
+    char *rowfilter;          /* row filter expression */
+    char *binspec;            /* histogram binning specifier */
+    char *colspec;            /* column filter specifier */
+    struct FFopenfile *next;  /* next entry in the same bucket */
+} FFopenfile;
+
+static FFopenfile **openTable = 0;  /* hash buckets of open file entries */
+static unsigned long openTableSize = 0;
+static unsigned long numOpenFiles = 0;
+
+/*
+   The driver handle of a READONLY file that is shared by independent
+   readers (see ffropn).  Each reader has its own FITSfile structure, with
+   its own HDU position and I/O buffers, and only the positioning and
+   reading of the driver handle, in ffread, is done under the lock.  The
+   handle is closed when the last reader using it is closed.
+*/
+typedef struct {
+#ifdef _REENTRANT
+    pthread_mutex_t lock;     /* serializes the use of the driver handle */
+#endif
+    int nusers;               /* number of FITSfile structures using it */
+} FFiosource;
+
+/*
+   A small cache of input file names that have been interpreted by the
+   general extended filename parser.  Each entry holds the name followed
+   by its FFPARSE_NPART components, in the order of the ffifile2
+   arguments, in one allocated block.  A name can only be held in the
+   slot given by its hash value.
+*/
+#define FFPARSE_NPART  9    /* number of components of a parsed name */
+#define FFPARSE_CACHE 64    /* number of cache slots */
+
+typedef struct {
+    unsigned long hash;       /* hash of the name */
+    char *url;                /* the name, followed by its components */
+} FFparsedname;
+
+static FFparsedname parseCache[FFPARSE_CACHE];
 
 int need_to_initialize = 1;    /* true if CFITSIO has not been initialized */
 int no_of_drivers = 0;         /* number of currently defined I/O drivers */
@@ -56,12 +108,47 @@ static int find_paren(char **string);
 static int find_bracket(char **string);
 static int find_curlybracket(char **string);
 static int standardize_path(char *fullpath, int *status);
+static unsigned long fits_hash_filename(const char *name);
+static FFopenfile *fits_new_openfile(FITSfile *Fptr);
+static int ffclosedrv(FITSfile *Fptr);
+static int ffifile_simple(char *url, char *urltype, char *infilex,
+           char *extspec);
+static int ffifile_cached(char *url, char *output[]);
+static void ffifile_save(char *url, char part[][FLEN_FILENAME]);
+static int ffifile_parse(char *url, char *urltype, char *infilex,
+           char *outfile, char *extspec, char *rowfilterx, char *binspec,
+           char *colspec, char *pixfilter, char *compspec, int *status);
 int comma2semicolon(char *string);
 
 #ifdef _REENTRANT
 
 pthread_mutex_t Fitsio_InitLock = PTHREAD_MUTEX_INITIALIZER;
 
+/* protects the registry of open files, separately from Fitsio_Lock; */
+/* locked directly, as FFLOCK1 would write the shared status global */
+static pthread_mutex_t Fitsio_OpenLock = PTHREAD_MUTEX_INITIALIZER;
+#define FFLOCKOPEN    pthread_mutex_lock(&Fitsio_OpenLock)
+#define FFUNLOCKOPEN  pthread_mutex_unlock(&Fitsio_OpenLock)
+
+/* protects the cache of parsed file names; also locked directly */
+static pthread_mutex_t Fitsio_ParseLock = PTHREAD_MUTEX_INITIALIZER;
+#define FFLOCKPARSE   pthread_mutex_lock(&Fitsio_ParseLock)
+#define FFUNLOCKPARSE pthread_mutex_unlock(&Fitsio_ParseLock)
+
+/* protects a driver handle shared by independent readers; unlike FFLOCK1, */
+/* this does not set Fitsio_Pthread_Status, since the readers run at once */
+#define FFLOCKSOURCE(src)   pthread_mutex_lock(&(src)->lock)
+#define FFUNLOCKSOURCE(src) pthread_mutex_unlock(&(src)->lock)
+
+#else
+
+#define FFLOCKOPEN
+#define FFUNLOCKOPEN
+#define FFLOCKPARSE
+#define FFUNLOCKPARSE
+#define FFLOCKSOURCE(src)
+#define FFUNLOCKSOURCE(src)
+
 #endif
 
 /*--------------------------------------------------------------------------*/
@@ -170,10 +257,8 @@ int ffomem(fitsfile **fptr,      /* O - FITS file pointer                   */
     }
 
     /* call driver routine to open the memory file */
-    FFLOCK;  /* lock this while searching for vacant handle */
     *status =   mem_openmem( buffptr, buffsize,deltasize,
                             mem_realloc,  &handle);
-    FFUNLOCK;
 
     if (*status > 0)
     {
@@ -563,7 +648,7 @@ int ffopen(fitsfile **fptr,      /* O - FITS file pointer                   */
     fitsfile *newptr;
     int  ii, driver, hdutyp, hdunum, slen, writecopy, isopen;
     LONGLONG filesize;
-    long rownum, nrows, goodrows;
+    long rownum;
     int extnum, extvers, handle, movetotype, tstatus = 0, only_one = 0;
     char urltype[MAX_PREFIX_LEN], infile[FLEN_FILENAME], outfile[FLEN_FILENAME];
     char origurltype[MAX_PREFIX_LEN], extspec[FLEN_FILENAME];
@@ -585,7 +670,7 @@ int ffopen(fitsfile **fptr,      /* O - FITS file pointer                   */
     char colname[4][FLEN_VALUE];
     char errmsg[FLEN_ERRMSG];
     char *hdtype[3] = {"IMAGE", "TABLE", "BINTABLE"};
-    char *rowselect = 0;
+    char *binfilter = 0;
 
     if (*status > 0)
         return(*status);
@@ -733,14 +818,11 @@ int ffopen(fitsfile **fptr,      /* O - FITS file pointer                   */
     /* check if this same file is already open, and if so, attach to it  */
     /*-------------------------------------------------------------------*/
 
-    FFLOCK;
     if (fits_already_open(fptr, url, urltype, infile, extspec, rowfilter,
             binspec, colspec, mode, open_disk_file, &isopen, status) > 0)
     {
-        FFUNLOCK;
         return(*status);
     }
-    FFUNLOCK;
 
     if (isopen) {
        goto move2hdu;  
@@ -796,7 +878,7 @@ int ffopen(fitsfile **fptr,      /* O - FITS file pointer                   */
     /* call appropriate driver to open the file */
     if (driverTable[driver].open)
     {
-        FFLOCK;  /* lock this while searching for vacant handle */
+        FFLOCK;  /* some drivers use static variables while opening */
         *status =  (*driverTable[driver].open)(infile, mode, &handle);
         FFUNLOCK;
         if (*status > 0)
@@ -1252,36 +1334,11 @@ move2hdu:
       {
         /*  since we are going to make a histogram of the selected rows,   */
         /*  it would be a waste of time and memory to make a whole copy of */
-        /*  the selected rows.  Instead, just construct an array of TRUE   */
-        /*  or FALSE values that indicate which rows are to be included    */
-        /*  in the histogram and pass that to the histogram generating     */
-        /*  routine                                                        */
-
-        fits_get_num_rows(*fptr, &nrows, status);  /* get no. of rows */
+        /*  the selected rows.  Instead, the histogram generating routine  */
+        /*  evaluates the filter along with the binning values, and only   */
+        /*  bins the rows for which it is TRUE                             */
 
-        rowselect = (char *) calloc(nrows, 1);
-        if (!rowselect)
-        {
-           ffpmsg(
-           "failed to allocate memory for selected columns array (ffopen)");
-           ffpmsg(" while trying to select rows with the following filter:");
-           ffpmsg(rowfilter);
-           ffclos(*fptr, status);
-           *fptr = 0;              /* return null file pointer */
-           return(*status = MEMORY_ALLOCATION);
-        }
-
-        if (fits_find_rows(*fptr, rowfilter, 1L, nrows, &goodrows,
-            rowselect, status) > 0)
-        {
-           ffpmsg("selection of rows in input table failed (ffopen)");
-           ffpmsg(" while trying to select rows with the following filter:");
-           ffpmsg(rowfilter);
-           free(rowselect);
-           ffclos(*fptr, status);
-           *fptr = 0;              /* return null file pointer */
-           return(*status);
-        }
+        binfilter = rowfilter;
       }
       else
       {
@@ -1347,17 +1404,14 @@ move2hdu:
        
        /* Create the histogram primary array and open it as the current fptr */
        /* This will close the table that was used to create the histogram. */
-       ffhist2e(fptr, outfile, imagetype, haxis, 
+       ffhist2ef(fptr, outfile, imagetype, haxis, 
 		colname, exprs, minin, maxin, binsizein, 
 		minname, maxname, binname,
 		weight, wtcol, (exprs?exprs[4]:0),
-		recip, rowselect, status);
+		recip, 0, binfilter, status);
 
        if (exprs) free(exprs);
 
-       if (rowselect)
-          free(rowselect);
-
        if (*status > 0)
        {
       ffpmsg("on-the-fly histogramming of input table failed (ffopen)");
@@ -1451,25 +1505,220 @@ int ffreopen(fitsfile *openfptr, /* I - FITS file pointer to open file  */
     return(*status);
 }
 /*--------------------------------------------------------------------------*/
+int ffropn(fitsfile *openfptr, /* I - FITS file pointer to open file    */
+           fitsfile **newfptr,  /* O - pointer to the new reader         */
+           int *status)         /* IO - error status                     */
+/*
+  Open an independent reader of a FITS file that was opened READONLY.
+  Unlike ffreopen, the reader has its own FITSfile structure, with its own
+  current HDU and I/O buffers, so it may be used by a different thread
+  than the open file, in parallel with it and with the other readers.
+  The reader shares the driver handle of the open file, instead of
+  opening the file again, and starts with a copy of the HDU directory
+  and of the saved HDU descriptors of the open file, so moving to an HDU
+  whose position is already known does not scan the preceding headers.
+  The reader is positioned at the primary array.
+*/
+{
+    FITSfile *Fptr, *newFptr;
+    FFiosource *source;
+    int ii, slen, hdutyp;
+
+    if (*status > 0)
+        return(*status);
+
+    *newfptr = 0;
+
+    /* check that the open file pointer is valid */
+    if (!openfptr)
+        return(*status = NULL_INPUT_PTR);
+    else if ((openfptr->Fptr)->validcode != VALIDSTRUC) /* check magic value */
+        return(*status = BAD_FILEPTR);
+
+    Fptr = openfptr->Fptr;
+
+    if (Fptr->writemode != READONLY)
+    {
+        ffpmsg("cannot open a reader of a file opened READWRITE (ffropn)");
+        ffpmsg(Fptr->filename);
+        return(*status = FILE_NOT_OPENED);
+    }
+
+    /* allocate the structures of the reader, initialized = 0 */
+    *newfptr = (fitsfile *) calloc(1, sizeof(fitsfile));
+    newFptr = (FITSfile *) calloc(1, sizeof(FITSfile));
+
+    slen = strlen(Fptr->filename) + 1;
+    slen = maxvalue(slen, 32); /* reserve at least 32 chars */
+
+    if (*newfptr && newFptr)
+    {
+        newFptr->filename = (char *) malloc(slen);
+        newFptr->headstart = (LONGLONG *) calloc(Fptr->MAXHDU + 1,
+                                                 sizeof(LONGLONG));
+        newFptr->iobuffer = (char *) calloc(NIOBUF, IOBUFLEN);
+    }
+
+    if (!(*newfptr) || !newFptr || !newFptr->filename ||
+        !newFptr->headstart || !newFptr->iobuffer)
+    {
+        if (newFptr)
+        {
+            free(newFptr->iobuffer);
+            free(newFptr->headstart);
+            free(newFptr->filename);
+            free(newFptr);
+        }
+        free(*newfptr);
+        *newfptr = 0;
+        ffpmsg("failed to allocate structure for the reader (ffropn)");
+        ffpmsg(Fptr->filename);
+        return(*status = MEMORY_ALLOCATION);
+    }
+
+    /* share the driver handle of the open file */
+    source = (FFiosource *) Fptr->iosource;
+    if (!source)
+    {
+        source = (FFiosource *) calloc(1, sizeof(FFiosource));
+        if (!source)
+        {
+            free(newFptr->iobuffer);
+            free(newFptr->headstart);
+            free(newFptr->filename);
+            free(newFptr);
+            free(*newfptr);
+            *newfptr = 0;
+            ffpmsg("failed to allocate structure for the reader (ffropn)");
+            return(*status = MEMORY_ALLOCATION);
+        }
+
+#ifdef _REENTRANT
+        pthread_mutex_init(&source->lock, NULL);
+#endif
+        source->nusers = 1;
+        Fptr->iosource = source;
+    }
+
+    FFLOCKSOURCE(source);
+    (source->nusers)++;
+    FFUNLOCKSOURCE(source);
+
+    /* initialize the ageindex array (relative age of the I/O buffers) */
+    /* and initialize the bufrecnum array as being empty */
+    for (ii = 0; ii < NIOBUF; ii++)  {
+        newFptr->ageindex[ii] = ii;
+        newFptr->bufrecnum[ii] = -1;
+    }
+
+    /* copy the HDU directory, which cannot change in a READONLY file */
+    memcpy(newFptr->headstart, Fptr->headstart,
+           (Fptr->MAXHDU + 1) * sizeof(LONGLONG));
+    newFptr->MAXHDU = Fptr->MAXHDU;
+    newFptr->maxhdu = Fptr->maxhdu;
+
+        /* store the parameters describing the file */
+    newFptr->iosource = source;                /* shared driver handle */
+    newFptr->filehandle = Fptr->filehandle;    /* file handle */
+    newFptr->driver = Fptr->driver;            /* driver number */
+    strcpy(newFptr->filename, Fptr->filename); /* full input filename */
+    newFptr->filesize = Fptr->filesize;        /* physical file size */
+    newFptr->logfilesize = Fptr->logfilesize;  /* logical file size */
+    newFptr->writemode = READONLY;             /* read-write mode */
+    newFptr->datastart = DATA_UNDEFINED;       /* unknown start of data */
+    newFptr->curbuf = -1;               /* undefined current IO buffer */
+    newFptr->io_pos = -1;               /* no current driver position */
+    newFptr->open_count = 1;       /* structure is currently used once */
+    newFptr->validcode = VALIDSTRUC;   /* flag denoting valid structure */
+    newFptr->only_one = Fptr->only_one;
+    newFptr->noextsyntax = Fptr->noextsyntax;
+
+    /* read compressed images with the same options as the open file */
+    newFptr->request_compress_type = Fptr->request_compress_type;
+    for (ii = 0; ii < MAX_COMPRESS_DIM; ii++)
+        newFptr->request_tilesize[ii] = Fptr->request_tilesize[ii];
+    newFptr->request_quantize_level = Fptr->request_quantize_level;
+    newFptr->request_quantize_method = Fptr->request_quantize_method;
+    newFptr->request_dither_seed = Fptr->request_dither_seed;
+    newFptr->request_lossy_int_compress = Fptr->request_lossy_int_compress;
+    newFptr->request_huge_hdu = Fptr->request_huge_hdu;
+    newFptr->request_hcomp_scale = Fptr->request_hcomp_scale;
+    newFptr->request_hcomp_smooth = Fptr->request_hcomp_smooth;
+
+    ffhcclone(newFptr, Fptr);
+
+    (*newfptr)->Fptr = newFptr;
+    (*newfptr)->HDUposition = 0;  /* set initial position to primary array */
+
+    ffldrc(*newfptr, 0, REPORT_EOF, status);     /* load first record */
+
+    if (ffrhdu(*newfptr, &hdutyp, status) > 0)  /* determine HDU structure */
+    {
+        ffpmsg("ffropn could not interpret primary array header of file:");
+        ffpmsg(Fptr->filename);
+        ffclos(*newfptr, status);
+        *newfptr = 0;
+    }
+
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
 int fits_store_Fptr(FITSfile *Fptr,  /* O - FITS file pointer               */ 
            int *status)              /* IO - error status                   */
 /*
    store the new Fptr address for future use by fits_already_open 
 */
 {
-    int ii;
+    FFopenfile *entry, **newtable, *next;
+    unsigned long ii, newsize;
 
     if (*status > 0)
         return(*status);
 
-    FFLOCK;
-    for (ii = 0; ii < NMAXFILES; ii++) {
-        if (FptrTable[ii] == 0) {
-            FptrTable[ii] = Fptr;
-            break;
+    /* parse the filename before taking the lock */
+    entry = fits_new_openfile(Fptr);
+    if (!entry)
+        return(*status);  /* cannot attach to this file later; not an error */
+
+    FFLOCKOPEN;
+
+    /* grow the hash table when the chains become long */
+    if (numOpenFiles >= 2 * openTableSize)
+    {
+        newsize = (openTableSize ? 4 * openTableSize : 64);
+        newtable = (FFopenfile **) calloc(newsize, sizeof(FFopenfile *));
+
+        if (newtable)  /* otherwise just keep using longer chains */
+        {
+            for (ii = 0; ii < openTableSize; ii++)
+            {
+                for ( ; openTable[ii]; openTable[ii] = next)
+                {
+                    next = openTable[ii]->next;
+                    openTable[ii]->next = newtable[openTable[ii]->hash % newsize];
+                    newtable[openTable[ii]->hash % newsize] = openTable[ii];
+                }
+            }
+            free(openTable);
+            openTable = newtable;
+            openTableSize = newsize;
         }
     }
-    FFUNLOCK;
+
+    if (openTableSize)
+    {
+        /* insert at the head, so the most recently opened file is found first */
+        entry->next = openTable[entry->hash % openTableSize];
+        openTable[entry->hash % openTableSize] = entry;
+        Fptr->openfile = entry;
+        numOpenFiles++;
+    }
+    else
+    {
+        free(entry);
+    }
+
+    FFUNLOCKOPEN;
     return(*status);
 }
 /*--------------------------------------------------------------------------*/
@@ -1479,19 +1728,120 @@ int fits_clear_Fptr(FITSfile *Fptr,  /* O - FITS file pointer               */
    clear the Fptr address from the Fptr Table  
 */
 {
-    int ii;
+    FFopenfile *entry, **prev;
 
-    FFLOCK;
-    for (ii = 0; ii < NMAXFILES; ii++) {
-        if (FptrTable[ii] == Fptr) {
-            FptrTable[ii] = 0;
-            break;
+    FFLOCKOPEN;
+
+    entry = (FFopenfile *) Fptr->openfile;
+    if (entry)
+    {
+        for (prev = &openTable[entry->hash % openTableSize]; *prev; 
+             prev = &(*prev)->next)
+        {
+            if (*prev == entry)
+            {
+                *prev = entry->next;
+                numOpenFiles--;
+                break;
+            }
         }
+        Fptr->openfile = 0;
     }
-    FFUNLOCK;
+
+    FFUNLOCKOPEN;
+
+    free(entry);
     return(*status);
 }
 /*--------------------------------------------------------------------------*/
+static FFopenfile *fits_new_openfile(FITSfile *Fptr) /* I - open file */
+/*
+   allocate a registry entry for the open file, holding the components of
+   its filename as they are compared by fits_already_open.  Returns NULL
+   if the filename cannot be parsed or memory cannot be allocated.
+*/
+{
+    FFopenfile *entry;
+    char urltype[MAX_PREFIX_LEN], infile[FLEN_FILENAME];
+    char extspec[FLEN_FILENAME], outfile[FLEN_FILENAME];
+    char rowfilter[FLEN_FILENAME];
+    char binspec[FLEN_FILENAME], colspec[FLEN_FILENAME];
+    char *cptr;
+    int tstatus = 0;
+    size_t len;
+
+    ffpmrk();  /* discard any messages from parsing the name below */
+
+    if (Fptr->noextsyntax)
+    {
+        /* the filename is the name of a disk file */
+        if (strlen(Fptr->filename) > FLEN_FILENAME-1)
+        {
+            ffcmrk();
+            return(NULL);
+        }
+
+        strcpy(urltype, "file://");
+        strcpy(infile, Fptr->filename);
+        extspec[0] = rowfilter[0] = binspec[0] = colspec[0] = '\0';
+        standardize_path(infile, &tstatus);
+    }
+    else
+    {
+        fits_parse_input_url(Fptr->filename, urltype, infile, outfile,
+             extspec, rowfilter, binspec, colspec, &tstatus);
+
+        if (!tstatus && fits_strcasecmp(urltype, "FILE://") == 0)
+            standardize_path(infile, &tstatus);
+    }
+
+    ffcmrk();
+    if (tstatus > 0)
+        return(NULL);
+
+    len = strlen(urltype) + strlen(infile) + strlen(extspec) +
+          strlen(rowfilter) + strlen(binspec) + strlen(colspec) + 6;
+
+    entry = (FFopenfile *) malloc(sizeof(FFopenfile) + len);
+    if (!entry)
+        return(NULL);
+
+    /* the strings are stored after the structure, in the same block */
+    cptr = (char *) (entry + 1);
+    entry->urltype = strcpy(cptr, urltype);
+    cptr += strlen(cptr) + 1;
+    entry->infile = strcpy(cptr, infile);
+    cptr += strlen(cptr) + 1;
+    entry->extspec = strcpy(cptr, extspec);
+    cptr += strlen(cptr) + 1;
+    entry->rowfilter = strcpy(cptr, rowfilter);
+    cptr += strlen(cptr) + 1;
+    entry->binspec = strcpy(cptr, binspec);
+    cptr += strlen(cptr) + 1;
+    entry->colspec = strcpy(cptr, colspec);
+
+    entry->Fptr = Fptr;
+    entry->hash = fits_hash_filename(infile);
+    entry->next = 0;
+    return(entry);
+}
+/*--------------------------------------------------------------------------*/
+static unsigned long fits_hash_filename(const char *name) /* I - file name */
+/*
+   return the FNV-1a hash of a file name
+*/
+{
+    unsigned long hash = 2166136261UL;
+
+    while (*name)
+    {
+        hash ^= (unsigned char) *name++;
+        hash *= 16777619UL;
+        hash &= 0xffffffffUL;
+    }
+    return(hash);
+}
+/*--------------------------------------------------------------------------*/
 int fits_already_open(fitsfile **fptr, /* I/O - FITS file pointer       */ 
            char *url, 
            char *urltype, 
@@ -1521,16 +1871,15 @@ int fits_already_open(fitsfile **fptr, /* I/O - FITS file pointer       */
        version of this function would not have reconized that the two files
        were the same. This version does recognize that the two files are
        the same.
+
+       The names of the open files are parsed and standardized when they
+       are stored in the registry by fits_store_Fptr, so only the files
+       with the same root file name are compared here.
      */
 {
-    FITSfile *oldFptr;
-    int ii, iMatch=-1;
-    char oldurltype[MAX_PREFIX_LEN], oldinfile[FLEN_FILENAME];
-    char oldextspec[FLEN_FILENAME], oldoutfile[FLEN_FILENAME];
-    char oldrowfilter[FLEN_FILENAME];
-    char oldbinspec[FLEN_FILENAME], oldcolspec[FLEN_FILENAME];
-    char cwd[FLEN_FILENAME];
-    char tmpStr[FLEN_FILENAME];
+    FITSfile *oldFptr = 0;
+    FFopenfile *entry;
+    unsigned long hash;
     char tmpinfile[FLEN_FILENAME]; 
     
     *isopen = 0;
@@ -1554,122 +1903,79 @@ int fits_already_open(fitsfile **fptr, /* I/O - FITS file pointer       */
           return(*status);          
     }
 
-    for (ii = 0; ii < NMAXFILES; ii++)   /* check every buffer */
+    hash = fits_hash_filename(tmpinfile);
+
+    FFLOCKOPEN;
+
+    entry = (openTableSize ? openTable[hash % openTableSize] : 0);
+    for ( ; entry; entry = entry->next)
     {
-        if (FptrTable[ii] != 0)
+        if (entry->hash != hash || strcmp(tmpinfile, entry->infile))
+            continue;  /* different root file */
+
+        if (entry->Fptr->noextsyntax)
         {
-          oldFptr = FptrTable[ii];
-          
-          if (oldFptr->noextsyntax)
-          {
             /* old urltype must be "file://" */
-            if (fits_strcasecmp(urltype,"FILE://") == 0)
-            {
-               /* compare tmpinfile to adjusted oldFptr->filename */
-               
-               /* This shouldn't be possible, but check anyway */
-               if (strlen(oldFptr->filename) > FLEN_FILENAME-1)        
-               {
-                  ffpmsg("Name of old file is too long. (fits_already_open)");
-                  return (*status = FILE_NOT_OPENED);
-               }
-               strcpy(oldinfile, oldFptr->filename);
-               if (standardize_path(oldinfile, status))
-                  return(*status);
-                              
-               if (!strcmp(tmpinfile, oldinfile))
-               {
-                  /* if infile is not noextsyn, must check that it is not
-                     using filters of any kind */
-                  if (noextsyn || (!rowfilter[0] && !binspec[0] && !colspec[0])) 
-                  {
-                     if (mode == READWRITE && oldFptr->writemode == READONLY)
-                     {
-                       /*
-                         cannot assume that a file previously opened with READONLY
-                         can now be written to (e.g., files on CDROM, or over the
-                         the network, or STDIN), so return with an error.
-                       */
-
-                       ffpmsg(
-                   "cannot reopen file READWRITE when previously opened READONLY");
-                       ffpmsg(url);
-                       return(*status = FILE_NOT_OPENED);
-                     }
-                     iMatch = ii;
-                  }  
-               }
-             }            
-          } /* end if old file has disabled extended syntax */
-          else
-          {
-             fits_parse_input_url(oldFptr->filename, oldurltype, 
-                       oldinfile, oldoutfile, oldextspec, oldrowfilter, 
-                       oldbinspec, oldcolspec, status);
+            if (fits_strcasecmp(urltype,"FILE://") != 0)
+                continue;
 
-             if (*status > 0)
-             {
-               ffpmsg("could not parse the previously opened filename: (ffopen)");
-               ffpmsg(oldFptr->filename);
-               return(*status);
-             }
-             
-             if(fits_strcasecmp(oldurltype,"FILE://") == 0)
-               {
-                 if (standardize_path(oldinfile, status))
-                    return(*status);
-               }
+            /* if infile is not noextsyn, must check that it is not
+               using filters of any kind */
+            if (!noextsyn && (rowfilter[0] || binspec[0] || colspec[0]))
+                continue;
+        }
+        else
+        {
+            if (strcmp(urltype, entry->urltype))
+                continue;  /* different type of file */
 
-             if (!strcmp(urltype, oldurltype) && !strcmp(tmpinfile, oldinfile) )
-             {
-                 /* identical type of file and root file name */
+            if ( !(!rowfilter[0] && !entry->rowfilter[0] &&
+                   !binspec[0]   && !entry->binspec[0] &&
+                   !colspec[0]   && !entry->colspec[0])
 
-                 if ( (!rowfilter[0] && !oldrowfilter[0] &&
-                       !binspec[0]   && !oldbinspec[0] &&
-                       !colspec[0]   && !oldcolspec[0])
+                 /* no filtering or binning specs for either file, so */
+                 /* this is a case where the same file is being reopened. */
+                 /* It doesn't matter if the extensions are different */
 
-                     /* no filtering or binning specs for either file, so */
-                     /* this is a case where the same file is being reopened. */
-                     /* It doesn't matter if the extensions are different */
+                 &&   /* and not */
 
-                         ||   /* or */
+                 !(!strcmp(rowfilter, entry->rowfilter) &&
+                   !strcmp(binspec, entry->binspec)     &&
+                   !strcmp(colspec, entry->colspec)     &&
+                   !strcmp(extspec, entry->extspec) ) )
 
-                     (!strcmp(rowfilter, oldrowfilter) &&
-                      !strcmp(binspec, oldbinspec)     &&
-                      !strcmp(colspec, oldcolspec)     &&
-                      !strcmp(extspec, oldextspec) ) )
+                 /* filtering specs are given and are identical, and */
+                 /* the same extension is specified */
 
-                     /* filtering specs are given and are identical, and */
-                     /* the same extension is specified */
+                continue;
+        }
 
-                 {
-                     if (mode == READWRITE && oldFptr->writemode == READONLY)
-                     {
-                       /*
-                         cannot assume that a file previously opened with READONLY
-                         can now be written to (e.g., files on CDROM, or over the
-                         the network, or STDIN), so return with an error.
-                       */
-
-                       ffpmsg(
-                   "cannot reopen file READWRITE when previously opened READONLY");
-                       ffpmsg(url);
-                       return(*status = FILE_NOT_OPENED);
-                     }
-                     iMatch = ii;
+        if (mode == READWRITE && entry->Fptr->writemode == READONLY)
+        {
+            /*
+              cannot assume that a file previously opened with READONLY
+              can now be written to (e.g., files on CDROM, or over the
+              the network, or STDIN), so return with an error.
+            */
+            FFUNLOCKOPEN;
 
-                  }
-              }
-          } /* end if old file recognizes extended syntax */
-      } /* end if old fptr exists */
-    } /* end loop over NMAXFILES */
-    if (iMatch >= 0)
+            ffpmsg(
+        "cannot reopen file READWRITE when previously opened READONLY");
+            ffpmsg(url);
+            return(*status = FILE_NOT_OPENED);
+        }
+
+        if (!oldFptr)
+            oldFptr = entry->Fptr;  /* the most recently opened match */
+    }
+
+    if (oldFptr)
     {
-       oldFptr = FptrTable[iMatch];
        *fptr = (fitsfile *) calloc(1, sizeof(fitsfile));
 
        if (!(*fptr))
        {
+          FFUNLOCKOPEN;
           ffpmsg(
         "failed to allocate structure for following file: (ffopen)");
           ffpmsg(url);
@@ -1679,7 +1985,12 @@ int fits_already_open(fitsfile **fptr, /* I/O - FITS file pointer       */
        (*fptr)->Fptr = oldFptr; /* point to the structure */
        (*fptr)->HDUposition = 0;     /* set initial position */
        (((*fptr)->Fptr)->open_count)++;  /* increment usage counter */
+    }
+
+    FFUNLOCKOPEN;
 
+    if (oldFptr)
+    {
        if (binspec[0])  /* if binning specified, don't move */
            extspec[0] = '\0';
 
@@ -4125,7 +4436,7 @@ int ffinit(fitsfile **fptr,      /* O - FITS file pointer                   */
     if (driverTable[driver].create)
     {
 
-        FFLOCK;  /* lock this while searching for vacant handle */
+        FFLOCK;  /* some drivers use static variables while opening */
         *status = (*driverTable[driver].create)(outfile, &handle);
         FFUNLOCK;
 
@@ -4290,10 +4601,8 @@ int ffimem(fitsfile **fptr,      /* O - FITS file pointer                   */
     }
 
     /* call driver routine to "open" the memory file */
-    FFLOCK;  /* lock this while searching for vacant handle */
     *status =   mem_openmem( buffptr, buffsize, deltasize,
                             mem_realloc,  &handle);
-    FFUNLOCK;
 
     if (*status > 0)
     {
@@ -4625,14 +4934,14 @@ int fits_init_cfitsio(void)
             NULL,            /* checkfile not needed */ 
             mem_iraf_open,
             NULL,            /* create function not required */
-            mem_truncate,
-            mem_close_free,
+            mem_iraf_truncate,
+            mem_iraf_close,
             NULL,            /* remove function not required */
             mem_size,
             NULL,            /* flush function not required */
             mem_seek,
-            mem_read,
-            mem_write);
+            mem_iraf_read,
+            mem_iraf_write);
 
     if (status)
     {
@@ -5455,6 +5764,284 @@ int ffifile2(char *url,       /* input filename */
 /*
    fits_parse_input_filename
    parse the input URL into its basic components.
+
+   Plain disk file names, with at most a single [extname, extver] or
+   [extnum] specifier, are split directly by ffifile_simple.  Any other
+   name is interpreted by the general parser, ffifile_parse, and the
+   components are saved in a small cache, because the same name is
+   typically parsed several times while a file is being opened.
+*/
+{
+    char part[FFPARSE_NPART][FLEN_FILENAME];
+    char *output[FFPARSE_NPART];
+    int ii, tstatus = 0;
+
+    if (*status > 0)
+        return(*status);
+
+    output[0] = urltype;
+    output[1] = infilex;
+    output[2] = outfile;
+    output[3] = extspec;
+    output[4] = rowfilterx;
+    output[5] = binspec;
+    output[6] = colspec;
+    output[7] = pixfilter;
+    output[8] = compspec;
+
+    /* Initialize null strings */
+    for (ii = 0; ii < FFPARSE_NPART; ii++)
+        if (output[ii]) *output[ii] = '\0';
+
+    if (*url == '\0')       /* blank filename ?? */
+        return(*status);
+
+    if (ffifile_simple(url, urltype, infilex, extspec))
+        return(*status);
+
+    if (ffifile_cached(url, output))
+        return(*status);
+
+    /* parse the name into all the components, so that the cache */
+    /* entry can be used by any later caller */
+    ffpmrk();
+    ffifile_parse(url, part[0], part[1], part[2], part[3], part[4],
+        part[5], part[6], part[7], part[8], &tstatus);
+    ffcmrk();
+
+    if (tstatus > 0)
+    {
+        /* parse again with the caller's arguments, which may not */
+        /* request every component, to report the error */
+        return(ffifile_parse(url, urltype, infilex, outfile, extspec,
+           rowfilterx, binspec, colspec, pixfilter, compspec, status));
+    }
+
+    ffifile_save(url, part);
+
+    for (ii = 0; ii < FFPARSE_NPART; ii++)
+        if (output[ii]) strcpy(output[ii], part[ii]);
+
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+static int ffifile_simple(char *url,  /* I - input filename */
+           char *urltype,    /* O - 'file://' or 'irafmem://' */
+           char *infilex,    /* O - root filename */
+           char *extspec)    /* O - [extname, extver] or [extnum] */
+/*
+   Split the common forms of input file name that contain no other
+   components of the extended filename syntax:  a plain disk file name,
+   optionally followed by a single [extname], [extname, extver], or
+   [extnum] specifier.  Returns 1 if the name has one of these forms, or
+   0 if the name must be interpreted by ffifile_parse.  The results are
+   identical to those of ffifile_parse.  The output strings have already
+   been set to null strings by the caller.
+*/
+{
+    char *cptr, *bracket = 0, *extptr = 0;
+    size_t rootlen, extlen = 0;
+
+    /* names for stdin, and VMS directory names */
+    if (*url == '-' || *url == '[' || !fits_strncasecmp(url, "stdin", 5))
+        return(0);
+
+    /* '(' starts an output file name; ':' occurs in urltype prefixes */
+    /* and VMS disk names; '+' may give the HDU number */
+    for (cptr = url; *cptr; cptr++)
+    {
+        if (*cptr == '(' || *cptr == ':' || *cptr == '+')
+            return(0);
+
+        if (*cptr == '[')
+        {
+            bracket = cptr;
+            break;
+        }
+    }
+
+    rootlen = cptr - url;
+
+    if (bracket)
+    {
+        /* the specifier must be an extension name or number, optionally */
+        /* followed by a comma and an EXTVER number, and must end the name */
+        extptr = bracket + 1;
+        cptr = extptr;
+
+        while (isalnum((int) *cptr) || *cptr == '_')
+            cptr++;
+
+        if (cptr == extptr)
+            return(0);
+
+        if (*cptr == ',')
+        {
+            cptr++;
+            while (*cptr == ' ')
+                cptr++;
+
+            if (!isdigit((int) *cptr))
+                return(0);
+
+            while (isdigit((int) *cptr))
+                cptr++;
+        }
+
+        if (*cptr != ']' || *(cptr + 1) != '\0')
+            return(0);
+
+        /* length of the specifier between the brackets */
+        extlen = cptr - extptr;
+        if (extlen >= FLEN_FILENAME)
+            return(0);
+
+        /* [compress] is an image compression specifier */
+        if (extlen == 8 && !fits_strncasecmp(extptr, "compress", 8))
+            return(0);
+
+        /* rawfile specifiers look like [b512,512] or [ib2880] */
+        cptr = extptr;
+        if (strchr("bBiIjJdDrRfFuU", *cptr))
+        {
+            cptr++;
+            if (*cptr == 'b' || *cptr == 'B' || *cptr == 'l' || *cptr == 'L')
+                cptr++;
+
+            if (isdigit((int) *cptr))
+            {
+                while (isdigit((int) *cptr))
+                    cptr++;
+
+                if (*cptr == ',' || *cptr == ']')
+                    return(0);
+            }
+        }
+    }
+
+    /* strip off any trailing blanks from the root name */
+    while (rootlen > 1 && url[rootlen - 1] == ' ')
+        rootlen--;
+
+    if (rootlen > FLEN_FILENAME - 1)
+        return(0);
+
+    if (urltype)
+    {
+        /* did the root name end with ".imh" ? */
+        cptr = strstr(url, ".imh");
+        if (cptr && cptr + 4 == url + rootlen)
+            strcpy(urltype, "irafmem://");
+        else
+            strcpy(urltype, "file://");
+    }
+
+    if (infilex)
+    {
+        strncpy(infilex, url, rootlen);
+        infilex[rootlen] = '\0';
+    }
+
+    if (bracket && extspec)
+    {
+        /* copy the specifier without the closing ']' */
+        memcpy(extspec, extptr, extlen);
+        extspec[extlen] = '\0';
+    }
+
+    return(1);
+}
+/*--------------------------------------------------------------------------*/
+static int ffifile_cached(char *url,    /* I - input filename */
+           char *output[])  /* O - components, or NULL if not required */
+/*
+   Copy the components of a previously parsed input file name from the
+   cache.  Returns 1 if the name was found, otherwise 0.
+*/
+{
+    FFparsedname *entry;
+    unsigned long hash;
+    char *cptr;
+    int ii, found = 0;
+
+    hash = fits_hash_filename(url);
+    entry = &parseCache[hash % FFPARSE_CACHE];
+
+    FFLOCKPARSE;
+
+    if (entry->url && entry->hash == hash && !strcmp(entry->url, url))
+    {
+        cptr = entry->url + strlen(entry->url) + 1;
+        for (ii = 0; ii < FFPARSE_NPART; ii++)
+        {
+            if (output[ii]) strcpy(output[ii], cptr);
+            cptr += strlen(cptr) + 1;
+        }
+        found = 1;
+    }
+
+    FFUNLOCKPARSE;
+
+    return(found);
+}
+/*--------------------------------------------------------------------------*/
+static void ffifile_save(char *url,    /* I - input filename */
+           char part[][FLEN_FILENAME])  /* I - parsed components */
+/*
+   Save the components of a parsed input file name in the cache,
+   replacing any other name that was held in the same cache slot.
+*/
+{
+    FFparsedname *entry;
+    unsigned long hash;
+    size_t len;
+    char *block, *cptr;
+    int ii;
+
+    len = strlen(url) + 1;
+    for (ii = 0; ii < FFPARSE_NPART; ii++)
+        len += strlen(part[ii]) + 1;
+
+    /* the name and its components are stored in a single block */
+    block = (char *) malloc(len);
+    if (!block)
+        return;    /* the cache is only an optimization */
+
+    strcpy(block, url);
+    cptr = block + strlen(block) + 1;
+    for (ii = 0; ii < FFPARSE_NPART; ii++)
+    {
+        strcpy(cptr, part[ii]);
+        cptr += strlen(cptr) + 1;
+    }
+
+    hash = fits_hash_filename(url);
+    entry = &parseCache[hash % FFPARSE_CACHE];
+
+    FFLOCKPARSE;
+
+    cptr = entry->url;
+    entry->url = block;
+    entry->hash = hash;
+
+    FFUNLOCKPARSE;
+
+    free(cptr);
+}
+/*--------------------------------------------------------------------------*/
+static int ffifile_parse(char *url,       /* input filename */
+           char *urltype,    /* e.g., 'file://', 'http://', 'mem://' */
+           char *infilex,    /* root filename (may be complete path) */
+           char *outfile,    /* optional output file name            */
+           char *extspec,    /* extension spec: +n or [extname, extver]  */
+           char *rowfilterx, /* boolean row filter expression */
+           char *binspec,    /* histogram binning specifier   */
+           char *colspec,    /* column or keyword modifier expression */
+           char *pixfilter,  /* pixel filter expression */
+           char *compspec,   /* image compression specification */
+           int *status)
+/*
+   parse the input URL into its basic components.
    This routine is big and ugly and should be redesigned someday!
 */
 { 
@@ -7599,7 +8186,7 @@ int ffclos(fitsfile *fptr,      /* I - FITS file pointer */
         ffflsh(fptr, TRUE, status);   /* flush and disassociate IO buffers */
 
         /* call driver function to actually close the file */
-        if ((*driverTable[(fptr->Fptr)->driver].close)((fptr->Fptr)->filehandle))
+        if (ffclosedrv(fptr->Fptr))
         {
             if (*status <= 0)
             {
@@ -7611,6 +8198,7 @@ int ffclos(fitsfile *fptr,      /* I - FITS file pointer */
         }
 
         fits_clear_Fptr( fptr->Fptr, status);  /* clear Fptr address */
+        ffhdufree(fptr->Fptr);           /* free memory for HDU metadata */
         free((fptr->Fptr)->iobuffer);    /* free memory for I/O buffers */
         free((fptr->Fptr)->headstart);    /* free memory for headstart array */
         free((fptr->Fptr)->filename);     /* free memory for the filename */
@@ -7660,7 +8248,7 @@ int ffdelt(fitsfile *fptr,      /* I - FITS file pointer */
     ffflsh(fptr, TRUE, status);     /* flush and disassociate IO buffers */
 
         /* call driver function to actually close the file */
-    if ( (*driverTable[(fptr->Fptr)->driver].close)((fptr->Fptr)->filehandle) )
+    if (ffclosedrv(fptr->Fptr))
     {
         if (*status <= 0)
         {
@@ -7694,6 +8282,7 @@ int ffdelt(fitsfile *fptr,      /* I - FITS file pointer */
     }
 
     fits_clear_Fptr( fptr->Fptr, status);  /* clear Fptr address */
+    ffhdufree(fptr->Fptr);           /* free memory for HDU metadata */
     free((fptr->Fptr)->iobuffer);    /* free memory for I/O buffers */
     free((fptr->Fptr)->headstart);    /* free memory for headstart array */
     free((fptr->Fptr)->filename);     /* free memory for the filename */
@@ -7705,6 +8294,35 @@ int ffdelt(fitsfile *fptr,      /* I - FITS file pointer */
     return(*status);
 }
 /*--------------------------------------------------------------------------*/
+static int ffclosedrv(FITSfile *Fptr)  /* I - FITS file structure           */
+/*
+  call the driver function to close the file, unless its driver handle is
+  still shared with other independent readers of the file (see ffropn).
+*/
+{
+    FFiosource *source;
+    int nusers;
+
+    source = (FFiosource *) Fptr->iosource;
+    if (source)
+    {
+        FFLOCKSOURCE(source);
+        nusers = --(source->nusers);
+        FFUNLOCKSOURCE(source);
+
+        Fptr->iosource = 0;
+        if (nusers > 0)
+            return(0);
+
+#ifdef _REENTRANT
+        pthread_mutex_destroy(&source->lock);
+#endif
+        free(source);
+    }
+
+    return( (*driverTable[Fptr->driver].close)(Fptr->filehandle) );
+}
+/*--------------------------------------------------------------------------*/
 int fftrun( fitsfile *fptr,    /* I - FITS file pointer           */
              LONGLONG filesize,   /* I - size to truncate the file   */
              int *status)      /* O - error status                */
@@ -7712,7 +8330,8 @@ int fftrun( fitsfile *fptr,    /* I - FITS file pointer           */
   low level routine to truncate a file to a new smaller size.
 */
 {
-  if (driverTable[(fptr->Fptr)->driver].truncate)
+  /* the data of a file shared with independent readers is never changed */
+  if (driverTable[(fptr->Fptr)->driver].truncate && !(fptr->Fptr)->iosource)
   {
     ffflsh(fptr, FALSE, status);  /* flush all the buffers first */
     (fptr->Fptr)->filesize = filesize;
@@ -7733,6 +8352,9 @@ int ffflushx( FITSfile *fptr)     /* I - FITS file pointer                  */
   low level routine to flush internal file buffers to the file.
 */
 {
+    if (fptr->iosource)
+        return(0);    /* a shared READONLY handle has nothing to flush */
+
     if (driverTable[fptr->driver].flush)
         return ( (*driverTable[fptr->driver].flush)(fptr->filehandle) );
     else
@@ -7745,6 +8367,14 @@ int ffseek( FITSfile *fptr,   /* I - FITS file pointer              */
   low level routine to seek to a position in a file.
 */
 {
+    if (fptr->iosource)
+    {
+        /* the handle is shared, so only record the position; */
+        /* ffread moves to it when the data are read */
+        fptr->io_pos = position;
+        return(0);
+    }
+
     return( (*driverTable[fptr->driver].seek)(fptr->filehandle, position) );
 }
 /*--------------------------------------------------------------------------*/
@@ -7776,8 +8406,22 @@ int ffread( FITSfile *fptr,   /* I - FITS file pointer              */
 {
     int readstatus;
 
-    readstatus = (*driverTable[fptr->driver].read)(fptr->filehandle, 
-        buffer, nbytes);
+    if (fptr->iosource)
+    {
+        /* position and read the shared handle in one step */
+        FFLOCKSOURCE((FFiosource *) fptr->iosource);
+        readstatus = (*driverTable[fptr->driver].seek)(fptr->filehandle,
+            fptr->io_pos);
+        if (readstatus <= 0)
+            readstatus = (*driverTable[fptr->driver].read)(fptr->filehandle,
+                buffer, nbytes);
+        FFUNLOCKSOURCE((FFiosource *) fptr->iosource);
+
+        fptr->io_pos += nbytes;
+    }
+    else
+        readstatus = (*driverTable[fptr->driver].read)(fptr->filehandle,
+            buffer, nbytes);
 
     if (readstatus == END_OF_FILE)
         *status = END_OF_FILE;
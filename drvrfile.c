@@ -50,17 +50,13 @@ typedef struct    /* structure containing disk file structure */
     int last_io_op;
 } diskdriver;
 
-static diskdriver handleTable[NMAXFILES]; /* allocate diskfile handle tables */
+/* diskfile handle table, which grows as needed */
+static FFhandletable handleTable = FFHT_INIT(sizeof(diskdriver));
+#define FILEHANDLE(hdl) ((diskdriver *) ffhtentry(&handleTable, hdl))
 
 /*--------------------------------------------------------------------------*/
 int file_init(void)
 {
-    int ii;
-
-    for (ii = 0; ii < NMAXFILES; ii++) /* initialize all empty slots in table */
-    {
-       handleTable[ii].fileptr = 0;
-    }
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -91,7 +87,7 @@ int file_shutdown(void)
 int file_open(char *filename, int rwmode, int *handle)
 {
     FILE *diskfile;
-    int copyhandle, ii, status;
+    int status;
     char recbuf[2880];
     size_t nread;
 
@@ -131,11 +127,9 @@ int file_open(char *filename, int rwmode, int *handle)
         }
       }
 
-      /* close both files */
+      /* close both files, but keep the handle for the reopened copy */
       fclose(diskfile);
-      copyhandle = *handle;
-      file_close(*handle);
-      *handle = copyhandle;  /* reuse the old file handle */
+      fclose(FILEHANDLE(*handle)->fileptr);
 
       /* reopen the new copy, with correct rwmode */
       status = file_openfile(file_outfile, rwmode, &diskfile);
@@ -143,26 +137,23 @@ int file_open(char *filename, int rwmode, int *handle)
     }
     else
     {
-      *handle = -1;
-      for (ii = 0; ii < NMAXFILES; ii++)  /* find empty slot in table */
-      {
-        if (handleTable[ii].fileptr == 0)
-        {
-            *handle = ii;
-            break;
-        }
-      }
-
-      if (*handle == -1)
-       return(TOO_MANY_FILES);    /* too many files opened */
+      status = ffhtalloc(&handleTable, handle);  /* get a new handle */
+      if (status)
+       return(status);
 
       /*open the file */
       status = file_openfile(filename, rwmode, &diskfile);
     }
 
-    handleTable[*handle].fileptr = diskfile;
-    handleTable[*handle].currentpos = 0;
-    handleTable[*handle].last_io_op = IO_SEEK;
+    if (status)
+    {
+        ffhtfree(&handleTable, *handle);
+        return(status);
+    }
+
+    FILEHANDLE(*handle)->fileptr = diskfile;
+    FILEHANDLE(*handle)->currentpos = 0;
+    FILEHANDLE(*handle)->last_io_op = IO_SEEK;
 
     return(status);
 }
@@ -390,7 +381,6 @@ int file_openfile(char *filename, int rwmode, FILE **diskfile)
 int file_create(char *filename, int *handle)
 {
     FILE *diskfile;
-    int ii;
 #if defined(_WIN32)
     wchar_t mode[4];
 #else
@@ -488,18 +478,6 @@ printf("ABS = %s\n", absURL);
 	/* if we got here, then the input filename appears to be valid */
     }
     
-    *handle = -1;
-    for (ii = 0; ii < NMAXFILES; ii++)  /* find empty slot in table */
-    {
-        if (handleTable[ii].fileptr == 0)
-        {
-            *handle = ii;
-            break;
-        }
-    }
-    if (*handle == -1)
-       return(TOO_MANY_FILES);    /* too many files opened */
-
 #if defined(_WIN32)
     wcscpy(mode, L"w+b");    /* create new file with read-write */
     /* Windows
@@ -580,9 +558,17 @@ printf("ABS = %s\n", absURL);
             return(FILE_NOT_CREATED); 
     }
 
-    handleTable[ii].fileptr = diskfile;
-    handleTable[ii].currentpos = 0;
-    handleTable[ii].last_io_op = IO_SEEK;
+    status = ffhtalloc(&handleTable, handle);  /* get a new handle */
+    if (status)
+    {
+        fclose(diskfile);
+        remove(filename);
+        return(status);
+    }
+
+    FILEHANDLE(*handle)->fileptr = diskfile;
+    FILEHANDLE(*handle)->currentpos = 0;
+    FILEHANDLE(*handle)->last_io_op = IO_SEEK;
 
     return(0);
 }
@@ -596,12 +582,12 @@ int file_truncate(int handle, LONGLONG filesize)
 #ifdef HAVE_FTRUNCATE
     int fdesc;
 
-    fdesc = fileno(handleTable[handle].fileptr);
+    fdesc = fileno(FILEHANDLE(handle)->fileptr);
     ftruncate(fdesc, (OFF_T) filesize);
     file_seek(handle, filesize);
 
-    handleTable[handle].currentpos = filesize;
-    handleTable[handle].last_io_op = IO_SEEK;
+    FILEHANDLE(handle)->currentpos = filesize;
+    FILEHANDLE(handle)->last_io_op = IO_SEEK;
 
 #endif
 
@@ -616,7 +602,7 @@ int file_size(int handle, LONGLONG *filesize)
     OFF_T position1,position2;
     FILE *diskfile;
 
-    diskfile = handleTable[handle].fileptr;
+    diskfile = FILEHANDLE(handle)->fileptr;
 
 #if defined(_MSC_VER) && (_MSC_VER >= 1400)
  
@@ -685,11 +671,13 @@ int file_close(int handle)
 */
 {
     
-    if (fclose(handleTable[handle].fileptr) )
-        return(FILE_NOT_CLOSED);
+    int status = 0;
 
-    handleTable[handle].fileptr = 0;
-    return(0);
+    if (fclose(FILEHANDLE(handle)->fileptr) )
+        status = FILE_NOT_CLOSED;
+
+    ffhtfree(&handleTable, handle);  /* the stream is gone in any case */
+    return(status);
 }
 /*--------------------------------------------------------------------------*/
 int file_remove(char *filename)
@@ -706,7 +694,7 @@ int file_flush(int handle)
   flush the file
 */
 {
-    if (fflush(handleTable[handle].fileptr) )
+    if (fflush(FILEHANDLE(handle)->fileptr) )
         return(WRITE_ERROR);
 
     /* The flush operation is not supposed to move the internal */
@@ -716,7 +704,7 @@ int file_flush(int handle)
 
 #if MACHINE == IBMPC
 
-    if (file_seek(handle, handleTable[handle].currentpos))
+    if (file_seek(handle, FILEHANDLE(handle)->currentpos))
             return(SEEK_ERROR);
 
 #endif
@@ -735,22 +723,22 @@ int file_seek(int handle, LONGLONG offset)
      /* Microsoft visual studio C++ */
      /* _fseeki64 supported beginning with version 8.0 */
  
-    if (_fseeki64(handleTable[handle].fileptr, (OFF_T) offset, 0) != 0)
+    if (_fseeki64(FILEHANDLE(handle)->fileptr, (OFF_T) offset, 0) != 0)
         return(SEEK_ERROR);
 	
 #elif _FILE_OFFSET_BITS - 0 == 64
 
-    if (fseeko(handleTable[handle].fileptr, (OFF_T) offset, 0) != 0)
+    if (fseeko(FILEHANDLE(handle)->fileptr, (OFF_T) offset, 0) != 0)
         return(SEEK_ERROR);
 
 #else
 
-    if (fseek(handleTable[handle].fileptr, (OFF_T) offset, 0) != 0)
+    if (fseek(FILEHANDLE(handle)->fileptr, (OFF_T) offset, 0) != 0)
         return(SEEK_ERROR);
 
 #endif
 
-    handleTable[handle].currentpos = offset;
+    FILEHANDLE(handle)->currentpos = offset;
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -762,13 +750,13 @@ int file_read(int hdl, void *buffer, long nbytes)
     long nread;
     char *cptr;
 
-    if (handleTable[hdl].last_io_op == IO_WRITE)
+    if (FILEHANDLE(hdl)->last_io_op == IO_WRITE)
     {
-        if (file_seek(hdl, handleTable[hdl].currentpos))
+        if (file_seek(hdl, FILEHANDLE(hdl)->currentpos))
             return(SEEK_ERROR);
     }
   
-    nread = (long) fread(buffer, 1, nbytes, handleTable[hdl].fileptr);
+    nread = (long) fread(buffer, 1, nbytes, FILEHANDLE(hdl)->fileptr);
 
     if (nread == 1)
     {
@@ -786,8 +774,8 @@ int file_read(int hdl, void *buffer, long nbytes)
         return(READ_ERROR);
     }
 
-    handleTable[hdl].currentpos += nbytes;
-    handleTable[hdl].last_io_op = IO_READ;
+    FILEHANDLE(hdl)->currentpos += nbytes;
+    FILEHANDLE(hdl)->last_io_op = IO_READ;
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -796,17 +784,17 @@ int file_write(int hdl, void *buffer, long nbytes)
   write bytes at the current position in the file
 */
 {
-    if (handleTable[hdl].last_io_op == IO_READ) 
+    if (FILEHANDLE(hdl)->last_io_op == IO_READ) 
     {
-        if (file_seek(hdl, handleTable[hdl].currentpos))
+        if (file_seek(hdl, FILEHANDLE(hdl)->currentpos))
             return(SEEK_ERROR);
     }
 
-    if((long) fwrite(buffer, 1, nbytes, handleTable[hdl].fileptr) != nbytes)
+    if((long) fwrite(buffer, 1, nbytes, FILEHANDLE(hdl)->fileptr) != nbytes)
         return(WRITE_ERROR);
 
-    handleTable[hdl].currentpos += nbytes;
-    handleTable[hdl].last_io_op = IO_WRITE;
+    FILEHANDLE(hdl)->currentpos += nbytes;
+    FILEHANDLE(hdl)->last_io_op = IO_WRITE;
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -48,20 +48,18 @@ typedef struct    /* structure containing mem file structure */
     LONGLONG currentpos;   /* current file position, relative to start */
     LONGLONG fitsfilesize; /* size of the FITS file (always <= *memsizeptr) */
     FILE *fileptr;      /* pointer to compressed output disk file */
+    void *irafpix;      /* IRAF pixel file that holds the data unit, */
+                        /* or NULL if the whole file is in memory */
+    LONGLONG irafhead;  /* size of the FITS header of an IRAF image */
 } memdriver;
 
-static memdriver memTable[NMAXFILES];  /* allocate mem file handle tables */
+/* mem file handle table, which grows as needed */
+static FFhandletable memTable = FFHT_INIT(sizeof(memdriver));
+#define MEMHANDLE(hdl) ((memdriver *) ffhtentry(&memTable, hdl))
 
 /*--------------------------------------------------------------------------*/
 int mem_init(void)
 {
-    int ii;
-
-    for (ii = 0; ii < NMAXFILES; ii++) /* initialize all empty slots in table */
-    {
-       memTable[ii].memaddrptr = 0;
-       memTable[ii].memaddr = 0;
-    }
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -170,7 +168,7 @@ int mem_create_comp(char *filename, int *handle)
         return(status);
     }
 
-    memTable[*handle].fileptr = diskfile;
+    MEMHANDLE(*handle)->fileptr = diskfile;
 
     return(0);
 }
@@ -184,26 +182,19 @@ int mem_openmem(void **buffptr,   /* I - address of memory pointer          */
   lowest level routine to open a pre-existing memory file.
 */
 {
-    int ii;
+    int ii, status;
 
-    *handle = -1;
-    for (ii = 0; ii < NMAXFILES; ii++)  /* find empty slot in handle table */
-    {
-        if (memTable[ii].memaddrptr == 0)
-        {
-            *handle = ii;
-            break;
-        }
-    }
-    if (*handle == -1)
-       return(TOO_MANY_FILES);    /* too many files opened */
-
-    memTable[ii].memaddrptr = (char **) buffptr; /* pointer to start addres */
-    memTable[ii].memsizeptr = buffsize;     /* allocated size of memory */
-    memTable[ii].deltasize = deltasize;     /* suggested realloc increment */
-    memTable[ii].fitsfilesize = *buffsize;  /* size of FITS file (upper limit) */
-    memTable[ii].currentpos = 0;            /* at beginning of the file */
-    memTable[ii].mem_realloc = memrealloc;  /* memory realloc function */
+    status = ffhtalloc(&memTable, handle);  /* get a new handle */
+    if (status)
+       return(status);
+
+    ii = *handle;
+    MEMHANDLE(ii)->memaddrptr = (char **) buffptr; /* pointer to start addres */
+    MEMHANDLE(ii)->memsizeptr = buffsize;     /* allocated size of memory */
+    MEMHANDLE(ii)->deltasize = deltasize;     /* suggested realloc increment */
+    MEMHANDLE(ii)->fitsfilesize = *buffsize;  /* size of FITS file (upper limit) */
+    MEMHANDLE(ii)->currentpos = 0;            /* at beginning of the file */
+    MEMHANDLE(ii)->mem_realloc = memrealloc;  /* memory realloc function */
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -212,41 +203,36 @@ int mem_createmem(size_t msize, int *handle)
   lowest level routine to allocate a memory file.
 */
 {
-    int ii;
+    int ii, status;
 
-    *handle = -1;
-    for (ii = 0; ii < NMAXFILES; ii++)  /* find empty slot in handle table */
-    {
-        if (memTable[ii].memaddrptr == 0)
-        {
-            *handle = ii;
-            break;
-        }
-    }
-    if (*handle == -1)
-       return(TOO_MANY_FILES);    /* too many files opened */
+    status = ffhtalloc(&memTable, handle);  /* get a new handle */
+    if (status)
+       return(status);
 
     /* use the internally allocated memaddr and memsize variables */
-    memTable[ii].memaddrptr = &memTable[ii].memaddr;
-    memTable[ii].memsizeptr = &memTable[ii].memsize;
+    ii = *handle;
+    MEMHANDLE(ii)->memaddrptr = &MEMHANDLE(ii)->memaddr;
+    MEMHANDLE(ii)->memsizeptr = &MEMHANDLE(ii)->memsize;
 
     /* allocate initial block of memory for the file */
     if (msize > 0)
     {
-        memTable[ii].memaddr = (char *) malloc(msize); 
-        if ( !(memTable[ii].memaddr) )
+        MEMHANDLE(ii)->memaddr = (char *) malloc(msize); 
+        if ( !(MEMHANDLE(ii)->memaddr) )
         {
             ffpmsg("malloc of initial memory failed (mem_createmem)");
+            ffhtfree(&memTable, *handle);
+            *handle = -1;
             return(FILE_NOT_OPENED);
         }
     }
 
     /* set initial state of the file */
-    memTable[ii].memsize = msize;
-    memTable[ii].deltasize = 2880;
-    memTable[ii].fitsfilesize = 0;
-    memTable[ii].currentpos = 0;
-    memTable[ii].mem_realloc = realloc;
+    MEMHANDLE(ii)->memsize = msize;
+    MEMHANDLE(ii)->deltasize = 2880;
+    MEMHANDLE(ii)->fitsfilesize = 0;
+    MEMHANDLE(ii)->currentpos = 0;
+    MEMHANDLE(ii)->mem_realloc = realloc;
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -258,10 +244,10 @@ int mem_truncate(int handle, LONGLONG filesize)
     char *ptr;
 
     /* call the memory reallocation function, if defined */
-    if ( memTable[handle].mem_realloc )
+    if ( MEMHANDLE(handle)->mem_realloc )
     {    /* explicit LONGLONG->size_t cast */
-        ptr = (memTable[handle].mem_realloc)(
-                                *(memTable[handle].memaddrptr),
+        ptr = (MEMHANDLE(handle)->mem_realloc)(
+                                *(MEMHANDLE(handle)->memaddrptr),
                                  (size_t) filesize);
         if (!ptr)
         {
@@ -270,19 +256,19 @@ int mem_truncate(int handle, LONGLONG filesize)
         }
 
         /* if allocated more memory, initialize it to zero */
-        if ( filesize > *(memTable[handle].memsizeptr) )
+        if ( filesize > *(MEMHANDLE(handle)->memsizeptr) )
         {
-             memset(ptr + *(memTable[handle].memsizeptr),
+             memset(ptr + *(MEMHANDLE(handle)->memsizeptr),
                     0,
-                ((size_t) filesize) - *(memTable[handle].memsizeptr) );
+                ((size_t) filesize) - *(MEMHANDLE(handle)->memsizeptr) );
         }
 
-        *(memTable[handle].memaddrptr) = ptr;
-        *(memTable[handle].memsizeptr) = (size_t) (filesize);
+        *(MEMHANDLE(handle)->memaddrptr) = ptr;
+        *(MEMHANDLE(handle)->memsizeptr) = (size_t) (filesize);
     }
 
-    memTable[handle].currentpos = filesize;
-    memTable[handle].fitsfilesize = filesize;
+    MEMHANDLE(handle)->currentpos = filesize;
+    MEMHANDLE(handle)->fitsfilesize = filesize;
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -378,7 +364,7 @@ int stdin_open(char *filename, int rwmode, int *handle)
         if (status)
         {
           ffpmsg("failed to copy stdin into memory (stdin_open)");
-          free(memTable[*handle].memaddr);
+          mem_close_free(*handle);
         }
       }
     }
@@ -398,9 +384,9 @@ int stdin2mem(int hd)  /* handle number */
     char simple[] = "SIMPLE";
     int c, ii, jj;
 
-    memptr = *memTable[hd].memaddrptr;
-    memsize = *memTable[hd].memsizeptr;
-    delta = memTable[hd].deltasize;
+    memptr = *MEMHANDLE(hd)->memaddrptr;
+    memsize = *MEMHANDLE(hd)->memsizeptr;
+    delta = MEMHANDLE(hd)->deltasize;
 
     filesize = 0;
     ii = 0;
@@ -438,7 +424,7 @@ int stdin2mem(int hd)  /* handle number */
 
     if (nread < memsize)    /* reached the end? */
     {
-       memTable[hd].fitsfilesize = nread;
+       MEMHANDLE(hd)->fitsfilesize = nread;
        return(0);
     }
 
@@ -465,9 +451,9 @@ int stdin2mem(int hd)  /* handle number */
            break;
     }
 
-     memTable[hd].fitsfilesize = filesize;
-    *memTable[hd].memaddrptr = memptr;
-    *memTable[hd].memsizeptr = memsize;
+     MEMHANDLE(hd)->fitsfilesize = filesize;
+    *MEMHANDLE(hd)->memaddrptr = memptr;
+    *MEMHANDLE(hd)->memsizeptr = memsize;
 
     return(0);
 }
@@ -535,17 +521,16 @@ int stdout_close(int handle)
     int status = 0;
 
     /* copy from memory to standard out.  explicit LONGLONG->size_t cast */
-    if(fwrite(memTable[handle].memaddr, 1,
-              ((size_t) memTable[handle].fitsfilesize), stdout) !=
-              (size_t) memTable[handle].fitsfilesize )
+    if(fwrite(MEMHANDLE(handle)->memaddr, 1,
+              ((size_t) MEMHANDLE(handle)->fitsfilesize), stdout) !=
+              (size_t) MEMHANDLE(handle)->fitsfilesize )
     {
                 ffpmsg("failed to copy memory file to stdout (stdout_close)");
                 status = WRITE_ERROR;
     }
 
-    free( memTable[handle].memaddr );   /* free the memory */
-    memTable[handle].memaddrptr = 0;
-    memTable[handle].memaddr = 0;
+    free( MEMHANDLE(handle)->memaddr );   /* free the memory */
+    ffhtfree(&memTable, handle);
     return(status);
 }
 /*--------------------------------------------------------------------------*/
@@ -716,19 +701,19 @@ int mem_compress_open(char *filename, int rwmode, int *hdl)
     }
 
     /* if we allocated too much memory initially, then free it */
-    if (*(memTable[*hdl].memsizeptr) > 
-       (( (size_t) memTable[*hdl].fitsfilesize) + 256L) ) 
+    if (*(MEMHANDLE(*hdl)->memsizeptr) > 
+       (( (size_t) MEMHANDLE(*hdl)->fitsfilesize) + 256L) ) 
     {
-        ptr = realloc(*(memTable[*hdl].memaddrptr), 
-                     ((size_t) memTable[*hdl].fitsfilesize) );
+        ptr = realloc(*(MEMHANDLE(*hdl)->memaddrptr), 
+                     ((size_t) MEMHANDLE(*hdl)->fitsfilesize) );
         if (!ptr)
         {
             ffpmsg("Failed to reduce size of allocated memory (compress_open)");
             return(MEMORY_ALLOCATION);
         }
 
-        *(memTable[*hdl].memaddrptr) = ptr;
-        *(memTable[*hdl].memsizeptr) = (size_t) (memTable[*hdl].fitsfilesize);
+        *(MEMHANDLE(*hdl)->memaddrptr) = ptr;
+        *(MEMHANDLE(*hdl)->memsizeptr) = (size_t) (MEMHANDLE(*hdl)->fitsfilesize);
     }
 
     return(0);
@@ -770,19 +755,19 @@ int mem_compress_stdin_open(char *filename, int rwmode, int *hdl)
     }
 
     /* if we allocated too much memory initially, then free it */
-    if (*(memTable[*hdl].memsizeptr) > 
-       (( (size_t) memTable[*hdl].fitsfilesize) + 256L) ) 
+    if (*(MEMHANDLE(*hdl)->memsizeptr) > 
+       (( (size_t) MEMHANDLE(*hdl)->fitsfilesize) + 256L) ) 
     {
-        ptr = realloc(*(memTable[*hdl].memaddrptr), 
-                      ((size_t) memTable[*hdl].fitsfilesize) );
+        ptr = realloc(*(MEMHANDLE(*hdl)->memaddrptr), 
+                      ((size_t) MEMHANDLE(*hdl)->fitsfilesize) );
         if (!ptr)
         {
             ffpmsg("Failed to reduce size of allocated memory (compress_stdin_open)");
             return(MEMORY_ALLOCATION);
         }
 
-        *(memTable[*hdl].memaddrptr) = ptr;
-        *(memTable[*hdl].memsizeptr) = (size_t) (memTable[*hdl].fitsfilesize);
+        *(MEMHANDLE(*hdl)->memaddrptr) = ptr;
+        *(MEMHANDLE(*hdl)->memsizeptr) = (size_t) (MEMHANDLE(*hdl)->fitsfilesize);
     }
 
     return(0);
@@ -790,12 +775,15 @@ int mem_compress_stdin_open(char *filename, int rwmode, int *hdl)
 /*--------------------------------------------------------------------------*/
 int mem_iraf_open(char *filename, int rwmode, int *hdl)
 /*
-  This routine creates an empty memory buffer, then calls iraf2mem to
-  open the IRAF disk file and convert it to a FITS file in memeory.
+  This routine creates a memory file that holds the FITS header converted
+  from the header of an IRAF image, then calls irafopenpix to open the
+  IRAF pixel file.  The pixels are read directly from the pixel file when
+  the FITS data unit is read, so the image is not copied into memory
+  unless the file is modified.
 */
 {
     int status;
-    size_t filesize = 0;
+    size_t headsize = 0, filesize = 0;
 
     /* create a memory file with size = 0 for the FITS converted IRAF file */
     status = mem_createmem(filesize, hdl);
@@ -805,9 +793,10 @@ int mem_iraf_open(char *filename, int rwmode, int *hdl)
         return(status);
     }
 
-    /* convert the iraf file into a FITS file in memory */
-    status = iraf2mem(filename, memTable[*hdl].memaddrptr,
-                      memTable[*hdl].memsizeptr, &filesize, &status);
+    /* convert the iraf header into a FITS header in memory */
+    status = irafopenpix(filename, MEMHANDLE(*hdl)->memaddrptr,
+                      MEMHANDLE(*hdl)->memsizeptr, &headsize, &filesize,
+                      &(MEMHANDLE(*hdl)->irafpix), &status);
 
     if (status)
     {
@@ -816,12 +805,119 @@ int mem_iraf_open(char *filename, int rwmode, int *hdl)
         return(status);
     }
 
-    memTable[*hdl].currentpos = 0;           /* save starting position */
-    memTable[*hdl].fitsfilesize=filesize;   /* and initial file size  */
+    MEMHANDLE(*hdl)->currentpos = 0;           /* save starting position */
+    MEMHANDLE(*hdl)->fitsfilesize=filesize;   /* and initial file size  */
+    MEMHANDLE(*hdl)->irafhead = headsize;     /* start of the data unit */
 
     return(0);
 }
 /*--------------------------------------------------------------------------*/
+static int mem_iraf_load(int hdl)
+/*
+  copy the IRAF image pixels into memory following the FITS header, and
+  close the IRAF pixel file, before the converted file is modified.
+*/
+{
+    int status = 0;
+    char *ptr;
+    size_t filesize;
+
+    filesize = (size_t) MEMHANDLE(hdl)->fitsfilesize;
+
+    if (filesize > *(MEMHANDLE(hdl)->memsizeptr))
+    {
+        ptr = realloc(*(MEMHANDLE(hdl)->memaddrptr), filesize);
+        if (!ptr)
+        {
+            ffpmsg("Failed to allocate memory for IRAF image (mem_iraf_load)");
+            return(MEMORY_ALLOCATION);
+        }
+
+        *(MEMHANDLE(hdl)->memaddrptr) = ptr;
+        *(MEMHANDLE(hdl)->memsizeptr) = filesize;
+    }
+
+    if (irafreadpix(MEMHANDLE(hdl)->irafpix, 0,
+            *(MEMHANDLE(hdl)->memaddrptr) + MEMHANDLE(hdl)->irafhead,
+            (long) (filesize - MEMHANDLE(hdl)->irafhead), &status))
+        return(status);
+
+    irafclosepix(MEMHANDLE(hdl)->irafpix);
+    MEMHANDLE(hdl)->irafpix = NULL;
+    return(0);
+}
+/*--------------------------------------------------------------------------*/
+int mem_iraf_truncate(int handle, LONGLONG filesize)
+/*
+  truncate the converted IRAF file to a new size
+*/
+{
+    int status;
+
+    if (MEMHANDLE(handle)->irafpix && (status = mem_iraf_load(handle)))
+        return(status);
+
+    return(mem_truncate(handle, filesize));
+}
+/*--------------------------------------------------------------------------*/
+int mem_iraf_close(int handle)
+/*
+  close the IRAF pixel file, and free the memory.
+*/
+{
+    irafclosepix(MEMHANDLE(handle)->irafpix);
+
+    return(mem_close_free(handle));
+}
+/*--------------------------------------------------------------------------*/
+int mem_iraf_read(int hdl, void *buffer, long nbytes)
+/*
+  read bytes from the current position in the converted IRAF file; the
+  bytes of the FITS data unit are read from the IRAF pixel file.
+*/
+{
+    int status = 0;
+    long nhead = 0;
+
+    if (!(MEMHANDLE(hdl)->irafpix))
+        return(mem_read(hdl, buffer, nbytes));
+
+    if (MEMHANDLE(hdl)->currentpos + nbytes > MEMHANDLE(hdl)->fitsfilesize)
+        return(END_OF_FILE);
+
+    /* copy the part of the FITS header, if any */
+    if (MEMHANDLE(hdl)->currentpos < MEMHANDLE(hdl)->irafhead)
+    {
+        nhead = (long) minvalue(nbytes,
+                 MEMHANDLE(hdl)->irafhead - MEMHANDLE(hdl)->currentpos);
+
+        memcpy(buffer,
+               *(MEMHANDLE(hdl)->memaddrptr) + MEMHANDLE(hdl)->currentpos,
+               nhead);
+    }
+
+    if (nbytes > nhead && irafreadpix(MEMHANDLE(hdl)->irafpix,
+            MEMHANDLE(hdl)->currentpos + nhead - MEMHANDLE(hdl)->irafhead,
+            (char *) buffer + nhead, nbytes - nhead, &status))
+        return(status);
+
+    MEMHANDLE(hdl)->currentpos += nbytes;
+    return(0);
+}
+/*--------------------------------------------------------------------------*/
+int mem_iraf_write(int hdl, void *buffer, long nbytes)
+/*
+  write bytes at the current position in the converted IRAF file
+*/
+{
+    int status;
+
+    if (MEMHANDLE(hdl)->irafpix && (status = mem_iraf_load(hdl)))
+        return(status);
+
+    return(mem_write(hdl, buffer, nbytes));
+}
+/*--------------------------------------------------------------------------*/
 int mem_rawfile_open(char *filename, int rwmode, int *hdl)
 /*
   This routine creates an empty memory buffer, writes a minimal
@@ -977,7 +1073,7 @@ int mem_rawfile_open(char *filename, int rwmode, int *hdl)
     }
 
     /* open this piece of memory as a new FITS file */
-    ffimem(&fptr, (void **) memTable[*hdl].memaddrptr, &filesize, 0, 0, &status);
+    ffimem(&fptr, (void **) MEMHANDLE(*hdl)->memaddrptr, &filesize, 0, 0, &status);
 
     /* write the required header keywords */
     ffcrim(fptr, datatype, naxis, dim, &status);
@@ -997,7 +1093,7 @@ int mem_rawfile_open(char *filename, int rwmode, int *hdl)
        fseek(diskfile, offset, 0);   /* offset to start of the data */
 
     /* read the raw data into memory */
-    ptr = *memTable[*hdl].memaddrptr + 2880;
+    ptr = *MEMHANDLE(*hdl)->memaddrptr + 2880;
 
     if (fread((char *) ptr, 1, datasize, diskfile) != datasize)
       status = READ_ERROR;
@@ -1051,8 +1147,8 @@ int mem_rawfile_open(char *filename, int rwmode, int *hdl)
       }
     }
 
-    memTable[*hdl].currentpos = 0;           /* save starting position */
-    memTable[*hdl].fitsfilesize=filesize;    /* and initial file size  */
+    MEMHANDLE(*hdl)->currentpos = 0;           /* save starting position */
+    MEMHANDLE(*hdl)->fitsfilesize=filesize;    /* and initial file size  */
 
     return(0);
 }
@@ -1071,8 +1167,8 @@ int mem_uncompress2mem(char *filename, FILE *diskfile, int hdl)
 
     if (strstr(filename, ".Z")) {
          zuncompress2mem(filename, diskfile,
-		 memTable[hdl].memaddrptr,   /* pointer to memory address */
-		 memTable[hdl].memsizeptr,   /* pointer to size of memory */
+		 MEMHANDLE(hdl)->memaddrptr,   /* pointer to memory address */
+		 MEMHANDLE(hdl)->memsizeptr,   /* pointer to size of memory */
 		 realloc,                     /* reallocation function */
 		 &finalsize, &status);        /* returned file size nd status*/
 #if HAVE_BZIP2
@@ -1081,14 +1177,14 @@ int mem_uncompress2mem(char *filename, FILE *diskfile, int hdl)
 #endif
     } else {
          uncompress2mem(filename, diskfile,
-		 memTable[hdl].memaddrptr,   /* pointer to memory address */
-		 memTable[hdl].memsizeptr,   /* pointer to size of memory */
+		 MEMHANDLE(hdl)->memaddrptr,   /* pointer to memory address */
+		 MEMHANDLE(hdl)->memsizeptr,   /* pointer to size of memory */
 		 realloc,                     /* reallocation function */
 		 &finalsize, &status);        /* returned file size nd status*/
     } 
 
-  memTable[hdl].currentpos = 0;           /* save starting position */
-  memTable[hdl].fitsfilesize=finalsize;   /* and initial file size  */
+  MEMHANDLE(hdl)->currentpos = 0;           /* save starting position */
+  MEMHANDLE(hdl)->fitsfilesize=finalsize;   /* and initial file size  */
   return status;
 }
 /*--------------------------------------------------------------------------*/
@@ -1097,7 +1193,7 @@ int mem_size(int handle, LONGLONG *filesize)
   return the size of the file; only called when the file is first opened
 */
 {
-    *filesize = memTable[handle].fitsfilesize;
+    *filesize = MEMHANDLE(handle)->fitsfilesize;
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -1106,10 +1202,9 @@ int mem_close_free(int handle)
   close the file and free the memory.
 */
 {
-    free( *(memTable[handle].memaddrptr) );
+    free( *(MEMHANDLE(handle)->memaddrptr) );
 
-    memTable[handle].memaddrptr = 0;
-    memTable[handle].memaddr = 0;
+    ffhtfree(&memTable, handle);
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -1118,8 +1213,7 @@ int mem_close_keep(int handle)
   close the memory file but do not free the memory.
 */
 {
-    memTable[handle].memaddrptr = 0;
-    memTable[handle].memaddr = 0;
+    ffhtfree(&memTable, handle);
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -1134,23 +1228,22 @@ int mem_close_comp(int handle)
 
     /* compress file in  memory to a .gz disk file */
 
-    if(compress2file_from_mem(memTable[handle].memaddr,
-              (size_t) (memTable[handle].fitsfilesize), 
-              memTable[handle].fileptr,
+    if(compress2file_from_mem(MEMHANDLE(handle)->memaddr,
+              (size_t) (MEMHANDLE(handle)->fitsfilesize), 
+              MEMHANDLE(handle)->fileptr,
               &compsize, &status ) )
     {
             ffpmsg("failed to copy memory file to file (mem_close_comp)");
             status = WRITE_ERROR;
     }
 
-    free( memTable[handle].memaddr );   /* free the memory */
-    memTable[handle].memaddrptr = 0;
-    memTable[handle].memaddr = 0;
+    free( MEMHANDLE(handle)->memaddr );   /* free the memory */
 
     /* close the compressed disk file (except if it is 'stdout' */
-    if (memTable[handle].fileptr != stdout)
-        fclose(memTable[handle].fileptr);
+    if (MEMHANDLE(handle)->fileptr != stdout)
+        fclose(MEMHANDLE(handle)->fileptr);
 
+    ffhtfree(&memTable, handle);
     return(status);
 }
 /*--------------------------------------------------------------------------*/
@@ -1159,10 +1252,10 @@ int mem_seek(int handle, LONGLONG offset)
   seek to position relative to start of the file.
 */
 {
-    if (offset >  memTable[handle].fitsfilesize )
+    if (offset >  MEMHANDLE(handle)->fitsfilesize )
         return(END_OF_FILE);
 
-    memTable[handle].currentpos = offset;
+    MEMHANDLE(handle)->currentpos = offset;
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -1171,14 +1264,14 @@ int mem_read(int hdl, void *buffer, long nbytes)
   read bytes from the current position in the file
 */
 {
-    if (memTable[hdl].currentpos + nbytes > memTable[hdl].fitsfilesize)
+    if (MEMHANDLE(hdl)->currentpos + nbytes > MEMHANDLE(hdl)->fitsfilesize)
         return(END_OF_FILE);
 
     memcpy(buffer,
-           *(memTable[hdl].memaddrptr) + memTable[hdl].currentpos,
+           *(MEMHANDLE(hdl)->memaddrptr) + MEMHANDLE(hdl)->currentpos,
            nbytes);
 
-    memTable[hdl].currentpos += nbytes;
+    MEMHANDLE(hdl)->currentpos += nbytes;
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -1190,11 +1283,11 @@ int mem_write(int hdl, void *buffer, long nbytes)
     size_t newsize;
     char *ptr;
 
-    if ((size_t) (memTable[hdl].currentpos + nbytes) > 
-         *(memTable[hdl].memsizeptr) )
+    if ((size_t) (MEMHANDLE(hdl)->currentpos + nbytes) > 
+         *(MEMHANDLE(hdl)->memsizeptr) )
     {
                
-        if (!(memTable[hdl].mem_realloc))
+        if (!(MEMHANDLE(hdl)->mem_realloc))
         {
             ffpmsg("realloc function not defined (mem_write)");
             return(WRITE_ERROR);
@@ -1208,12 +1301,12 @@ int mem_write(int hdl, void *buffer, long nbytes)
          */
 
         newsize = maxvalue( (size_t)
-            (((memTable[hdl].currentpos + nbytes - 1) / 2880) + 1) * 2880,
-            *(memTable[hdl].memsizeptr) + memTable[hdl].deltasize);
+            (((MEMHANDLE(hdl)->currentpos + nbytes - 1) / 2880) + 1) * 2880,
+            *(MEMHANDLE(hdl)->memsizeptr) + MEMHANDLE(hdl)->deltasize);
 
         /* call the realloc function */
-        ptr = (memTable[hdl].mem_realloc)(
-                                    *(memTable[hdl].memaddrptr),
+        ptr = (MEMHANDLE(hdl)->mem_realloc)(
+                                    *(MEMHANDLE(hdl)->memaddrptr),
                                      newsize);
         if (!ptr)
         {
@@ -1221,19 +1314,19 @@ int mem_write(int hdl, void *buffer, long nbytes)
             return(MEMORY_ALLOCATION);
         }
 
-        *(memTable[hdl].memaddrptr) = ptr;
-        *(memTable[hdl].memsizeptr) = newsize;
+        *(MEMHANDLE(hdl)->memaddrptr) = ptr;
+        *(MEMHANDLE(hdl)->memsizeptr) = newsize;
     }
 
     /* now copy the bytes from the buffer into memory */
-    memcpy( *(memTable[hdl].memaddrptr) + memTable[hdl].currentpos,
+    memcpy( *(MEMHANDLE(hdl)->memaddrptr) + MEMHANDLE(hdl)->currentpos,
              buffer,
              nbytes);
 
-    memTable[hdl].currentpos += nbytes;
-    memTable[hdl].fitsfilesize =
-               maxvalue(memTable[hdl].fitsfilesize,
-                        memTable[hdl].currentpos);
+    MEMHANDLE(hdl)->currentpos += nbytes;
+    MEMHANDLE(hdl)->fitsfilesize =
+               maxvalue(MEMHANDLE(hdl)->fitsfilesize,
+                        MEMHANDLE(hdl)->currentpos);
     return(0);
 }
 
@@ -1247,15 +1340,15 @@ int mem_zuncompress_and_write(int hdl, void *buffer, long nbytes)
   size_t newsize;
   int status = 0;
 
-  if (memTable[hdl].currentpos != 0) {
+  if (MEMHANDLE(hdl)->currentpos != 0) {
       ffpmsg("cannot append uncompressed data (mem_uncompress_and_write)");
       return(WRITE_ERROR);
   }
 
   uncompress2mem_from_mem(buffer, nbytes,
-			  memTable[hdl].memaddrptr,
-			  memTable[hdl].memsizeptr,
-			  memTable[hdl].mem_realloc, 
+			  MEMHANDLE(hdl)->memaddrptr,
+			  MEMHANDLE(hdl)->memsizeptr,
+			  MEMHANDLE(hdl)->mem_realloc, 
 			  &newsize, &status);
   
   if (status) {
@@ -1263,8 +1356,8 @@ int mem_zuncompress_and_write(int hdl, void *buffer, long nbytes)
     return(WRITE_ERROR);
   }
 
-  memTable[hdl].currentpos += newsize;
-  memTable[hdl].fitsfilesize = newsize;
+  MEMHANDLE(hdl)->currentpos += newsize;
+  MEMHANDLE(hdl)->fitsfilesize = newsize;
   return(0);
 }
 
@@ -229,7 +229,9 @@ typedef struct  /* simple mem struct for receiving files from curl */
    size_t size;
 } curlmembuf;
 
-static rootdriver handleTable[NMAXFILES];  /* allocate diskfile handle tables */
+/* root file handle table, which grows as needed */
+static FFhandletable handleTable = FFHT_INIT(sizeof(rootdriver));
+#define ROOTHANDLE(hdl) ((rootdriver *) ffhtentry(&handleTable, hdl))
 
 /* static prototypes */
 
@@ -252,6 +254,7 @@ static int ftp_file_exist(char *url);
 static int root_send_buffer(int sock, int op, char *buffer, int buflen);
 static int root_recv_buffer(int sock, int *op, char *buffer,int buflen);
 static int root_openfile(char *filename, char *rwmode, int *sock);
+static int root_newhandle(int sock, int *handle);
 static int encode64(unsigned s_len, char *src, unsigned d_len, char *dst);
 static int ssl_get_with_curl(char *url, curlmembuf* buffer, 
                 char* username, char* password);
@@ -3998,13 +4001,6 @@ static void signal_handler(int sig) {
 /*--------------------------------------------------------------------------*/
 int root_init(void)
 {
-    int ii;
-
-    for (ii = 0; ii < NMAXFILES; ii++) /* initialize all empty slots in table */
-    {
-       handleTable[ii].sock = 0;
-       handleTable[ii].currentpos = 0;
-    }
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -4034,21 +4030,10 @@ int root_shutdown(void)
 /*--------------------------------------------------------------------------*/
 int root_open(char *url, int rwmode, int *handle)
 {
-    int ii, status;
+    int status;
     int sock;
 
     *handle = -1;
-    for (ii = 0; ii < NMAXFILES; ii++)  /* find empty slot in table */
-    {
-        if (handleTable[ii].sock == 0)
-        {
-            *handle = ii;
-            break;
-        }
-    }
-
-    if (*handle == -1)
-       return(TOO_MANY_FILES);    /* too many files opened */
 
     /*open the file */
     if (rwmode) {
@@ -4059,29 +4044,15 @@ int root_open(char *url, int rwmode, int *handle)
     if (status)
       return(status);
     
-    handleTable[ii].sock = sock;
-    handleTable[ii].currentpos = 0;
-    
-    return(0);
+    return(root_newhandle(sock, handle));
 }
 /*--------------------------------------------------------------------------*/
 int root_create(char *filename, int *handle)
 {
-    int ii, status;
+    int status;
     int sock;
 
     *handle = -1;
-    for (ii = 0; ii < NMAXFILES; ii++)  /* find empty slot in table */
-    {
-        if (handleTable[ii].sock == 0)
-        {
-            *handle = ii;
-            break;
-        }
-    }
-
-    if (*handle == -1)
-       return(TOO_MANY_FILES);    /* too many files opened */
 
     /*open the file */
     status = root_openfile(filename, "create", &sock);
@@ -4091,9 +4062,25 @@ int root_create(char *filename, int *handle)
       return(status);
     }
     
-    handleTable[ii].sock = sock;
-    handleTable[ii].currentpos = 0;
-    
+    return(root_newhandle(sock, handle));
+}
+/*--------------------------------------------------------------------------*/
+static int root_newhandle(int sock, int *handle)
+/*
+  allocate a handle for the open socket, closing it if that fails
+*/
+{
+    int status;
+
+    status = ffhtalloc(&handleTable, handle);
+    if (status) {
+      root_send_buffer(sock,ROOTD_CLOSE,NULL,0);
+      close(sock);
+      return(status);
+    }
+
+    ROOTHANDLE(*handle)->sock = sock;
+    ROOTHANDLE(*handle)->currentpos = 0;
     return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -4108,7 +4095,7 @@ int root_size(int handle, LONGLONG *filesize)
   int status;
   int op;
 
-  sock = handleTable[handle].sock;
+  sock = ROOTHANDLE(handle)->sock;
 
   status = root_send_buffer(sock,ROOTD_STAT,NULL,0);
   status = root_recv_buffer(sock,&op,(char *)&offset, 4);
@@ -4126,10 +4113,10 @@ int root_close(int handle)
   int status;
   int sock;
 
-  sock = handleTable[handle].sock;
+  sock = ROOTHANDLE(handle)->sock;
   status = root_send_buffer(sock,ROOTD_CLOSE,NULL,0);
   close(sock);
-  handleTable[handle].sock = 0;
+  ffhtfree(&handleTable, handle);
   return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -4141,7 +4128,7 @@ int root_flush(int handle)
   int status;
   int sock;
 
-  sock = handleTable[handle].sock;
+  sock = ROOTHANDLE(handle)->sock;
   status = root_send_buffer(sock,ROOTD_FLUSH,NULL,0);
   return(0);
 }
@@ -4151,7 +4138,7 @@ int root_seek(int handle, LONGLONG offset)
   seek to position relative to start of the file
 */
 {
-  handleTable[handle].currentpos = offset;
+  ROOTHANDLE(handle)->currentpos = offset;
   return(0);
 }
 /*--------------------------------------------------------------------------*/
@@ -4166,22 +4153,22 @@ int root_read(int hdl, void *buffer, long nbytes)
   int astat;
 
   /* we presume here that the file position will never be > 2**31 = 2.1GB */
-  snprintf(msg,SHORTLEN,"%ld %ld ",(long) handleTable[hdl].currentpos,nbytes);
-  status = root_send_buffer(handleTable[hdl].sock,ROOTD_GET,msg,strlen(msg));
+  snprintf(msg,SHORTLEN,"%ld %ld ",(long) ROOTHANDLE(hdl)->currentpos,nbytes);
+  status = root_send_buffer(ROOTHANDLE(hdl)->sock,ROOTD_GET,msg,strlen(msg));
   if ((unsigned) status != strlen(msg)) {
     return (READ_ERROR);
   }
   astat = 0;
-  status = root_recv_buffer(handleTable[hdl].sock,&op,(char *) &astat,4);
+  status = root_recv_buffer(ROOTHANDLE(hdl)->sock,&op,(char *) &astat,4);
   if (astat != 0) {
     return (READ_ERROR);
   }
 
-  status = NET_RecvRaw(handleTable[hdl].sock,buffer,nbytes);
+  status = NET_RecvRaw(ROOTHANDLE(hdl)->sock,buffer,nbytes);
   if (status != nbytes) {
     return (READ_ERROR);
   }
-  handleTable[hdl].currentpos += nbytes;
+  ROOTHANDLE(hdl)->currentpos += nbytes;
 
   return(0);
 }
@@ -4199,9 +4186,9 @@ int root_write(int hdl, void *buffer, long nbytes)
   int astat;
   int op;
 
-  sock = handleTable[hdl].sock;
+  sock = ROOTHANDLE(hdl)->sock;
   /* we presume here that the file position will never be > 2**31 = 2.1GB */
-  snprintf(msg,SHORTLEN,"%ld %ld ",(long) handleTable[hdl].currentpos,nbytes);
+  snprintf(msg,SHORTLEN,"%ld %ld ",(long) ROOTHANDLE(hdl)->currentpos,nbytes);
 
   len = strlen(msg);
   status = root_send_buffer(sock,ROOTD_PUT,msg,len+1);
@@ -4213,12 +4200,12 @@ int root_write(int hdl, void *buffer, long nbytes)
     return (WRITE_ERROR);
   }
   astat = 0;
-  status = root_recv_buffer(handleTable[hdl].sock,&op,(char *) &astat,4);
+  status = root_recv_buffer(ROOTHANDLE(hdl)->sock,&op,(char *) &astat,4);
 
   if (astat != 0) {
     return (WRITE_ERROR);
   }
-  handleTable[hdl].currentpos += nbytes;
+  ROOTHANDLE(hdl)->currentpos += nbytes;
   return(0);
 }
 
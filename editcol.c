@@ -9,6 +9,8 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include "fitsio2.h"
+
+#define REWRITE_BUFSIZE (1000 * IOBUFLEN) /* bytes of rows to rewrite at a time */
 /*--------------------------------------------------------------------------*/
 int ffrsim(fitsfile *fptr,      /* I - FITS file pointer           */
            int bitpix,          /* I - bits per pixel              */
@@ -2775,146 +2777,200 @@ int ffdcol(fitsfile *fptr,  /* I - FITS file pointer                        */
     return(*status);
 }
 /*--------------------------------------------------------------------------*/
-int ffcins(fitsfile *fptr,  /* I - FITS file pointer                        */
-           LONGLONG naxis1,     /* I - width of the table, in bytes             */
-           LONGLONG naxis2,     /* I - number of rows in the table              */
-           LONGLONG ninsert,    /* I - number of bytes to insert in each row    */
-           LONGLONG bytepos,    /* I - rel. position in row to insert bytes     */
+int ffdcls(fitsfile *fptr,  /* I - FITS file pointer                        */
+           int ncols,       /* I - number of columns to delete              */
+           int *colnums,    /* I - list of columns to delete (1 = 1st)      */
            int *status)     /* IO - error status                            */
 /*
- Insert 'ninsert' bytes into each row of the table at position 'bytepos'.
+  Delete a list of columns from a table.  The columns may be given in any
+  order.  In a binary table all the columns are removed with a single pass
+  through the rows of the table; ASCII table columns are deleted one at a
+  time with ffdcol.
 */
 {
-    unsigned char buffer[10000], cfill;
-    LONGLONG newlen, fbyte, nbytes, irow, nseg, ii;
+    int ii, jj, tfields, nkeep, tstatus, *cols;
+    LONGLONG firstbyte, size, ndelete, naxis1, naxis2, delbyte, freespace;
+    LONGLONG lastend, *srcpos, *seglen;
+    long nblock;
+    tcolumn *colptr;
 
-    if (*status > 0)
+    if (*status > 0 || ncols < 1)
         return(*status);
 
-    if (naxis2 == 0)
-        return(*status);  /* just return if there are 0 rows in the table */
+    if (fptr->HDUposition != (fptr->Fptr)->curhdu)
+    {
+        ffmahd(fptr, (fptr->HDUposition) + 1, NULL, status);
+    }
+    /* rescan header if data structure is undefined */
+    else if ((fptr->Fptr)->datastart == DATA_UNDEFINED)
+        if ( ffrdef(fptr, status) > 0)               
+            return(*status);
 
-    /* select appropriate fill value */
-    if ((fptr->Fptr)->hdutype == ASCII_TBL)
-        cfill = 32;                     /* ASCII tables use blank fill */
-    else
-        cfill = 0;    /* primary array and binary tables use zero fill */
+    if ((fptr->Fptr)->hdutype == IMAGE_HDU)
+    {
+       ffpmsg
+       ("Can only delete columns from TABLE or BINTABLE extension (ffdcls)");
+       return(*status = NOT_TABLE);
+    }
 
-    newlen = naxis1 + ninsert;
+    tfields = (fptr->Fptr)->tfield;
 
-    if (newlen <= 10000)
+    /* make a sorted list of the distinct column numbers */
+    cols = (int *) calloc(tfields + 2, sizeof(int));
+    srcpos = (LONGLONG *) malloc((tfields + 2) * sizeof(LONGLONG));
+    seglen = (LONGLONG *) malloc((tfields + 2) * sizeof(LONGLONG));
+    if (!cols || !srcpos || !seglen)
     {
-       /*******************************************************************
-       CASE #1: optimal case where whole new row fits in the work buffer
-       *******************************************************************/
+        free(cols);
+        free(srcpos);
+        free(seglen);
+        ffpmsg("Failed to allocate memory for column list (ffdcls)");
+        return(*status = MEMORY_ALLOCATION);
+    }
 
-        for (ii = 0; ii < ninsert; ii++)
-            buffer[ii] = cfill;      /* initialize buffer with fill value */
+    for (ii = 0; ii < ncols; ii++)
+    {
+        if (colnums[ii] < 1 || colnums[ii] > tfields)
+        {
+            free(cols);
+            free(srcpos);
+            free(seglen);
+            return(*status = BAD_COL_NUM);
+        }
+        cols[colnums[ii]] = 1;   /* flag the columns to delete */
+    }
 
-        /* first move the trailing bytes (if any) in the last row */
-        fbyte = bytepos + 1;
-        nbytes = naxis1 - bytepos;
-        /* If the last row hasn't yet been accessed in full, it's possible
-           that logfilesize hasn't been updated to account for it (by way
-           of an ffldrc call).  This could cause ffgtbb to return with an
-           EOF error.  To prevent this, we must increase logfilesize here. 
-        */
-        if ((fptr->Fptr)->logfilesize < (fptr->Fptr)->datastart + 
-                 (fptr->Fptr)->heapstart)
+    if ((fptr->Fptr)->hdutype == ASCII_TBL)
+    {
+        /* delete the ASCII columns one by one, starting with the last */
+        for (ii = tfields; ii > 0 && *status <= 0; ii--)
         {
-            (fptr->Fptr)->logfilesize = (((fptr->Fptr)->datastart +
-                 (fptr->Fptr)->heapstart + 2879)/2880)*2880;
+            if (cols[ii])
+                ffdcol(fptr, ii, status);
         }
-        
-        ffgtbb(fptr, naxis2, fbyte, nbytes, &buffer[ninsert], status);
-        (fptr->Fptr)->rowlength = newlen; /*  new row length */
 
-        /* write the row (with leading fill bytes) in the new place */
-        nbytes += ninsert;
-        ffptbb(fptr, naxis2, fbyte, nbytes, buffer, status);
-        (fptr->Fptr)->rowlength = naxis1;  /* reset to orig. value */
+        free(cols);
+        free(srcpos);
+        free(seglen);
+        return(*status);
+    }
 
-        /*  now move the rest of the rows */
-        for (irow = naxis2 - 1; irow > 0; irow--)
-        {
-            /* read the row to be shifted (work backwards thru the table) */
-            ffgtbb(fptr, irow, fbyte, naxis1, &buffer[ninsert], status);
-            (fptr->Fptr)->rowlength = newlen; /* new row length */
+    naxis1 = (fptr->Fptr)->rowlength;   /* current width of the table */
+    naxis2 = (fptr->Fptr)->numrows;
 
-            /* write the row (with the leading fill bytes) in the new place */
-            ffptbb(fptr, irow, fbyte, newlen, buffer, status);
-            (fptr->Fptr)->rowlength = naxis1; /* reset to orig value */
+    /* make the list of byte ranges that are kept in each row */
+    nkeep = 0;
+    lastend = 0;
+    delbyte = 0;
+    colptr = (fptr->Fptr)->tableptr;
+    for (ii = 1; ii <= tfields; ii++, colptr++)
+    {
+        if (!cols[ii])
+            continue;
+
+        if (colptr->tbcol > lastend)
+        {
+            srcpos[nkeep] = lastend;
+            seglen[nkeep] = colptr->tbcol - lastend;
+            nkeep++;
         }
+
+        lastend = (ii < tfields) ? (colptr + 1)->tbcol : naxis1;
+        delbyte += lastend - colptr->tbcol;
     }
-    else
+
+    if (lastend < naxis1)
     {
-        /*****************************************************************
-        CASE #2:  whole row doesn't fit in work buffer; move row in pieces
-        ******************************************************************
-        first copy the data, then go back and write fill into the new column
-        start by copying the trailing bytes (if any) in the last row.     */
+        srcpos[nkeep] = lastend;
+        seglen[nkeep] = naxis1 - lastend;
+        nkeep++;
+    }
 
-        nbytes = naxis1 - bytepos;
-        nseg = (nbytes + 9999) / 10000;
-        fbyte = (nseg - 1) * 10000 + bytepos + 1;
-        nbytes = naxis1 - fbyte + 1;
+    /* current size of table */
+    size = (fptr->Fptr)->heapstart + (fptr->Fptr)->heapsize;
+    freespace = ((LONGLONG)delbyte * naxis2) + ((size + 2879) / 2880) * 2880 - size;
+    nblock = (long) (freespace / 2880);   /* number of empty blocks to delete */
 
-        for (ii = 0; ii < nseg; ii++)
-        {
-            ffgtbb(fptr, naxis2, fbyte, nbytes, buffer, status);
-            (fptr->Fptr)->rowlength =   newlen;  /* new row length */
+    /* rewrite all the rows without the deleted columns */
+    ffrwlay(fptr, naxis1, naxis2, naxis1 - delbyte, nkeep, srcpos, seglen,
+            status);
 
-            ffptbb(fptr, naxis2, fbyte + ninsert, nbytes, buffer, status);
-            (fptr->Fptr)->rowlength =   naxis1; /* reset to orig value */
+    free(srcpos);
+    free(seglen);
 
-            fbyte -= 10000;
-            nbytes = 10000;
-        }
+    /* absolute heap position */
+    firstbyte = (fptr->Fptr)->datastart + (fptr->Fptr)->heapstart;
+    ndelete = (LONGLONG)delbyte * naxis2; /* size of shift */
 
-        /* now move the rest of the rows */
-        nseg = (naxis1 + 9999) / 10000;
-        for (irow = naxis2 - 1; irow > 0; irow--)
-        {
-          fbyte = (nseg - 1) * 10000 + bytepos + 1;
-          nbytes = naxis1 - (nseg - 1) * 10000;
-          for (ii = 0; ii < nseg; ii++)
-          { 
-            /* read the row to be shifted (work backwards thru the table) */
-            ffgtbb(fptr, irow, fbyte, nbytes, buffer, status);
-            (fptr->Fptr)->rowlength =   newlen;  /* new row length */
-
-            /* write the row in the new place */
-            ffptbb(fptr, irow, fbyte + ninsert, nbytes, buffer, status);
-            (fptr->Fptr)->rowlength =   naxis1; /* reset to orig value */
-
-            fbyte -= 10000;
-            nbytes = 10000;
-          }
-        }
+    /* shift heap up (if it exists) */
+    if ((fptr->Fptr)->heapsize > 0 && *status <= 0)
+    {
+      if (ffshft(fptr, firstbyte, (fptr->Fptr)->heapsize, -ndelete,
+          status) > 0) /* mv heap */
+      {
+          free(cols);
+          return(*status);
+      }
+    }
+
+    /* delete the empty  blocks at the end of the HDU */
+    if (nblock > 0)
+        ffdblk(fptr, nblock, status);
 
-        /* now write the fill values into the new column */
-        nbytes = minvalue(ninsert, 10000);
-        memset(buffer, cfill, (size_t) nbytes); /* initialize with fill value */
+    /* update the heap starting address */
+    (fptr->Fptr)->heapstart -= ndelete;
 
-        nseg = (ninsert + 9999) / 10000;
-        (fptr->Fptr)->rowlength =  newlen;  /* new row length */
+    /* update the THEAP keyword if it exists */
+    tstatus = 0;
+    ffmkyj(fptr, "THEAP", (long)(fptr->Fptr)->heapstart, "&", &tstatus);
 
-        for (irow = 1; irow <= naxis2; irow++)
-        {
-          fbyte = bytepos + 1;
-          nbytes = ninsert - ((nseg - 1) * 10000);
-          for (ii = 0; ii < nseg; ii++)
-          {
-            ffptbb(fptr, irow, fbyte, nbytes, buffer, status);
-            fbyte += nbytes;
-            nbytes = 10000;
-          }
-        }
-        (fptr->Fptr)->rowlength = naxis1;  /* reset to orig value */
+    /* update the mandatory keywords */
+    for (ii = 1, jj = 0; ii <= tfields; ii++)
+        jj += cols[ii];   /* number of distinct columns deleted */
+
+    ffmkyj(fptr, "TFIELDS", tfields - jj, "&", status);        
+    ffmkyj(fptr,  "NAXIS1",   naxis1 - delbyte, "&", status);
+
+    /*
+      delete the index keywords starting with 'T' associated with the 
+      deleted columns and shift the index of all higher keywords, starting
+      with the last deleted column so the lower numbers stay valid
+    */
+    for (ii = tfields; ii > 0; ii--)
+    {
+        if (cols[ii])
+            ffkshf(fptr, ii, tfields, -1, status);
     }
+
+    free(cols);
+    ffrdef(fptr, status);  /* initialize the new table structure */
     return(*status);
 }
 /*--------------------------------------------------------------------------*/
+int ffcins(fitsfile *fptr,  /* I - FITS file pointer                        */
+           LONGLONG naxis1,     /* I - width of the table, in bytes             */
+           LONGLONG naxis2,     /* I - number of rows in the table              */
+           LONGLONG ninsert,    /* I - number of bytes to insert in each row    */
+           LONGLONG bytepos,    /* I - rel. position in row to insert bytes     */
+           int *status)     /* IO - error status                            */
+/*
+ Insert 'ninsert' bytes into each row of the table at position 'bytepos'.
+*/
+{
+    LONGLONG srcpos[3], seglen[3];
+
+    /* new row = leading bytes + fill bytes + trailing bytes */
+    srcpos[0] = 0;
+    seglen[0] = bytepos;
+    srcpos[1] = -1;
+    seglen[1] = ninsert;
+    srcpos[2] = bytepos;
+    seglen[2] = naxis1 - bytepos;
+
+    return(ffrwlay(fptr, naxis1, naxis2, naxis1 + ninsert, 3, srcpos, seglen,
+           status));
+}
+/*--------------------------------------------------------------------------*/
 int ffcdel(fitsfile *fptr,  /* I - FITS file pointer                        */
            LONGLONG naxis1,     /* I - width of the table, in bytes             */
            LONGLONG naxis2,     /* I - number of rows in the table              */
@@ -2924,9 +2980,42 @@ int ffcdel(fitsfile *fptr,  /* I - FITS file pointer                        */
 /*
  delete 'ndelete' bytes from each row of the table at position 'bytepos'.  */
 {
-    unsigned char buffer[10000];
-    LONGLONG i1, i2, ii, irow, nseg;
-    LONGLONG newlen, remain, nbytes;
+    LONGLONG srcpos[2], seglen[2];
+
+    /* new row = leading bytes + trailing bytes */
+    srcpos[0] = 0;
+    seglen[0] = bytepos;
+    srcpos[1] = bytepos + ndelete;
+    seglen[1] = naxis1 - bytepos - ndelete;
+
+    return(ffrwlay(fptr, naxis1, naxis2, naxis1 - ndelete, 2, srcpos, seglen,
+           status));
+}
+/*--------------------------------------------------------------------------*/
+int ffrwlay(fitsfile *fptr,  /* I - FITS file pointer                       */
+           LONGLONG naxis1,     /* I - current width of the table, in bytes     */
+           LONGLONG naxis2,     /* I - number of rows in the table              */
+           LONGLONG newlen,     /* I - new width of the table, in bytes         */
+           int nseg,            /* I - number of segments in the new rows       */
+           LONGLONG *srcpos,    /* I - position of each segment in the old row, */
+                                /*     or < 0 to fill the segment               */
+           LONGLONG *seglen,    /* I - length of each segment, in bytes         */
+           int *status)     /* IO - error status                            */
+/*
+  Rewrite every row of the table with a new layout, in a single pass.  Each
+  new row is the concatenation of nseg segments, which are either copied
+  from the given byte position in the old row, or filled with blanks (ASCII
+  tables) or zeros (binary tables).  The sum of the segment lengths must
+  equal newlen.  Large blocks of rows are read, rebuilt in memory and
+  written back.  If the rows get wider, the blocks are processed from the
+  end of the table backwards, otherwise from the start forwards, so that
+  rows are never overwritten before they have been read.  If the rows get
+  wider, the caller must already have made room for the larger table.
+*/
+{
+    unsigned char cfill, *inbuff, *outbuff, *iptr, *optr;
+    LONGLONG bufrows, nrows, done, first, readpos, nread, ii;
+    int iseg, grow;
 
     if (*status > 0)
         return(*status);
@@ -2934,86 +3023,95 @@ int ffcdel(fitsfile *fptr,  /* I - FITS file pointer                        */
     if (naxis2 == 0)
         return(*status);  /* just return if there are 0 rows in the table */
 
-    newlen = naxis1 - ndelete;
+    /* select appropriate fill value */
+    if ((fptr->Fptr)->hdutype == ASCII_TBL)
+        cfill = 32;                     /* ASCII tables use blank fill */
+    else
+        cfill = 0;    /* primary array and binary tables use zero fill */
 
-    if (newlen <= 10000)
+    /* If the last row hasn't yet been accessed in full, it's possible
+       that logfilesize hasn't been updated to account for it (by way
+       of an ffldrc call).  This could cause the read to return with an
+       EOF error.  To prevent this, we must increase logfilesize here. 
+    */
+    if ((fptr->Fptr)->logfilesize < (fptr->Fptr)->datastart + 
+             (fptr->Fptr)->heapstart)
     {
-      /*******************************************************************
-      CASE #1: optimal case where whole new row fits in the work buffer
-      *******************************************************************/
-      i1 = bytepos + 1;
-      i2 = i1 + ndelete;
-      for (irow = 1; irow < naxis2; irow++)
-      {
-        ffgtbb(fptr, irow, i2, newlen, buffer, status); /* read row */
-        (fptr->Fptr)->rowlength = newlen;  /* new row length */
+        (fptr->Fptr)->logfilesize = (((fptr->Fptr)->datastart +
+             (fptr->Fptr)->heapstart + 2879)/2880)*2880;
+    }
 
-        ffptbb(fptr, irow, i1, newlen, buffer, status); /* write row */
-        (fptr->Fptr)->rowlength = naxis1;  /* reset to orig value */
-      }
+    /* number of rows to process at a time */
+    bufrows = REWRITE_BUFSIZE / maxvalue(1, maxvalue(naxis1, newlen));
+    bufrows = minvalue(maxvalue(bufrows, 1), naxis2);
 
-      /* now do the last row */
-      remain = naxis1 - (bytepos + ndelete);
+    inbuff = (unsigned char *) malloc((size_t) maxvalue(1, bufrows * naxis1));
+    outbuff = (unsigned char *) malloc((size_t) maxvalue(1, bufrows * newlen));
+    if (!inbuff || !outbuff)
+    {
+        free(inbuff);
+        free(outbuff);
+        ffpmsg("Failed to allocate memory to rewrite table rows (ffrwlay)");
+        return(*status = MEMORY_ALLOCATION);
+    }
 
-      if (remain > 0)
-      {
-        ffgtbb(fptr, naxis2, i2, remain, buffer, status); /* read row */
-        (fptr->Fptr)->rowlength = newlen;  /* new row length */
+    grow = (newlen > naxis1);
 
-        ffptbb(fptr, naxis2, i1, remain, buffer, status); /* write row */
-        (fptr->Fptr)->rowlength = naxis1;  /* reset to orig value */
-      }
-    }
-    else
+    for (done = 0; done < naxis2; done += nrows)
     {
-        /*****************************************************************
-        CASE #2:  whole row doesn't fit in work buffer; move row in pieces
-        ******************************************************************/
+        nrows = minvalue(bufrows, naxis2 - done);
+        first = grow ? naxis2 - done - nrows : done;  /* 0-based first row */
+
+        /* read the block of old rows */
+        readpos = (fptr->Fptr)->datastart + first * naxis1;
+        ffmbyt(fptr, readpos, REPORT_EOF, status);
 
-        nseg = (newlen + 9999) / 10000;
-        for (irow = 1; irow < naxis2; irow++)
+        if (readpos + nrows * naxis1 <= (fptr->Fptr)->filesize)
         {
-          i1 = bytepos + 1;
-          i2 = i1 + ndelete;
+            ffgbyt(fptr, nrows * naxis1, inbuff, status);
+        }
+        else
+        {
+            /* the rows are not all on disk yet, so read them via the IO */
+            /* buffers, in pieces that are too small to be read directly */
+            for (ii = 0; ii < nrows * naxis1; ii += nread)
+            {
+                nread = minvalue(nrows * naxis1 - ii, IOBUFLEN);
+                ffgbyt(fptr, nread, inbuff + ii, status);
+            }
+        }
 
-          nbytes = newlen - (nseg - 1) * 10000;
-          for (ii = 0; ii < nseg; ii++)
-          { 
-            ffgtbb(fptr, irow, i2, nbytes, buffer, status); /* read bytes */
-            (fptr->Fptr)->rowlength = newlen;  /* new row length */
+        /* build the new rows */
+        for (ii = 0; ii < nrows; ii++)
+        {
+            iptr = inbuff + ii * naxis1;
+            optr = outbuff + ii * newlen;
 
-            ffptbb(fptr, irow, i1, nbytes, buffer, status); /* rewrite bytes */
-            (fptr->Fptr)->rowlength = naxis1; /* reset to orig value */
+            for (iseg = 0; iseg < nseg; iseg++)
+            {
+                if (srcpos[iseg] < 0)
+                    memset(optr, cfill, (size_t) seglen[iseg]);
+                else
+                    memcpy(optr, iptr + srcpos[iseg], (size_t) seglen[iseg]);
 
-            i1 += nbytes;
-            i2 += nbytes;
-            nbytes = 10000;
-          }
+                optr += seglen[iseg];
+            }
         }
 
-        /* now do the last row */
-        remain = naxis1 - (bytepos + ndelete);
+        /* write them in the new place */
+        ffmbyt(fptr, (fptr->Fptr)->datastart + first * newlen, IGNORE_EOF,
+               status);
+        ffpbyt(fptr, nrows * newlen, outbuff, status);
 
-        if (remain > 0)
+        if (*status > 0)
         {
-          nseg = (remain + 9999) / 10000;
-          i1 = bytepos + 1;
-          i2 = i1 + ndelete;
-          nbytes = remain - (nseg - 1) * 10000;
-          for (ii = 0; ii < nseg; ii++)
-          { 
-            ffgtbb(fptr, naxis2, i2, nbytes, buffer, status);
-            (fptr->Fptr)->rowlength = newlen;  /* new row length */
-
-            ffptbb(fptr, naxis2, i1, nbytes, buffer, status); /* write row */
-            (fptr->Fptr)->rowlength = naxis1;  /* reset to orig value */
-
-            i1 += nbytes;
-            i2 += nbytes;
-            nbytes = 10000;
-          }
+            ffpmsg("Error rewriting the rows of the table (ffrwlay)");
+            break;
         }
     }
+
+    free(inbuff);
+    free(outbuff);
     return(*status);
 }
 /*--------------------------------------------------------------------------*/
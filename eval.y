@@ -163,6 +163,16 @@ static int  Locate_Col( ParseData *, Node *this );
 static int  Test_Dims ( ParseData *, int Node1, int Node2 );
 static void Copy_Dims ( ParseData *, int Node1, int Node2 );
 
+static int  Optimize_Node( ParseData *, int thisNode, int *canon, int *cost,
+			   int *hashHead, int *hashNext, int hashMask );
+static int  Same_Node    ( ParseData *, int Node1, int Node2 );
+static void Count_Refs   ( ParseData *, int thisNode, char *seen );
+static void Free_Value   ( Node *this );
+static int  Evaluate_Shortcut( ParseData *, Node *this );
+static int  Row_Local    ( ParseData *, int thisNode );
+static void Gather_Rows  ( ParseData *, int thisNode, long nLive, long *rows,
+			   int *gNodes, lval *gSaved, int *nG );
+
 static void Allocate_Ptrs( ParseData *, Node *this );
 static void Do_Unary     ( ParseData *, Node *this );
 static void Do_Offset    ( ParseData *, Node *this );
@@ -186,9 +196,11 @@ static double GTI_Over(double evtStart, double evtStop,
 		       long *gtiout);
 
 static char  saobox (double xcen, double ycen, double xwid, double ywid,
-		     double rot,  double xcol, double ycol);
+		     double cosr, double sinr, double xcol, double ycol);
 static char  ellipse(double xcen, double ycen, double xrad, double yrad,
-		     double rot, double xcol, double ycol);
+		     double cosr, double sinr, double xcol, double ycol);
+static double angsep_hav(double dra, double ddec,
+			 double cosdec1, double cosdec2);
 static char  circle (double xcen, double ycen, double rad,
 		     double xcol, double ycol);
 static char  bnear  (double x, double y, double tolerance);
@@ -1365,6 +1377,8 @@ static int Alloc_Node( ParseData *lParse )
       }
    }
 
+   lParse->Nodes[ lParse->nNodes ].nRefs    = 0;
+   lParse->Nodes[ lParse->nNodes ].nPending = 0;
    return ( lParse->nNodes++ );
 }
 
@@ -2252,6 +2266,245 @@ static void Copy_Dims( ParseData *lParse, int Node1, int Node2 )
       that1->value.naxes[i] = that2->value.naxes[i];
 }
 
+/********************************************************************/
+/*    Routines for optimizing the parsed expression start here      */
+/********************************************************************/
+
+void Optimize_Parser( ParseData *lParse )
+    /***********************************************************************/
+    /*  Simplify the finished expression tree before it is evaluated:      */
+    /*    - identical subtrees (same operation, type, dimensions and       */
+    /*      operands) are merged so each is evaluated only once per row    */
+    /*      chunk; Evaluate_Node keeps a shared result alive until its     */
+    /*      last consumer has run (see nRefs/nPending in Node)             */
+    /*    - x**2 on doubles becomes x*x                                    */
+    /*    - the operands of && and || are ordered cheapest first           */
+    /*  Null propagation is unaffected: merged subtrees produce the same   */
+    /*  undef arrays, and AND/OR treat their operands symmetrically.       */
+    /*  When several expressions were parsed together (nResultNodes>0),    */
+    /*  subtrees are merged across all of them and each root counts as    */
+    /*  one more consumer of its node.                                     */
+    /***********************************************************************/
+{
+   int *canon, *cost, *hashHead, *hashNext;
+   int i, hashSize;
+   char *seen;
+
+   if( lParse->status || lParse->nNodes<2 ) return;
+
+   hashSize = 64;
+   while( hashSize < 2*lParse->nNodes ) hashSize += hashSize;
+
+   canon    = (int *)malloc( (3*lParse->nNodes + hashSize) * sizeof(int) );
+   seen     = (char *)calloc( lParse->nNodes, sizeof(char) );
+   if( !canon || !seen ) {
+      if( canon ) free( canon );
+      if( seen  ) free( seen  );
+      lParse->status = MEMORY_ALLOCATION;
+      return;
+   }
+   cost     = canon + lParse->nNodes;
+   hashNext = cost  + lParse->nNodes;
+   hashHead = hashNext + lParse->nNodes;
+   for( i=0; i<lParse->nNodes; i++ ) canon[i] = -1;
+   for( i=0; i<hashSize; i++ ) hashHead[i] = -1;
+
+   lParse->resultNode = Optimize_Node( lParse, lParse->resultNode, canon, cost,
+				       hashHead, hashNext, hashSize-1 );
+   for( i=0; i<lParse->nResultNodes; i++ )
+      lParse->resultNodes[i] = Optimize_Node( lParse, lParse->resultNodes[i],
+					      canon, cost, hashHead, hashNext,
+					      hashSize-1 );
+
+   for( i=0; i<lParse->nNodes; i++ ) {
+      lParse->Nodes[i].nRefs    = 0;
+      lParse->Nodes[i].nPending = 0;
+   }
+   Count_Refs( lParse, lParse->resultNode, seen );
+   for( i=0; i<lParse->nResultNodes; i++ ) {
+      lParse->Nodes[ lParse->resultNodes[i] ].nRefs++;
+      Count_Refs( lParse, lParse->resultNodes[i], seen );
+   }
+
+   free( canon );
+   free( seen );
+}
+
+static int Optimize_Node( ParseData *lParse, int thisNode, int *canon,
+			  int *cost, int *hashHead, int *hashNext, int hashMask )
+    /***********************************************************************/
+    /*  Depth-first rewrite of thisNode's subtree.  Returns the index of   */
+    /*  the node which should be used in place of thisNode.                */
+    /***********************************************************************/
+{
+   Node *this, *that;
+   int i, n, tmp, share;
+   unsigned int hash;
+
+   if( canon[thisNode]>=0 ) return( canon[thisNode] );
+
+   this = lParse->Nodes + thisNode;
+   if( this->operation==CONST_OP ) {
+      cost[thisNode]  = 0;
+      canon[thisNode] = thisNode;
+      return( thisNode );
+   }
+
+   cost[thisNode] = ( this->DoOp==Do_Func || this->DoOp==Do_GTI
+		      || this->DoOp==Do_GTI_Over || this->DoOp==Do_REG ? 16 : 1 );
+   for( i=0; i<this->nSubNodes; i++ ) {
+      n = Optimize_Node( lParse, this->SubNodes[i], canon, cost,
+			 hashHead, hashNext, hashMask );
+      this->SubNodes[i] = n;
+      cost[thisNode] += cost[n];
+   }
+   if( cost[thisNode] > 0x1000000 ) cost[thisNode] = 0x1000000;
+
+   /*  x**2 --> x*x  */
+
+   if( this->operation==POWER && this->DoOp==Do_BinOp_dbl ) {
+      that = lParse->Nodes + this->SubNodes[1];
+      if( that->operation==CONST_OP && that->value.data.dbl==2.0
+	  && OPER(this->SubNodes[0])!=CONST_OP ) {
+	 this->operation   = '*';
+	 this->SubNodes[1] = this->SubNodes[0];
+      }
+   }
+
+   /*  Cheapest operand of && and || first, ties broken by node index  */
+   /*  so that a&&b and b&&a become the same subtree                   */
+
+   if( (this->operation==AND || this->operation==OR)
+       && this->DoOp==Do_BinOp_log ) {
+      if( cost[this->SubNodes[0]] > cost[this->SubNodes[1]]
+	  || ( cost[this->SubNodes[0]] == cost[this->SubNodes[1]]
+	       && this->SubNodes[0] > this->SubNodes[1] ) ) {
+	 tmp               = this->SubNodes[0];
+	 this->SubNodes[0] = this->SubNodes[1];
+	 this->SubNodes[1] = tmp;
+      }
+   }
+
+   /*  Look for an identical subtree built earlier.  Random deviates,  */
+   /*  running sums/differences (which keep state between chunks) and  */
+   /*  GTI/region filters (which own data) are never shared.           */
+
+   share = 1;
+   if( this->operation==ACCUM || this->operation==DIFF
+       || this->DoOp==Do_GTI || this->DoOp==Do_GTI_Over
+       || this->DoOp==Do_REG )
+      share = 0;
+   if( this->DoOp==Do_Func && ( this->operation==rnd_fct
+				|| this->operation==gasrnd_fct
+				|| this->operation==poirnd_fct ) )
+      share = 0;
+
+   if( share ) {
+      hash = (unsigned int)this->operation * 31u + (unsigned int)this->type;
+      hash = hash * 31u + (unsigned int)this->value.nelem;
+      for( i=0; i<this->nSubNodes; i++ ) {
+	 n = this->SubNodes[i];
+	 hash = hash * 31u + ( OPER(n)==CONST_OP ? 0u : (unsigned int)n + 1u );
+      }
+      hash &= hashMask;
+
+      for( n=hashHead[hash]; n>=0; n=hashNext[n] ) {
+	 if( Same_Node( lParse, n, thisNode ) ) {
+	    canon[thisNode] = n;
+	    return( n );
+	 }
+      }
+      hashNext[thisNode] = hashHead[hash];
+      hashHead[hash]     = thisNode;
+   }
+
+   canon[thisNode] = thisNode;
+   return( thisNode );
+}
+
+static int Same_Node( ParseData *lParse, int Node1, int Node2 )
+{
+   Node *this1, *this2, *that1, *that2;
+   int i;
+
+   this1 = lParse->Nodes + Node1;
+   this2 = lParse->Nodes + Node2;
+
+   if( this1->operation   != this2->operation
+       || this1->type        != this2->type
+       || this1->DoOp        != this2->DoOp
+       || this1->nSubNodes   != this2->nSubNodes
+       || this1->value.nelem != this2->value.nelem
+       || this1->value.naxis != this2->value.naxis )
+      return( 0 );
+   for( i=0; i<this1->value.naxis; i++ )
+      if( this1->value.naxes[i] != this2->value.naxes[i] ) return( 0 );
+
+   for( i=0; i<this1->nSubNodes; i++ ) {
+      if( this1->SubNodes[i] == this2->SubNodes[i] ) continue;
+
+      /*  Distinct constant nodes are equal if they hold the same scalar  */
+
+      that1 = lParse->Nodes + this1->SubNodes[i];
+      that2 = lParse->Nodes + this2->SubNodes[i];
+      if( that1->operation!=CONST_OP || that2->operation!=CONST_OP
+	  || that1->type!=that2->type || that1->value.nelem!=1
+	  || that2->value.nelem!=1 )
+	 return( 0 );
+      switch( that1->type ) {
+      case DOUBLE:
+	 if( memcmp( &that1->value.data.dbl, &that2->value.data.dbl,
+		     sizeof(double) ) ) return( 0 );
+	 break;
+      case LONG:
+	 if( that1->value.data.lng != that2->value.data.lng ) return( 0 );
+	 break;
+      case BOOLEAN:
+	 if( that1->value.data.log != that2->value.data.log ) return( 0 );
+	 break;
+      case STRING:
+      case BITSTR:
+	 if( strcmp( that1->value.data.str, that2->value.data.str ) )
+	    return( 0 );
+	 break;
+      default:
+	 return( 0 );
+      }
+   }
+   return( 1 );
+}
+
+static void Count_Refs( ParseData *lParse, int thisNode, char *seen )
+    /***********************************************************************/
+    /*  Count, for every node reachable from thisNode, how many evaluated  */
+    /*  operands refer to it                                               */
+    /***********************************************************************/
+{
+   Node *this;
+   int i;
+
+   if( seen[thisNode] ) return;
+   seen[thisNode] = 1;
+
+   this = lParse->Nodes + thisNode;
+   if( this->operation<=0 ) return;
+
+   for( i=0; i<this->nSubNodes; i++ ) {
+      lParse->Nodes[ this->SubNodes[i] ].nRefs++;
+      Count_Refs( lParse, this->SubNodes[i], seen );
+   }
+}
+
+static void Free_Value( Node *this )
+{
+   if( this->type==BITSTR || this->type==STRING ) {
+      free( this->value.data.strptr[0] );
+      free( this->value.data.strptr );
+   } else {
+      free( this->value.data.ptr );
+   }
+}
+
 /********************************************************************/
 /*    Routines for actually evaluating the expression start here    */
 /********************************************************************/
@@ -2263,22 +2516,25 @@ void Evaluate_Parser( ParseData *lParse, long firstRow, long nRows )
     /*    nRows:     Number of rows to be processed                        */
     /*  Initialize each COLUMN node so that its UNDEF and DATA pointers    */
     /*  point to the appropriate column arrays.                            */
-    /*  Finally, call Evaluate_Node for final node.                        */
+    /*  Finally, call Evaluate_Node for final node, or for every root of   */
+    /*  expressions parsed together.  A root shared with another one is    */
+    /*  left pending until the caller has consumed it nRefs times.         */
     /***********************************************************************/
 {
    int     i, column;
    long    offset, rowOffset;
-   static int rand_initialized = 0;
-
-   /* Initialize the random number generator once and only once */
-   if (rand_initialized == 0) {
-     simplerng_srand( (unsigned int) time(NULL) );
-     rand_initialized = 1;
-   }
-
    lParse->firstRow = firstRow;
    lParse->nRows    = nRows;
 
+   /*  Discard shared results left over from an aborted evaluation  */
+
+   for( i=0; i<lParse->nNodes; i++ ) {
+      if( lParse->Nodes[i].nPending ) {
+	 Free_Value( lParse->Nodes + i );
+	 lParse->Nodes[i].nPending = 0;
+      }
+   }
+
    /*  Reset Column Nodes' pointers to point to right data and UNDEF arrays  */
 
    rowOffset = firstRow - lParse->firstDataRow;
@@ -2316,7 +2572,35 @@ void Evaluate_Parser( ParseData *lParse, long firstRow, long nRows )
       }
    }
 
-   Evaluate_Node( lParse, lParse->resultNode );
+   if( lParse->nResultNodes ) {
+      for( i=0; i<lParse->nResultNodes; i++ )
+	 Evaluate_Node( lParse, lParse->resultNodes[i] );
+   } else
+      Evaluate_Node( lParse, lParse->resultNode );
+}
+
+int Rows_Independent( ParseData *lParse )
+    /***********************************************************************/
+    /*  True if each row's result depends on that row alone, so separate   */
+    /*  blocks of rows may be evaluated at once on private copies of the   */
+    /*  Nodes: nothing looks at other rows, keeps running totals or draws  */
+    /*  from the random number stream.                                     */
+    /***********************************************************************/
+{
+   Node *this;
+   int i;
+
+   for( i=0; i<lParse->nNodes; i++ ) {
+      this = lParse->Nodes + i;
+      if( this->operation==ACCUM || this->operation==DIFF
+	  || this->DoOp==Do_Offset )
+	 return( 0 );
+      if( this->DoOp==Do_Func && ( this->operation==rnd_fct
+				   || this->operation==gasrnd_fct
+				   || this->operation==poirnd_fct ) )
+	 return( 0 );
+   }
+   return( 1 );
 }
 
 static void Evaluate_Node( ParseData *lParse, int thisNode )
@@ -2325,22 +2609,262 @@ static void Evaluate_Node( ParseData *lParse, int thisNode )
     /*  Do_<Action> functions pointed to by thisNode's DoOp element.      */
     /**********************************************************************/
 {
-   Node *this;
+   Node *this, *that;
    int i;
    
    if( lParse->status ) return;
 
    this = lParse->Nodes + thisNode;
    if( this->operation>0 ) {  /* <=0 indicate constants and columns */
+      if( this->nPending ) return;  /* Shared and already evaluated */
+
+      if( !Evaluate_Shortcut( lParse, this ) ) {
+	 i = this->nSubNodes;
+	 while( i-- ) {
+	    Evaluate_Node( lParse, this->SubNodes[i] );
+	    if( lParse->status ) return;
+	 }
+      }
+      if( lParse->status ) return;
+
+      /*  Shared operands must outlive this operation, so hide them from  */
+      /*  DoOp's cleanup by making them look like column data for now.    */
+
       i = this->nSubNodes;
       while( i-- ) {
-	 Evaluate_Node( lParse, this->SubNodes[i] );
-	 if( lParse->status ) return;
+	 that = lParse->Nodes + this->SubNodes[i];
+	 if( that->nPending && that->operation>0 )
+	    that->operation = -that->operation;
       }
+
       this->DoOp( lParse, this );
+
+      i = this->nSubNodes;
+      while( i-- ) {
+	 that = lParse->Nodes + this->SubNodes[i];
+	 if( that->nPending ) {
+	    if( that->operation<0 ) that->operation = -that->operation;
+	    if( --that->nPending == 0 ) Free_Value( that );
+	 }
+      }
+
+      if( this->nRefs>1 && !lParse->status ) this->nPending = this->nRefs;
+   }
+}
+
+static int Row_Local( ParseData *lParse, int thisNode )
+    /***********************************************************************/
+    /*  True if thisNode's subtree can be evaluated on any subset of the   */
+    /*  rows: nothing in it looks at neighbouring rows or row numbers, and */
+    /*  no computed node in it is shared with the rest of the expression   */
+    /*  unless that node has already been evaluated.                       */
+    /***********************************************************************/
+{
+   Node *this;
+   int i;
+
+   this = lParse->Nodes + thisNode;
+   if( this->operation<=0 ) return( 1 );
+   if( this->nPending )
+      return( this->type!=STRING && this->type!=BITSTR );
+   if( this->nRefs>1 ) return( 0 );
+
+   if( this->operation==ACCUM || this->operation==DIFF
+       || this->DoOp==Do_Offset )
+      return( 0 );
+   if( this->DoOp==Do_Func && ( this->operation==row_fct
+				|| this->operation==rnd_fct
+				|| this->operation==gasrnd_fct
+				|| this->operation==poirnd_fct ) )
+      return( 0 );
+
+   for( i=0; i<this->nSubNodes; i++ )
+      if( !Row_Local( lParse, this->SubNodes[i] ) ) return( 0 );
+   return( 1 );
+}
+
+static void Gather_Rows( ParseData *lParse, int thisNode, long nLive,
+			 long *rows, int *gNodes, lval *gSaved, int *nG )
+    /***********************************************************************/
+    /*  Point every column (and every already evaluated shared node) in    */
+    /*  thisNode's subtree at compacted copies holding just the nLive rows */
+    /*  listed in rows[].  The original values are saved in gSaved.        */
+    /***********************************************************************/
+{
+   Node *this;
+   long k, nelem, size;
+   char *block, *undef;
+   char **strs;
+   int i;
+
+   if( lParse->status ) return;
+
+   this = lParse->Nodes + thisNode;
+   if( this->operation==CONST_OP ) return;
+
+   if( this->operation>0 && !this->nPending ) {
+      for( i=0; i<this->nSubNodes; i++ )
+	 Gather_Rows( lParse, this->SubNodes[i], nLive, rows,
+		      gNodes, gSaved, nG );
+      return;
+   }
+
+   for( i=0; i<*nG; i++ )
+      if( gNodes[i]==thisNode ) return;
+
+   nelem = this->value.nelem;
+   if( this->type==STRING || this->type==BITSTR ) {
+
+      /*  Copy the strings back to back, as laid out by Allocate_Ptrs,  */
+      /*  since Do_Deref indexes them all from strptr[0]                */
+
+      strs  = (char **)malloc( nLive * sizeof(char*) );
+      block = (char *)malloc( nLive * (nelem+2) );
+      if( !strs || !block ) {
+	 if( strs  ) free( strs );
+	 if( block ) free( block );
+	 lParse->status = MEMORY_ALLOCATION;
+	 return;
+      }
+      undef = block + nLive * (nelem+1);
+      for( k=0; k<nLive; k++ ) {
+	 strs[k] = block + k * (nelem+1);
+	 strncpy( strs[k], this->value.data.strptr[ rows[k] ], nelem );
+	 strs[k][nelem] = '\0';
+	 if( this->value.undef ) undef[k] = this->value.undef[ rows[k] ];
+      }
+      gNodes[*nG]   = thisNode;
+      gSaved[(*nG)++] = this->value;
+      this->value.data.strptr = strs;
+      if( this->value.undef ) this->value.undef = undef;
+   } else {
+      switch( this->type ) {
+      case DOUBLE:  size = sizeof( double ); break;
+      case LONG:    size = sizeof( long   ); break;
+      default:      size = sizeof( char   ); break;
+      }
+      block = (char *)malloc( nLive * nelem * (size+1) );
+      if( !block ) {
+	 lParse->status = MEMORY_ALLOCATION;
+	 return;
+      }
+      undef = block + nLive * nelem * size;
+      for( k=0; k<nLive; k++ ) {
+	 memcpy( block + k*nelem*size,
+		 (char *)this->value.data.ptr + rows[k]*nelem*size,
+		 nelem*size );
+	 memcpy( undef + k*nelem, this->value.undef + rows[k]*nelem, nelem );
+      }
+      gNodes[*nG]   = thisNode;
+      gSaved[(*nG)++] = this->value;
+      this->value.data.ptr = block;
+      this->value.undef    = undef;
    }
 }
 
+static int Evaluate_Shortcut( ParseData *lParse, Node *this )
+    /***********************************************************************/
+    /*  Evaluate the operands of a scalar && or || node.  The second       */
+    /*  operand is computed only for the rows which the first one leaves   */
+    /*  open (TRUE or null for &&, FALSE or null for ||), by evaluating    */
+    /*  its subtree on compacted copies of those rows.  Both operands end  */
+    /*  up as full-length results, so Do_BinOp_log combines them (and      */
+    /*  propagates nulls) exactly as before.  Returns 0, having done       */
+    /*  nothing, for nodes which do not qualify.                           */
+    /***********************************************************************/
+{
+   Node *that1, *that2, tmp;
+   long row, nRows, nLive, *rows;
+   int  i, nG=0, *gNodes;
+   lval *gSaved, live;
+   char settled;
+
+   that1 = lParse->Nodes + this->SubNodes[0];
+   that2 = lParse->Nodes + this->SubNodes[1];
+   if( (this->operation!=AND && this->operation!=OR)
+       || this->DoOp!=Do_BinOp_log || this->value.nelem!=1
+       || that1->operation==CONST_OP || that1->value.nelem!=1
+       || that2->operation<=0 || that2->value.nelem!=1 || that2->nRefs>1 )
+      return( 0 );
+
+   Evaluate_Node( lParse, this->SubNodes[0] );
+   if( lParse->status ) return( 1 );
+   that1 = lParse->Nodes + this->SubNodes[0];
+   nRows = lParse->nRows;
+   settled = ( this->operation==OR );
+
+   rows = (long *)malloc( nRows * sizeof(long) );
+   if( !rows ) {
+      lParse->status = MEMORY_ALLOCATION;
+      return( 1 );
+   }
+   nLive = 0;
+   for( row=0; row<nRows; row++ )
+      if( that1->value.undef[row]
+	  || (that1->value.data.logptr[row]!=0) != settled )
+	 rows[nLive++] = row;
+
+   /*  Compacting only pays when a good fraction of the rows is settled  */
+
+   if( 2*nLive > nRows || !Row_Local( lParse, this->SubNodes[1] ) ) {
+      free( rows );
+      Evaluate_Node( lParse, this->SubNodes[1] );
+      return( 1 );
+   }
+
+   if( nLive ) {
+      gNodes = (int  *)malloc( lParse->nNodes * sizeof(int)  );
+      gSaved = (lval *)malloc( lParse->nNodes * sizeof(lval) );
+      if( !gNodes || !gSaved ) {
+	 if( gNodes ) free( gNodes );
+	 if( gSaved ) free( gSaved );
+	 free( rows );
+	 lParse->status = MEMORY_ALLOCATION;
+	 return( 1 );
+      }
+
+      Gather_Rows( lParse, this->SubNodes[1], nLive, rows,
+		   gNodes, gSaved, &nG );
+      if( !lParse->status ) {
+	 lParse->nRows = nLive;
+	 Evaluate_Node( lParse, this->SubNodes[1] );
+	 lParse->nRows = nRows;
+      }
+
+      /*  Put back the full-length values.  A shared node whose last  */
+      /*  consumer was in the subtree has already had its compacted   */
+      /*  copy freed; free the original instead.                      */
+
+      for( i=0; i<nG; i++ ) {
+	 tmp = lParse->Nodes[ gNodes[i] ];
+	 if( tmp.operation>0 && !tmp.nPending )
+	    tmp.value = gSaved[i];
+	 Free_Value( &tmp );
+	 lParse->Nodes[ gNodes[i] ].value = gSaved[i];
+      }
+      free( gNodes );
+      free( gSaved );
+   }
+
+   if( !lParse->status ) {
+
+      /*  Spread the compacted result back over all rows; the settled  */
+      /*  rows are left FALSE, which Do_BinOp_log ignores for them     */
+
+      live = that2->value;
+      Allocate_Ptrs( lParse, that2 );
+      if( !lParse->status ) {
+	 for( row=0; row<nLive; row++ ) {
+	    that2->value.data.logptr[ rows[row] ] = live.data.logptr[row];
+	    that2->value.undef[ rows[row] ]       = live.undef[row];
+	 }
+      }
+      if( nLive ) free( live.data.ptr );
+   }
+   free( rows );
+   return( 1 );
+}
+
 static void Allocate_Ptrs( ParseData *lParse, Node *this )
 {
    long elem, row, size;
@@ -3645,6 +4169,9 @@ double qselect_median_dbl(double arr[], int n)
 
 #undef ELEM_SWAP
 
+#define ANGSEP_DEG (myPI/180.0)
+  /* #define ANGSEP_DEG 1.0  **** USE THIS IF YOU WANT RADIANS */
+
 /*
  * angsep_calc - compute angular separation between celestial coordinates
  *   
@@ -3660,26 +4187,37 @@ double qselect_median_dbl(double arr[], int n)
  */
 double angsep_calc(double ra1, double dec1, double ra2, double dec2)
 {
-/*  double cd;  */
-  static double deg = 0;
+  return angsep_hav( ra2 - ra1, dec2 - dec1,
+		     cos(dec1*ANGSEP_DEG), cos(dec2*ANGSEP_DEG) );
+}
+
+/*
+ * angsep_hav - angular separation from the coordinate differences
+ *
+ * double dra, ddec         - ra2-ra1 and dec2-dec1 in degrees
+ * double cosdec1, cosdec2  - cosines of the two declinations
+ *
+ * Do_Func calls this directly so that the cosine of a constant
+ * declination is computed only once.
+ */
+static double angsep_hav(double dra, double ddec,
+			 double cosdec1, double cosdec2)
+{
   double a, sdec, sra;
-  
-  if (deg == 0) deg = ((double)4)*atan((double)1)/((double)180);
-  /* deg = 1.0; **** UNCOMMENT IF YOU WANT RADIANS */
 
   /* The algorithm is the law of Haversines.  This algorithm is
      stable even when the points are close together.  The normal
      Law of Cosines fails for angles around 0.1 arcsec. */
 
-  sra  = sin( (ra2 - ra1)*deg / 2 );
-  sdec = sin( (dec2 - dec1)*deg / 2);
-  a = sdec*sdec + cos(dec1*deg)*cos(dec2*deg)*sra*sra;
+  sra  = sin( dra*ANGSEP_DEG / 2 );
+  sdec = sin( ddec*ANGSEP_DEG / 2);
+  a = sdec*sdec + cosdec1*cosdec2*sra*sra;
 
   /* Sanity checking to avoid a range error in the sqrt()'s below */
   if (a < 0) { a = 0; }
   if (a > 1) { a = 1; }
 
-  return 2.0*atan2(sqrt(a), sqrt(1.0 - a)) / deg;
+  return 2.0*atan2(sqrt(a), sqrt(1.0 - a)) / ANGSEP_DEG;
 }
 
 static void Do_Func( ParseData *lParse, Node *this )
@@ -3689,7 +4227,7 @@ static void Do_Func( ParseData *lParse, Node *this )
    lval pVals[MAXSUBS];
    char pNull[MAXSUBS];
    long   ival;
-   double dval;
+   double dval, cosr=0.0, sinr=0.0, cosdec1=0.0, cosdec2=0.0;
    int  i, valInit;
    long row, elem, nelem;
 
@@ -3756,9 +4294,9 @@ static void Do_Func( ParseData *lParse, Node *this )
 
 	 case poirnd_fct:
 	    if( theParams[0]->type==DOUBLE )
-	      this->value.data.lng = simplerng_getpoisson(pVals[0].data.dbl);
+	      this->value.data.lng = simplerng_getpoisson_r(&lParse->rng, pVals[0].data.dbl);
 	    else
-	      this->value.data.lng = simplerng_getpoisson(pVals[0].data.lng);
+	      this->value.data.lng = simplerng_getpoisson_r(&lParse->rng, pVals[0].data.lng);
 	    break;
 
 	 case abs_fct:
@@ -3879,6 +4417,7 @@ static void Do_Func( ParseData *lParse, Node *this )
 	    this->value.data.dbl = 
 	      angsep_calc(pVals[0].data.dbl, pVals[1].data.dbl,
 			  pVals[2].data.dbl, pVals[3].data.dbl);
+	    break;
 
 	    /*  Min/Max functions taking 1 or 2 arguments  */
 
@@ -3929,17 +4468,19 @@ static void Do_Func( ParseData *lParse, Node *this )
 					   pVals[4].data.dbl );
 	    break;
 	 case box_fct:
+	    dval = (pVals[4].data.dbl / 180.0) * myPI;
 	    this->value.data.log = saobox( pVals[0].data.dbl, pVals[1].data.dbl,
 					   pVals[2].data.dbl, pVals[3].data.dbl,
-					   pVals[4].data.dbl, pVals[5].data.dbl,
-					   pVals[6].data.dbl );
+					   cos(dval), sin(dval),
+					   pVals[5].data.dbl, pVals[6].data.dbl );
 	    break;
 	 case elps_fct:
+	    dval = (pVals[4].data.dbl / 180.0) * myPI;
 	    this->value.data.log =
                                ellipse( pVals[0].data.dbl, pVals[1].data.dbl,
 					pVals[2].data.dbl, pVals[3].data.dbl,
-					pVals[4].data.dbl, pVals[5].data.dbl,
-					pVals[6].data.dbl );
+					cos(dval), sin(dval),
+					pVals[5].data.dbl, pVals[6].data.dbl );
 	    break;
 
             /* C Conditional expression:  bool ? expr : expr */
@@ -4063,14 +4604,14 @@ static void Do_Func( ParseData *lParse, Node *this )
 	   break;
 	 case rnd_fct:
 	   while( elem-- ) {
-	     this->value.data.dblptr[elem] = simplerng_getuniform();
+	     this->value.data.dblptr[elem] = simplerng_getuniform_r(&lParse->rng);
 	     this->value.undef[elem] = 0;
 	    }
 	    break;
 
 	 case gasrnd_fct:
 	    while( elem-- ) {
-	       this->value.data.dblptr[elem] = simplerng_getnorm();
+	       this->value.data.dblptr[elem] = simplerng_getnorm_r(&lParse->rng);
 	       this->value.undef[elem] = 0;
 	    }
 	    break;
@@ -4081,7 +4622,7 @@ static void Do_Func( ParseData *lParse, Node *this )
 		while( elem-- ) {
 		  this->value.undef[elem] = (pVals[0].data.dbl < 0);
 		  if (! this->value.undef[elem]) {
-		    this->value.data.lngptr[elem] = simplerng_getpoisson(pVals[0].data.dbl);
+		    this->value.data.lngptr[elem] = simplerng_getpoisson_r(&lParse->rng, pVals[0].data.dbl);
 		  }
 		} 
 	      } else {
@@ -4091,7 +4632,7 @@ static void Do_Func( ParseData *lParse, Node *this )
 		    this->value.undef[elem] = 1;
 		  if (! this->value.undef[elem]) {
 		    this->value.data.lngptr[elem] = 
-		      simplerng_getpoisson(theParams[0]->value.data.dblptr[elem]);
+		      simplerng_getpoisson_r(&lParse->rng, theParams[0]->value.data.dblptr[elem]);
 		  }
 		} /* while */
 	      } /* ! CONST_OP */
@@ -4101,7 +4642,7 @@ static void Do_Func( ParseData *lParse, Node *this )
 		while( elem-- ) {
 		  this->value.undef[elem] = (pVals[0].data.lng < 0);
 		  if (! this->value.undef[elem]) {
-		    this->value.data.lngptr[elem] = simplerng_getpoisson(pVals[0].data.lng);
+		    this->value.data.lngptr[elem] = simplerng_getpoisson_r(&lParse->rng, pVals[0].data.lng);
 		  }
 		} 
 	      } else {
@@ -4111,7 +4652,7 @@ static void Do_Func( ParseData *lParse, Node *this )
 		    this->value.undef[elem] = 1;
 		  if (! this->value.undef[elem]) {
 		    this->value.data.lngptr[elem] = 
-		      simplerng_getpoisson(theParams[0]->value.data.lngptr[elem]);
+		      simplerng_getpoisson_r(&lParse->rng, theParams[0]->value.data.lngptr[elem]);
 		  }
 		} /* while */
 	      } /* ! CONST_OP */
@@ -4122,52 +4663,52 @@ static void Do_Func( ParseData *lParse, Node *this )
 	    /* Non-Trig single-argument functions */
 	    
 	 case sum_fct:
-	    elem = row * theParams[0]->value.nelem;
+	    /*  Accumulate each row in locals rather than in the result     */
+	    /*  array, which would otherwise be reloaded and stored for     */
+	    /*  every element.  Integer sums do not depend on the order of  */
+	    /*  addition and are written without branches so that they can */
+	    /*  be vectorized; double sums keep their element order.        */
+	    nelem = theParams[0]->value.nelem;
 	    if( theParams[0]->type==BOOLEAN ) {
-	       while( row-- ) {
-		  this->value.data.lngptr[row] = 0;
-		  /* Default is UNDEF until a defined value is found */
-		  this->value.undef[row] = 1;
-		  nelem = theParams[0]->value.nelem;
-		  while( nelem-- ) {
-		     elem--;
-		     if ( ! theParams[0]->value.undef[elem] ) {
-		       this->value.data.lngptr[row] +=
-			 ( theParams[0]->value.data.logptr[elem] ? 1 : 0 );
-		       this->value.undef[row] = 0;
-		     }
+	       char *lptr = theParams[0]->value.data.logptr;
+	       char *uptr = theParams[0]->value.undef;
+	       for( elem=0; elem<row; elem++, lptr+=nelem, uptr+=nelem ) {
+		  long lsum = 0, ndef = 0, ii;
+		  for( ii=0; ii<nelem; ii++ ) {
+		     ndef += !uptr[ii];
+		     lsum += ( !uptr[ii] & (lptr[ii]!=0) );
 		  }
+		  this->value.data.lngptr[elem] = lsum;
+		  /* Default is UNDEF until a defined value is found */
+		  this->value.undef[elem] = (ndef==0);
 	       }
 	    } else if( theParams[0]->type==LONG ) {
-	       while( row-- ) {
-		  this->value.data.lngptr[row] = 0;
-		  /* Default is UNDEF until a defined value is found */
-		  this->value.undef[row] = 1;
-		  nelem = theParams[0]->value.nelem;
-		  while( nelem-- ) {
-		     elem--;
-		     if ( ! theParams[0]->value.undef[elem] ) {
-		       this->value.data.lngptr[row] +=
-			 theParams[0]->value.data.lngptr[elem];
-		       this->value.undef[row] = 0;
-		     }
+	       long *lptr = theParams[0]->value.data.lngptr;
+	       char *uptr = theParams[0]->value.undef;
+	       for( elem=0; elem<row; elem++, lptr+=nelem, uptr+=nelem ) {
+		  long lsum = 0, ndef = 0, ii;
+		  for( ii=0; ii<nelem; ii++ ) {
+		     ndef += !uptr[ii];
+		     lsum += ( uptr[ii] ? 0 : lptr[ii] );
 		  }
-	       }		  
+		  this->value.data.lngptr[elem] = lsum;
+		  this->value.undef[elem] = (ndef==0);
+	       }
 	    } else if( theParams[0]->type==DOUBLE ){
-	       while( row-- ) {
-		  this->value.data.dblptr[row] = 0.0;
-		  /* Default is UNDEF until a defined value is found */
-		  this->value.undef[row] = 1;
-		  nelem = theParams[0]->value.nelem;
-		  while( nelem-- ) {
-		     elem--;
-		     if ( ! theParams[0]->value.undef[elem] ) {
-		       this->value.data.dblptr[row] +=
-			 theParams[0]->value.data.dblptr[elem];
-		       this->value.undef[row] = 0;
+	       double *dptr = theParams[0]->value.data.dblptr;
+	       char   *uptr = theParams[0]->value.undef;
+	       for( elem=0; elem<row; elem++, dptr+=nelem, uptr+=nelem ) {
+		  double dsum = 0.0;
+		  long ndef = 0, ii = nelem;
+		  while( ii-- ) {
+		     if( !uptr[ii] ) {
+			dsum += dptr[ii];
+			ndef++;
 		     }
 		  }
-	       }		  
+		  this->value.data.dblptr[elem] = dsum;
+		  this->value.undef[elem] = (ndef==0);
+	       }
 	    } else { /* BITSTR */
 	       nelem = theParams[0]->value.nelem;
 	       while( row-- ) {
@@ -4183,126 +4724,51 @@ static void Do_Func( ParseData *lParse, Node *this )
 	    break;
 
 	 case average_fct:
-	    elem = row * theParams[0]->value.nelem;
-	    if( theParams[0]->type==LONG ) {
-	       while( row-- ) {
-		  int count = 0;
-		  this->value.data.dblptr[row] = 0;
-		  nelem = theParams[0]->value.nelem;
-		  while( nelem-- ) {
-		     elem--;
-		     if (theParams[0]->value.undef[elem] == 0) {
-		       this->value.data.dblptr[row] +=
-			 theParams[0]->value.data.lngptr[elem];
-		       count ++;
-		     }
-		  }
-		  if (count == 0) {
-		    this->value.undef[row] = 1;
-		  } else {
-		    this->value.undef[row] = 0;
-		    this->value.data.dblptr[row] /= count;
-		  }
-	       }		  
-	    } else if( theParams[0]->type==DOUBLE ){
-	       while( row-- ) {
-		  int count = 0;
-		  this->value.data.dblptr[row] = 0;
-		  nelem = theParams[0]->value.nelem;
-		  while( nelem-- ) {
-		     elem--;
-		     if (theParams[0]->value.undef[elem] == 0) {
-		       this->value.data.dblptr[row] +=
-			 theParams[0]->value.data.dblptr[elem];
-		       count ++;
-		     }
-		  }
-		  if (count == 0) {
-		    this->value.undef[row] = 1;
-		  } else {
-		    this->value.undef[row] = 0;
-		    this->value.data.dblptr[row] /= count;
-		  }
-	       }		  
-	    }
-	    break;
 	 case stddev_fct:
-	    elem = row * theParams[0]->value.nelem;
-	    if( theParams[0]->type==LONG ) {
-
-	       /* Compute the mean value */
-	       while( row-- ) {
-		  int count = 0;
-		  double sum = 0, sum2 = 0;
-
-		  nelem = theParams[0]->value.nelem;
-		  while( nelem-- ) {
-		     elem--;
-		     if (theParams[0]->value.undef[elem] == 0) {
-		       sum += theParams[0]->value.data.lngptr[elem];
-		       count ++;
-		     }
-		  }
-		  if (count > 1) {
-		    sum /= count;
-
-		    /* Compute the sum of squared deviations */
-		    nelem = theParams[0]->value.nelem;
-		    elem += nelem;  /* Reset elem for second pass */
-		    while( nelem-- ) {
-		      elem--;
-		      if (theParams[0]->value.undef[elem] == 0) {
-			double dx = (theParams[0]->value.data.lngptr[elem] - sum);
-			sum2 += (dx*dx);
-		      }
-		    }
-
-		    sum2 /= (double)count-1;
-
-		    this->value.undef[row] = 0;
-		    this->value.data.dblptr[row] = sqrt(sum2);
+	    nelem = theParams[0]->value.nelem;
+	    if( theParams[0]->type==LONG || theParams[0]->type==DOUBLE ) {
+	       long   *lptr = theParams[0]->value.data.lngptr;
+	       double *dptr = theParams[0]->value.data.dblptr;
+	       char   *uptr = theParams[0]->value.undef;
+	       int    isLong = ( theParams[0]->type==LONG );
+	       for( elem=0; elem<row; elem++, uptr+=nelem ) {
+		  double sum = 0.0, sum2 = 0.0, dx;
+		  long count = 0, ii = nelem;
+
+		  /* Compute the mean value */
+		  if( isLong ) {
+		     while( ii-- )
+			if( !uptr[ii] ) { sum += lptr[ii]; count++; }
 		  } else {
-		    this->value.undef[row] = 0;       /* STDDEV => 0 */
-		    this->value.data.dblptr[row] = 0;
+		     while( ii-- )
+			if( !uptr[ii] ) { sum += dptr[ii]; count++; }
 		  }
-	       }
-	    } else if( theParams[0]->type==DOUBLE ){
-
-	       /* Compute the mean value */
-	       while( row-- ) {
-		  int count = 0;
-		  double sum = 0, sum2 = 0;
 
-		  nelem = theParams[0]->value.nelem;
-		  while( nelem-- ) {
-		     elem--;
-		     if (theParams[0]->value.undef[elem] == 0) {
-		       sum += theParams[0]->value.data.dblptr[elem];
-		       count ++;
+		  if( this->operation==average_fct ) {
+		     this->value.undef[elem] = ( count==0 );
+		     this->value.data.dblptr[elem] = ( count ? sum/count : 0.0 );
+		  } else if( count > 1 ) {
+		     sum /= count;
+
+		     /* Compute the sum of squared deviations */
+		     ii = nelem;
+		     if( isLong ) {
+			while( ii-- )
+			   if( !uptr[ii] ) { dx = lptr[ii] - sum; sum2 += dx*dx; }
+		     } else {
+			while( ii-- )
+			   if( !uptr[ii] ) { dx = dptr[ii] - sum; sum2 += dx*dx; }
 		     }
-		  }
-		  if (count > 1) {
-		    sum /= count;
-
-		    /* Compute the sum of squared deviations */
-		    nelem = theParams[0]->value.nelem;
-		    elem += nelem;  /* Reset elem for second pass */
-		    while( nelem-- ) {
-		      elem--;
-		      if (theParams[0]->value.undef[elem] == 0) {
-			double dx = (theParams[0]->value.data.dblptr[elem] - sum);
-			sum2 += (dx*dx);
-		      }
-		    }
+		     sum2 /= (double)count-1;
 
-		    sum2 /= (double)count-1;
-
-		    this->value.undef[row] = 0;
-		    this->value.data.dblptr[row] = sqrt(sum2);
+		     this->value.undef[elem] = 0;
+		     this->value.data.dblptr[elem] = sqrt(sum2);
 		  } else {
-		    this->value.undef[row] = 0;       /* STDDEV => 0 */
-		    this->value.data.dblptr[row] = 0;
+		     this->value.undef[elem] = 0;       /* STDDEV => 0 */
+		     this->value.data.dblptr[elem] = 0;
 		  }
+		  lptr += nelem;
+		  dptr += nelem;
 	       }
 	    }
 	    break;
@@ -4713,6 +5179,10 @@ static void Do_Func( ParseData *lParse, Node *this )
 	    /* Four-argument ANGSEP Function */
 	    
 	 case angsep_fct:
+	    /*  Cone searches compare against a fixed position; take the  */
+	    /*  cosine of a constant declination only once                */
+	    if( !vector[1] ) cosdec1 = cos( pVals[1].data.dbl*ANGSEP_DEG );
+	    if( !vector[3] ) cosdec2 = cos( pVals[3].data.dbl*ANGSEP_DEG );
 	    while( row-- ) {
 	       nelem = this->value.nelem;
 	       while( nelem-- ) {
@@ -4728,10 +5198,16 @@ static void Do_Func( ParseData *lParse, Node *this )
 			pNull[i] = theParams[i]->value.undef[row];
 		     }
 		  if( !(this->value.undef[elem] = (pNull[0] || pNull[1] ||
-						   pNull[2] || pNull[3]) ) )
+						   pNull[2] || pNull[3]) ) ) {
+		     if( vector[1] )
+			cosdec1 = cos( pVals[1].data.dbl*ANGSEP_DEG );
+		     if( vector[3] )
+			cosdec2 = cos( pVals[3].data.dbl*ANGSEP_DEG );
 		     this->value.data.dblptr[elem] =
-		       angsep_calc(pVals[0].data.dbl, pVals[1].data.dbl,
-				   pVals[2].data.dbl, pVals[3].data.dbl);
+		       angsep_hav(pVals[2].data.dbl - pVals[0].data.dbl,
+				  pVals[3].data.dbl - pVals[1].data.dbl,
+				  cosdec1, cosdec2);
+		  }
 	       }
 	    }
 	    break;
@@ -5041,6 +5517,12 @@ static void Do_Func( ParseData *lParse, Node *this )
 	    break;
 
 	 case box_fct:
+	    /*  Rotation angle is usually constant; do its trig once  */
+	    if( !vector[4] ) {
+	       dval = (pVals[4].data.dbl / 180.0) * myPI;
+	       cosr = cos( dval );
+	       sinr = sin( dval );
+	    }
 	    while( row-- ) {
 	       nelem = this->value.nelem;
 	       while( nelem-- ) {
@@ -5058,17 +5540,28 @@ static void Do_Func( ParseData *lParse, Node *this )
 		  if( !(this->value.undef[elem] = (pNull[0] || pNull[1] ||
 						   pNull[2] || pNull[3] ||
 						   pNull[4] || pNull[5] ||
-						   pNull[6] ) ) )
+						   pNull[6] ) ) ) {
+		    if( vector[4] ) {
+		       dval = (pVals[4].data.dbl / 180.0) * myPI;
+		       cosr = cos( dval );
+		       sinr = sin( dval );
+		    }
 		    this->value.data.logptr[elem] =
 		     saobox( pVals[0].data.dbl, pVals[1].data.dbl,
 			     pVals[2].data.dbl, pVals[3].data.dbl,
-			     pVals[4].data.dbl, pVals[5].data.dbl,
-			     pVals[6].data.dbl );	
+			     cosr, sinr, pVals[5].data.dbl, pVals[6].data.dbl );
+		  }
 	       }
 	    }
 	    break;
 
 	 case elps_fct:
+	    /*  Rotation angle is usually constant; do its trig once  */
+	    if( !vector[4] ) {
+	       dval = (pVals[4].data.dbl / 180.0) * myPI;
+	       cosr = cos( dval );
+	       sinr = sin( dval );
+	    }
 	    while( row-- ) {
 	       nelem = this->value.nelem;
 	       while( nelem-- ) {
@@ -5086,12 +5579,17 @@ static void Do_Func( ParseData *lParse, Node *this )
 		  if( !(this->value.undef[elem] = (pNull[0] || pNull[1] ||
 						   pNull[2] || pNull[3] ||
 						   pNull[4] || pNull[5] ||
-						   pNull[6] ) ) )
+						   pNull[6] ) ) ) {
+		    if( vector[4] ) {
+		       dval = (pVals[4].data.dbl / 180.0) * myPI;
+		       cosr = cos( dval );
+		       sinr = sin( dval );
+		    }
 		    this->value.data.logptr[elem] =
 		     ellipse( pVals[0].data.dbl, pVals[1].data.dbl,
 			      pVals[2].data.dbl, pVals[3].data.dbl,
-			      pVals[4].data.dbl, pVals[5].data.dbl,
-			      pVals[6].data.dbl );
+			      cosr, sinr, pVals[5].data.dbl, pVals[6].data.dbl );
+		  }
 	       }
 	    }
 	    break;
@@ -5882,6 +6380,8 @@ static void Do_REG( ParseData *lParse, Node *this )
 	 nelem = this->value.nelem;
 	 elem  = rows*nelem;
 
+	 fits_prepare_region( (SAORegion *)theRegion->value.data.ptr, elem );
+
 	 while( rows-- ) {
 	    while( nelem-- ) {
 	       elem--;
@@ -6086,155 +6586,136 @@ static void Do_Array( ParseData *lParse, Node *this )
 /*  Utility routines which perform the calculations on bits and SAO regions  */
 /*****************************************************************************/
 
+/*  The bit string routines below line up the two operands on their last  */
+/*  (least significant) bit, treating missing leading bits as '0', without */
+/*  making padded copies.  When both operands have the same length, they   */
+/*  are processed 8 bits at a time as packed words, as long as the words   */
+/*  contain only '0' and '1' characters (no 'x' wildcards).                */
+
+#define BITWORD_ZERO   0x3030303030303030ULL   /* 8 '0' characters */
+#define BITWORD_ONES   0x0101010101010101ULL
+
+static int bitword(char *bits, ULONGLONG *word)
+{
+   memcpy(word, bits, sizeof(ULONGLONG));
+   return( (*word & ~BITWORD_ONES) == BITWORD_ZERO );
+}
+
 static char bitlgte(char *bits1, int oper, char *bits2)
 {
- int val1, val2, nextbit;
- char result;
- int i, l1, l2, length, ldiff;
- char *stream=0;
- char chr1, chr2;
+ long i, l1, l2, length, d1, d2;
+ int cmp = 0, val1, val2;
+ char chr1, chr2, result;
 
  l1 = strlen(bits1);
  l2 = strlen(bits2);
  length = (l1 > l2) ? l1 : l2;
- stream = (char *)malloc(sizeof(char)*(length+1));
- if (l1 < l2)
-   {
-    ldiff = l2 - l1;
-    i=0;
-    while( ldiff-- ) stream[i++] = '0';
-    while( l1--    ) stream[i++] = *(bits1++);
-    stream[i] = '\0';
-    bits1 = stream;
-   }
- else if (l2 < l1)
-   {
-    ldiff = l1 - l2;
-    i=0;
-    while( ldiff-- ) stream[i++] = '0';
-    while( l2--    ) stream[i++] = *(bits2++);
-    stream[i] = '\0';
-    bits2 = stream;
-   }
+ d1 = length - l1;
+ d2 = length - l2;
 
- val1 = val2 = 0;
- nextbit = 1;
-
- while( length-- )
+ /* the first differing bit, from the most significant end, decides */
+ for( i=0; i<length && !cmp; i++ )
     {
-     chr1 = bits1[length];
-     chr2 = bits2[length];
+     chr1 = ( i < d1 ? '0' : bits1[i-d1] );
+     chr2 = ( i < d2 ? '0' : bits2[i-d2] );
      if ((chr1 != 'x')&&(chr1 != 'X')&&(chr2 != 'x')&&(chr2 != 'X'))
        {
-        if (chr1 == '1') val1 += nextbit;
-        if (chr2 == '1') val2 += nextbit;
-        nextbit *= 2;
+        val1 = (chr1 == '1');
+        val2 = (chr2 == '1');
+        cmp  = val1 - val2;
        }
     }
  result = 0;
  switch (oper)
        {
         case LT:
-             if (val1 < val2) result = 1;
+             if (cmp <  0) result = 1;
              break;
         case LTE:
-             if (val1 <= val2) result = 1;
+             if (cmp <= 0) result = 1;
              break;
         case GT:
-             if (val1 > val2) result = 1;
+             if (cmp >  0) result = 1;
              break;
         case GTE:
-             if (val1 >= val2) result = 1;
+             if (cmp >= 0) result = 1;
              break;
        }
- free(stream);
  return (result);
 }
 
 static void bitand(char *result,char *bitstrm1,char *bitstrm2)
 {
- int i, l1, l2, ldiff, largestStream;
- char *stream=0;
+ long i, l1, l2, length, d1, d2;
+ ULONGLONG word1, word2;
  char chr1, chr2;
 
  l1 = strlen(bitstrm1);
  l2 = strlen(bitstrm2);
- largestStream = (l1 > l2) ? l1 : l2;
- stream = (char *)malloc(sizeof(char)*(largestStream+1));
- if (l1 < l2)
-   {
-    ldiff = l2 - l1;
-    i=0;
-    while( ldiff-- ) stream[i++] = '0';
-    while( l1--    ) stream[i++] = *(bitstrm1++);
-    stream[i] = '\0';
-    bitstrm1 = stream;
-   }
- else if (l2 < l1)
+ length = (l1 > l2) ? l1 : l2;
+ d1 = length - l1;
+ d2 = length - l2;
+ i = 0;
+
+ if (l1 == l2)
    {
-    ldiff = l1 - l2;
-    i=0;
-    while( ldiff-- ) stream[i++] = '0';
-    while( l2--    ) stream[i++] = *(bitstrm2++);
-    stream[i] = '\0';
-    bitstrm2 = stream;
+    for( ; i + 8 <= length; i += 8 )
+       {
+        if( !bitword(bitstrm1+i, &word1) || !bitword(bitstrm2+i, &word2) )
+           break;
+        word1 &= word2;
+        memcpy(result+i, &word1, sizeof(ULONGLONG));
+       }
    }
- while ( (chr1 = *(bitstrm1++)) ) 
+ for( ; i<length; i++ )
     {
-       chr2 = *(bitstrm2++);
+       chr1 = ( i < d1 ? '0' : bitstrm1[i-d1] );
+       chr2 = ( i < d2 ? '0' : bitstrm2[i-d2] );
        if ((chr1 == 'x') || (chr2 == 'x'))
-          *result = 'x';
+          result[i] = 'x';
        else if ((chr1 == '1') && (chr2 == '1'))
-          *result = '1';
+          result[i] = '1';
        else
-          *result = '0';
-       result++;
+          result[i] = '0';
     }
- free(stream);
- *result = '\0';
+ result[length] = '\0';
 }
 
 static void bitor(char *result,char *bitstrm1,char *bitstrm2)
 {
- int i, l1, l2, ldiff, largestStream;
- char *stream=0;
+ long i, l1, l2, length, d1, d2;
+ ULONGLONG word1, word2;
  char chr1, chr2;
 
  l1 = strlen(bitstrm1);
  l2 = strlen(bitstrm2);
- largestStream = (l1 > l2) ? l1 : l2;
- stream = (char *)malloc(sizeof(char)*(largestStream+1));
- if (l1 < l2)
-   {
-    ldiff = l2 - l1;
-    i=0;
-    while( ldiff-- ) stream[i++] = '0';
-    while( l1--    ) stream[i++] = *(bitstrm1++);
-    stream[i] = '\0';
-    bitstrm1 = stream;
-   }
- else if (l2 < l1)
+ length = (l1 > l2) ? l1 : l2;
+ d1 = length - l1;
+ d2 = length - l2;
+ i = 0;
+
+ if (l1 == l2)
    {
-    ldiff = l1 - l2;
-    i=0;
-    while( ldiff-- ) stream[i++] = '0';
-    while( l2--    ) stream[i++] = *(bitstrm2++);
-    stream[i] = '\0';
-    bitstrm2 = stream;
+    for( ; i + 8 <= length; i += 8 )
+       {
+        if( !bitword(bitstrm1+i, &word1) || !bitword(bitstrm2+i, &word2) )
+           break;
+        word1 |= word2;
+        memcpy(result+i, &word1, sizeof(ULONGLONG));
+       }
    }
- while ( (chr1 = *(bitstrm1++)) ) 
+ for( ; i<length; i++ )
     {
-       chr2 = *(bitstrm2++);
+       chr1 = ( i < d1 ? '0' : bitstrm1[i-d1] );
+       chr2 = ( i < d2 ? '0' : bitstrm2[i-d2] );
        if ((chr1 == '1') || (chr2 == '1'))
-          *result = '1';
+          result[i] = '1';
        else if ((chr1 == '0') || (chr2 == '0'))
-          *result = '0';
+          result[i] = '0';
        else
-          *result = 'x';
-       result++;
+          result[i] = 'x';
     }
- free(stream);
- *result = '\0';
+ result[length] = '\0';
 }
 
 static void bitnot(char *result,char *bits)
@@ -6252,43 +6733,35 @@ static void bitnot(char *result,char *bits)
 
 static char bitcmp(char *bitstrm1, char *bitstrm2)
 {
- int i, l1, l2, ldiff, largestStream;
- char *stream=0;
+ long i, l1, l2, length, d1, d2;
+ ULONGLONG word1, word2;
  char chr1, chr2;
 
  l1 = strlen(bitstrm1);
  l2 = strlen(bitstrm2);
- largestStream = (l1 > l2) ? l1 : l2;
- stream = (char *)malloc(sizeof(char)*(largestStream+1));
- if (l1 < l2)
-   {
-    ldiff = l2 - l1;
-    i=0;
-    while( ldiff-- ) stream[i++] = '0';
-    while( l1--    ) stream[i++] = *(bitstrm1++);
-    stream[i] = '\0';
-    bitstrm1 = stream;
-   }
- else if (l2 < l1)
+ length = (l1 > l2) ? l1 : l2;
+ d1 = length - l1;
+ d2 = length - l2;
+ i = 0;
+
+ if (l1 == l2)
    {
-    ldiff = l1 - l2;
-    i=0;
-    while( ldiff-- ) stream[i++] = '0';
-    while( l2--    ) stream[i++] = *(bitstrm2++);
-    stream[i] = '\0';
-    bitstrm2 = stream;
+    for( ; i + 8 <= length; i += 8 )
+       {
+        if( !bitword(bitstrm1+i, &word1) || !bitword(bitstrm2+i, &word2) )
+           break;
+        if( word1 != word2 )
+           return( 0 );
+       }
    }
- while( (chr1 = *(bitstrm1++)) )
+ for( ; i<length; i++ )
     {
-       chr2 = *(bitstrm2++);
+       chr1 = ( i < d1 ? '0' : bitstrm1[i-d1] );
+       chr2 = ( i < d2 ? '0' : bitstrm2[i-d2] );
        if ( ((chr1 == '0') && (chr2 == '1'))
 	    || ((chr1 == '1') && (chr2 == '0')) )
-       {
-          free(stream);
 	  return( 0 );
-       }
     }
- free(stream);
  return( 1 );
 }
 
@@ -6301,15 +6774,15 @@ static char bnear(double x, double y, double tolerance)
 }
 
 static char saobox(double xcen, double ycen, double xwid, double ywid,
-		   double rot,  double xcol, double ycol)
+		   double cosr, double sinr, double xcol, double ycol)
+/* cosr, sinr: cosine and sine of the rotation angle */
 {
- double x,y,xprime,yprime,xmin,xmax,ymin,ymax,theta;
+ double x,y,xprime,yprime,xmin,xmax,ymin,ymax;
 
- theta = (rot / 180.0) * myPI;
  xprime = xcol - xcen;
  yprime = ycol - ycen;
- x =  xprime * cos(theta) + yprime * sin(theta);
- y = -xprime * sin(theta) + yprime * cos(theta);
+ x =  xprime * cosr + yprime * sinr;
+ y = -xprime * sinr + yprime * cosr;
  xmin = - 0.5 * xwid; xmax = 0.5 * xwid;
  ymin = - 0.5 * ywid; ymax = 0.5 * ywid;
  if ((x >= xmin) && (x <= xmax) && (y >= ymin) && (y <= ymax))
@@ -6335,15 +6808,15 @@ static char circle(double xcen, double ycen, double rad,
 }
 
 static char ellipse(double xcen, double ycen, double xrad, double yrad,
-		    double rot, double xcol, double ycol)
+		    double cosr, double sinr, double xcol, double ycol)
+/* cosr, sinr: cosine and sine of the rotation angle */
 {
- double x,y,xprime,yprime,dx,dy,dlen,theta;
+ double x,y,xprime,yprime,dx,dy,dlen;
 
- theta = (rot / 180.0) * myPI;
  xprime = xcol - xcen;
  yprime = ycol - ycen;
- x =  xprime * cos(theta) + yprime * sin(theta);
- y = -xprime * sin(theta) + yprime * cos(theta);
+ x =  xprime * cosr + yprime * sinr;
+ y = -xprime * sinr + yprime * cosr;
  dx = x / xrad; dy = y / yrad;
  dx *= dx; dy *= dy;
  dlen = dx + dy;
@@ -9,6 +9,7 @@
 #include <malloc.h>
 #endif
 #include "fitsio2.h"
+#include "simplerng.h"
 
 #define MAXDIMS       5
 #define MAXSUBS      10
@@ -63,6 +64,8 @@ typedef struct Node {
                   int    SubNodes[MAXSUBS];
                   int    type;
                   lval   value;
+                  int    nRefs;     /* # of operands referring to this node */
+                  int    nPending;  /* # of those still to consume result   */
                                 } Node;
 
 struct ParseData_struct {
@@ -84,6 +87,8 @@ struct ParseData_struct {
                   int         nNodes;
                   int         nNodesAlloc;
                   int         resultNode;
+                  int         *resultNodes;  /* Roots of several expressions  */
+                  int         nResultNodes;  /*   parsed together, or 0       */
                   
                   long        firstRow;
                   long        nRows;
@@ -103,6 +108,9 @@ struct ParseData_struct {
 
                   int         datatype;
                   int         hdutype;
+                  int         nKeywds;   /* Number of header keywords read */
+
+                  simplerng_state rng;   /* This expression's random stream */
 
                   int         status;
 };
@@ -183,6 +191,13 @@ struct parseInfo_struct {
      struct ParseStatusVariables parseVariables;
 };
 
+struct fitsexpr_struct {
+     ParseData lParse;   /* Parsed expression, bound to lParse.def_fptr      */
+     char *expr;         /* Copy of the expression text, for re-parsing      */
+     int  rebind;        /* Can be rebound by checking column types only?    */
+     int  bound;         /* Is lParse currently valid?                       */
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -198,7 +213,9 @@ extern "C" {
    int  fits_parser_yylex_init_extra ( YY_EXTRA_TYPE user_defined, yyscan_t* scanner);
    int  fits_parser_yylex_destroy (yyscan_t scanner);
 
+   void Optimize_Parser( ParseData *lParse );
    void Evaluate_Parser( ParseData *lParse, long firstRow, long nRows );
+   int  Rows_Independent( ParseData *lParse );
    int  fits_parser_allocateCol( ParseData *lParse, int nCol, int *status );
    int fits_parser_set_temporary_col(ParseData *lParse, parseInfo *Info,
 				     long int nrows, void *nulval, int *status);
@@ -52,9 +52,24 @@
 
 #include <limits.h>
 #include <ctype.h>
+#include <time.h>
+#if defined(_REENTRANT) && !defined(_WIN32)
+#include <unistd.h>
+#endif
 #include "eval_defs.h"
 #include "region.h"
 
+#ifdef _REENTRANT
+/* protects the count of random number streams handed out by seed_random; */
+/* a plain mutex, so that FFLOCK1 does not write Fitsio_Pthread_Status     */
+static pthread_mutex_t Fitsio_StreamLock = PTHREAD_MUTEX_INITIALIZER;
+#define FFLOCKSTREAM   pthread_mutex_lock(&Fitsio_StreamLock)
+#define FFUNLOCKSTREAM pthread_mutex_unlock(&Fitsio_StreamLock)
+#else
+#define FFLOCKSTREAM
+#define FFUNLOCKSTREAM
+#endif
+
 
 /*  Internal routines needed to allow the evaluator to operate on FITS data  */
 
@@ -64,6 +79,47 @@ static int  find_column( ParseData *lParse, char *colName, void *itslval );
 static int  find_keywd ( ParseData *lParse, char *key,     void *itslval );
 static int  load_column( ParseData *lParse, int varNum, long fRow, long nRows,
                          void *data, char *undef );
+static int  set_table_col_types( ParseData *lParse, fitsfile *fptr, int colnum,
+                                 int typecode, long repeat, long width,
+                                 DataInfo *varInfo, iteratorCol *colIter );
+static int  find_rows  ( ParseData *lParse, long firstrow, long nrows,
+                         long *n_good_rows, char *row_status, int *status );
+static int  select_rows( ParseData *lParse, fitsfile *outfptr, int *status );
+static int  calc_rows  ( ParseData *lParse, int datatype, long firstrow,
+                         long nelements, void *nulval, void *array,
+                         int *anynul, int *status );
+static void Reset_State( ParseData *lParse );
+static int  calc_output( ParseData *lParse, int datatype, int constant,
+                         long nelem, int naxis, long *naxes, fitsfile *outfptr,
+                         char **parName, char *parInfo, int *colNo,
+                         char *nullKwd, int *newNullKwd, int *status );
+static void calc_keyword( ParseData *lParse, int datatype, fitsfile *outfptr,
+                          char *parName, char *parInfo, int *status );
+static int  calc_multi_workfn( long totalrows, long offset, long firstrow,
+                               long nrows, int nCols, iteratorCol *colData,
+                               void *userPtr );
+static int  find_rows_sel( ParseData *lParse, long firstrow, long nrows,
+                           long maxgood, int nproj, int *colnum, int *datatype,
+                           void **nulval, void **array, long *n_good_rows,
+                           long *rownums, unsigned char *bitmap, int *anynul,
+                           int *status );
+
+static void seed_random( ParseData *lParse );
+static int  init_parser( fitsfile *fptr, int compressed, ParseData *lParse,
+                         int *status );
+static int  parse_expr ( ParseData *lParse, char *expr, int *status );
+static int  result_info( ParseData *lParse, int maxdim, int *datatype,
+                         long *nelem, int *naxis, long *naxes, int *status );
+static int  workfn_init ( ParseData *lParse, int resultNode, parseInfo *userInfo,
+                          iteratorCol *outcol, long totalrows, long firstrow,
+                          long nrows );
+static void workfn_nulls( parseInfo *userInfo, iteratorCol *outcol );
+static long workfn_rowsize( Node *result, struct ParseStatusVariables *pv );
+static void workfn_store( ParseData *lParse, Node *result, int resType,
+                          struct ParseStatusVariables *pv, long ntodo,
+                          int *anyNullThisTime );
+static void workfn_done ( parseInfo *userInfo, iteratorCol *outcol,
+                          void *Data0, int anyNullThisTime );
 
 static int DEBUG_PIXFILTER;
 
@@ -82,45 +138,64 @@ int fffrow( fitsfile *fptr,         /* I - Input FITS file                   */
 /* array of flags indicating which rows evaluated to TRUE/FALSE              */
 /*---------------------------------------------------------------------------*/
 {
-   parseInfo Info;
-   int naxis, constant;
-   long nelem, naxes[MAXDIMS], elem;
-   char result;
+   int naxis, datatype;
+   long nelem, naxes[MAXDIMS];
    ParseData lParse;
 
    if( *status ) return( *status );
-   memset(&Info, 0, sizeof(Info));   
 
-   if( ffiprs( fptr, 0, expr, MAXDIMS, &Info.datatype, &nelem, &naxis,
+   if( ffiprs( fptr, 0, expr, MAXDIMS, &datatype, &nelem, &naxis,
                naxes, &lParse, status ) ) {
       ffcprs(&lParse);
       return( *status );
    }
-   if( nelem<0 ) {
-      constant = 1;
-      nelem = -nelem;
-   } else
-      constant = 0;
 
-   if( Info.datatype!=TLOGICAL || nelem!=1 ) {
-      ffcprs(&lParse);
+   find_rows( &lParse, firstrow, nrows, n_good_rows, row_status, status );
+
+   ffcprs(&lParse);
+   return(*status);
+}
+
+/*---------------------------------------------------------------------------*/
+static int find_rows( ParseData *lParse, /* I - Parsed boolean expression    */
+            long     firstrow,      /* I - First row of table to eval        */
+            long     nrows,         /* I - Number of rows to evaluate        */
+            long     *n_good_rows,  /* O - Number of rows eval to True       */
+            char     *row_status,   /* O - Array of boolean results          */
+            int      *status )      /* O - Error status                      */
+/*                                                                           */
+/* The body of fffrow, run on an expression which has already been parsed   */
+/* by ffiprs.  Also used by fffrwx on a compiled expression.                 */
+/*---------------------------------------------------------------------------*/
+{
+   parseInfo Info;
+   long elem;
+   char result;
+
+   if( *status ) return( *status );
+   memset(&Info, 0, sizeof(Info));   
+   Info.datatype = lParse->datatype;
+
+   if( Info.datatype!=TLOGICAL || lParse->nElements!=1 ) {
       ffpmsg("Expression does not evaluate to a logical scalar.");
       return( *status = PARSE_BAD_TYPE );
    }
 
-   if( constant ) { /* No need to call parser... have result from ffiprs */
-      result = lParse.Nodes[lParse.resultNode].value.data.log;
+   if( lParse->Nodes[lParse->resultNode].operation==CONST_OP ) {
+      /* No need to call parser... have result from ffiprs */
+      result = lParse->Nodes[lParse->resultNode].value.data.log;
       *n_good_rows = nrows;
       for( elem=0; elem<nrows; elem++ )
          row_status[elem] = result;
    } else {
+      Reset_State( lParse );
       firstrow     = (firstrow>1 ? firstrow : 1);
       Info.dataPtr = row_status;
       Info.nullPtr = NULL;
       Info.maxRows = nrows;
-      Info.parseData = &lParse;
+      Info.parseData = lParse;
 
-      if( ffiter( lParse.nCols, lParse.colData, firstrow-1, 0,
+      if( ffiter( lParse->nCols, lParse->colData, firstrow-1, 0,
                   fits_parser_workfn, (void*)&Info, status ) == -1 )
          *status = 0;  /* -1 indicates exitted without error before end... OK */
 
@@ -143,7 +218,6 @@ int fffrow( fitsfile *fptr,         /* I - Input FITS file                   */
       }
    }
 
-   ffcprs(&lParse);
    return(*status);
 }
 
@@ -160,10 +234,37 @@ int ffsrow( fitsfile *infptr,   /* I - Input FITS file                      */
 /* extension is before the input extension, the second extension *MUST* be  */
 /* opened using ffreopen, so that CFITSIO can handle changing file lengths. */
 /*--------------------------------------------------------------------------*/
+{
+   int naxis, datatype;
+   long nelem, naxes[MAXDIMS];
+   ParseData lParse;
+
+   if( *status ) return( *status );
+
+   if( ffiprs( infptr, 0, expr, MAXDIMS, &datatype, &nelem, &naxis,
+               naxes, &lParse, status ) ) {
+      ffcprs(&lParse);
+      return( *status );
+   }
+
+   select_rows( &lParse, outfptr, status );
+
+   ffcprs(&lParse);
+   return(*status);
+}
+
+/*--------------------------------------------------------------------------*/
+static int select_rows( ParseData *lParse, /* I - Parsed boolean expression */
+            fitsfile *outfptr,  /* I - Output FITS file                     */
+            int      *status )  /* O - Error status                         */
+/*                                                                          */
+/* The body of ffsrow, run on an expression which has already been parsed   */
+/* by ffiprs against the input table, lParse->def_fptr.  Also used by       */
+/* ffsrwx on a compiled expression.                                         */
+/*--------------------------------------------------------------------------*/
 {
    parseInfo Info;
-   int naxis, constant;
-   long nelem, rdlen, naxes[MAXDIMS], maxrows, nbuff, nGood, inloc, outloc;
+   long rdlen, maxrows, nbuff, nGood, inloc, outloc;
    LONGLONG ntodo, inbyteloc, outbyteloc, hsize;
    long freespace;
    unsigned char *buffer, result;
@@ -171,32 +272,20 @@ int ffsrow( fitsfile *infptr,   /* I - Input FITS file                      */
       LONGLONG rowLength, numRows, heapSize;
       LONGLONG dataStart, heapStart;
    } inExt, outExt;
-   ParseData lParse;
+   fitsfile *infptr = lParse->def_fptr;
 
    if( *status ) return( *status );
 
    memset(&Info, 0, sizeof(Info));   
    memset(&inExt, 0, sizeof(inExt));
    memset(&outExt, 0, sizeof(outExt));
-
-   if( ffiprs( infptr, 0, expr, MAXDIMS, &Info.datatype, &nelem, &naxis,
-               naxes, &lParse, status ) ) {
-      ffcprs(&lParse);
-      return( *status );
-   }
-
-   if( nelem<0 ) {
-      constant = 1;
-      nelem = -nelem;
-   } else
-      constant = 0;
+   Info.datatype = lParse->datatype;
 
    /**********************************************************************/
    /* Make sure expression evaluates to the right type... logical scalar */
    /**********************************************************************/
 
-   if( Info.datatype!=TLOGICAL || nelem!=1 ) {
-      ffcprs(&lParse);
+   if( Info.datatype!=TLOGICAL || lParse->nElements!=1 ) {
       ffpmsg("Expression does not evaluate to a logical scalar.");
       return( *status = PARSE_BAD_TYPE );
    }
@@ -207,26 +296,18 @@ int ffsrow( fitsfile *infptr,   /* I - Input FITS file                      */
 
    if( infptr->HDUposition != (infptr->Fptr)->curhdu )
       ffmahd( infptr, (infptr->HDUposition) + 1, NULL, status );
-   if( *status ) {
-      ffcprs(&lParse);
-      return( *status );
-   }
+   if( *status ) return( *status );
    inExt.rowLength = (long) (infptr->Fptr)->rowlength;
    inExt.numRows   = (infptr->Fptr)->numrows;
    inExt.heapSize  = (infptr->Fptr)->heapsize;
-   if( inExt.numRows == 0 ) { /* Nothing to copy */
-      ffcprs(&lParse);
+   if( inExt.numRows == 0 )  /* Nothing to copy */
       return( *status );
-   }
 
    if( outfptr->HDUposition != (outfptr->Fptr)->curhdu )
       ffmahd( outfptr, (outfptr->HDUposition) + 1, NULL, status );
    if( (outfptr->Fptr)->datastart < 0 )
       ffrdef( outfptr, status );
-   if( *status ) {
-      ffcprs(&lParse);
-      return( *status );
-   }
+   if( *status ) return( *status );
    outExt.rowLength = (long) (outfptr->Fptr)->rowlength;
    outExt.numRows   = (outfptr->Fptr)->numrows;
    if( !outExt.numRows )
@@ -235,7 +316,6 @@ int ffsrow( fitsfile *infptr,   /* I - Input FITS file                      */
 
    if( inExt.rowLength != outExt.rowLength ) {
       ffpmsg("Output table has different row length from input");
-      ffcprs(&lParse);
       return( *status = PARSE_BAD_OUTPUT );
    }
 
@@ -246,26 +326,27 @@ int ffsrow( fitsfile *infptr,   /* I - Input FITS file                      */
    Info.dataPtr = (char *)malloc( (size_t) ((inExt.numRows + 1) * sizeof(char)) );
    Info.nullPtr = NULL;
    Info.maxRows = (long) inExt.numRows;
-   Info.parseData = &lParse;
+   Info.parseData = lParse;
    if( !Info.dataPtr ) {
       ffpmsg("Unable to allocate memory for row selection");
-      ffcprs(&lParse);
       return( *status = MEMORY_ALLOCATION );
    }
    
    /* make sure array is zero terminated */
    ((char*)Info.dataPtr)[inExt.numRows] = 0;
 
-   if( constant ) { /*  Set all rows to the same value from constant result  */
+   if( lParse->Nodes[lParse->resultNode].operation==CONST_OP ) {
+      /*  Set all rows to the same value from constant result  */
 
-      result = lParse.Nodes[lParse.resultNode].value.data.log;
+      result = lParse->Nodes[lParse->resultNode].value.data.log;
       for( ntodo = 0; ntodo<inExt.numRows; ntodo++ )
          ((char*)Info.dataPtr)[ntodo] = result;
       nGood = (long) (result ? inExt.numRows : 0);
 
    } else {
 
-      ffiter( lParse.nCols, lParse.colData, 0L, 0L,
+      Reset_State( lParse );
+      ffiter( lParse->nCols, lParse->colData, 0L, 0L,
               fits_parser_workfn, (void*)&Info, status );
 
       nGood = 0;
@@ -279,8 +360,7 @@ int ffsrow( fitsfile *infptr,   /* I - Input FITS file                      */
       rdlen  = (long) inExt.rowLength;
       buffer = (unsigned char *)malloc(maxvalue(500000,rdlen) * sizeof(char) );
       if( buffer==NULL ) {
-         ffcprs(&lParse);
-         return( *status=MEMORY_ALLOCATION );
+            return( *status=MEMORY_ALLOCATION );
       }
       maxrows = maxvalue( (500000L/rdlen), 1);
       nbuff = 0;
@@ -398,7 +478,6 @@ int ffsrow( fitsfile *infptr,   /* I - Input FITS file                      */
    }
 
    FREE(Info.dataPtr);
-   ffcprs(&lParse);
 
    ffcmph(outfptr, status);  /* compress heap, deleting any orphaned data */
    return(*status);
@@ -423,24 +502,49 @@ int ffcrow( fitsfile *fptr,      /* I - Input FITS file                      */
 /* dimensions of the results.                                                */
 /*---------------------------------------------------------------------------*/
 {
-   parseInfo Info;
-   int naxis;
+   int naxis, restype;
    long nelem1, naxes[MAXDIMS];
    ParseData lParse;
 
    if( *status ) return( *status );
 
-   memset(&Info, 0, sizeof(Info));   
-
-   if( ffiprs( fptr, 0, expr, MAXDIMS, &Info.datatype, &nelem1, &naxis,
+   if( ffiprs( fptr, 0, expr, MAXDIMS, &restype, &nelem1, &naxis,
                naxes, &lParse, status ) ) {
       ffcprs(&lParse);
       return( *status );
    }
-   if( nelem1<0 ) nelem1 = - nelem1;
+
+   calc_rows( &lParse, datatype, firstrow, nelements, nulval, array,
+              anynul, status );
+
+   ffcprs(&lParse);
+   return( *status );
+}
+
+/*---------------------------------------------------------------------------*/
+static int calc_rows( ParseData *lParse, /* I - Parsed expression            */
+            int      datatype,   /* I - Datatype to return results as        */
+            long     firstrow,   /* I - First row to evaluate                */
+            long     nelements,  /* I - Number of elements to return         */
+            void     *nulval,    /* I - Ptr to value to use as UNDEF         */
+            void     *array,     /* O - Array of results                     */
+            int      *anynul,    /* O - Were any UNDEFs encountered?         */
+            int      *status )   /* O - Error status                         */
+/*                                                                           */
+/* The body of ffcrow, run on an expression which has already been parsed   */
+/* by ffiprs.  Also used by ffcrwx on a compiled expression.                 */
+/*---------------------------------------------------------------------------*/
+{
+   parseInfo Info;
+   long nelem1;
+
+   if( *status ) return( *status );
+
+   memset(&Info, 0, sizeof(Info));   
+   Info.datatype = lParse->datatype;
+   nelem1 = lParse->nElements;
 
    if( nelements<nelem1 ) {
-      ffcprs(&lParse);
       ffpmsg("Array not large enough to hold at least one row of data.");
       return( *status = PARSE_LRG_VECTOR );
    }
@@ -452,14 +556,14 @@ int ffcrow( fitsfile *fptr,      /* I - Input FITS file                      */
    Info.dataPtr = array;
    Info.nullPtr = nulval;
    Info.maxRows = nelements / nelem1;
-   Info.parseData = &lParse;
+   Info.parseData = lParse;
    
-   if( ffiter( lParse.nCols, lParse.colData, firstrow-1, 0,
+   Reset_State( lParse );
+   if( ffiter( lParse->nCols, lParse->colData, firstrow-1, 0,
                fits_parser_workfn, (void*)&Info, status ) == -1 )
       *status=0;  /* -1 indicates exitted without error before end... OK */
 
    *anynul = Info.anyNull;
-   ffcprs(&lParse);
    return( *status );
 }
 
@@ -507,11 +611,10 @@ int ffcalc_rng( fitsfile *infptr,   /* I - Input FITS file                  */
 /*--------------------------------------------------------------------------*/
 {
    parseInfo Info;
-   int naxis, constant, typecode, newNullKwd=0;
-   long nelem, naxes[MAXDIMS], repeat, width;
+   int naxis, constant, newNullKwd=0;
+   long nelem, naxes[MAXDIMS];
    int col_cnt, colNo;
-   Node *result;
-   char card[81], tform[16], nullKwd[9], tdimKwd[9];
+   char nullKwd[9];
    ParseData lParse;
 
    if( *status ) return( *status );
@@ -531,11 +634,114 @@ int ffcalc_rng( fitsfile *infptr,   /* I - Input FITS file                  */
       constant = 0;
 
    Info.parseData = &lParse;
+   if( calc_output( &lParse, Info.datatype, constant, nelem, naxis, naxes,
+                    outfptr, &parName, parInfo, &colNo, nullKwd,
+                    &newNullKwd, status ) ) {
+      ffcprs(&lParse);
+      return( *status );
+   }
+
+   if( colNo>0 ) {
+
+      /*  Output column exists (now)... put results into it  */
+
+      int anyNull = 0;
+      int nPerLp, i;
+      long totaln;
+
+      ffgkyj(infptr, "NAXIS2", &totaln, 0, status);
+
+      /*************************************/
+      /* Create new iterator Output Column */
+      /*************************************/
+
+      col_cnt = lParse.nCols;
+      if( fits_parser_allocateCol( &lParse, col_cnt, status ) ) {
+         ffcprs(&lParse);
+         return( *status );
+      }
+
+      fits_iter_set_by_num( lParse.colData+col_cnt, outfptr,
+                            colNo, 0, OutputCol );
+      lParse.nCols++;
+
+      for( i=0; i<nRngs; i++ ) {
+         Info.dataPtr = NULL;
+         Info.maxRows = end[i]-start[i]+1;
+
+          /*
+            If there is only 1 range, and it includes all the rows,
+            and there are 10 or more rows, then set nPerLp = 0 so
+            that the iterator function will dynamically choose the
+            most efficient number of rows to process in each loop.
+            Otherwise, set nPerLp to the number of rows in this range.
+         */
+
+         if( (Info.maxRows >= 10) && (nRngs == 1) &&
+             (start[0] == 1) && (end[0] == totaln))
+              nPerLp = 0;
+         else
+              nPerLp = Info.maxRows;
+
+         if( ffiter( lParse.nCols, lParse.colData, start[i]-1,
+                     nPerLp, fits_parser_workfn, (void*)&Info, status ) == -1 )
+            *status = 0;
+         else if( *status ) {
+            ffcprs(&lParse);
+            return( *status );
+         }
+         if( Info.anyNull ) anyNull = 1;
+      }
+
+      if( newNullKwd && !anyNull ) {
+         ffdkey( outfptr, nullKwd, status );
+      }
+
+   } else {
+
+      /* Put constant result into keyword */
+
+      calc_keyword( &lParse, Info.datatype, outfptr, parName, parInfo,
+                    status );
+   }
+
+   ffcprs(&lParse);
+   return( *status );
+}
+
+/*--------------------------------------------------------------------------*/
+static int calc_output( ParseData *lParse, /* I - Parsed expression         */
+                        int      datatype, /* I - Data type of result       */
+                        int      constant, /* I - Is the result constant?   */
+                        long     nelem,    /* I - Vector length of result   */
+                        int      naxis,    /* I - # of dimensions of result */
+                        long     *naxes,   /* I - Size of each dimension    */
+                        fitsfile *outfptr, /* I - Output fits file          */
+                        char     **parName,/* IO- Name of output parameter  */
+                        char     *parInfo, /* I - Extra parameter info      */
+                        int      *colNo,   /* O - Output column, or 0       */
+                        char     *nullKwd, /* O - Name of TNULLn keyword    */
+                        int      *newNullKwd, /* O - Was TNULLn created?    */
+                        int      *status ) /* O - Error status              */
+/*                                                                          */
+/* Find or create the destination of an ffcalc result, following cases (1) */
+/* to (4) described in ffcalc_rng.  On return colNo is the output column,   */
+/* or 0 if the constant result belongs in keyword *parName (advanced past   */
+/* any leading '#').                                                        */
+/*--------------------------------------------------------------------------*/
+{
+   int typecode;
+   long repeat, width;
+   char card[81], tform[16], tdimKwd[9];
+   char *name = *parName;
+
+   if( *status ) return( *status );
+
    /*  Case (1): If column exists put it there  */
 
-   colNo = 0;
+   *colNo = 0;
    ffpmrk(); /* prevent lack of column name from sullying the stack */
-   ffgcno( outfptr, CASEINSEN, parName, &colNo, status );
+   ffgcno( outfptr, CASEINSEN, name, colNo, status );
    ffcmsg();   
    if( *status ) {
 
@@ -544,16 +750,14 @@ int ffcalc_rng( fitsfile *infptr,   /* I - Input FITS file                  */
       /* Case (2): Does parName indicate result should be put into keyword */
 
       *status = 0;
-      if( parName[0]=='#' ) {
+      if( name[0]=='#' ) {
          if( ! constant ) {
-            ffcprs(&lParse);
             ffpmsg( "Cannot put tabular result into keyword (ffcalc)" );
             return( *status = PARSE_BAD_TYPE );
          }
-         parName++;  /* Advance past '#' */
-	 if ( (fits_strcasecmp(parName,"HISTORY") == 0 || fits_strcasecmp(parName,"COMMENT") == 0) &&
-	      Info.datatype != TSTRING ) {
-            ffcprs(&lParse);
+         name++;  /* Advance past '#' */
+	 if ( (fits_strcasecmp(name,"HISTORY") == 0 || fits_strcasecmp(name,"COMMENT") == 0) &&
+	      datatype != TSTRING ) {
             ffpmsg( "HISTORY and COMMENT values must be strings (ffcalc)" );
 	    return( *status = PARSE_BAD_TYPE );
 	 }
@@ -562,28 +766,27 @@ int ffcalc_rng( fitsfile *infptr,   /* I - Input FITS file                  */
 
          /* Case (3): Does a keyword named parName already exist */
 
-         if( ffgcrd( outfptr, parName, card, status )==KEY_NO_EXIST ) {
-            colNo = -1;
+         if( ffgcrd( outfptr, name, card, status )==KEY_NO_EXIST ) {
+            *colNo = -1;
          } else if( *status ) {
-            ffcprs(&lParse);
             return( *status );
          }
 
       } else
-         colNo = -1;
+         *colNo = -1;
 
-      if( colNo<0 ) {
+      if( *colNo<0 ) {
 
          /* Case (4): Create new column */
 
          *status = 0;
-         ffgncl( outfptr, &colNo, status );
-         colNo++;
+         ffgncl( outfptr, colNo, status );
+         (*colNo)++;
          if( parInfo==NULL || *parInfo=='\0' ) {
             /*  Figure out best default column type  */
-            if( lParse.hdutype==BINARY_TBL ) {
+            if( lParse->hdutype==BINARY_TBL ) {
                snprintf(tform,15,"%ld",nelem);
-               switch( Info.datatype ) {
+               switch( datatype ) {
                case TLOGICAL:  strcat(tform,"L");  break;
                case TLONG:     strcat(tform,"J");  break;
                case TDOUBLE:   strcat(tform,"D");  break;
@@ -592,9 +795,8 @@ int ffcalc_rng( fitsfile *infptr,   /* I - Input FITS file                  */
                case TLONGLONG: strcat(tform,"K");  break;
                }
             } else {
-               switch( Info.datatype ) {
+               switch( datatype ) {
                case TLOGICAL:
-                  ffcprs(&lParse);
                   ffpmsg("Cannot create LOGICAL column in ASCII table");
                   return( *status = NOT_BTABLE );
                case TLONG:     strcpy(tform,"I11");     break;
@@ -604,22 +806,22 @@ int ffcalc_rng( fitsfile *infptr,   /* I - Input FITS file                  */
                }
             }
             parInfo = tform;
-         } else if( !(isdigit((int) *parInfo)) && lParse.hdutype==BINARY_TBL ) {
-            if( Info.datatype==TBIT && *parInfo=='B' )
+         } else if( !(isdigit((int) *parInfo)) && lParse->hdutype==BINARY_TBL ) {
+            if( datatype==TBIT && *parInfo=='B' )
                nelem = (nelem+7)/8;
             snprintf(tform,16,"%ld%s",nelem,parInfo);
             parInfo = tform;
          }
-         fficol( outfptr, colNo, parName, parInfo, status );
+         fficol( outfptr, *colNo, name, parInfo, status );
          if( naxis>1 )
-            ffptdm( outfptr, colNo, naxis, naxes, status );
+            ffptdm( outfptr, *colNo, naxis, naxes, status );
 
          /*  Setup TNULLn keyword in case NULLs are encountered  */
 
-         ffkeyn("TNULL", colNo, nullKwd, status);
+         ffkeyn("TNULL", *colNo, nullKwd, status);
          if( ffgcrd( outfptr, nullKwd, card, status )==KEY_NO_EXIST ) {
             *status = 0;
-            if( lParse.hdutype==BINARY_TBL ) {
+            if( lParse->hdutype==BINARY_TBL ) {
 	       LONGLONG nullVal=0;
                fits_binary_tform( parInfo, &typecode, &repeat, &width, status );
                if( typecode==TBYTE )
@@ -639,20 +841,19 @@ int ffcalc_rng( fitsfile *infptr,   /* I - Input FITS file                  */
 		  
                if( nullVal ) {
                   ffpkyj( outfptr, nullKwd, nullVal, "Null value", status );
-                  fits_set_btblnull( outfptr, colNo, nullVal, status );
-                  newNullKwd = 1;
+                  fits_set_btblnull( outfptr, *colNo, nullVal, status );
+                  *newNullKwd = 1;
                }
-            } else if( lParse.hdutype==ASCII_TBL ) {
+            } else if( lParse->hdutype==ASCII_TBL ) {
                ffpkys( outfptr, nullKwd, "NULL", "Null value string", status );
-               fits_set_atblnull( outfptr, colNo, "NULL", status );
-               newNullKwd = 1;
+               fits_set_atblnull( outfptr, *colNo, "NULL", status );
+               *newNullKwd = 1;
             }
          }
 
       }
 
    } else if( *status ) {
-      ffcprs(&lParse);
       return( *status );
    } else {
 
@@ -660,117 +861,525 @@ int ffcalc_rng( fitsfile *infptr,   /* I - Input FITS file                  */
       /*  Check if a TDIM keyword should be written/updated.  */
       /********************************************************/
 
-      ffkeyn("TDIM", colNo, tdimKwd, status);
+      ffkeyn("TDIM", *colNo, tdimKwd, status);
       ffgcrd( outfptr, tdimKwd, card, status );
       if( *status==0 ) {
          /*  TDIM exists, so update it with result's dimension  */
-         ffptdm( outfptr, colNo, naxis, naxes, status );
+         ffptdm( outfptr, *colNo, naxis, naxes, status );
       } else if( *status==KEY_NO_EXIST ) {
          /*  TDIM does not exist, so clear error stack and     */
          /*  write a TDIM only if result is multi-dimensional  */
          *status = 0;
          ffcmsg();
          if( naxis>1 )
-            ffptdm( outfptr, colNo, naxis, naxes, status );
+            ffptdm( outfptr, *colNo, naxis, naxes, status );
       }
       if( *status ) {
          /*  Either some other error happened in ffgcrd   */
          /*  or one happened in ffptdm                    */
-         ffcprs(&lParse);
          return( *status );
       }
 
    }
 
-   if( colNo>0 ) {
+   *parName = name;
+   return( *status );
+}
 
-      /*  Output column exists (now)... put results into it  */
+/*--------------------------------------------------------------------------*/
+static void calc_keyword( ParseData *lParse, /* I - Parsed constant expr    */
+                          int      datatype, /* I - Data type of result     */
+                          fitsfile *outfptr, /* I - Output fits file        */
+                          char     *parName, /* I - Name of output keyword  */
+                          char     *parInfo, /* I - Keyword comment         */
+                          int      *status ) /* O - Error status            */
+/*                                                                          */
+/* Write the constant result of an ffcalc expression into keyword parName.  */
+/*--------------------------------------------------------------------------*/
+{
+   Node *result;
 
-      int anyNull = 0;
-      int nPerLp, i;
-      long totaln;
+   result  = lParse->Nodes + lParse->resultNode;
+   switch( datatype ) {
+   case TDOUBLE:
+      ffukyd( outfptr, parName, result->value.data.dbl, 15,
+              parInfo, status );
+      break;
+   case TLONG:
+      ffukyj( outfptr, parName, result->value.data.lng, parInfo, status );
+      break;
+   case TLOGICAL:
+      ffukyl( outfptr, parName, result->value.data.log, parInfo, status );
+      break;
+   case TBIT:
+   case TSTRING:
+      if (fits_strcasecmp(parName,"HISTORY") == 0) {
+        ffphis( outfptr, result->value.data.str, status);
+      } else if (fits_strcasecmp(parName,"COMMENT") == 0) {
+        ffpcom( outfptr, result->value.data.str, status);
+      } else {
+        ffukys( outfptr, parName, result->value.data.str, parInfo, status );
+      }
+      break;
+   }
+}
 
-      ffgkyj(infptr, "NAXIS2", &totaln, 0, status);
+typedef struct {
+  ParseData *lParse;      /* All the definitions, parsed together          */
+  int  nIn;               /* Number of input columns in lParse->colData    */
+  int  nDefs;             /* Number of definitions written to columns      */
+  int  *root;             /* Result node of each of them                   */
+  int  *resType;          /* Data type of each result                      */
+  parseInfo *Info;        /* Output instructions of each                   */
+  int  nThreads;          /* Threads to share each block of rows between   */
+} ffcalm_workdata;
 
-      /*************************************/
-      /* Create new iterator Output Column */
-      /*************************************/
+typedef struct {
+  ffcalm_workdata *work;
+  ParseData *lParse;      /* Parser evaluating this slice of the block     */
+  ParseData copy;         /* Private copy of the parser for a thread       */
+  struct ParseStatusVariables *pv;  /* Output position of each definition  */
+  int  *anyNull;          /* Were nulls written for each definition?      */
+  long firstrow;          /* First row of the slice                        */
+  long nrows;             /* Number of rows in the slice                   */
+#ifdef _REENTRANT
+  pthread_t thread;
+  int  started;
+#endif
+} ffcalm_slice;
+
+#define CALC_MAX_THREADS  8      /* Most threads used by ffcalc_multi      */
+#define CALC_SLICE_ROWS   256    /* Fewest rows worth handing to a thread  */
+
+static void calc_multi_rows  ( ffcalm_slice *slice );
+static void calc_multi_slices( ffcalm_slice *slice, int nSlices );
+#ifdef _REENTRANT
+static void *calc_multi_thread( void *userPtr );
+static int  calc_threads( void );
+#endif
 
-      col_cnt = lParse.nCols;
-      if( fits_parser_allocateCol( &lParse, col_cnt, status ) ) {
-         ffcprs(&lParse);
-         return( *status );
-      }
+/*--------------------------------------------------------------------------*/
+int ffcalc_multi( fitsfile *infptr, /* I - Input FITS file                  */
+                  int      ndefs,   /* I - Number of definitions            */
+                  char     **defs,  /* I - "NAME = expression" strings      */
+                  fitsfile *outfptr,/* I - Output fits file                 */
+                  char     **parInfo, /* I - TFORM or comment for each      */
+                                      /*     definition; array may be NULL  */
+                  int      nRngs,   /* I - Row range info                   */
+                  long     *start,  /* I - Row range info                   */
+                  long     *end,    /* I - Row range info                   */
+                  int      *status )/* O - Error status                     */
+/*                                                                          */
+/* Evaluate several "NAME = expression" definitions over the same rows and  */
+/* write each result as ffcalc_rng would, but with a single iterator pass.  */
+/* All the definitions are parsed into one ParseData, so every input column */
+/* is read once per block of rows no matter how many definitions use it,   */
+/* and a subexpression common to several definitions is evaluated once.    */
+/* Unless some definition depends on other rows or on random numbers, each  */
+/* block of rows is split between several threads (thread-safe builds      */
+/* only).  All definitions are parsed before any output column is created, */
+/* so each one sees the input table as it was before the call.             */
+/*--------------------------------------------------------------------------*/
+{
+   ParseData lParse;
+   parseInfo *Info = NULL;
+   ffcalm_workdata work;
+   int *datatype = NULL, *constant = NULL, *naxis = NULL, *colNo = NULL;
+   int *newNullKwd = NULL;
+   long *nelem = NULL, (*naxes)[MAXDIMS] = NULL;
+   char (*nullKwd)[9] = NULL, **names = NULL, *text = NULL, *expr, *cptr;
+   char msg[FLEN_ERRMSG];
+   int ii, jj, kk, nPerLp;
+   long totaln, len;
 
-      fits_iter_set_by_num( lParse.colData+col_cnt, outfptr,
-                            colNo, 0, OutputCol );
-      lParse.nCols++;
+   if( *status ) return( *status );
+   if( ndefs<1 ) return( *status );
+
+   memset( &lParse, 0, sizeof(lParse) );
+   memset( &work, 0, sizeof(work) );
+
+   len = 0;
+   for( ii=0; ii<ndefs; ii++ ) len += strlen( defs[ii] ) + 1;
+
+   Info       = (parseInfo *)calloc( ndefs, sizeof(parseInfo) );
+   datatype   = (int *)calloc( 7*ndefs, sizeof(int) );
+   nelem      = (long *)calloc( ndefs, sizeof(long) );
+   naxes      = (long (*)[MAXDIMS])calloc( ndefs, sizeof(*naxes) );
+   nullKwd    = (char (*)[9])calloc( ndefs, sizeof(*nullKwd) );
+   names      = (char **)calloc( ndefs, sizeof(char *) );
+   text       = (char *)malloc( len );
+   if( !Info || !datatype || !nelem || !naxes || !nullKwd || !names
+       || !text ) {
+      ffpmsg("memory allocation failed (ffcalc_multi)");
+      *status = MEMORY_ALLOCATION;
+      goto cleanup;
+   }
+   constant     = datatype   + ndefs;
+   naxis        = constant   + ndefs;
+   colNo        = naxis      + ndefs;
+   newNullKwd   = colNo      + ndefs;
+   work.root    = newNullKwd + ndefs;
+   work.resType = work.root  + ndefs;
+
+   if( init_parser( infptr, 0, &lParse, status ) ) goto cleanup;
+   lParse.resultNodes = (int *)malloc( ndefs * sizeof(int) );
+   if( !lParse.resultNodes ) {
+      ffpmsg("memory allocation failed (ffcalc_multi)");
+      *status = MEMORY_ALLOCATION;
+      goto cleanup;
+   }
 
-      for( i=0; i<nRngs; i++ ) {
-         Info.dataPtr = NULL;
-         Info.maxRows = end[i]-start[i]+1;
+   /*  Split each definition at its '=' and parse every expression into  */
+   /*  the same parser, so they share columns and subexpressions         */
+
+   cptr = text;
+   for( ii=0; ii<ndefs; ii++ ) {
+      strcpy( cptr, defs[ii] );
+      names[ii] = cptr;
+      cptr += strlen( cptr ) + 1;
+
+      expr = strchr( names[ii], '=' );
+      if( expr ) {
+         *expr++ = '\0';
+         while( *names[ii]==' ' ) names[ii]++;
+         kk = strlen( names[ii] );
+         while( kk && names[ii][kk-1]==' ' ) names[ii][--kk] = '\0';
+      }
+      if( !expr || *expr=='=' || !*names[ii] || strchr( names[ii], ' ' ) ) {
+         snprintf( msg, FLEN_ERRMSG,
+                   "Definition %d is not of the form NAME = expression:",
+                   ii+1 );
+         ffpmsg( msg );
+         ffpmsg( defs[ii] );
+         *status = PARSE_SYNTAX_ERR;
+         goto cleanup;
+      }
 
-          /*
-            If there is only 1 range, and it includes all the rows,
-            and there are 10 or more rows, then set nPerLp = 0 so
-            that the iterator function will dynamically choose the
-            most efficient number of rows to process in each loop.
-            Otherwise, set nPerLp to the number of rows in this range.
-         */
+      if( parse_expr( &lParse, expr, status ) ) {
+         snprintf( msg, FLEN_ERRMSG,
+                   "Unable to parse definition %d (ffcalc_multi):", ii+1 );
+         ffpmsg( msg );
+         ffpmsg( defs[ii] );
+         goto cleanup;
+      }
+      lParse.resultNodes[ii] = lParse.resultNode;
+      lParse.nResultNodes    = ii+1;
+   }
 
-         if( (Info.maxRows >= 10) && (nRngs == 1) &&
-             (start[0] == 1) && (end[0] == totaln))
-              nPerLp = 0;
-         else
-              nPerLp = Info.maxRows;
+   Optimize_Parser( &lParse );
+   if( (*status = lParse.status) ) goto cleanup;
+
+   for( ii=0; ii<ndefs; ii++ ) {
+      lParse.resultNode = lParse.resultNodes[ii];
+      if( result_info( &lParse, MAXDIMS, datatype+ii, nelem+ii, naxis+ii,
+                       naxes[ii], status ) )
+         goto cleanup;
+      if( nelem[ii]<0 ) {
+         constant[ii] = 1;
+         nelem[ii] = -nelem[ii];
+      }
+   }
 
-         if( ffiter( lParse.nCols, lParse.colData, start[i]-1,
-                     nPerLp, fits_parser_workfn, (void*)&Info, status ) == -1 )
-            *status = 0;
-         else if( *status ) {
-            ffcprs(&lParse);
-            return( *status );
+   /*  Find or create each output, writing the constant keywords now  */
+
+   work.lParse = &lParse;
+   work.Info   = Info;
+   work.nIn    = lParse.nCols;
+   for( ii=0; ii<ndefs; ii++ ) {
+      lParse.resultNode = lParse.resultNodes[ii];
+      if( calc_output( &lParse, datatype[ii], constant[ii], nelem[ii],
+                       naxis[ii], naxes[ii], outfptr, names+ii,
+                       ( parInfo ? parInfo[ii] : NULL ), colNo+ii,
+                       nullKwd[ii], newNullKwd+ii, status ) )
+         goto cleanup;
+
+      if( colNo[ii]>0 ) {
+         for( jj=0; jj<ii; jj++ ) {
+            if( colNo[jj]==colNo[ii] ) {
+               snprintf( msg, FLEN_ERRMSG,
+                         "Definitions %d and %d write the same column (ffcalc_multi)",
+                         jj+1, ii+1 );
+               ffpmsg( msg );
+               *status = PARSE_BAD_OUTPUT;
+               goto cleanup;
+            }
          }
-         if( Info.anyNull ) anyNull = 1;
-      }
 
-      if( newNullKwd && !anyNull ) {
-         ffdkey( outfptr, nullKwd, status );
+         /*  Add the output column after the input columns  */
+
+         if( fits_parser_allocateCol( &lParse, lParse.nCols, status ) )
+            goto cleanup;
+         fits_iter_set_by_num( lParse.colData+lParse.nCols, outfptr,
+                               colNo[ii], 0, OutputCol );
+         lParse.nCols++;
+
+         Info[work.nDefs].parseData = &lParse;
+         work.root[work.nDefs]      = lParse.resultNodes[ii];
+         work.resType[work.nDefs]   = datatype[ii];
+         work.nDefs++;
+      } else {
+         calc_keyword( &lParse, datatype[ii], outfptr, names[ii],
+                       ( parInfo ? parInfo[ii] : NULL ), status );
+         if( *status ) goto cleanup;
       }
+   }
+   if( !work.nDefs ) goto cleanup;
 
-   } else {
+   work.nThreads = 1;
+#ifdef _REENTRANT
+   if( Rows_Independent( &lParse ) ) work.nThreads = calc_threads();
+#endif
 
-      /* Put constant result into keyword */
+   /*  Evaluate all the definitions together, range by range  */
 
-      result  = lParse.Nodes + lParse.resultNode;
-      switch( Info.datatype ) {
-      case TDOUBLE:
-         ffukyd( outfptr, parName, result->value.data.dbl, 15,
-                 parInfo, status );
-         break;
-      case TLONG:
-         ffukyj( outfptr, parName, result->value.data.lng, parInfo, status );
-         break;
-      case TLOGICAL:
-         ffukyl( outfptr, parName, result->value.data.log, parInfo, status );
-         break;
-      case TBIT:
-      case TSTRING:
-	 if (fits_strcasecmp(parName,"HISTORY") == 0) {
-	   ffphis( outfptr, result->value.data.str, status);
-	 } else if (fits_strcasecmp(parName,"COMMENT") == 0) {
-	   ffpcom( outfptr, result->value.data.str, status);
-	 } else {
-	   ffukys( outfptr, parName, result->value.data.str, parInfo, status );
-	 }
-         break;
+   ffgkyj( infptr, "NAXIS2", &totaln, 0, status );
+   for( ii=0; ii<nRngs && !*status; ii++ ) {
+      for( kk=0; kk<work.nDefs; kk++ ) {
+         Info[kk].dataPtr = NULL;
+         Info[kk].maxRows = end[ii]-start[ii]+1;
+         Info[kk].anyNull = 0;
       }
+
+      if( (Info[0].maxRows >= 10) && (nRngs == 1) &&
+          (start[0] == 1) && (end[0] == totaln) )
+         nPerLp = 0;
+      else
+         nPerLp = Info[0].maxRows;
+
+      if( ffiter( lParse.nCols, lParse.colData, start[ii]-1, nPerLp,
+                  calc_multi_workfn, (void*)&work, status ) == -1 )
+         *status = 0;
+
+      for( kk=0, jj=0; kk<ndefs; kk++ )
+         if( colNo[kk]>0 && Info[jj++].anyNull ) newNullKwd[kk] = 0;
    }
 
-   ffcprs(&lParse);
+   /*  Remove any TNULLn keyword created for a column without nulls  */
+
+   for( ii=0; ii<ndefs && !*status; ii++ )
+      if( newNullKwd[ii] ) ffdkey( outfptr, nullKwd[ii], status );
+
+cleanup:
+   ffcprs( &lParse );
+   if( Info ) free( Info );
+   if( datatype ) free( datatype );
+   if( nelem ) free( nelem );
+   if( naxes ) free( naxes );
+   if( nullKwd ) free( nullKwd );
+   if( names ) free( names );
+   if( text ) free( text );
    return( *status );
 }
 
+/*---------------------------------------------------------------------------*/
+static int calc_multi_workfn( long    totalrows, /* I - Total rows to process */
+                              long    offset,    /* I - Rows skipped at start */
+                              long    firstrow,  /* I - First row this pass   */
+                              long    nrows,     /* I - Rows in this pass     */
+                              int     nCols,     /* I - Number of columns     */
+                              iteratorCol *colData, /* IO- Column data        */
+                              void    *userPtr ) /* I - ffcalm_workdata       */
+/*                                                                           */
+/* Iterator work function for ffcalc_multi: evaluate every definition on     */
+/* this block of rows and convert each result into its output column, the   */
+/* one after the input columns which belongs to it.  The block is divided   */
+/* into slices, evaluated at once by separate threads when work->nThreads   */
+/* allows, each thread on its own copy of the parser's Nodes.               */
+/*---------------------------------------------------------------------------*/
+{
+   ffcalm_workdata *work = (ffcalm_workdata *)userPtr;
+   ParseData *lParse = work->lParse;
+   ffcalm_slice *slice;
+   struct ParseStatusVariables *pv;
+   iteratorCol *outcol = colData + work->nIn;
+   int ii, kk, nSlices, status, *anyNull;
+   long row, nEach, lastRow;
+
+   if( firstrow == offset+1 ) {
+      for( ii=0; ii<nCols; ii++ )
+         lParse->colData[ii].repeat = colData[ii].repeat;
+      for( ii=0; ii<work->nDefs; ii++ ) {
+         status = workfn_init( lParse, work->root[ii], work->Info+ii,
+                               outcol+ii, totalrows, firstrow, nrows );
+         if( status ) return( status );
+      }
+   }
+
+   for( ii=0; ii<work->nDefs; ii++ )
+      workfn_nulls( work->Info+ii, outcol+ii );
+
+   lastRow = work->Info[0].parseVariables.lastRow;
+   nrows = minvalue( nrows, lastRow-firstrow+1 );
+
+   Setup_DataArrays( lParse, nCols, colData, firstrow, nrows );
+
+   nSlices = work->nThreads;
+   if( nSlices > nrows/CALC_SLICE_ROWS ) nSlices = nrows/CALC_SLICE_ROWS;
+   if( nSlices < 1 ) nSlices = 1;
+
+   slice   = (ffcalm_slice *)calloc( nSlices, sizeof(ffcalm_slice) );
+   pv      = (struct ParseStatusVariables *)
+                malloc( nSlices * work->nDefs * sizeof(*pv) );
+   anyNull = (int *)calloc( nSlices * work->nDefs, sizeof(int) );
+   if( !slice || !pv || !anyNull ) {
+      if( slice ) free( slice );
+      if( pv ) free( pv );
+      if( anyNull ) free( anyNull );
+      ffpmsg("memory allocation failed (ffcalc_multi)");
+      return( lParse->status = MEMORY_ALLOCATION );
+   }
+
+   /*  Give each slice its own rows and output positions  */
+
+   nEach = (nrows + nSlices - 1) / nSlices;
+   for( kk=0, row=0; kk<nSlices; kk++, row+=nEach ) {
+      slice[kk].work     = work;
+      slice[kk].lParse   = lParse;
+      slice[kk].pv       = pv + kk*work->nDefs;
+      slice[kk].anyNull  = anyNull + kk*work->nDefs;
+      slice[kk].firstrow = firstrow + row;
+      slice[kk].nrows    = minvalue( nEach, nrows-row );
+      for( ii=0; ii<work->nDefs; ii++ ) {
+         slice[kk].pv[ii]      = work->Info[ii].parseVariables;
+         slice[kk].pv[ii].Data = (char*)slice[kk].pv[ii].Data + row *
+            workfn_rowsize( lParse->Nodes + work->root[ii], slice[kk].pv+ii );
+      }
+   }
+
+   if( nSlices==1 )
+      calc_multi_rows( slice );
+   else
+      calc_multi_slices( slice, nSlices );
+
+   /*  Collect the results of the slices, in row order  */
+
+   for( kk=0; kk<nSlices; kk++ ) {
+      if( slice[kk].lParse!=lParse ) {
+         if( slice[kk].copy.status && !lParse->status )
+            lParse->status = slice[kk].copy.status;
+         free( slice[kk].copy.Nodes );
+      }
+      if( kk )
+         for( ii=0; ii<work->nDefs; ii++ )
+            if( slice[kk].anyNull[ii] ) anyNull[ii] = 1;
+   }
+
+   for( ii=0; ii<work->nDefs; ii++ )
+      workfn_done( work->Info+ii, outcol+ii,
+                   work->Info[ii].parseVariables.Data, anyNull[ii] );
+
+   free( slice );
+   free( pv );
+   free( anyNull );
+
+   if( lParse->status ) return( lParse->status );
+   if( lParse->hdutype != IMAGE_HDU && firstrow+nrows-1 == lastRow
+       && work->Info[0].maxRows<totalrows )
+      return( -1 );
+   return( 0 );
+}
+
+/*---------------------------------------------------------------------------*/
+static void calc_multi_rows( ffcalm_slice *slice ) /* IO- Rows to evaluate   */
+/*                                                                           */
+/* Evaluate all the ffcalc_multi definitions on one slice of rows and store  */
+/* each result, a few thousand rows at a time.                               */
+/*---------------------------------------------------------------------------*/
+{
+   ffcalm_workdata *work = slice->work;
+   ParseData *lParse = slice->lParse;
+   long firstrow = slice->firstrow, remain = slice->nrows, ntodo;
+   int ii;
+
+   while( remain && !lParse->status ) {
+      ntodo = minvalue( remain, 10000 );
+      Evaluate_Parser( lParse, firstrow, ntodo );
+      firstrow += ntodo;
+      remain   -= ntodo;
+
+      for( ii=0; ii<work->nDefs && !lParse->status; ii++ )
+         workfn_store( lParse, lParse->Nodes + work->root[ii],
+                       work->resType[ii], slice->pv+ii, ntodo,
+                       slice->anyNull+ii );
+   }
+}
+
+#ifdef _REENTRANT
+/*---------------------------------------------------------------------------*/
+static void *calc_multi_thread( void *userPtr ) /* IO- ffcalm_slice          */
+{
+   calc_multi_rows( (ffcalm_slice *)userPtr );
+   return( NULL );
+}
+#endif
+
+/*---------------------------------------------------------------------------*/
+static void calc_multi_slices( ffcalm_slice *slice, /* IO- Slices of rows    */
+                               int nSlices )        /* I - Number of slices  */
+/*                                                                           */
+/* Evaluate every slice but the first on a thread of its own, each with a    */
+/* private copy of the Nodes, while the calling thread does the first one.   */
+/* A slice whose thread cannot be started is evaluated here afterwards.      */
+/*---------------------------------------------------------------------------*/
+{
+   ParseData *lParse = slice[0].lParse;
+   int kk;
+
+   for( kk=1; kk<nSlices; kk++ ) {
+      slice[kk].copy = *lParse;
+      slice[kk].copy.Nodes = (Node *)malloc( lParse->nNodes * sizeof(Node) );
+      if( !slice[kk].copy.Nodes ) {
+         ffpmsg("memory allocation failed (ffcalc_multi)");
+         slice[kk].copy.status = MEMORY_ALLOCATION;
+      } else
+         memcpy( slice[kk].copy.Nodes, lParse->Nodes,
+                 lParse->nNodes * sizeof(Node) );
+      slice[kk].lParse = &slice[kk].copy;
+#ifdef _REENTRANT
+      if( slice[kk].copy.Nodes )
+         slice[kk].started = !pthread_create( &slice[kk].thread, NULL,
+                                              calc_multi_thread, slice+kk );
+#endif
+   }
+
+   calc_multi_rows( slice );
+
+   for( kk=1; kk<nSlices; kk++ ) {
+#ifdef _REENTRANT
+      if( slice[kk].started ) {
+         pthread_join( slice[kk].thread, NULL );
+         continue;
+      }
+#endif
+      calc_multi_rows( slice+kk );
+   }
+}
+
+#ifdef _REENTRANT
+/*---------------------------------------------------------------------------*/
+static int calc_threads( void )
+/*                                                                           */
+/* Number of threads ffcalc_multi may use: the CFITSIO_CALC_THREADS          */
+/* environment variable if set, or else the number of processors online,    */
+/* at most CALC_MAX_THREADS.                                                 */
+/*---------------------------------------------------------------------------*/
+{
+   char *env;
+   long n = 1;
+
+   env = getenv("CFITSIO_CALC_THREADS");
+   if( env && *env )
+      n = strtol( env, NULL, 10 );
+#ifdef _SC_NPROCESSORS_ONLN
+   else
+      n = sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+   if( n<1 ) n = 1;
+   if( n>CALC_MAX_THREADS ) n = CALC_MAX_THREADS;
+   return( (int)n );
+}
+#endif
+
 /*--------------------------------------------------------------------------*/
 int fftexp( fitsfile *fptr,      /* I - Input FITS file                     */
             char     *expr,      /* I - Arithmetic expression               */
@@ -792,6 +1401,34 @@ int fftexp( fitsfile *fptr,      /* I - Input FITS file                     */
 }
 
 
+/*--------------------------------------------------------------------------*/
+static void seed_random( ParseData *lParse )
+/*                                                                          */
+/* Give a newly parsed expression its own random number stream, used by    */
+/* its random(), randomn() and randomp() functions.  Expressions evaluated  */
+/* in different threads therefore never share generator state.  The seed   */
+/* is taken from the CFITSIO_RANDOM_SEED environment variable, if set, or   */
+/* else from the clock, and is mixed with the number of expressions parsed  */
+/* so far so that each expression draws a different sequence.              */
+/*--------------------------------------------------------------------------*/
+{
+   static unsigned int nStreams = 0;
+   unsigned int seed, stream;
+   char *env;
+
+   env = getenv("CFITSIO_RANDOM_SEED");
+   if( env && *env )
+      seed = (unsigned int) strtoul( env, NULL, 0 );
+   else
+      seed = (unsigned int) time( NULL );
+
+   FFLOCKSTREAM;
+   stream = nStreams++;
+   FFUNLOCKSTREAM;
+
+   simplerng_srand_r( &lParse->rng, seed + 0x9e3779b9U * stream );
+}
+
 /*--------------------------------------------------------------------------*/
 int ffiprs( fitsfile *fptr,      /* I - Input FITS file                     */
             int      compressed, /* I - Is FITS file hkunexpanded?          */
@@ -808,15 +1445,46 @@ int ffiprs( fitsfile *fptr,      /* I - Input FITS file                     */
 /* produces.                                                                */
 /*--------------------------------------------------------------------------*/
 {
-   Node *result;
-   int  i,lexpr, tstatus = 0;
-   int xaxis, bitpix;
+   if( *status ) return( *status );
+
+   if( init_parser( fptr, compressed, lParse, status ) ) return( *status );
+   if( parse_expr( lParse, expr, status ) ) return( *status );
+
+   /*  Merge common subexpressions and simplify before evaluating  */
+
+   Optimize_Parser( lParse );
+   if( (*status = lParse->status) ) return(*status);
+
+   if( !lParse->nCols ) {
+     lParse->colData = (iteratorCol *) malloc(sizeof(iteratorCol));
+     if (lParse->colData == 0) {
+       ffpmsg("memory allocation failed (ffiprs)");
+       return( *status = MEMORY_ALLOCATION );
+     }
+     /* This allows iterator to know value of */ 
+     /* fptr when no columns are referenced   */
+     memset(lParse->colData, 0, sizeof(iteratorCol));
+     lParse->colData[0].fptr = fptr;
+   }
+
+   return( result_info( lParse, maxdim, datatype, nelem, naxis, naxes,
+                        status ) );
+}
+
+/*--------------------------------------------------------------------------*/
+static int init_parser( fitsfile *fptr,      /* I - Input FITS file         */
+                        int      compressed, /* I - hkunexpanded file?      */
+                        ParseData *lParse,   /* O - parser status           */
+                        int      *status )   /* O - Error status            */
+/*                                                                          */
+/* Clear lParse and attach it to the current HDU of fptr, ready for one or  */
+/* more expressions to be parsed into it by parse_expr.                     */
+/*--------------------------------------------------------------------------*/
+{
+   int i, xaxis, bitpix, tstatus = 0;
    long xaxes[9];
-   yyscan_t yylex_scanner; /* Used internally by FLEX lexer */
    PixelFilter *pixFilter = 0;
 
-   if( *status ) return( *status );
-
    /* make sure all internal structures for this HDU are current */
    if ( ffrdef(fptr, status) ) return(*status);
 
@@ -840,6 +1508,7 @@ int ffiprs( fitsfile *fptr,      /* I - Input FITS file                     */
    lParse->nNodes     = 0;
    lParse->hdutype    = 0;
    lParse->status     = 0;
+   seed_random( lParse );
 
    fits_get_hdu_type(fptr, &(lParse->hdutype), status );
 
@@ -861,7 +1530,20 @@ int ffiprs( fitsfile *fptr,      /* I - Input FITS file                     */
       /* this might be a 1D or null image with no NAXIS2 keyword */
       lParse->totalRows = 0;
    } 
-   
+   return( *status );
+}
+
+/*--------------------------------------------------------------------------*/
+static int parse_expr( ParseData *lParse, /* IO- parser status              */
+                       char     *expr,    /* I - Arithmetic expression      */
+                       int      *status ) /* O - Error status               */
+/*                                                                          */
+/* Parse expr, adding its Nodes and columns to any already in lParse, and   */
+/* leave the index of its final node in lParse->resultNode.                 */
+/*--------------------------------------------------------------------------*/
+{
+   int  lexpr;
+   yyscan_t yylex_scanner; /* Used internally by FLEX lexer */
 
    /*  Copy expression into parser... read from file if necessary  */
 
@@ -877,6 +1559,7 @@ int ffiprs( fitsfile *fptr,      /* I - Input FITS file                     */
    strcat(lParse->expr + lexpr,"\n");
    lParse->index    = 0;
    lParse->is_eobuf = 0;
+   lParse->resultNode = -1;
 
    /*  Parse the expression, building the Nodes and determing  */
    /*  which columns are needed and what data type is returned  */
@@ -886,27 +1569,37 @@ int ffiprs( fitsfile *fptr,      /* I - Input FITS file                     */
    *status = fits_parser_yyparse(yylex_scanner, lParse);
    fits_parser_yylex_destroy(yylex_scanner);
 
+   FREE(lParse->expr);
+   lParse->expr = NULL;
+
    if( *status  ) return( *status = PARSE_SYNTAX_ERR );
 
    /*  Check results  */
    *status = lParse->status;
    if( *status ) return(*status);
 
-   if( !lParse->nNodes ) {
+   if( lParse->resultNode<0 ) {
       ffpmsg("Blank expression");
       return( *status = PARSE_SYNTAX_ERR );
    }
-   if( !lParse->nCols ) {
-     lParse->colData = (iteratorCol *) malloc(sizeof(iteratorCol));
-     if (lParse->colData == 0) {
-       ffpmsg("memory allocation failed (ffiprs)");
-       return( *status = MEMORY_ALLOCATION );
-     }
-     /* This allows iterator to know value of */ 
-     /* fptr when no columns are referenced   */
-     memset(lParse->colData, 0, sizeof(iteratorCol));
-     lParse->colData[0].fptr = fptr;
-   }
+   return( *status );
+}
+
+/*--------------------------------------------------------------------------*/
+static int result_info( ParseData *lParse, /* IO- parser status             */
+                        int      maxdim,   /* I - Max Dimension of naxes    */
+                        int      *datatype,/* O - Data type of result       */
+                        long     *nelem,   /* O - Vector length of result   */
+                        int      *naxis,   /* O - # of dimensions of result */
+                        long     *naxes,   /* O - Size of each dimension    */
+                        int      *status ) /* O - Error status              */
+/*                                                                          */
+/* Describe the result of the expression whose final node is resultNode;   */
+/* nelem is returned negative if the result is a constant.                  */
+/*--------------------------------------------------------------------------*/
+{
+   Node *result;
+   int  i;
 
    result = lParse->Nodes + lParse->resultNode;
 
@@ -938,7 +1631,6 @@ int ffiprs( fitsfile *fptr,      /* I - Input FITS file                     */
       break;
    }
    lParse->datatype = *datatype;
-   FREE(lParse->expr);
 
    if( result->operation==CONST_OP ) *nelem = - *nelem;
    return(*status);
@@ -984,149 +1676,503 @@ void ffcprs( ParseData *lParse )
    }
    if( lParse->Nodes ) free( lParse->Nodes );
    lParse->Nodes = NULL;
+   if( lParse->resultNodes ) free( lParse->resultNodes );
+   lParse->resultNodes  = NULL;
+   lParse->nResultNodes = 0;
 
    lParse->hdutype = ANY_HDU;
    lParse->pixFilter = 0;
    lParse->nDataRows = lParse->nPrevDataRows = 0;
 }
 
-/*---------------------------------------------------------------------------*/
-int fits_parser_workfn( long    totalrows,     /* I - Total rows to be processed     */
-                long    offset,        /* I - Number of rows skipped at start*/
-                long    firstrow,      /* I - First row of this iteration    */
-                long    nrows,         /* I - Number of rows in this iter    */
-                int      nCols,        /* I - Number of columns in use       */
-                iteratorCol *colData,  /* IO- Column information/data        */
-                void    *userPtr )     /* I - Data handling instructions     */
-/*                                                                           */
-/* Iterator work function which calls the parser and copies the results      */
-/* into either an OutputCol or a data pointer supplied in the userPtr        */
-/* structure.                                                                */
-/*---------------------------------------------------------------------------*/
+/*--------------------------------------------------------------------------*/
+static void Reset_State( ParseData *lParse )
+/*                                                                          */
+/* Clear the running totals kept by ACCUM and SEQDIFF between batches, so   */
+/* that a parsed expression can be evaluated again from the start.          */
+/*--------------------------------------------------------------------------*/
 {
-    int status, constant=0, anyNullThisTime=0;
-    long jj, kk, idx, remain, ntodo;
-    Node *result;
-    iteratorCol * outcol;
-    ParseData *lParse = ((parseInfo*)userPtr)->parseData;
-    struct ParseStatusVariables *pv = &( ((parseInfo*)userPtr)->parseVariables );
-    void *Data0 = 0;
+   int node;
+   Node *state;
+
+   for( node=0; node<lParse->nNodes; node++ ) {
+      if( lParse->Nodes[node].operation!=ACCUM
+          && lParse->Nodes[node].operation!=DIFF ) continue;
+      state = lParse->Nodes + lParse->Nodes[node].SubNodes[1];
+      if( state->type==DOUBLE )
+         state->value.data.dbl = 0.0;
+      else
+         state->value.data.lng = 0;
+      state->value.undef = NULL;
+   }
+}
 
-    /* declare variables static to preserve their values between calls */
-    long zeros[4] = {0,0,0,0};
+/*--------------------------------------------------------------------------*/
+int ffcexp( fitsfile *fptr,      /* I - FITS file to compile against        */
+            char     *expr,      /* I - Arithmetic or boolean expression    */
+            fitsexpr **cexpr,    /* O - Compiled expression                 */
+            int      *status )   /* O - Error status                        */
+/*                                                                          */
+/* Parse an expression once, bound to the table in the current HDU of fptr, */
+/* so that it can be evaluated many times with fffrwx, ffsrwx or ffcrwx     */
+/* without re-parsing it.  Use ffbexp to bind it to another table of the    */
+/* same layout, and fffexp to release it.                                   */
+/*--------------------------------------------------------------------------*/
+{
+   fitsexpr *ce;
 
-    if (DEBUG_PIXFILTER)
-       printf("fits_parser_workfn(total=%ld, offset=%ld, first=%ld, rows=%ld, cols=%d)\n",
-                totalrows, offset, firstrow, nrows, nCols);
-    /*--------------------------------------------------------*/
-    /*  Initialization procedures: execute on the first call  */
-    /*--------------------------------------------------------*/
-    outcol = colData + (nCols - 1);
-    if (firstrow == offset+1)
-    {
-       (pv->userInfo) = (parseInfo*)userPtr;
-       (pv->userInfo)->anyNull = 0;
+   *cexpr = NULL;
+   if( *status ) return( *status );
 
-       /* Unfortunately there are two copies of the iterator columns,
-	  one inside the parser and one outside maintained by the
-	  higher level.  (This could happen if the histogramming
-	  routines are binning multiple columns, and so there are
-	  multiple parsers being managed at one time.) Upon the first
-	  call we make sure they match */
-       for (jj = 0; jj<nCols; jj++) {
-	 lParse->colData[jj].repeat = colData[jj].repeat;
-       }
+   ce = (fitsexpr*)calloc( 1, sizeof(fitsexpr) );
+   if( ce ) ce->expr = (char*)malloc( strlen(expr)+1 );
+   if( !ce || !ce->expr ) {
+      if( ce ) free( ce );
+      ffpmsg("memory allocation failed (ffcexp)");
+      return( *status = MEMORY_ALLOCATION );
+   }
+   strcpy( ce->expr, expr );
 
-       if( (pv->userInfo)->maxRows>0 )
-          (pv->userInfo)->maxRows = minvalue(totalrows,(pv->userInfo)->maxRows);
-       else if( (pv->userInfo)->maxRows<0 )
-          (pv->userInfo)->maxRows = totalrows;
-       else
-          (pv->userInfo)->maxRows = nrows;
+   if( ffbexp( ce, fptr, status ) ) {
+      fffexp( ce, status );
+      return( *status );
+   }
 
-       (pv->lastRow) = firstrow + (pv->userInfo)->maxRows - 1;
+   *cexpr = ce;
+   return( *status );
+}
 
-       /* dataPtr == NULL indicates an iterator-derived column, which
-	  means that the first value will be a null value and the remaining
-	  values will be the where the outputs are placed */
-       if( (pv->userInfo)->dataPtr==NULL ) {
+/*--------------------------------------------------------------------------*/
+int ffbexp( fitsexpr *cexpr,     /* I - Compiled expression                 */
+            fitsfile *fptr,      /* I - FITS file to bind the expression to */
+            int      *status )   /* O - Error status                        */
+/*                                                                          */
+/* Bind a compiled expression to the table in the current HDU of fptr.  If  */
+/* every column the expression uses exists in the new table with the same   */
+/* data type and dimensions, only the column numbers are looked up again;   */
+/* otherwise the expression is re-parsed against the new table.  The result */
+/* type of the expression may therefore change when it is rebound.          */
+/*--------------------------------------------------------------------------*/
+{
+   ParseData *lParse;
+   DataInfo varInfo;
+   iteratorCol colIter;
+   int col, colnum, typecode, hdutype, naxis, datatype, i, same, tstatus;
+   int node, op;
+   long repeat, width, nelem, naxes[MAXDIMS];
 
-          if( outcol->iotype == InputCol ) {
-             ffpmsg("Output column for parser results not found!");
-             return( PARSE_NO_OUTPUT );
-          }
-          /* Data gets set later */
-          (pv->Null) = outcol->array;
-          (pv->userInfo)->datatype = outcol->datatype;
+   if( *status ) return( *status );
+   if( !cexpr ) {
+      ffpmsg("Null compiled expression pointer (ffbexp)");
+      return( *status = NULL_INPUT_PTR );
+   }
+   lParse = &cexpr->lParse;
+
+   if( ffrdef(fptr, status) ) return( *status );
+   if( fits_get_hdu_type(fptr, &hdutype, status) ) return( *status );
+
+   same = ( cexpr->bound && cexpr->rebind && hdutype!=IMAGE_HDU );
+   if( same ) {
+      lParse->hdutype = hdutype;
+      ffpmrk();
+      for( col=0; same && col<lParse->nCols; col++ ) {
+         tstatus = 0;
+         memset( &varInfo, 0, sizeof(varInfo) );
+         memset( &colIter, 0, sizeof(colIter) );
+         if( fits_get_colnum( fptr, CASEINSEN, lParse->varData[col].name,
+                              &colnum, &tstatus )
+             || fits_get_coltype( fptr, colnum, &typecode, &repeat, &width,
+                                  &tstatus )
+             || set_table_col_types( lParse, fptr, colnum, typecode, repeat,
+                                     width, &varInfo, &colIter ) ) {
+            same = 0;
+            break;
+         }
+         if( varInfo.type  != lParse->varData[col].type
+             || varInfo.nelem != lParse->varData[col].nelem
+             || varInfo.naxis != lParse->varData[col].naxis ) {
+            same = 0;
+            break;
+         }
+         for( i=0; i<varInfo.naxis; i++ )
+            if( varInfo.naxes[i] != lParse->varData[col].naxes[i] ) same = 0;
+         if( same ) {
+            fits_iter_set_by_num( lParse->colData+col, fptr, colnum, 0,
+                                  InputCol );
+            lParse->colData[col].datatype = colIter.datatype;
+            lParse->colData[col].repeat   = 0;
+         }
+      }
+      ffcmrk();
+      lParse->status = 0;
+   }
 
-          /* Check for a TNULL/BLANK keyword for output column/image */
+   if( same ) {
 
-          status = 0;
-          (pv->jnull) = 0;
-          if (lParse->hdutype == IMAGE_HDU) {
-             if (lParse->pixFilter->blank)
-                (pv->jnull) = (LONGLONG) lParse->pixFilter->blank;
-          }
-          else {
-	    if (outcol->iotype != TemporaryCol) {
-	      ffgknjj( outcol->fptr, "TNULL", outcol->colnum,
-		       1, &(pv->jnull), (int*)&jj, &status );
-	    }
+      /*  Fast path: the parse tree is unchanged, just point it at fptr  */
 
-             if( status==BAD_INTKEY || outcol->iotype == TemporaryCol) {
-                /*  Probably ASCII table with text TNULL keyword  */
-                switch( (pv->userInfo)->datatype ) {
-                   case TSHORT:  (pv->jnull) = (LONGLONG) SHRT_MIN;      break;
-                   case TINT:    (pv->jnull) = (LONGLONG) INT_MIN;       break;
-                   case TLONG:   (pv->jnull) = (LONGLONG) LONG_MIN;      break;
-                }
-             }
-          }
-          (pv->repeat) = outcol->repeat;
-/*
-          if (DEBUG_PIXFILTER)
-            printf("fits_parser_workfn: using null value %ld\n", (pv->jnull));
-*/
-       } else {
+      lParse->def_fptr = fptr;
+      if( !lParse->nCols ) lParse->colData[0].fptr = fptr;
+      tstatus = 0;
+      if( ffgkyj(fptr, "NAXIS2", &lParse->totalRows, 0, &tstatus) )
+         lParse->totalRows = 0;
 
-	  /* This clause applies if the user is passing user-allocated 
-	     data arrays, which is where the data will be placed.  This 
-	     means they should also be passing null values */
-          (pv->Data) = (pv->userInfo)->dataPtr;
-          (pv->Null) = ((pv->userInfo)->nullPtr ? (pv->userInfo)->nullPtr : zeros);
-          (pv->repeat) = lParse->Nodes[lParse->resultNode].value.nelem;
+   } else {
 
-       }
+      if( cexpr->bound ) ffcprs( lParse );
+      cexpr->bound = 0;
+      lParse->pixFilter = 0;
+      if( ffiprs( fptr, 0, cexpr->expr, MAXDIMS, &datatype, &nelem, &naxis,
+                  naxes, lParse, status ) ) {
+         ffcprs( lParse );
+         return( *status );
+      }
+      cexpr->bound = 1;
 
-       /* Determine the size of each element of the returned result */
+      /*  Expressions reading header keywords, GTIs or regions from the  */
+      /*  HDU hold results that depend on it, so they must be parsed     */
+      /*  again when they are bound to another HDU.                      */
 
-       switch( (pv->userInfo)->datatype ) {
-       case TBIT:       /*  Fall through to TBYTE  */
-       case TLOGICAL:   /*  Fall through to TBYTE  */
-       case TBYTE:     (pv->datasize) = sizeof(char);     break;
-       case TSHORT:    (pv->datasize) = sizeof(short);    break;
-       case TINT:      (pv->datasize) = sizeof(int);      break;
-       case TLONG:     (pv->datasize) = sizeof(long);     break;
-       case TLONGLONG: (pv->datasize) = sizeof(LONGLONG); break;
-       case TFLOAT:    (pv->datasize) = sizeof(float);    break;
-       case TDOUBLE:   (pv->datasize) = sizeof(double);   break;
-       case TSTRING:   (pv->datasize) = sizeof(char*);    break;
-       }
+      cexpr->rebind = ( lParse->nKeywds==0 && lParse->hdutype!=IMAGE_HDU );
+      for( node=0; node<lParse->nNodes; node++ ) {
+         op = lParse->Nodes[node].operation;
+         if( op==gtifilt_fct || op==regfilt_fct
+             || op==gtiover_fct || op==gtifind_fct ) cexpr->rebind = 0;
+      }
+   }
+   return( *status );
+}
+
+/*--------------------------------------------------------------------------*/
+int fftcex( fitsexpr *cexpr,     /* I - Compiled expression                 */
+            int      maxdim,     /* I - Max Dimension of naxes              */
+            int      *datatype,  /* O - Data type of result                 */
+            long     *nelem,     /* O - Vector length of result             */
+            int      *naxis,     /* O - # of dimensions of result           */
+            long     *naxes,     /* O - Size of each dimension              */
+            int      *status )   /* O - Error status                        */
+/*                                                                          */
+/* Return information on the result of a compiled expression, as fftexp.    */
+/*--------------------------------------------------------------------------*/
+{
+   ParseData *lParse;
+   int i;
+
+   if( *status ) return( *status );
+   if( !cexpr || !cexpr->bound ) {
+      ffpmsg("Compiled expression is not bound to a table (fftcex)");
+      return( *status = NULL_INPUT_PTR );
+   }
+   lParse = &cexpr->lParse;
+
+   *datatype = lParse->datatype;
+   *naxis    = lParse->nAxis;
+   *nelem    = lParse->nElements;
+   for( i=0; i<*naxis && i<maxdim; i++ )
+      naxes[i] = lParse->nAxes[i];
+   if( lParse->Nodes[lParse->resultNode].operation==CONST_OP )
+      *nelem = - *nelem;
+   return( *status );
+}
+
+/*--------------------------------------------------------------------------*/
+int fffrwx( fitsexpr *cexpr,        /* I - Compiled boolean expression      */
+            long     firstrow,      /* I - First row of table to eval       */
+            long     nrows,         /* I - Number of rows to evaluate       */
+            long     *n_good_rows,  /* O - Number of rows eval to True      */
+            char     *row_status,   /* O - Array of boolean results         */
+            int      *status )      /* O - Error status                     */
+/*                                                                          */
+/* fffrow for a compiled expression, on the table it is bound to.          */
+/*--------------------------------------------------------------------------*/
+{
+   if( *status ) return( *status );
+   if( !cexpr || !cexpr->bound ) {
+      ffpmsg("Compiled expression is not bound to a table (fffrwx)");
+      return( *status = NULL_INPUT_PTR );
+   }
+
+   return find_rows( &cexpr->lParse, firstrow, nrows, n_good_rows,
+                     row_status, status );
+}
+
+/*--------------------------------------------------------------------------*/
+int ffsrwx( fitsexpr *cexpr,     /* I - Compiled boolean expression         */
+            fitsfile *outfptr,   /* I - Output FITS file                    */
+            int      *status )   /* O - Error status                        */
+/*                                                                          */
+/* ffsrow for a compiled expression, selecting rows from the table it is    */
+/* bound to.                                                                */
+/*--------------------------------------------------------------------------*/
+{
+   if( *status ) return( *status );
+   if( !cexpr || !cexpr->bound ) {
+      ffpmsg("Compiled expression is not bound to a table (ffsrwx)");
+      return( *status = NULL_INPUT_PTR );
+   }
+
+   return select_rows( &cexpr->lParse, outfptr, status );
+}
 
-       /* Determine the size of each element of the calculated result */
-       /*   (only matters for numeric/logical data)                   */
+/*--------------------------------------------------------------------------*/
+int ffcrwx( fitsexpr *cexpr,     /* I - Compiled expression                 */
+            int      datatype,   /* I - Datatype to return results as       */
+            long     firstrow,   /* I - First row to evaluate               */
+            long     nelements,  /* I - Number of elements to return        */
+            void     *nulval,    /* I - Ptr to value to use as UNDEF        */
+            void     *array,     /* O - Array of results                    */
+            int      *anynul,    /* O - Were any UNDEFs encountered?        */
+            int      *status )   /* O - Error status                        */
+/*                                                                          */
+/* ffcrow for a compiled expression, on the table it is bound to.          */
+/*--------------------------------------------------------------------------*/
+{
+   if( *status ) return( *status );
+   if( !cexpr || !cexpr->bound ) {
+      ffpmsg("Compiled expression is not bound to a table (ffcrwx)");
+      return( *status = NULL_INPUT_PTR );
+   }
+
+   return calc_rows( &cexpr->lParse, datatype, firstrow, nelements, nulval,
+                     array, anynul, status );
+}
+
+/*--------------------------------------------------------------------------*/
+int fffexp( fitsexpr *cexpr,     /* I - Compiled expression                 */
+            int      *status )   /* IO - Error status                       */
+/*                                                                          */
+/* Release a compiled expression.  This is done even if *status is set, so  */
+/* that it may be called during error cleanup.                              */
+/*--------------------------------------------------------------------------*/
+{
+   if( !cexpr ) return( *status );
+
+   if( cexpr->bound ) ffcprs( &cexpr->lParse );
+   if( cexpr->expr ) free( cexpr->expr );
+   free( cexpr );
+   return( *status );
+}
+
+/*---------------------------------------------------------------------------*/
+int fits_parser_workfn( long    totalrows,     /* I - Total rows to be processed     */
+                long    offset,        /* I - Number of rows skipped at start*/
+                long    firstrow,      /* I - First row of this iteration    */
+                long    nrows,         /* I - Number of rows in this iter    */
+                int      nCols,        /* I - Number of columns in use       */
+                iteratorCol *colData,  /* IO- Column information/data        */
+                void    *userPtr )     /* I - Data handling instructions     */
+/*                                                                           */
+/* Iterator work function which calls the parser and copies the results      */
+/* into either an OutputCol or a data pointer supplied in the userPtr        */
+/* structure.                                                                */
+/*---------------------------------------------------------------------------*/
+{
+    int status, anyNullThisTime=0;
+    long jj, remain, ntodo;
+    iteratorCol * outcol;
+    parseInfo *userInfo = (parseInfo*)userPtr;
+    ParseData *lParse = userInfo->parseData;
+    struct ParseStatusVariables *pv = &( userInfo->parseVariables );
+    void *Data0 = 0;
 
-       switch( lParse->Nodes[lParse->resultNode].type ) {
-       case BOOLEAN:   (pv->resDataSize) = sizeof(char);    break;
-       case LONG:      (pv->resDataSize) = sizeof(long);    break;
-       case DOUBLE:    (pv->resDataSize) = sizeof(double);  break;
+    if (DEBUG_PIXFILTER)
+       printf("fits_parser_workfn(total=%ld, offset=%ld, first=%ld, rows=%ld, cols=%d)\n",
+                totalrows, offset, firstrow, nrows, nCols);
+    /*--------------------------------------------------------*/
+    /*  Initialization procedures: execute on the first call  */
+    /*--------------------------------------------------------*/
+    /*  An expression using no columns has no output column either  */
+    outcol = ( nCols > 0 ? colData + (nCols - 1) : NULL );
+    if (firstrow == offset+1)
+    {
+       /* Unfortunately there are two copies of the iterator columns,
+	  one inside the parser and one outside maintained by the
+	  higher level.  (This could happen if the histogramming
+	  routines are binning multiple columns, and so there are
+	  multiple parsers being managed at one time.) Upon the first
+	  call we make sure they match */
+       for (jj = 0; jj<nCols; jj++) {
+	 lParse->colData[jj].repeat = colData[jj].repeat;
        }
+
+       status = workfn_init( lParse, lParse->resultNode, userInfo, outcol,
+                             totalrows, firstrow, nrows );
+       if( status ) return( status );
     }
 
     /*-------------------------------------------*/
     /*  Main loop: process all the rows of data  */
     /*-------------------------------------------*/
 
+    workfn_nulls( userInfo, outcol );
+
+    /* Alter nrows in case calling routine didn't want to do all rows */
+
+    Data0 = pv->Data; /* Record starting point */
+    nrows = minvalue(nrows,(pv->lastRow)-firstrow+1);
+
+    Setup_DataArrays( lParse, nCols, colData, firstrow, nrows );
+
+    /* Parser allocates arrays for each column and calculation it performs. */
+    /* Limit number of rows processed during each pass to reduce memory     */
+    /* requirements... In most cases, iterator will limit rows to less      */
+    /* than 10000 rows per iteration, so this is really only relevant for    */
+    /* hk-compressed files which must be decompressed in memory and sent    */
+    /* whole to fits_parser_workfn in a single iteration.                           */
+
+    remain = nrows;
+    while( remain ) {
+       ntodo = minvalue(remain,10000);
+       Evaluate_Parser ( lParse, firstrow, ntodo );
+       if( lParse->status ) break;
+
+       firstrow += ntodo;
+       remain   -= ntodo;
+
+       /*  Copy results into data array  */
+
+       workfn_store( lParse, lParse->Nodes + lParse->resultNode,
+                     lParse->datatype, pv, ntodo, &anyNullThisTime );
+       if( lParse->status ) break;
+    }
+
+    workfn_done( userInfo, outcol, Data0, anyNullThisTime );
+
+    /*-------------------------------------------------------*/
+    /*  Clean up procedures:  after processing all the rows  */
+    /*-------------------------------------------------------*/
+
+    /*  if the calling routine specified that only a limited number    */
+    /*  of rows in the table should be processed, return a value of -1 */
+    /*  once all the rows have been done, if no other error occurred.  */
+
+    if (lParse->hdutype != IMAGE_HDU && firstrow - 1 == (pv->lastRow)) {
+           if (!lParse->status && (pv->userInfo)->maxRows<totalrows) {
+                  return (-1);
+           }
+    }
+
+    return(lParse->status);  /* return successful status */
+}
+
+/*---------------------------------------------------------------------------*/
+static int workfn_init( ParseData *lParse,   /* I - Parsed expression        */
+                        int   resultNode,    /* I - Node holding the result  */
+                        parseInfo *userInfo, /* IO- Data handling info       */
+                        iteratorCol *outcol, /* I - Output column            */
+                        long  totalrows,     /* I - Total rows to process    */
+                        long  firstrow,      /* I - First row of this pass   */
+                        long  nrows )        /* I - Rows in this pass        */
+/*                                                                           */
+/* First call of an iterator work function: work out where the results of   */
+/* resultNode go, the null value to use there and the size of each element. */
+/*---------------------------------------------------------------------------*/
+{
+    int status;
+    long jj;
+    struct ParseStatusVariables *pv = &( userInfo->parseVariables );
+
+    (pv->userInfo) = userInfo;
+    (pv->userInfo)->anyNull = 0;
+
+    if( (pv->userInfo)->maxRows>0 )
+       (pv->userInfo)->maxRows = minvalue(totalrows,(pv->userInfo)->maxRows);
+    else if( (pv->userInfo)->maxRows<0 )
+       (pv->userInfo)->maxRows = totalrows;
+    else
+       (pv->userInfo)->maxRows = nrows;
+
+    (pv->lastRow) = firstrow + (pv->userInfo)->maxRows - 1;
+
+    /* dataPtr == NULL indicates an iterator-derived column, which
+	  means that the first value will be a null value and the remaining
+	  values will be the where the outputs are placed */
+    if( (pv->userInfo)->dataPtr==NULL ) {
+
+       if( outcol->iotype == InputCol ) {
+          ffpmsg("Output column for parser results not found!");
+          return( PARSE_NO_OUTPUT );
+       }
+       /* Data gets set later */
+       (pv->Null) = outcol->array;
+       (pv->userInfo)->datatype = outcol->datatype;
+
+       /* Check for a TNULL/BLANK keyword for output column/image */
+
+       status = 0;
+       (pv->jnull) = 0;
+       if (lParse->hdutype == IMAGE_HDU) {
+          if (lParse->pixFilter->blank)
+             (pv->jnull) = (LONGLONG) lParse->pixFilter->blank;
+       }
+       else {
+	    if (outcol->iotype != TemporaryCol) {
+	      ffgknjj( outcol->fptr, "TNULL", outcol->colnum,
+		       1, &(pv->jnull), (int*)&jj, &status );
+	    }
+
+          if( status==BAD_INTKEY || outcol->iotype == TemporaryCol) {
+             /*  Probably ASCII table with text TNULL keyword  */
+             switch( (pv->userInfo)->datatype ) {
+                case TSHORT:  (pv->jnull) = (LONGLONG) SHRT_MIN;      break;
+                case TINT:    (pv->jnull) = (LONGLONG) INT_MIN;       break;
+                case TLONG:   (pv->jnull) = (LONGLONG) LONG_MIN;      break;
+             }
+          }
+       }
+       (pv->repeat) = outcol->repeat;
+/*
+       if (DEBUG_PIXFILTER)
+         printf("fits_parser_workfn: using null value %ld\n", (pv->jnull));
+*/
+    } else {
+
+	  /* This clause applies if the user is passing user-allocated 
+	     data arrays, which is where the data will be placed.  This 
+	     means they should also be passing null values */
+       memset( pv->zeros, 0, sizeof(pv->zeros) );
+       (pv->Data) = (pv->userInfo)->dataPtr;
+       (pv->Null) = ((pv->userInfo)->nullPtr ? (pv->userInfo)->nullPtr : pv->zeros);
+       (pv->repeat) = lParse->Nodes[resultNode].value.nelem;
+
+    }
+
+    /* Determine the size of each element of the returned result */
+
+    switch( (pv->userInfo)->datatype ) {
+    case TBIT:       /*  Fall through to TBYTE  */
+    case TLOGICAL:   /*  Fall through to TBYTE  */
+    case TBYTE:     (pv->datasize) = sizeof(char);     break;
+    case TSHORT:    (pv->datasize) = sizeof(short);    break;
+    case TINT:      (pv->datasize) = sizeof(int);      break;
+    case TLONG:     (pv->datasize) = sizeof(long);     break;
+    case TLONGLONG: (pv->datasize) = sizeof(LONGLONG); break;
+    case TFLOAT:    (pv->datasize) = sizeof(float);    break;
+    case TDOUBLE:   (pv->datasize) = sizeof(double);   break;
+    case TSTRING:   (pv->datasize) = sizeof(char*);    break;
+    }
+
+    /* Determine the size of each element of the calculated result */
+    /*   (only matters for numeric/logical data)                   */
+
+    switch( lParse->Nodes[resultNode].type ) {
+    case BOOLEAN:   (pv->resDataSize) = sizeof(char);    break;
+    case LONG:      (pv->resDataSize) = sizeof(long);    break;
+    case DOUBLE:    (pv->resDataSize) = sizeof(double);  break;
+    }
+    return( 0 );
+}
+
+/*---------------------------------------------------------------------------*/
+static void workfn_nulls( parseInfo *userInfo, /* IO- Data handling info     */
+                          iteratorCol *outcol )/* I - Output column          */
+/*                                                                           */
+/* Start of each iterator pass: point Data at the first output element and,  */
+/* when writing to a column, store the null value in its 0th element.        */
+/*---------------------------------------------------------------------------*/
+{
+    struct ParseStatusVariables *pv = &( userInfo->parseVariables );
+
     /*  If writing to output column, set first element to appropriate  */
     /*  null value.  If no NULLs encounter, zero out before returning. */
 /*
@@ -1162,196 +2208,211 @@ int fits_parser_workfn( long    totalrows,     /* I - Total rows to be processed
 	 }
        }
     }
+}
 
-    /* Alter nrows in case calling routine didn't want to do all rows */
-
-    Data0 = pv->Data; /* Record starting point */
-    nrows = minvalue(nrows,(pv->lastRow)-firstrow+1);
-
-    Setup_DataArrays( lParse, nCols, colData, firstrow, nrows );
-
-    /* Parser allocates arrays for each column and calculation it performs. */
-    /* Limit number of rows processed during each pass to reduce memory     */
-    /* requirements... In most cases, iterator will limit rows to less      */
-    /* than 10000 rows per iteration, so this is really only relevant for    */
-    /* hk-compressed files which must be decompressed in memory and sent    */
-    /* whole to fits_parser_workfn in a single iteration.                           */
-
-    remain = nrows;
-    while( remain ) {
-       ntodo = minvalue(remain,10000);
-       Evaluate_Parser ( lParse, firstrow, ntodo );
-       if( lParse->status ) break;
-
-       firstrow += ntodo;
-       remain   -= ntodo;
-
-       /*  Copy results into data array  */
-
-       result = lParse->Nodes + lParse->resultNode;
-       if( result->operation==CONST_OP ) constant = 1;
-
-       switch( result->type ) {
+/*---------------------------------------------------------------------------*/
+static long workfn_rowsize( Node *result,   /* I - Node holding the result   */
+                            struct ParseStatusVariables *pv ) /* I - Output  */
+/*                                                                           */
+/* Number of bytes of output taken by each row of result.                    */
+/*---------------------------------------------------------------------------*/
+{
+    if( result->type==BITSTR && (pv->userInfo)->datatype==TBYTE )
+       return( (pv->datasize) * ( (result->value.nelem+7)/8 ) );
+    else if( result->type==STRING )
+       return( (pv->datasize) );
+    else
+       return( (pv->datasize) * (pv->repeat) );
+}
 
-       case BOOLEAN:
-       case LONG:
-       case DOUBLE:
-          if( constant ) {
-             char undef=0;
+/*---------------------------------------------------------------------------*/
+static void workfn_store( ParseData *lParse,  /* IO- Evaluated parser        */
+                          Node *result,       /* IO- Node holding the result */
+                          int  resType,       /* I - Data type of result     */
+                          struct ParseStatusVariables *pv, /* IO- Output     */
+                          long ntodo,         /* I - Rows evaluated          */
+                          int  *anyNullThisTime ) /* O - Any nulls written?  */
+/*                                                                           */
+/* Convert ntodo rows of result into the output array, advance pv->Data past */
+/* them and free the result once no other root of lParse still needs it.     */
+/*---------------------------------------------------------------------------*/
+{
+    int constant=0;
+    long jj, kk, idx;
+
+    if( result->operation==CONST_OP ) constant = 1;
+
+    switch( result->type ) {
+
+    case BOOLEAN:
+    case LONG:
+    case DOUBLE:
+       if( constant ) {
+          char undef=0;
+          for( kk=0; kk<ntodo; kk++ )
+             for( jj=0; jj<(pv->repeat); jj++ )
+                ffcvtn( resType,
+                        &(result->value.data),
+                        &undef, result->value.nelem /* 1 */,
+                        (pv->userInfo)->datatype, (pv->Null),
+                        (char*)(pv->Data) + (kk*(pv->repeat)+jj)*(pv->datasize),
+                        anyNullThisTime, &lParse->status );
+       } else {
+          if ( (pv->repeat) == result->value.nelem ) {
+             ffcvtn( resType,
+                     result->value.data.ptr,
+                     result->value.undef,
+                     result->value.nelem*ntodo,
+                     (pv->userInfo)->datatype, (pv->Null), (pv->Data),
+                     anyNullThisTime, &lParse->status );
+          } else if( result->value.nelem == 1 ) {
              for( kk=0; kk<ntodo; kk++ )
-                for( jj=0; jj<(pv->repeat); jj++ )
-                   ffcvtn( lParse->datatype,
-                           &(result->value.data),
-                           &undef, result->value.nelem /* 1 */,
-                           (pv->userInfo)->datatype, (pv->Null),
+                for( jj=0; jj<(pv->repeat); jj++ ) {
+                   ffcvtn( resType,
+                           (char*)result->value.data.ptr + kk*(pv->resDataSize),
+                           (char*)result->value.undef + kk,
+                           1, (pv->userInfo)->datatype, (pv->Null),
                            (char*)(pv->Data) + (kk*(pv->repeat)+jj)*(pv->datasize),
-                           &anyNullThisTime, &lParse->status );
+                           anyNullThisTime, &lParse->status );
+                }
           } else {
-             if ( (pv->repeat) == result->value.nelem ) {
-                ffcvtn( lParse->datatype,
-                        result->value.data.ptr,
-                        result->value.undef,
-                        result->value.nelem*ntodo,
-                        (pv->userInfo)->datatype, (pv->Null), (pv->Data),
-                        &anyNullThisTime, &lParse->status );
-             } else if( result->value.nelem == 1 ) {
-                for( kk=0; kk<ntodo; kk++ )
-                   for( jj=0; jj<(pv->repeat); jj++ ) {
-                      ffcvtn( lParse->datatype,
-                              (char*)result->value.data.ptr + kk*(pv->resDataSize),
-                              (char*)result->value.undef + kk,
-                              1, (pv->userInfo)->datatype, (pv->Null),
-                              (char*)(pv->Data) + (kk*(pv->repeat)+jj)*(pv->datasize),
-                              &anyNullThisTime, &lParse->status );
-                   }
-             } else {
-                int nCopy;
-                nCopy = minvalue( (pv->repeat), result->value.nelem );
-                for( kk=0; kk<ntodo; kk++ ) {
-                   ffcvtn( lParse->datatype,
-                           (char*)result->value.data.ptr
-                                  + kk*result->value.nelem*(pv->resDataSize),
-                           (char*)result->value.undef
-                                  + kk*result->value.nelem,
-                           nCopy, (pv->userInfo)->datatype, (pv->Null),
-                           (char*)(pv->Data) + (kk*(pv->repeat))*(pv->datasize),
-                           &anyNullThisTime, &lParse->status );
-                   if( nCopy < (pv->repeat) ) {
-                      memset( (char*)(pv->Data) + (kk*(pv->repeat)+nCopy)*(pv->datasize),
-                              0, ((pv->repeat)-nCopy)*(pv->datasize));
-                   }
+             int nCopy;
+             nCopy = minvalue( (pv->repeat), result->value.nelem );
+             for( kk=0; kk<ntodo; kk++ ) {
+                ffcvtn( resType,
+                        (char*)result->value.data.ptr
+                               + kk*result->value.nelem*(pv->resDataSize),
+                        (char*)result->value.undef
+                               + kk*result->value.nelem,
+                        nCopy, (pv->userInfo)->datatype, (pv->Null),
+                        (char*)(pv->Data) + (kk*(pv->repeat))*(pv->datasize),
+                        anyNullThisTime, &lParse->status );
+                if( nCopy < (pv->repeat) ) {
+                   memset( (char*)(pv->Data) + (kk*(pv->repeat)+nCopy)*(pv->datasize),
+                           0, ((pv->repeat)-nCopy)*(pv->datasize));
                 }
-
-             }
-             if( result->operation>0 ) {
-                FREE( result->value.data.ptr );
              }
+
           }
-          if( lParse->status==OVERFLOW_ERR ) {
-             lParse->status = NUM_OVERFLOW;
-             ffpmsg("Numerical overflow while converting expression to necessary datatype");
+          if( result->operation>0
+              && ( !result->nPending || --result->nPending==0 ) ) {
+             FREE( result->value.data.ptr );
           }
-          break;
+       }
+       if( lParse->status==OVERFLOW_ERR ) {
+          lParse->status = NUM_OVERFLOW;
+          ffpmsg("Numerical overflow while converting expression to necessary datatype");
+       }
+       break;
 
-       case BITSTR:
-          switch( (pv->userInfo)->datatype ) {
-          case TBYTE:
-             idx = -1;
-             for( kk=0; kk<ntodo; kk++ ) {
-                for( jj=0; jj<result->value.nelem; jj++ ) {
-                   if( jj%8 == 0 )
-                      ((char*)(pv->Data))[++idx] = 0;
-                   if( constant ) {
-                      if( result->value.data.str[jj]=='1' )
-                         ((char*)(pv->Data))[idx] |= 128>>(jj%8);
-                   } else {
-                      if( result->value.data.strptr[kk][jj]=='1' )
-                         ((char*)(pv->Data))[idx] |= 128>>(jj%8);
-                   }
+    case BITSTR:
+       switch( (pv->userInfo)->datatype ) {
+       case TBYTE:
+          idx = -1;
+          for( kk=0; kk<ntodo; kk++ ) {
+             for( jj=0; jj<result->value.nelem; jj++ ) {
+                if( jj%8 == 0 )
+                   ((char*)(pv->Data))[++idx] = 0;
+                if( constant ) {
+                   if( result->value.data.str[jj]=='1' )
+                      ((char*)(pv->Data))[idx] |= 128>>(jj%8);
+                } else {
+                   if( result->value.data.strptr[kk][jj]=='1' )
+                      ((char*)(pv->Data))[idx] |= 128>>(jj%8);
                 }
              }
-             break;
-          case TBIT:
-          case TLOGICAL:
-             if( constant ) {
-                for( kk=0; kk<ntodo; kk++ )
-                   for( jj=0; jj<result->value.nelem; jj++ ) {
-                      ((char*)(pv->Data))[ jj+kk*result->value.nelem ] =
-                         ( result->value.data.str[jj]=='1' );
-                   }
-             } else {
-                for( kk=0; kk<ntodo; kk++ )
-                   for( jj=0; jj<result->value.nelem; jj++ ) {
-                      ((char*)(pv->Data))[ jj+kk*result->value.nelem ] =
-                         ( result->value.data.strptr[kk][jj]=='1' );
-                   }
-             }
-             break; 
-          case TSTRING:
-             if( constant ) {
-                for( jj=0; jj<ntodo; jj++ ) {
-                   strcpy( ((char**)(pv->Data))[jj], result->value.data.str );
+          }
+          break;
+       case TBIT:
+       case TLOGICAL:
+          if( constant ) {
+             for( kk=0; kk<ntodo; kk++ )
+                for( jj=0; jj<result->value.nelem; jj++ ) {
+                   ((char*)(pv->Data))[ jj+kk*result->value.nelem ] =
+                      ( result->value.data.str[jj]=='1' );
                 }
-             } else {
-                for( jj=0; jj<ntodo; jj++ ) {
-                   strcpy( ((char**)(pv->Data))[jj], result->value.data.strptr[jj] );
+          } else {
+             for( kk=0; kk<ntodo; kk++ )
+                for( jj=0; jj<result->value.nelem; jj++ ) {
+                   ((char*)(pv->Data))[ jj+kk*result->value.nelem ] =
+                      ( result->value.data.strptr[kk][jj]=='1' );
                 }
-             }
-             break;
-          default:
-             ffpmsg("Cannot convert bit expression to desired type.");
-             lParse->status = PARSE_BAD_TYPE;
-             break;
           }
-          if( result->operation>0 ) {
-             FREE( result->value.data.strptr[0] );
-             FREE( result->value.data.strptr );
+          break; 
+       case TSTRING:
+          if( constant ) {
+             for( jj=0; jj<ntodo; jj++ ) {
+                strcpy( ((char**)(pv->Data))[jj], result->value.data.str );
+             }
+          } else {
+             for( jj=0; jj<ntodo; jj++ ) {
+                strcpy( ((char**)(pv->Data))[jj], result->value.data.strptr[jj] );
+             }
           }
           break;
+       default:
+          ffpmsg("Cannot convert bit expression to desired type.");
+          lParse->status = PARSE_BAD_TYPE;
+          break;
+       }
+       if( result->operation>0
+           && ( !result->nPending || --result->nPending==0 ) ) {
+          FREE( result->value.data.strptr[0] );
+          FREE( result->value.data.strptr );
+       }
+       break;
 
-       case STRING:
-          if( (pv->userInfo)->datatype==TSTRING ) {
-             if( constant ) {
-                for( jj=0; jj<ntodo; jj++ )
-                   strcpy( ((char**)(pv->Data))[jj], result->value.data.str );
-             } else {
-                for( jj=0; jj<ntodo; jj++ )
-                   if( result->value.undef[jj] ) {
-                      anyNullThisTime = 1;
-                      strcpy( ((char**)(pv->Data))[jj],
-                              *(char **)(pv->Null) );
-                   } else {
-                      strcpy( ((char**)(pv->Data))[jj],
-                              result->value.data.strptr[jj] );
-                   }
-             }
+    case STRING:
+       if( (pv->userInfo)->datatype==TSTRING ) {
+          if( constant ) {
+             for( jj=0; jj<ntodo; jj++ )
+                strcpy( ((char**)(pv->Data))[jj], result->value.data.str );
           } else {
-             ffpmsg("Cannot convert string expression to desired type.");
-             lParse->status = PARSE_BAD_TYPE;
-          }
-          if( result->operation>0 ) {
-             FREE( result->value.data.strptr[0] );
-             FREE( result->value.data.strptr );
+             for( jj=0; jj<ntodo; jj++ )
+                if( result->value.undef[jj] ) {
+                   *anyNullThisTime = 1;
+                   strcpy( ((char**)(pv->Data))[jj],
+                           *(char **)(pv->Null) );
+                } else {
+                   strcpy( ((char**)(pv->Data))[jj],
+                           result->value.data.strptr[jj] );
+                }
           }
-          break;
+       } else {
+          ffpmsg("Cannot convert string expression to desired type.");
+          lParse->status = PARSE_BAD_TYPE;
+       }
+       if( result->operation>0
+           && ( !result->nPending || --result->nPending==0 ) ) {
+          FREE( result->value.data.strptr[0] );
+          FREE( result->value.data.strptr );
        }
+       break;
+    }
 
-       if( lParse->status ) break;
+    if( lParse->status ) return;
 
-       /*  Increment Data to point to where the next block should go  */
+    /*  Increment Data to point to where the next block should go  */
 
-       if( result->type==BITSTR && (pv->userInfo)->datatype==TBYTE )
-          (pv->Data) = (char*)(pv->Data)
-                    + (pv->datasize) * ( (result->value.nelem+7)/8 ) * ntodo;
-       else if( result->type==STRING )
-          (pv->Data) = (char*)(pv->Data) + (pv->datasize) * ntodo;
-       else
-          (pv->Data) = (char*)(pv->Data) + (pv->datasize) * ntodo * (pv->repeat);
-    }
+       (pv->Data) = (char*)(pv->Data) + workfn_rowsize( result, pv ) * ntodo;
+}
+
+/*---------------------------------------------------------------------------*/
+static void workfn_done( parseInfo *userInfo, /* IO- Data handling info      */
+                         iteratorCol *outcol, /* IO- Output column           */
+                         void *Data0,         /* I - Data at start of pass   */
+                         int  anyNullThisTime ) /* I - Any nulls written?    */
+/*                                                                           */
+/* End of each iterator pass: report the null value of a TemporaryCol and    */
+/* record whether any nulls were written.                                    */
+/*---------------------------------------------------------------------------*/
+{
+    struct ParseStatusVariables *pv = &( userInfo->parseVariables );
+    long zeros[4] = {0,0,0,0};
 
     /* If a TemporaryCol output is used, we want to inform the caller
        what the null value is expected to be */
-    if (pv->Null != outcol->array && 
+    if (outcol && pv->Null != outcol->array && 
 	(Data0) == (char*) outcol->array + (pv->datasize)) {
       if( (pv->userInfo)->datatype == TSTRING )
 	memcpy( outcol->array, *(char **)(pv->Null), 2 );
@@ -1364,28 +2425,12 @@ int fits_parser_workfn( long    totalrows,     /* I - Total rows to be processed
 
     if( anyNullThisTime )
        (pv->userInfo)->anyNull = 1;
-    else if( pv->Null == outcol->array ) {
+    else if( outcol && pv->Null == outcol->array ) {
        if( (pv->userInfo)->datatype == TSTRING )
           memcpy( *(char **)(pv->Null), zeros, 2 );
        else 
           memcpy( (pv->Null), zeros, (pv->datasize) );
     }
-
-    /*-------------------------------------------------------*/
-    /*  Clean up procedures:  after processing all the rows  */
-    /*-------------------------------------------------------*/
-
-    /*  if the calling routine specified that only a limited number    */
-    /*  of rows in the table should be processed, return a value of -1 */
-    /*  once all the rows have been done, if no other error occurred.  */
-
-    if (lParse->hdutype != IMAGE_HDU && firstrow - 1 == (pv->lastRow)) {
-           if (!lParse->status && (pv->userInfo)->maxRows<totalrows) {
-                  return (-1);
-           }
-    }
-
-    return(lParse->status);  /* return successful status */
 }
 
 static void Setup_DataArrays( ParseData *lParse, int nCols, iteratorCol *cols,
@@ -1405,6 +2450,9 @@ static void Setup_DataArrays( ParseData *lParse, int nCols, iteratorCol *cols,
    double *rarray;
    char msg[80];
    int do_realloc = 0;
+   int bitchars_set = 0;
+   unsigned char *bytes;
+   char bitchars[256][8];   /* '0'/'1' expansion of each packed byte */
 
    lParse->firstDataRow = fRow;
    lParse->nDataRows    = nRows;
@@ -1447,16 +2495,21 @@ static void Setup_DataArrays( ParseData *lParse, int nCols, iteratorCol *cols,
 	   }
 	 }
 
+         if( !bitchars_set ) {
+            for( idx=0; idx<256; idx++ )
+               for( len=0; len<8; len++ )
+                  bitchars[idx][len] = ( idx & (128>>len) ? '1' : '0' );
+            bitchars_set = 1;
+         }
+
+         /*  Expand the packed bytes a whole byte at a time  */
          for( row=0; row<nRows; row++ ) {
             bitStrs[row] = bitStrs[0] + row*(nelem+1);
-            idx = (row)*( (nelem+7)/8 ) + 1;
-            for(len=0; len<nelem; len++) {
-               if( ((char*)icol->array)[idx] & (1<<(7-len%8)) )
-                  bitStrs[row][len] = '1';
-               else
-                  bitStrs[row][len] = '0';
-               if( len%8==7 ) idx++;
-            }
+            bytes = (unsigned char*)icol->array + row*( (nelem+7)/8 ) + 1;
+            for(len=0; len+8<=nelem; len+=8)
+               memcpy( bitStrs[row]+len, bitchars[*(bytes++)], 8 );
+            for(; len<nelem; len++)
+               bitStrs[row][len] = bitchars[*bytes][len%8];
             bitStrs[row][len] = '\0';
          }
          varData->undef = (char*)bitStrs;
@@ -2160,41 +3213,163 @@ int fits_uncompress_hkdata( ParseData *lParse,
       }
    }
 
-   if( currelem<ntimes ) {
-      ffpmsg("Found fewer unique time stamps than caller indicated");
-      return( *status = PARSE_BAD_COL );
-   }
+   if( currelem<ntimes ) {
+      ffpmsg("Found fewer unique time stamps than caller indicated");
+      return( *status = PARSE_BAD_COL );
+   }
+
+   /*  Check for any parameters which were not located in the table  */
+   parNo = lParse->nCols;
+   while( parNo-- )
+      if( !found[parNo] ) {
+         snprintf( parName, 256, "Parameter not found: %-30s", 
+                  lParse->varData[parNo].name );
+         ffpmsg( parName );
+         *status = PARSE_SYNTAX_ERR;
+      }
+   return( *status );
+}
+
+typedef struct {
+  ParseData *lParse;
+  long lastrow;           /* Last row of the requested range               */
+  long firstrow;          /* First row of the requested range              */
+  long maxgood;           /* Stop after this many TRUE rows, 0 = no limit  */
+  long ngood;             /* Number of TRUE rows found so far              */
+  long *rownums;          /* O - Row numbers of the TRUE rows, or NULL     */
+  unsigned char *bitmap;  /* O - One bit per row of the range, or NULL     */
+  int  nproj;             /* Number of projected columns                   */
+  int  *datatype;         /* Datatype of each projected column             */
+  void **nulval;          /* Ptr to value to use as UNDEF, or NULL         */
+  void **array;           /* O - Values of the TRUE rows of each column    */
+  int  *anynul;           /* O - Were any UNDEFs encountered?              */
+} ffffrw_workdata;
+
+/*---------------------------------------------------------------------------*/
+int ffffrw( fitsfile *fptr,         /* I - Input FITS file                   */
+            char     *expr,         /* I - Boolean expression                */
+            long     *rownum,       /* O - First row of table to eval to T   */
+            int      *status )      /* O - Error status                      */
+/*                                                                           */
+/* Evaluate a boolean expression, returning the row number of the first      */
+/* row which evaluates to TRUE                                               */
+/*---------------------------------------------------------------------------*/
+{
+   int naxis, dtype;
+   long nelem, naxes[MAXDIMS], ngood;
+   ParseData lParse;
+
+   if( *status ) return( *status );
+
+   if( ffiprs( fptr, 0, expr, MAXDIMS, &dtype, &nelem, &naxis,
+               naxes, &lParse, status ) ) {
+      ffcprs(&lParse);
+      return( *status );
+   }
+
+   *rownum = 0;
+   find_rows_sel( &lParse, 1, -1, 1, 0, NULL, NULL, NULL, NULL,
+                  &ngood, rownum, NULL, NULL, status );
+
+   ffcprs(&lParse);
+   return(*status);
+}
+
+/*---------------------------------------------------------------------------*/
+int fffrwl( fitsfile *fptr,         /* I - Input FITS file                   */
+            char     *expr,         /* I - Boolean expression                */
+            long     firstrow,      /* I - First row of table to eval        */
+            long     nrows,         /* I - Number of rows to evaluate        */
+            long     maxgood,       /* I - Stop after this many TRUE rows    */
+            long     *n_good_rows,  /* O - Number of rows eval to True       */
+            long     *rownums,      /* O - Row numbers of the TRUE rows      */
+            int      *status )      /* O - Error status                      */
+/*                                                                           */
+/* Evaluate a boolean expression over the indicated rows, returning the      */
+/* numbers of the rows which evaluate to TRUE, in increasing order.  If      */
+/* maxgood > 0, stop reading the table once that many rows have been found.  */
+/*---------------------------------------------------------------------------*/
+{
+   int naxis, dtype;
+   long nelem, naxes[MAXDIMS];
+   ParseData lParse;
+
+   if( *status ) return( *status );
+
+   if( ffiprs( fptr, 0, expr, MAXDIMS, &dtype, &nelem, &naxis,
+               naxes, &lParse, status ) ) {
+      ffcprs(&lParse);
+      return( *status );
+   }
+
+   find_rows_sel( &lParse, firstrow, nrows, maxgood, 0, NULL, NULL, NULL,
+                  NULL, n_good_rows, rownums, NULL, NULL, status );
+
+   ffcprs(&lParse);
+   return(*status);
+}
+
+/*---------------------------------------------------------------------------*/
+int fffrwb( fitsfile *fptr,         /* I - Input FITS file                   */
+            char     *expr,         /* I - Boolean expression                */
+            long     firstrow,      /* I - First row of table to eval        */
+            long     nrows,         /* I - Number of rows to evaluate        */
+            long     maxgood,       /* I - Stop after this many TRUE rows    */
+            long     *n_good_rows,  /* O - Number of rows eval to True       */
+            unsigned char *bitmap,  /* O - One bit per row, set if TRUE      */
+            int      *status )      /* O - Error status                      */
+/*                                                                           */
+/* Evaluate a boolean expression over the indicated rows, returning a        */
+/* bitmap of (nrows+7)/8 bytes in which the most significant bit of the      */
+/* first byte corresponds to firstrow.  If maxgood > 0, stop reading the     */
+/* table once that many rows have been found; later bits are left clear.     */
+/*---------------------------------------------------------------------------*/
+{
+   int naxis, dtype;
+   long nelem, naxes[MAXDIMS];
+   ParseData lParse;
+
+   if( *status ) return( *status );
+
+   if( ffiprs( fptr, 0, expr, MAXDIMS, &dtype, &nelem, &naxis,
+               naxes, &lParse, status ) ) {
+      ffcprs(&lParse);
+      return( *status );
+   }
+
+   find_rows_sel( &lParse, firstrow, nrows, maxgood, 0, NULL, NULL, NULL,
+                  NULL, n_good_rows, NULL, bitmap, NULL, status );
 
-   /*  Check for any parameters which were not located in the table  */
-   parNo = lParse->nCols;
-   while( parNo-- )
-      if( !found[parNo] ) {
-         snprintf( parName, 256, "Parameter not found: %-30s", 
-                  lParse->varData[parNo].name );
-         ffpmsg( parName );
-         *status = PARSE_SYNTAX_ERR;
-      }
-   return( *status );
+   ffcprs(&lParse);
+   return(*status);
 }
 
-typedef struct {
-  long *prownum;
-  ParseData *lParse;
-} ffffrw_workdata;
-
 /*---------------------------------------------------------------------------*/
-int ffffrw( fitsfile *fptr,         /* I - Input FITS file                   */
+int fffrwp( fitsfile *fptr,         /* I - Input FITS file                   */
             char     *expr,         /* I - Boolean expression                */
-            long     *rownum,       /* O - First row of table to eval to T   */
+            long     firstrow,      /* I - First row of table to eval        */
+            long     nrows,         /* I - Number of rows to evaluate        */
+            long     maxgood,       /* I - Stop after this many TRUE rows    */
+            int      ncols,         /* I - Number of columns to read         */
+            int      *colnum,       /* I - Number of each column to read     */
+            int      *datatype,     /* I - Datatype to return each column as */
+            void     **nulval,      /* I - Ptr to value to use as UNDEF      */
+            void     **array,       /* O - Values of each column             */
+            long     *n_good_rows,  /* O - Number of rows eval to True       */
+            long     *rownums,      /* O - Row numbers of TRUE rows, or NULL */
+            int      *anynul,       /* O - Were any UNDEFs encountered?      */
             int      *status )      /* O - Error status                      */
 /*                                                                           */
-/* Evaluate a boolean expression, returning the row number of the first      */
-/* row which evaluates to TRUE                                               */
+/* Evaluate a boolean expression over the indicated rows and, in the same    */
+/* pass through the table, read the values of the given columns in only the  */
+/* rows which evaluate to TRUE.  array[i] receives n_good_rows times the     */
+/* repeat count of column colnum[i] elements, cast as datatype[i]; for       */
+/* TSTRING, array[i] is an array of char pointers, one per row.  Undefined   */
+/* elements are set to *nulval[i] unless nulval or nulval[i] is NULL.        */
 /*---------------------------------------------------------------------------*/
 {
-   int naxis, constant, dtype;
+   int naxis, dtype;
    long nelem, naxes[MAXDIMS];
-   char result;
    ParseData lParse;
 
    if( *status ) return( *status );
@@ -2204,37 +3379,120 @@ int ffffrw( fitsfile *fptr,         /* I - Input FITS file                   */
       ffcprs(&lParse);
       return( *status );
    }
-   if( nelem<0 ) {
-      constant = 1;
-      nelem = -nelem;
-   } else
-      constant = 0;
 
-   if( dtype!=TLOGICAL || nelem!=1 ) {
-      ffcprs(&lParse);
+   find_rows_sel( &lParse, firstrow, nrows, maxgood, ncols, colnum,
+                  datatype, nulval, array, n_good_rows, rownums, NULL,
+                  anynul, status );
+
+   ffcprs(&lParse);
+   return(*status);
+}
+
+/*---------------------------------------------------------------------------*/
+static int find_rows_sel( ParseData *lParse, /* I - Parsed boolean expr     */
+            long     firstrow,      /* I - First row of table to eval        */
+            long     nrows,         /* I - Number of rows, -1 = all          */
+            long     maxgood,       /* I - Stop after this many TRUE rows    */
+            int      nproj,         /* I - Number of columns to read         */
+            int      *colnum,       /* I - Number of each column to read     */
+            int      *datatype,     /* I - Datatype to return each column as */
+            void     **nulval,      /* I - Ptr to value to use as UNDEF      */
+            void     **array,       /* O - Values of each column             */
+            long     *n_good_rows,  /* O - Number of rows eval to True       */
+            long     *rownums,      /* O - Row numbers of TRUE rows, or NULL */
+            unsigned char *bitmap,  /* O - Bitmap of TRUE rows, or NULL      */
+            int      *anynul,       /* O - Were any UNDEFs encountered?      */
+            int      *status )      /* O - Error status                      */
+/*                                                                           */
+/* Common body of ffffrw, fffrwl, fffrwb and fffrwp.  The expression columns */
+/* and the projected columns are read by a single ffiter pass, which         */
+/* ffffrw_work stops as soon as maxgood rows have been found.               */
+/*---------------------------------------------------------------------------*/
+{
+   ffffrw_workdata workData;
+   iteratorCol *cols;
+   fitsfile *fptr = lParse->def_fptr;
+   long totalrows, ii;
+   int ncols;
+
+   if( *status ) return( *status );
+
+   *n_good_rows = 0;
+   if( anynul ) *anynul = 0;
+
+   if( lParse->datatype!=TLOGICAL || lParse->nElements!=1 ) {
       ffpmsg("Expression does not evaluate to a logical scalar.");
       return( *status = PARSE_BAD_TYPE );
    }
+   if( lParse->hdutype==IMAGE_HDU ) {
+      ffpmsg("Row selection requires a table HDU (ffffrw)");
+      return( *status = NOT_TABLE );
+   }
 
-   *rownum = 0;
-   if( constant ) { /* No need to call parser... have result from ffiprs */
-      result = lParse.Nodes[lParse.resultNode].value.data.log;
-      if( result ) {
-         /*  Make sure there is at least 1 row in table  */
-         ffgnrw( fptr, &nelem, status );
-         if( nelem )
-            *rownum = 1;
+   /*  Clip the requested range to the table  */
+
+   if( bitmap && nrows>0 ) memset( bitmap, 0, (nrows+7)/8 );
+   if( ffgnrw( fptr, &totalrows, status ) ) return( *status );
+   firstrow = (firstrow>1 ? firstrow : 1);
+   if( nrows<0 || firstrow+nrows-1>totalrows ) nrows = totalrows-firstrow+1;
+   if( nrows<=0 ) return( *status );
+
+   if( lParse->Nodes[lParse->resultNode].operation==CONST_OP && nproj<=0 ) {
+      /* No need to call parser... have result from ffiprs */
+      if( lParse->Nodes[lParse->resultNode].value.data.log ) {
+         *n_good_rows = ( maxgood>0 ? minvalue(maxgood,nrows) : nrows );
+         for( ii=0; ii<*n_good_rows; ii++ ) {
+            if( rownums ) rownums[ii] = firstrow+ii;
+            if( bitmap ) bitmap[ii/8] |= (unsigned char)(0x80 >> (ii%8));
+         }
       }
-   } else {
-      ffffrw_workdata workData;
-      workData.prownum = rownum;
-      workData.lParse = &lParse;
-      if( ffiter( lParse.nCols, lParse.colData, 0, 0,
-                  ffffrw_work, (void*)&workData, status ) == -1 )
-         *status = 0;  /* -1 indicates exitted without error before end... OK */
+      return( *status );
    }
 
-   ffcprs(&lParse);
+   memset( &workData, 0, sizeof(workData) );
+   workData.lParse   = lParse;
+   workData.firstrow = firstrow;
+   workData.lastrow  = firstrow+nrows-1;
+   workData.maxgood  = maxgood;
+   workData.rownums  = rownums;
+   workData.bitmap   = bitmap;
+   workData.nproj    = nproj;
+   workData.datatype = datatype;
+   workData.nulval   = nulval;
+   workData.array    = array;
+   workData.anynul   = anynul;
+
+   /*  Append the projected columns to the expression's own columns  */
+
+   ncols = lParse->nCols;
+   cols  = lParse->colData;
+   if( nproj>0 ) {
+      cols = (iteratorCol *)calloc( ncols+nproj, sizeof(iteratorCol) );
+      if( !cols ) {
+         ffpmsg("memory allocation failed (ffffrw)");
+         return( *status = MEMORY_ALLOCATION );
+      }
+      if( ncols ) memcpy( cols, lParse->colData, ncols*sizeof(iteratorCol) );
+      for( ii=0; ii<nproj; ii++ ) {
+         if( datatype[ii]==TBIT || datatype[ii]==TCOMPLEX
+             || datatype[ii]==TDBLCOMPLEX ) {
+            ffpmsg("Unsupported datatype for a projected column (fffrwp)");
+            free( cols );
+            return( *status = BAD_DATATYPE );
+         }
+         fits_iter_set_by_num( cols+ncols+ii, fptr, colnum[ii],
+                               datatype[ii], InputCol );
+      }
+      ncols += nproj;
+   }
+
+   Reset_State( lParse );
+   if( ffiter( ncols, cols, firstrow-1, 0,
+               ffffrw_work, (void*)&workData, status ) == -1 )
+      *status = 0;  /* -1 indicates exitted without error before end... OK */
+
+   if( cols!=lParse->colData ) free( cols );
+   *n_good_rows = workData.ngood;
    return(*status);
 }
 
@@ -2247,41 +3505,110 @@ int ffffrw_work(long        totalrows, /* I - Total rows to be processed     */
                 iteratorCol *colData,  /* IO- Column information/data        */
                 void        *userPtr ) /* I - Data handling instructions     */
 /*                                                                           */
-/* Iterator work function which calls the parser and searches for the        */
-/* first row which evaluates to TRUE.                                        */
+/* Iterator work function which calls the parser and records each row       */
+/* which evaluates to TRUE, copying out the values of the projected columns  */
+/* which follow the parser's own columns in colData.  Returns -1 to stop     */
+/* the iterator at the end of the row range or once maxgood rows are found. */
 /*---------------------------------------------------------------------------*/
 {
-    long idx;
+    long idx, row, ntodo, remain, elem, repeat, size, n;
+    int ii, stop = 0;
+    double zeros[2] = {0.0, 0.0};
+    char *src, *dst;
     Node *result;
+    iteratorCol *pcol;
     ffffrw_workdata *workData = userPtr;
     ParseData *lParse = workData->lParse;
 
-    Evaluate_Parser( lParse, firstrow, nrows );
+    /*  The parser re-reads offset rows through its own copy of the columns  */
 
-    if( !lParse->status ) {
+    if( firstrow == offset+1 )
+       for( ii=0; ii<lParse->nCols; ii++ )
+          lParse->colData[ii].repeat = colData[ii].repeat;
 
-       result = lParse->Nodes + lParse->resultNode;
-       if( result->operation==CONST_OP ) {
+    nrows = minvalue( nrows, workData->lastrow - firstrow + 1 );
+    if( nrows<=0 ) return( -1 );
 
-          if( result->value.data.log ) {
-	     *(workData->prownum) = firstrow;
-             return( -1 );
-          }
+    Setup_DataArrays( lParse, lParse->nCols, colData, firstrow, nrows );
+    if( lParse->status ) return( lParse->status );
 
-       } else {
+    row    = firstrow;
+    remain = nrows;
+    while( remain && !stop ) {
+       ntodo = minvalue(remain,10000);
+       Evaluate_Parser( lParse, row, ntodo );
+       if( lParse->status ) break;
 
-          for( idx=0; idx<nrows; idx++ )
-             if( result->value.data.logptr[idx] && !result->value.undef[idx] ) {
-	        *(workData->prownum) = firstrow + idx;;
-                return( -1 );
+       result = lParse->Nodes + lParse->resultNode;
+       for( idx=0; idx<ntodo; idx++ ) {
+          if( result->operation==CONST_OP ) {
+             if( !result->value.data.log ) break;
+          } else if( !result->value.data.logptr[idx]
+                     || result->value.undef[idx] ) continue;
+
+          n = workData->ngood++;
+          if( workData->rownums ) workData->rownums[n] = row+idx;
+          if( workData->bitmap ) {
+             elem = row + idx - workData->firstrow;
+             workData->bitmap[elem/8] |= (unsigned char)(0x80 >> (elem%8));
+          }
+
+          /*  Copy this row of each projected column, skipping the null  */
+          /*  value which the iterator stores in the first element       */
+
+          for( ii=0; ii<workData->nproj; ii++ ) {
+             pcol = colData + lParse->nCols + ii;
+             elem = row + idx - firstrow;
+             if( pcol->datatype==TSTRING ) {
+                src = ((char**)pcol->array)[elem+1];
+                if( workData->nulval && workData->nulval[ii]
+                    && **(char**)pcol->array
+                    && !FSTRCMP( src, *(char**)pcol->array ) ) {
+                   src = (char*)workData->nulval[ii];
+                   if( workData->anynul ) *workData->anynul = 1;
+                }
+                strcpy( ((char**)workData->array[ii])[n], src );
+                continue;
              }
+             switch( pcol->datatype ) {
+             case TLOGICAL: case TBYTE: case TSBYTE: size = 1;             break;
+             case TSHORT:   case TUSHORT:   size = sizeof(short);          break;
+             case TINT:     case TUINT:     size = sizeof(int);            break;
+             case TLONG:    case TULONG:    size = sizeof(long);           break;
+             case TLONGLONG: case TULONGLONG: size = sizeof(LONGLONG);     break;
+             case TFLOAT:                   size = sizeof(float);          break;
+             default:                       size = sizeof(double);         break;
+             }
+             repeat = pcol->repeat;
+             src = (char*)pcol->array + size*(1 + elem*repeat);
+             dst = (char*)workData->array[ii] + size*n*repeat;
+             memcpy( dst, src, size*repeat );
+             if( workData->nulval && workData->nulval[ii] ) {
+                for( elem=0; elem<repeat; elem++ )
+                   if( memcmp( dst+elem*size, pcol->array, size )==0
+                       && memcmp( pcol->array, zeros, size ) ) {
+                      memcpy( dst+elem*size, workData->nulval[ii], size );
+                      if( workData->anynul ) *workData->anynul = 1;
+                   }
+             }
+          }
+
+          if( workData->ngood==workData->maxgood ) {
+             stop = 1;
+             break;
+          }
        }
+       if( result->operation>0 ) FREE( result->value.data.ptr );
+
+       row    += ntodo;
+       remain -= ntodo;
     }
 
-    return( lParse->status );
+    if( lParse->status ) return( lParse->status );
+    if( stop || firstrow+nrows-1 >= workData->lastrow ) return( -1 );
+    return( 0 );
 }
 
-
 static int set_image_col_types (ParseData *lParse,
 				fitsfile * fptr, const char * name, int bitpix,
 				DataInfo * varInfo, iteratorCol *colIter) {
@@ -2338,6 +3665,105 @@ static int set_image_col_types (ParseData *lParse,
 
  *************************************************************************/
 
+static int set_table_col_types (ParseData *lParse,
+				fitsfile *fptr, int colnum, int typecode,
+				long repeat, long width,
+				DataInfo *varInfo, iteratorCol *colIter) {
+
+   /* Map a table column onto the parser data type it is read as.  Shared */
+   /* by find_column and ffbexp, which must agree on the mapping when it  */
+   /* decides whether a compiled expression can be rebound to a new HDU.  */
+
+   char temp[80];
+   double tzero,tscale;
+   int istatus, status = 0;
+
+   switch( typecode ) {
+   case TBIT:
+      varInfo->type     = BITSTR;
+      colIter->datatype = TBYTE;
+      break;
+   case TBYTE:
+   case TSHORT:
+   case TLONG:
+      /* The datatype of column with TZERO and TSCALE keywords might be 
+         float or double. 
+      */
+      snprintf(temp,80,"TZERO%d",colnum);
+      istatus = 0;
+      if(fits_read_key(fptr,TDOUBLE,temp,&tzero,NULL,&istatus)) {
+          tzero = 0.0;
+      } 
+      snprintf(temp,80,"TSCAL%d",colnum);
+      istatus = 0;
+      if(fits_read_key(fptr,TDOUBLE,temp,&tscale,NULL,&istatus)) {
+          tscale = 1.0;
+      } 
+      if (tscale == 1.0 && (tzero == 0.0 || tzero == 32768.0 )) {
+          varInfo->type     = LONG;
+          colIter->datatype = TLONG;
+/*    Reading an unsigned long column as a long can cause overflow errors.
+      Treat the column as a double instead.
+      } else if (tscale == 1.0 &&  tzero == 2147483648.0 ) {
+          varInfo->type     = LONG;
+          colIter->datatype = TULONG;
+ */
+
+      }
+      else {
+          varInfo->type     = DOUBLE;
+          colIter->datatype = TDOUBLE;
+      }
+      break;
+/* 
+  For now, treat 8-byte integer columns as type double.
+  This can lose precision, so the better long term solution
+  will be to add support for TLONGLONG as a separate datatype.
+*/
+   case TLONGLONG:
+   case TFLOAT:
+   case TDOUBLE:
+      varInfo->type     = DOUBLE;
+      colIter->datatype = TDOUBLE;
+      break;
+   case TLOGICAL:
+      varInfo->type     = BOOLEAN;
+      colIter->datatype = TLOGICAL;
+      break;
+   case TSTRING:
+      varInfo->type     = STRING;
+      colIter->datatype = TSTRING;
+      if ( width >= MAX_STRLEN ) {
+	snprintf(temp, 80, "column %d is wider than maximum %d characters",
+		colnum, MAX_STRLEN-1);
+        ffpmsg(temp);
+	return lParse->status = PARSE_LRG_VECTOR;
+      }
+      if( lParse->hdutype == ASCII_TBL ) repeat = width;
+      break;
+   default:
+      if (typecode < 0) {
+        snprintf(temp, 80,"variable-length array columns are not supported. typecode = %d", typecode);
+        ffpmsg(temp);
+      }
+      return lParse->status = PARSE_BAD_TYPE;
+   }
+   varInfo->nelem = repeat;
+   colIter->repeat = 0; /* ffiter() will fill in this value */
+   if( repeat>1 && typecode!=TSTRING ) {
+      if( fits_read_tdim( fptr, colnum, MAXDIMS,
+                          &varInfo->naxis,
+                          &varInfo->naxes[0], &status )
+          ) {
+         return lParse->status = status;
+      }
+   } else {
+      varInfo->naxis = 1;
+      varInfo->naxes[0] = 1;
+   }
+   return 0;
+}
+
 static int find_column( ParseData *lParse, char *colName, void *itslval )
 {
    FITS_PARSER_YYSTYPE *thelval = (FITS_PARSER_YYSTYPE*)itslval;
@@ -2346,8 +3772,6 @@ static int find_column( ParseData *lParse, char *colName, void *itslval )
    long repeat, width;
    fitsfile *fptr;
    char temp[80];
-   double tzero,tscale;
-   int istatus;
    DataInfo *varInfo;
    iteratorCol *colIter;
 
@@ -2434,96 +3858,14 @@ else { /* HDU holds a table */
    varInfo->name[MAXVARNAME] = '\0';
 
 if (lParse->hdutype != IMAGE_HDU) {
-   switch( typecode ) {
-   case TBIT:
-      varInfo->type     = BITSTR;
-      colIter->datatype = TBYTE;
-      type = BITCOL;
-      break;
-   case TBYTE:
-   case TSHORT:
-   case TLONG:
-      /* The datatype of column with TZERO and TSCALE keywords might be 
-         float or double. 
-      */
-      snprintf(temp,80,"TZERO%d",colnum);
-      istatus = 0;
-      if(fits_read_key(fptr,TDOUBLE,temp,&tzero,NULL,&istatus)) {
-          tzero = 0.0;
-      } 
-      snprintf(temp,80,"TSCAL%d",colnum);
-      istatus = 0;
-      if(fits_read_key(fptr,TDOUBLE,temp,&tscale,NULL,&istatus)) {
-          tscale = 1.0;
-      } 
-      if (tscale == 1.0 && (tzero == 0.0 || tzero == 32768.0 )) {
-          varInfo->type     = LONG;
-          colIter->datatype = TLONG;
-/*    Reading an unsigned long column as a long can cause overflow errors.
-      Treat the column as a double instead.
-      } else if (tscale == 1.0 &&  tzero == 2147483648.0 ) {
-          varInfo->type     = LONG;
-          colIter->datatype = TULONG;
- */
-
-      }
-      else {
-          varInfo->type     = DOUBLE;
-          colIter->datatype = TDOUBLE;
-      }
-      type = COLUMN;
-      break;
-/* 
-  For now, treat 8-byte integer columns as type double.
-  This can lose precision, so the better long term solution
-  will be to add support for TLONGLONG as a separate datatype.
-*/
-   case TLONGLONG:
-   case TFLOAT:
-   case TDOUBLE:
-      varInfo->type     = DOUBLE;
-      colIter->datatype = TDOUBLE;
-      type = COLUMN;
-      break;
-   case TLOGICAL:
-      varInfo->type     = BOOLEAN;
-      colIter->datatype = TLOGICAL;
-      type = BCOLUMN;
-      break;
-   case TSTRING:
-      varInfo->type     = STRING;
-      colIter->datatype = TSTRING;
-      type = SCOLUMN;
-      if ( width >= MAX_STRLEN ) {
-	snprintf(temp, 80, "column %d is wider than maximum %d characters",
-		colnum, MAX_STRLEN-1);
-        ffpmsg(temp);
-	lParse->status = PARSE_LRG_VECTOR;
-	return pERROR;
-      }
-      if( lParse->hdutype == ASCII_TBL ) repeat = width;
-      break;
-   default:
-      if (typecode < 0) {
-        snprintf(temp, 80,"variable-length array columns are not supported. typecode = %d", typecode);
-        ffpmsg(temp);
-      }
-      lParse->status = PARSE_BAD_TYPE;
+   if( set_table_col_types( lParse, fptr, colnum, typecode, repeat, width,
+                            varInfo, colIter ) )
       return pERROR;
-   }
-   varInfo->nelem = repeat;
-   colIter->repeat = 0; /* ffiter() will fill in this value */
-   if( repeat>1 && typecode!=TSTRING ) {
-      if( fits_read_tdim( fptr, colnum, MAXDIMS,
-                          &varInfo->naxis,
-                          &varInfo->naxes[0], &status )
-          ) {
-         lParse->status = status;
-         return pERROR;
-      }
-   } else {
-      varInfo->naxis = 1;
-      varInfo->naxes[0] = 1;
+   switch( varInfo->type ) {
+   case BITSTR:  type = BITCOL;  break;
+   case BOOLEAN: type = BCOLUMN; break;
+   case STRING:  type = SCOLUMN; break;
+   default:      type = COLUMN;  break;
    }
 }
    lParse->nCols++;
@@ -2591,6 +3933,7 @@ static int find_keywd(ParseData *lParse, char *keyname, void *itslval )
       return pERROR;
    }
 
+   lParse->nKeywds++;
    return( type );
 }
 
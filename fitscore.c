@@ -55,6 +55,30 @@ SERVICES PROVIDED HEREUNDER."
 #define PutMesg    5 /* add a new message to the stack */
 #define PutMark    6 /* add a marker to the stack */
 
+/*
+    The error message stack.  In a multi-threaded build each thread has
+    its own stack, so threads do not see each other's messages and
+    need no lock to put or get them.
+*/
+typedef struct FFerrstack {
+    int  id;               /* stack identifier returned by ffgmid */
+    int  first;            /* buffer holding the oldest message */
+    int  nummsg;           /* number of messages and markers on the stack */
+    char txt[errmsgsiz][81];
+    struct FFerrstack *next;  /* next stack in the list of thread stacks */
+} FFerrstack;
+
+/* buffer of the n-th oldest message on the stack */
+#define ERRSLOT(stack, n) ((stack)->txt[((stack)->first + (n)) % errmsgsiz])
+
+static FFerrstack *ffxstk(int create);
+static void ffxmsgs(FFerrstack *stack, int action, char *errmsg);
+static char *ffxslot(FFerrstack *stack);
+static int ffhtchunk(int handle);
+static int ffhcload(FITSfile *Fptr, int *hdutype);
+static void ffhcsave(FITSfile *Fptr);
+static void ffhcfree(FITSfile *Fptr);
+
 #ifdef _REENTRANT
 /*
     Fitsio_Lock and Fitsio_Pthread_Status are declared in fitsio2.h. 
@@ -62,6 +86,21 @@ SERVICES PROVIDED HEREUNDER."
 pthread_mutex_t Fitsio_Lock;
 int Fitsio_Pthread_Status = 0;
 
+/*
+    Each thread's error stack is found through errstack_key.  The list of
+    all the stacks, used by ffgmsi to look up the stack of another thread,
+    is only locked when a stack is created, freed or read that way.
+*/
+static pthread_key_t   errstack_key;
+static pthread_once_t  errstack_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t errstack_lock = PTHREAD_MUTEX_INITIALIZER;
+static FFerrstack     *errstack_list = 0;
+static int             errstack_nextid = 1;
+
+#else
+
+static FFerrstack errstack = {1};  /* the single stack has identifier 1 */
+
 #endif
 
 int STREAM_DRIVER = 0;
@@ -733,13 +772,119 @@ void ffcmrk(void)
     return;
 }
 /*--------------------------------------------------------------------------*/
+int ffgmid(void)
+/*
+  return the identifier of the error stack of the calling thread, which
+  another thread may pass to ffgmsi to read the messages on this stack.
+  Returns 0 if the stack could not be allocated.
+*/
+{
+    FFerrstack *stack;
+
+    stack = ffxstk(1);
+    return(stack ? stack->id : 0);
+}
+/*--------------------------------------------------------------------------*/
+int ffgmsi(int stackid,       /* I - stack identifier returned by ffgmid */
+           char *err_message) /* O - oldest message on that stack        */
+/*
+  get oldest message from the error stack with the given identifier,
+  ignoring markers.  This lets one thread collect the messages of another
+  thread; the owning thread must not be calling CFITSIO at the same time
+  (e.g., it has stopped at a barrier, or is waiting to be joined).
+*/
+{
+    FFerrstack *stack;
+
+    *err_message = '\0';
+
+#ifdef _REENTRANT
+    pthread_mutex_lock(&errstack_lock);
+    for (stack = errstack_list; stack; stack = stack->next)
+    {
+        if (stack->id == stackid)
+        {
+            ffxmsgs(stack, GetMesg, err_message);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&errstack_lock);
+#else
+    stack = ffxstk(1);
+    if (stack->id == stackid)
+        ffxmsgs(stack, GetMesg, err_message);
+#endif
+
+    return(*err_message);
+}
+/*--------------------------------------------------------------------------*/
+#ifdef _REENTRANT
+static void ffxstk_free(void *stack)
+/*
+  free the error stack of a thread when the thread exits
+*/
+{
+    FFerrstack **prev;
+
+    pthread_mutex_lock(&errstack_lock);
+    for (prev = &errstack_list; *prev; prev = &(*prev)->next)
+    {
+        if (*prev == (FFerrstack *) stack)
+        {
+            *prev = (*prev)->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&errstack_lock);
+
+    free(stack);
+}
+/*--------------------------------------------------------------------------*/
+static void ffxstk_key(void)
+{
+    pthread_key_create(&errstack_key, ffxstk_free);
+}
+#endif
+/*--------------------------------------------------------------------------*/
+static FFerrstack *ffxstk(int create) /* I - allocate stack if none yet? */
+/*
+  return the error stack of the calling thread.  In a multi-threaded
+  build each thread gets its own stack, allocated when the thread first
+  puts a message on it, so NULL is returned if the thread has none yet
+  and create = 0, or if the allocation fails.
+*/
+{
+#ifdef _REENTRANT
+    FFerrstack *stack;
+
+    pthread_once(&errstack_once, ffxstk_key);
+
+    stack = (FFerrstack *) pthread_getspecific(errstack_key);
+    if (!stack && create)
+    {
+        stack = (FFerrstack *) calloc(1, sizeof(FFerrstack));
+        if (!stack)
+            return(stack);
+
+        pthread_mutex_lock(&errstack_lock);
+        stack->id = errstack_nextid++;
+        stack->next = errstack_list;
+        errstack_list = stack;
+        pthread_mutex_unlock(&errstack_lock);
+
+        pthread_setspecific(errstack_key, stack);
+    }
+    return(stack);
+#else
+    return(&errstack);
+#endif
+}
+/*--------------------------------------------------------------------------*/
 void ffxmsg( int action,
             char *errmsg)
 /*
-  general routine to get, put, or clear the error message stack.
-  Use a static array rather than allocating memory as needed for
-  the error messages because it is likely to be more efficient
-  and simpler to implement.
+  general routine to get, put, or clear the error message stack of the
+  calling thread.
 
   Action Code:
 DelAll     1  delete all messages on the error stack 
@@ -751,27 +896,42 @@ PutMark    6  add a marker to the stack
 
 */
 {
-    int ii;
-    char markflag;
-    static char *txtbuff[errmsgsiz], *tmpbuff, *msgptr;
-    static char errbuff[errmsgsiz][81];  /* initialize all = \0 */
-    static int nummsg = 0;
+    FFerrstack *stack;
+
+    /* only a thread that puts something on its stack needs one */
+    stack = ffxstk(action == PutMesg || action == PutMark);
+
+    if (stack)
+        ffxmsgs(stack, action, errmsg);
+    else if (action == GetMesg)
+        errmsg[0] = '\0';  /*  no messages in the stack */
+
+    return;
+}
+/*--------------------------------------------------------------------------*/
+static void ffxmsgs(FFerrstack *stack, /* IO - error stack               */
+            int action,                /* I - action code (see ffxmsg)   */
+            char *errmsg)              /* IO - message to get or put     */
+/*
+  get, put, or clear messages on the given error stack.  The messages
+  are kept in a ring of errmsgsiz buffers, so a message is pushed or
+  popped without moving the other messages; when the ring is full the
+  oldest message is overwritten.
+*/
+{
+    char markflag, *msgptr;
 
-    FFLOCK;
-    
     if (action == DelAll)  /* clear the whole message stack */
     {
-      for (ii = 0; ii < nummsg; ii ++)
-        *txtbuff[ii] = '\0';
-
-      nummsg = 0;
+      stack->first = 0;
+      stack->nummsg = 0;
     }
     else if (action == DelMark)  /* clear up to and including first marker */
     {
-      while (nummsg > 0) {
-        nummsg--;  
-        markflag = *txtbuff[nummsg]; /* store possible marker character */
-        *txtbuff[nummsg] = '\0';  /* clear the buffer for this msg */
+      while (stack->nummsg > 0) {
+        stack->nummsg--;  
+        /* store possible marker character */
+        markflag = *ERRSLOT(stack, stack->nummsg);
 
         if (markflag == ESMARKER)
            break;   /* found a marker, so quit */
@@ -779,28 +939,20 @@ PutMark    6  add a marker to the stack
     }
     else if (action == DelNewest)  /* remove newest message from stack */ 
     {
-      if (nummsg > 0)
-      {
-        nummsg--;  
-        *txtbuff[nummsg] = '\0';  /* clear the buffer for this msg */
-      }
+      if (stack->nummsg > 0)
+        stack->nummsg--;  
     }
     else if (action == GetMesg)  /* pop and return oldest message from stack */ 
     {                            /* ignoring markers */
-      while (nummsg > 0)
+      while (stack->nummsg > 0)
       {
-         strcpy(errmsg, txtbuff[0]);   /* copy oldest message to output */
+         strcpy(errmsg, stack->txt[stack->first]);  /* copy oldest message */
 
-         *txtbuff[0] = '\0';  /* clear the buffer for this msg */
-           
-         nummsg--;  
-         for (ii = 0; ii < nummsg; ii++)
-             txtbuff[ii] = txtbuff[ii + 1]; /* shift remaining pointers */
+         stack->first = (stack->first + 1) % errmsgsiz;
+         stack->nummsg--;  
 
-         if (errmsg[0] != ESMARKER) {   /* quit if this is not a marker */
-            FFUNLOCK;
+         if (errmsg[0] != ESMARKER)   /* quit if this is not a marker */
             return;
-         }
        }
        errmsg[0] = '\0';  /*  no messages in the stack */
     }
@@ -809,68 +961,40 @@ PutMark    6  add a marker to the stack
      msgptr = errmsg;
      while (strlen(msgptr))
      {
-      if (nummsg == errmsgsiz)
-      {
-        tmpbuff = txtbuff[0];  /* buffers full; reuse oldest buffer */
-        *txtbuff[0] = '\0';  /* clear the buffer for this msg */
-
-        nummsg--;
-        for (ii = 0; ii < nummsg; ii++)
-             txtbuff[ii] = txtbuff[ii + 1];   /* shift remaining pointers */
-
-        txtbuff[nummsg] = tmpbuff;  /* set pointer for the new message */
-      }
-      else
-      {
-        for (ii = 0; ii < errmsgsiz; ii++)
-        {
-          if (*errbuff[ii] == '\0') /* find first empty buffer */
-          {
-            txtbuff[nummsg] = errbuff[ii];
-            break;
-          }
-        }
-      }
-
-      strncat(txtbuff[nummsg], msgptr, 80);
-      nummsg++;
-
+      /* long messages are split into 80-character pieces */
+      strncpy(ffxslot(stack), msgptr, 80);
       msgptr += minvalue(80, strlen(msgptr));
      }
     }
     else if (action == PutMark)  /* put a marker on the stack */
     {
-      if (nummsg == errmsgsiz)
-      {
-        tmpbuff = txtbuff[0];  /* buffers full; reuse oldest buffer */
-        *txtbuff[0] = '\0';  /* clear the buffer for this msg */
-
-        nummsg--;
-        for (ii = 0; ii < nummsg; ii++)
-             txtbuff[ii] = txtbuff[ii + 1];   /* shift remaining pointers */
-
-        txtbuff[nummsg] = tmpbuff;  /* set pointer for the new message */
-      }
-      else
-      {
-        for (ii = 0; ii < errmsgsiz; ii++)
-        {
-          if (*errbuff[ii] == '\0') /* find first empty buffer */
-          {
-            txtbuff[nummsg] = errbuff[ii];
-            break;
-          }
-        }
-      }
+      msgptr = ffxslot(stack);
+      msgptr[0] = ESMARKER;      /* write the marker */
+      msgptr[1] = '\0';
+    }
 
-      *txtbuff[nummsg] = ESMARKER;      /* write the marker */
-      *(txtbuff[nummsg] + 1) = '\0';
-      nummsg++;
+    return;
+}
+/*--------------------------------------------------------------------------*/
+static char *ffxslot(FFerrstack *stack) /* IO - error stack */
+/*
+  return the buffer for a new message at the top of the stack, first
+  dropping the oldest message if all the buffers are in use.
+*/
+{
+    char *buff;
 
+    if (stack->nummsg == errmsgsiz)
+    {
+        /* buffers full; reuse oldest buffer */
+        stack->first = (stack->first + 1) % errmsgsiz;
+        stack->nummsg--;
     }
 
-    FFUNLOCK;
-    return;
+    buff = ERRSLOT(stack, stack->nummsg);
+    buff[80] = '\0';
+    stack->nummsg++;
+    return(buff);
 }
 /*--------------------------------------------------------------------------*/
 int ffpxsz(int datatype)
@@ -4348,7 +4472,7 @@ int ffrhdu(fitsfile *fptr,    /* I - FITS file pointer */
   structure elements that describe the format of the HDU
 */
 {
-    int ii, tstatus;
+    int ii, tstatus = 0;
     char card[FLEN_CARD];
     char name[FLEN_KEYWORD], value[FLEN_VALUE], comm[FLEN_COMMENT];
     char xname[FLEN_VALUE], *xtension, urltype[20];
@@ -4356,6 +4480,10 @@ int ffrhdu(fitsfile *fptr,    /* I - FITS file pointer */
     if (*status > 0)
         return(*status);
 
+    /* reuse the saved descriptors if this HDU has been read before */
+    if (ffhcload(fptr->Fptr, hdutype))
+        return(*status);
+
     if (ffgrec(fptr, 1, card, status) > 0 )  /* get the 80-byte card */
     {
         ffpmsg("Cannot read first keyword in header (ffrhdu).");
@@ -4474,6 +4602,11 @@ int ffrhdu(fitsfile *fptr,    /* I - FITS file pointer */
                status);
         }
     }
+
+    /* save the descriptors, in case this HDU is read again */
+    if (*status <= 0 && tstatus != UNKNOWN_EXT)
+        ffhcsave(fptr->Fptr);
+
     return(*status);
 }
 /*--------------------------------------------------------------------------*/
@@ -4485,7 +4618,7 @@ int ffpinit(fitsfile *fptr,      /* I - FITS file pointer */
 */
 {
     int groups, tstatus, simple, bitpix, naxis, extend, nspace;
-    int ttype = 0, bytlen = 0, ii, ntilebins;
+    int ttype = 0, bytlen = 0, ii;
     long  pcount, gcount;
     LONGLONG naxes[999], npix, blank;
     double bscale, bzero;
@@ -4613,38 +4746,8 @@ int ffpinit(fitsfile *fptr,      /* I - FITS file pointer */
         (fptr->Fptr)->rowlength = 0;    /* rows have zero length */
         (fptr->Fptr)->tfield = 0;       /* table has no fields   */
 
-        /* free the tile-compressed image cache, if it exists */
-        if ((fptr->Fptr)->tilerow) {
-           ntilebins = 
-	    (((fptr->Fptr)->znaxis[0] - 1) / ((fptr->Fptr)->tilesize[0])) + 1;
-
-           for (ii = 0; ii < ntilebins; ii++) {
-             if ((fptr->Fptr)->tiledata[ii]) {
-	       free((fptr->Fptr)->tiledata[ii]);
-             }
-
-             if ((fptr->Fptr)->tilenullarray[ii]) {
-	       free((fptr->Fptr)->tilenullarray[ii]);
-             }
-            }
-	    
-	    free((fptr->Fptr)->tileanynull);
-	    free((fptr->Fptr)->tiletype);	   
-	    free((fptr->Fptr)->tiledatasize);
-	    free((fptr->Fptr)->tilenullarray);
-	    free((fptr->Fptr)->tiledata);
-	    free((fptr->Fptr)->tilerow);
-
-	    (fptr->Fptr)->tileanynull = 0;
-	    (fptr->Fptr)->tiletype = 0;	   
-	    (fptr->Fptr)->tiledatasize = 0;
-	    (fptr->Fptr)->tilenullarray = 0;
-	    (fptr->Fptr)->tiledata = 0;
-	    (fptr->Fptr)->tilerow = 0;
-        }
-
-        if ((fptr->Fptr)->tableptr)
-           free((fptr->Fptr)->tableptr); /* free memory for the old CHDU */
+        /* release the column descriptors and tile cache of the old CHDU */
+        ffhdureset(fptr->Fptr);
 
         (fptr->Fptr)->tableptr = 0;     /* set a null table structure pointer */
         (fptr->Fptr)->numrows = 0;
@@ -4666,41 +4769,10 @@ int ffpinit(fitsfile *fptr,      /* I - FITS file pointer */
         (fptr->Fptr)->rowlength = (npix + pcount) * bytlen; /* total size */
         (fptr->Fptr)->tfield = 2;  /* 2 fields: group params and the image */
 
-        /* free the tile-compressed image cache, if it exists */
-        if ((fptr->Fptr)->tilerow) {
-
-           ntilebins = 
-	    (((fptr->Fptr)->znaxis[0] - 1) / ((fptr->Fptr)->tilesize[0])) + 1;
-
-           for (ii = 0; ii < ntilebins; ii++) {
-             if ((fptr->Fptr)->tiledata[ii]) {
-	       free((fptr->Fptr)->tiledata[ii]);
-             }
-
-             if ((fptr->Fptr)->tilenullarray[ii]) {
-	       free((fptr->Fptr)->tilenullarray[ii]);
-             }
-            }
-	    
-	    free((fptr->Fptr)->tileanynull);
-	    free((fptr->Fptr)->tiletype);	   
-	    free((fptr->Fptr)->tiledatasize);
-	    free((fptr->Fptr)->tilenullarray);
-	    free((fptr->Fptr)->tiledata);
-	    free((fptr->Fptr)->tilerow);
-
-	    (fptr->Fptr)->tileanynull = 0;
-	    (fptr->Fptr)->tiletype = 0;	   
-	    (fptr->Fptr)->tiledatasize = 0;
-	    (fptr->Fptr)->tilenullarray = 0;
-	    (fptr->Fptr)->tiledata = 0;
-	    (fptr->Fptr)->tilerow = 0;
-        }
-
-        if ((fptr->Fptr)->tableptr)
-           free((fptr->Fptr)->tableptr); /* free memory for the old CHDU */
+        /* release the column descriptors and tile cache of the old CHDU */
+        ffhdureset(fptr->Fptr);
 
-        colptr = (tcolumn *) calloc(2, sizeof(tcolumn) ) ;
+        colptr = (tcolumn *) ffhdualloc(fptr->Fptr, 2 * sizeof(tcolumn));
 
         if (!colptr)
         {
@@ -4746,7 +4818,7 @@ int ffainit(fitsfile *fptr,      /* I - FITS file pointer */
 /*
   initialize the parameters defining the structure of an ASCII table 
 */
-    int  ii, nspace, ntilebins;
+    int  ii, nspace;
     long tfield;
     LONGLONG pcount, rowlen, nrows, tbcoln;
     tcolumn *colptr = 0;
@@ -4778,44 +4850,13 @@ int ffainit(fitsfile *fptr,      /* I - FITS file pointer */
     (fptr->Fptr)->rowlength = rowlen; /* store length of a row */
     (fptr->Fptr)->tfield = tfield; /* store number of table fields in row */
 
-     /* free the tile-compressed image cache, if it exists */
-     if ((fptr->Fptr)->tilerow) {
-
-           ntilebins = 
-	    (((fptr->Fptr)->znaxis[0] - 1) / ((fptr->Fptr)->tilesize[0])) + 1;
-
-           for (ii = 0; ii < ntilebins; ii++) {
-             if ((fptr->Fptr)->tiledata[ii]) {
-	       free((fptr->Fptr)->tiledata[ii]);
-             }
-
-             if ((fptr->Fptr)->tilenullarray[ii]) {
-	       free((fptr->Fptr)->tilenullarray[ii]);
-             }
-            }
-	    
-	    free((fptr->Fptr)->tileanynull);
-	    free((fptr->Fptr)->tiletype);	   
-	    free((fptr->Fptr)->tiledatasize);
-	    free((fptr->Fptr)->tilenullarray);
-	    free((fptr->Fptr)->tiledata);
-	    free((fptr->Fptr)->tilerow);
-
-	    (fptr->Fptr)->tileanynull = 0;
-	    (fptr->Fptr)->tiletype = 0;	   
-	    (fptr->Fptr)->tiledatasize = 0;
-	    (fptr->Fptr)->tilenullarray = 0;
-	    (fptr->Fptr)->tiledata = 0;
-	    (fptr->Fptr)->tilerow = 0;
-     }
-
-    if ((fptr->Fptr)->tableptr)
-       free((fptr->Fptr)->tableptr); /* free memory for the old CHDU */
+     /* release the column descriptors and tile cache of the old CHDU */
+     ffhdureset(fptr->Fptr);
 
     /* mem for column structures ; space is initialized = 0 */
     if (tfield > 0)
     {
-      colptr = (tcolumn *) calloc(tfield, sizeof(tcolumn) );
+      colptr = (tcolumn *) ffhdualloc(fptr->Fptr, tfield * sizeof(tcolumn));
       if (!colptr)
       {
         ffpmsg
@@ -4963,7 +5004,7 @@ int ffbinit(fitsfile *fptr,     /* I - FITS file pointer */
 /*
   initialize the parameters defining the structure of a binary table 
 */
-    int  ii, nspace, ntilebins;
+    int  ii, nspace;
     long tfield;
     LONGLONG pcount, rowlen, nrows, totalwidth;
     tcolumn *colptr = 0;
@@ -4987,44 +5028,13 @@ int ffbinit(fitsfile *fptr,     /* I - FITS file pointer */
     (fptr->Fptr)->rowlength =  rowlen; /* store length of a row */
     (fptr->Fptr)->tfield = tfield; /* store number of table fields in row */
 
-     /* free the tile-compressed image cache, if it exists */
-     if ((fptr->Fptr)->tilerow) {
-
-           ntilebins = 
-	    (((fptr->Fptr)->znaxis[0] - 1) / ((fptr->Fptr)->tilesize[0])) + 1;
-
-           for (ii = 0; ii < ntilebins; ii++) {
-             if ((fptr->Fptr)->tiledata[ii]) {
-	       free((fptr->Fptr)->tiledata[ii]);
-             }
-
-             if ((fptr->Fptr)->tilenullarray[ii]) {
-	       free((fptr->Fptr)->tilenullarray[ii]);
-             }
-            }
-	    
-	    free((fptr->Fptr)->tileanynull);
-	    free((fptr->Fptr)->tiletype);	   
-	    free((fptr->Fptr)->tiledatasize);
-	    free((fptr->Fptr)->tilenullarray);
-	    free((fptr->Fptr)->tiledata);
-	    free((fptr->Fptr)->tilerow);
-
-	    (fptr->Fptr)->tileanynull = 0;
-	    (fptr->Fptr)->tiletype = 0;	   
-	    (fptr->Fptr)->tiledatasize = 0;
-	    (fptr->Fptr)->tilenullarray = 0;
-	    (fptr->Fptr)->tiledata = 0;
-	    (fptr->Fptr)->tilerow = 0;
-     }
-
-    if ((fptr->Fptr)->tableptr)
-       free((fptr->Fptr)->tableptr); /* free memory for the old CHDU */
+     /* release the column descriptors and tile cache of the old CHDU */
+     ffhdureset(fptr->Fptr);
 
     /* mem for column structures ; space is initialized = 0  */
     if (tfield > 0)
     {
-      colptr = (tcolumn *) calloc(tfield, sizeof(tcolumn) );
+      colptr = (tcolumn *) ffhdualloc(fptr->Fptr, tfield * sizeof(tcolumn));
       if (!colptr)
       {
         ffpmsg
@@ -6636,6 +6646,449 @@ int ffpdes(fitsfile *fptr,  /* I - FITS file pointer                         */
     return(*status);
 }
 /*--------------------------------------------------------------------------*/
+/*
+  The metadata of the CHDU that lives only as long as the HDU is current
+  (the table column descriptors and the index arrays of the tile-compressed
+  image cache) is allocated from a per-file arena.  The arena is a list of
+  blocks that is reset in one step, without freeing the individual
+  allocations, whenever the CHDU is closed or reinitialized, so that moving
+  through the HDUs of a file does not repeatedly allocate and free many
+  small pieces of memory.  The newest block is always the largest, and
+  only it is kept when the arena is reset.
+*/
+
+typedef struct FFarenablock  /* block of memory in the HDU arena */
+{
+    struct FFarenablock *next;  /* next older block */
+    size_t size;                /* usable size of the block, in bytes */
+    size_t used;                /* number of bytes already allocated */
+} FFarenablock;
+
+#define FFARENA_ALIGN  16    /* alignment of each arena allocation */
+#define FFARENA_MINSIZE 4096 /* minimum size of an arena block */
+#define FFARENA_HEAD  ((sizeof(FFarenablock) + FFARENA_ALIGN - 1) / \
+                      FFARENA_ALIGN * FFARENA_ALIGN)
+
+/*--------------------------------------------------------------------------*/
+void *ffhdualloc(FITSfile *Fptr,  /* I - FITS file structure                */
+                 size_t nbytes)   /* I - number of bytes to allocate        */
+/*
+  Allocate zeroed memory for the metadata of the CHDU from the HDU arena of
+  the file.  The memory must not be freed; it remains valid until the next
+  call to ffhdureset or ffhdufree.  Returns NULL if out of memory.
+*/
+{
+    FFarenablock *block;
+    size_t size;
+    char *ptr;
+
+    nbytes = (nbytes + FFARENA_ALIGN - 1) / FFARENA_ALIGN * FFARENA_ALIGN;
+    if (nbytes == 0)
+        nbytes = FFARENA_ALIGN;
+
+    block = (FFarenablock *) Fptr->hduarena;
+
+    if (!block || block->size - block->used < nbytes)
+    {
+        /* add a new block, at least twice as large as the previous one */
+        size = FFARENA_MINSIZE;
+        if (block && size < 2 * block->size)
+            size = 2 * block->size;
+        if (size < nbytes)
+            size = nbytes;
+
+        block = (FFarenablock *) malloc(FFARENA_HEAD + size);
+        if (!block)
+            return(NULL);
+
+        block->next = (FFarenablock *) Fptr->hduarena;
+        block->size = size;
+        block->used = 0;
+        Fptr->hduarena = block;
+        (Fptr->arenablocks)++;
+    }
+
+    ptr = (char *) block + FFARENA_HEAD + block->used;
+    block->used += nbytes;
+    (Fptr->arenaallocs)++;
+
+    memset(ptr, 0, nbytes);
+    return(ptr);
+}
+/*--------------------------------------------------------------------------*/
+void ffhdureset(FITSfile *Fptr)  /* I - FITS file structure                 */
+/*
+  Release the metadata of the CHDU: free the cached uncompressed tiles of a
+  tile-compressed image and reset the HDU arena, which holds the table
+  column descriptors and the tile cache index arrays.
+*/
+{
+    FFarenablock *block, *next;
+    int ii, ntilebins;
+
+    /* free the tile-compressed image cache, if it exists */
+    if (Fptr->tilerow)
+    {
+        ntilebins = ((Fptr->znaxis[0] - 1) / (Fptr->tilesize[0])) + 1;
+
+        for (ii = 0; ii < ntilebins; ii++)
+        {
+            if (Fptr->tiledata[ii])
+                free(Fptr->tiledata[ii]);
+
+            if (Fptr->tilenullarray[ii])
+                free(Fptr->tilenullarray[ii]);
+        }
+    }
+
+    Fptr->tileanynull = 0;
+    Fptr->tiletype = 0;
+    Fptr->tiledatasize = 0;
+    Fptr->tilenullarray = 0;
+    Fptr->tiledata = 0;
+    Fptr->tilerow = 0;
+    Fptr->tableptr = 0;
+
+    /* keep only the newest (and largest) block of the arena */
+    block = (FFarenablock *) Fptr->hduarena;
+    if (block)
+    {
+        for (next = block->next; next; next = block->next)
+        {
+            block->next = next->next;
+            free(next);
+        }
+
+        block->used = 0;
+    }
+}
+/*--------------------------------------------------------------------------*/
+void ffhdufree(FITSfile *Fptr)  /* I - FITS file structure                  */
+/*
+  Release the metadata of the CHDU and free all the memory of the HDU
+  arena and of the HDU cache, when the file is closed.
+*/
+{
+    FFarenablock *block, *next;
+
+    ffhdureset(Fptr);
+    ffhcfree(Fptr);
+
+    for (block = (FFarenablock *) Fptr->hduarena; block; block = next)
+    {
+        next = block->next;
+        free(block);
+    }
+
+    Fptr->hduarena = 0;
+}
+/*--------------------------------------------------------------------------*/
+int ffghmc(fitsfile *fptr,  /* I - FITS file pointer                        */
+           long *nblocks,   /* O - number of blocks allocated from system   */
+           long *nallocs,   /* O - number of allocations made from arena    */
+           int *status)     /* IO - error status                            */
+/*
+  Return the number of memory blocks that have been allocated from the
+  system for the HDU metadata arena of the file, and the number of pieces
+  of HDU metadata that have been allocated from the arena, since the file
+  was opened.  These are shared by all the fitsfile pointers to the file.
+*/
+{
+    if (*status > 0)
+        return(*status);
+
+    if (nblocks)
+        *nblocks = (fptr->Fptr)->arenablocks;
+
+    if (nallocs)
+        *nallocs = (fptr->Fptr)->arenaallocs;
+
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+/*
+  When a file is opened READONLY, the descriptors of the last few HDUs that
+  were read (the header-derived elements of the FITSfile structure and the
+  table column descriptors) are saved in a small per-file cache, so that
+  moving back to one of these HDUs, e.g. when reading alternately from two
+  HDUs of the same file, does not re-read and re-parse the whole header.
+  The headers of a READONLY file cannot be modified, and the cache is
+  discarded as soon as the file has write access.
+*/
+
+#define NHDUCACHE 4  /* number of HDU descriptors saved per file */
+
+typedef struct       /* saved descriptors of one HDU */
+{
+    int hdunum;          /* HDU number (0 = primary array); -1 if unused */
+    unsigned long lastuse;  /* value of the cache clock when last used */
+    LONGLONG headstart;  /* byte offset to the start of the HDU */
+    LONGLONG nextstart;  /* byte offset to the start of the next HDU */
+    FITSfile hdu;        /* header-derived elements of the file structure */
+    tcolumn *colptr;     /* copy of the table column descriptors */
+    int maxcols;         /* allocated number of column descriptors */
+} FFhduslot;
+
+typedef struct       /* per-file cache of HDU descriptors */
+{
+    unsigned long clock;          /* incremented at each use of the cache */
+    FFhduslot slot[NHDUCACHE];
+} FFhducache;
+
+/*--------------------------------------------------------------------------*/
+static void ffhccopy(FITSfile *to,    /* O - structure to copy to   */
+                     FITSfile *from)  /* I - structure to copy from */
+/*
+  copy the elements of the FITSfile structure that are initialized from the
+  header keywords when the HDU is read by ffrhdu.  The compression
+  parameters are only copied if the HDU contains a compressed image, in the
+  same way as they are only set by ffrhdu in that case.
+*/
+{
+    to->hdutype = from->hdutype;
+    to->lasthdu = from->lasthdu;
+    to->headend = from->headend;
+    to->datastart = from->datastart;
+    to->imgdim = from->imgdim;
+    memcpy(to->imgnaxis, from->imgnaxis, sizeof(to->imgnaxis));
+    to->tfield = from->tfield;
+    to->origrows = from->origrows;
+    to->numrows = from->numrows;
+    to->rowlength = from->rowlength;
+    to->heapstart = from->heapstart;
+    to->heapsize = from->heapsize;
+    to->compressimg = from->compressimg;
+
+    if (!from->compressimg)
+        return;
+
+    to->compress_type = from->compress_type;
+    memcpy(to->tilesize, from->tilesize, sizeof(to->tilesize));
+    to->quantize_level = from->quantize_level;
+    to->quantize_method = from->quantize_method;
+    to->dither_seed = from->dither_seed;
+    memcpy(to->zcmptype, from->zcmptype, sizeof(to->zcmptype));
+    to->zbitpix = from->zbitpix;
+    to->zndim = from->zndim;
+    memcpy(to->znaxis, from->znaxis, sizeof(to->znaxis));
+    to->maxtilelen = from->maxtilelen;
+    to->maxelem = from->maxelem;
+    to->cn_compressed = from->cn_compressed;
+    to->cn_uncompressed = from->cn_uncompressed;
+    to->cn_gzip_data = from->cn_gzip_data;
+    to->cn_zscale = from->cn_zscale;
+    to->cn_zzero = from->cn_zzero;
+    to->cn_zblank = from->cn_zblank;
+    to->zscale = from->zscale;
+    to->zzero = from->zzero;
+    to->cn_bscale = from->cn_bscale;
+    to->cn_bzero = from->cn_bzero;
+    to->cn_actual_bzero = from->cn_actual_bzero;
+    to->zblank = from->zblank;
+    to->rice_blocksize = from->rice_blocksize;
+    to->rice_bytepix = from->rice_bytepix;
+    to->hcomp_scale = from->hcomp_scale;
+    to->hcomp_smooth = from->hcomp_smooth;
+}
+/*--------------------------------------------------------------------------*/
+static void ffhcsave(FITSfile *Fptr)  /* I - FITS file structure            */
+/*
+  save the descriptors of the CHDU, which has just been read by ffrhdu,
+  in the HDU cache of the file, replacing the least recently used entry
+  if the cache is full.
+*/
+{
+    FFhducache *cache;
+    FFhduslot *slot;
+    tcolumn *colptr;
+    int ii;
+
+    if (Fptr->writemode != READONLY)
+        return;
+
+    /* the quantize level of a compressed image may be overridden by the */
+    /* user, so don't save it in this case */
+    if (Fptr->compressimg && Fptr->request_quantize_level != 0.)
+        return;
+
+    cache = (FFhducache *) Fptr->hducache;
+    if (!cache)
+    {
+        cache = (FFhducache *) calloc(1, sizeof(FFhducache));
+        if (!cache)
+            return;   /* the cache is only an optimization; just skip it */
+
+        for (ii = 0; ii < NHDUCACHE; ii++)
+            cache->slot[ii].hdunum = -1;
+
+        Fptr->hducache = cache;
+    }
+
+    /* reuse the entry of this HDU, or else the least recently used entry */
+    slot = cache->slot;
+    for (ii = 0; ii < NHDUCACHE; ii++)
+    {
+        if (cache->slot[ii].hdunum == Fptr->curhdu)
+        {
+            slot = cache->slot + ii;
+            break;
+        }
+        else if (cache->slot[ii].lastuse < slot->lastuse)
+            slot = cache->slot + ii;
+    }
+
+    slot->hdunum = -1;
+
+    if (Fptr->tfield > slot->maxcols)
+    {
+        colptr = (tcolumn *) realloc(slot->colptr,
+                                     Fptr->tfield * sizeof(tcolumn));
+        if (!colptr)
+            return;
+
+        slot->colptr = colptr;
+        slot->maxcols = Fptr->tfield;
+    }
+
+    if (Fptr->tfield > 0)
+        memcpy(slot->colptr, Fptr->tableptr, Fptr->tfield * sizeof(tcolumn));
+
+    ffhccopy(&slot->hdu, Fptr);
+    slot->headstart = Fptr->headstart[Fptr->curhdu];
+    slot->nextstart = Fptr->headstart[Fptr->curhdu + 1];
+    slot->lastuse = ++(cache->clock);
+    slot->hdunum = Fptr->curhdu;
+}
+/*--------------------------------------------------------------------------*/
+static int ffhcload(FITSfile *Fptr,  /* I - FITS file structure             */
+                    int *hdutype)    /* O - type of HDU                     */
+/*
+  If the descriptors of the CHDU were saved in the HDU cache of the file,
+  then initialize the CHDU from them, in place of re-reading the header,
+  and return 1.  Otherwise return 0.
+*/
+{
+    FFhducache *cache;
+    FFhduslot *slot;
+    tcolumn *colptr = 0;
+    int ii;
+
+    cache = (FFhducache *) Fptr->hducache;
+    if (!cache)
+        return(0);
+
+    if (Fptr->writemode != READONLY)
+    {
+        /* the headers may now be modified, so discard the cache */
+        ffhcfree(Fptr);
+        return(0);
+    }
+
+    for (ii = 0; ii < NHDUCACHE; ii++)
+    {
+        slot = cache->slot + ii;
+        if (slot->hdunum == Fptr->curhdu &&
+            slot->headstart == Fptr->headstart[Fptr->curhdu])
+            break;
+    }
+
+    if (ii == NHDUCACHE)
+        return(0);
+
+    /* release the column descriptors and tile cache of the old CHDU */
+    ffhdureset(Fptr);
+
+    if (slot->hdu.tfield > 0)
+    {
+        colptr = (tcolumn *) ffhdualloc(Fptr,
+                             slot->hdu.tfield * sizeof(tcolumn));
+        if (!colptr)
+            return(0);  /* read the header in the normal way */
+
+        memcpy(colptr, slot->colptr, slot->hdu.tfield * sizeof(tcolumn));
+    }
+
+    ffhccopy(Fptr, &slot->hdu);
+    Fptr->tableptr = colptr;
+    Fptr->headstart[Fptr->curhdu + 1] = slot->nextstart;
+    Fptr->nextkey = Fptr->headstart[Fptr->curhdu];
+    slot->lastuse = ++(cache->clock);
+
+    if (hdutype != NULL)
+        *hdutype = Fptr->hdutype;
+
+    return(1);
+}
+/*--------------------------------------------------------------------------*/
+void ffhcclone(FITSfile *newFptr,  /* O - structure of the new reader       */
+               FITSfile *Fptr)     /* I - structure of the open file        */
+/*
+  copy the HDU cache of a READONLY file to the FITSfile structure of a new
+  independent reader of the same file (see ffropn), so that the reader does
+  not have to parse the headers of the HDUs that have already been read.
+  Entries that cannot be copied are simply left out.
+*/
+{
+    FFhducache *cache, *newcache;
+    FFhduslot *slot;
+    int ii;
+
+    cache = (FFhducache *) Fptr->hducache;
+    if (!cache || newFptr->hducache)
+        return;
+
+    newcache = (FFhducache *) calloc(1, sizeof(FFhducache));
+    if (!newcache)
+        return;
+
+    newcache->clock = cache->clock;
+
+    for (ii = 0; ii < NHDUCACHE; ii++)
+    {
+        slot = newcache->slot + ii;
+        *slot = cache->slot[ii];
+        slot->colptr = 0;
+        slot->maxcols = 0;
+
+        if (slot->hdunum >= 0 && slot->hdu.tfield > 0)
+        {
+            slot->colptr = (tcolumn *) malloc(slot->hdu.tfield * sizeof(tcolumn));
+            if (slot->colptr)
+            {
+                memcpy(slot->colptr, cache->slot[ii].colptr,
+                       slot->hdu.tfield * sizeof(tcolumn));
+                slot->maxcols = slot->hdu.tfield;
+            }
+            else
+                slot->hdunum = -1;
+        }
+    }
+
+    newFptr->hducache = newcache;
+}
+/*--------------------------------------------------------------------------*/
+static void ffhcfree(FITSfile *Fptr)  /* I - FITS file structure            */
+/*
+  free the HDU cache of the file
+*/
+{
+    FFhducache *cache;
+    int ii;
+
+    cache = (FFhducache *) Fptr->hducache;
+    if (!cache)
+        return;
+
+    for (ii = 0; ii < NHDUCACHE; ii++)
+    {
+        if (cache->slot[ii].colptr)
+            free(cache->slot[ii].colptr);
+    }
+
+    free(cache);
+    Fptr->hducache = 0;
+}
+/*--------------------------------------------------------------------------*/
 int ffchdu(fitsfile *fptr,      /* I - FITS file pointer */
            int *status)         /* IO - error status     */
 {
@@ -6645,7 +7098,7 @@ int ffchdu(fitsfile *fptr,      /* I - FITS file pointer */
     - check the data fill values, and rewrite them if not correct
 */
     char message[FLEN_ERRMSG];
-    int ii, stdriver, ntilebins;
+    int stdriver;
 
     /* reset position to the correct HDU if necessary */
     if (fptr->HDUposition != (fptr->Fptr)->curhdu)
@@ -6672,42 +7125,7 @@ int ffchdu(fitsfile *fptr,      /* I - FITS file pointer */
     {
 
     /* free memory for the CHDU structure only if no other files are using it */
-        if ((fptr->Fptr)->tableptr)
-        {
-            free((fptr->Fptr)->tableptr);
-           (fptr->Fptr)->tableptr = NULL;
-
-          /* free the tile-compressed image cache, if it exists */
-          if ((fptr->Fptr)->tilerow) {
-
-           ntilebins = 
-	    (((fptr->Fptr)->znaxis[0] - 1) / ((fptr->Fptr)->tilesize[0])) + 1;
-
-           for (ii = 0; ii < ntilebins; ii++) {
-             if ((fptr->Fptr)->tiledata[ii]) {
-	       free((fptr->Fptr)->tiledata[ii]);
-             }
-
-             if ((fptr->Fptr)->tilenullarray[ii]) {
-	       free((fptr->Fptr)->tilenullarray[ii]);
-             }
-            }
-	    
-	    free((fptr->Fptr)->tileanynull);
-	    free((fptr->Fptr)->tiletype);	   
-	    free((fptr->Fptr)->tiledatasize);
-	    free((fptr->Fptr)->tilenullarray);
-	    free((fptr->Fptr)->tiledata);
-	    free((fptr->Fptr)->tilerow);
-
-	    (fptr->Fptr)->tileanynull = 0;
-	    (fptr->Fptr)->tiletype = 0;	   
-	    (fptr->Fptr)->tiledatasize = 0;
-	    (fptr->Fptr)->tilenullarray = 0;
-	    (fptr->Fptr)->tiledata = 0;
-	    (fptr->Fptr)->tilerow = 0;
-          }
-        }
+        ffhdureset(fptr->Fptr);
     }
 
     if (*status > 0 && *status != NO_CLOSE_ERROR)
@@ -9891,4 +10309,116 @@ void *fits_recalloc(void *ptr, size_t old_num, size_t new_num, size_t size)
 	  (new_num - old_num)*size );
   return (newptr);
 }
+/*--------------------------------------------------------------------------*/
+int ffhtalloc(FFhandletable *table, /* IO - driver handle table           */
+              int *handle)          /* O - new handle                       */
+/*
+  allocate a handle in the table, reusing the most recently released
+  handle if there is one, and zero its entry.  The table grows by a new
+  chunk of entries when all the handles are in use.
+*/
+{
+    int chunk, status = 0;
+    long nentries;
 
+#ifdef _REENTRANT
+    pthread_mutex_lock(&table->lock);
+#endif
+
+    if (table->freehandle >= 0)
+    {
+        *handle = table->freehandle;
+        chunk = ffhtchunk(*handle);
+        table->freehandle = table->nextfree[chunk]
+            [*handle + FFHT_CHUNK0 - (FFHT_CHUNK0 << chunk)];
+    }
+    else
+    {
+        chunk = ffhtchunk(table->nhandles);
+
+        if (chunk >= FFHT_NCHUNK)
+        {
+            status = TOO_MANY_FILES;    /* too many files opened */
+        }
+        else if (!table->chunk[chunk])
+        {
+            nentries = (long) FFHT_CHUNK0 << chunk;
+            table->chunk[chunk] = (char *) malloc(nentries * table->entsize);
+            table->nextfree[chunk] = (int *) malloc(nentries * sizeof(int));
+
+            if (!table->chunk[chunk] || !table->nextfree[chunk])
+            {
+                free(table->chunk[chunk]);
+                free(table->nextfree[chunk]);
+                table->chunk[chunk] = 0;
+                table->nextfree[chunk] = 0;
+                status = MEMORY_ALLOCATION;
+            }
+        }
+
+        if (!status)
+            *handle = (table->nhandles)++;
+    }
+
+#ifdef _REENTRANT
+    pthread_mutex_unlock(&table->lock);
+#endif
+
+    if (status)
+    {
+        *handle = -1;
+        return(status);
+    }
+
+    memset(ffhtentry(table, *handle), 0, table->entsize);
+    return(status);
+}
+/*--------------------------------------------------------------------------*/
+void ffhtfree(FFhandletable *table, /* IO - driver handle table           */
+              int handle)           /* I - handle to release                */
+/*
+  release a handle allocated by ffhtalloc
+*/
+{
+    int chunk;
+
+    chunk = ffhtchunk(handle);
+
+#ifdef _REENTRANT
+    pthread_mutex_lock(&table->lock);
+#endif
+    table->nextfree[chunk][handle + FFHT_CHUNK0 - (FFHT_CHUNK0 << chunk)] =
+        table->freehandle;
+    table->freehandle = handle;
+#ifdef _REENTRANT
+    pthread_mutex_unlock(&table->lock);
+#endif
+}
+/*--------------------------------------------------------------------------*/
+void *ffhtentry(FFhandletable *table, /* I - driver handle table          */
+                int handle)           /* I - handle                         */
+/*
+  return the address of the entry of an allocated handle
+*/
+{
+    int chunk;
+
+    chunk = ffhtchunk(handle);
+    return(table->chunk[chunk] + (size_t) (handle + FFHT_CHUNK0 -
+           (FFHT_CHUNK0 << chunk)) * table->entsize);
+}
+/*--------------------------------------------------------------------------*/
+static int ffhtchunk(int handle)
+/*
+  return the number of the chunk that holds the entry of a handle
+*/
+{
+    int chunk = 0;
+    unsigned long nn;
+
+    nn = (unsigned long) handle + FFHT_CHUNK0;
+    while (nn >= ((unsigned long) FFHT_CHUNK0 << (chunk + 1)))
+        chunk++;
+
+    return(chunk);
+}
@@ -450,6 +450,15 @@ typedef struct      /* structure used to store basic FITS file information */
     long bufrecnum[NIOBUF]; /* file record number of each of the buffers */
     int dirty[NIOBUF];     /* has the corresponding buffer been modified? */
     int ageindex[NIOBUF];  /* relative age of each buffer */  
+
+    void *openfile;         /* entry of this file in the registry of open files */
+
+    void *hduarena;         /* memory arena for the metadata of the CHDU */
+    long arenablocks;       /* number of arena blocks allocated from the system */
+    long arenaallocs;       /* number of allocations made from the arena */
+
+    void *hducache;         /* saved descriptors of recently read HDUs */
+    void *iosource;         /* driver handle shared with independent readers */
 } FITSfile;
 
 typedef struct         /* structure used to store basic HDU information */
@@ -479,6 +488,12 @@ typedef struct  /* structure for the iterator function column information */
 
 } iteratorCol;
 
+/* an expression compiled once by fits_compile_expr, to be evaluated on many HDUs */
+typedef struct fitsexpr_struct fitsexpr;
+
+/* an ASCII template compiled once by fits_compile_template, to create many files */
+typedef struct fitstemplate_struct fitstemplate;
+
 #define InputCol         0  /* flag for input only iterator column       */
 #define InputOutputCol   1  /* flag for input and output iterator column */
 #define OutputCol        2  /* flag for output only iterator column      */
@@ -554,6 +569,52 @@ int CFITS_API fits_read_wcstab(fitsfile *fptr, int nwtb, wtbarr *wtb, int *statu
 
 #endif /* WCSLIB_GETWCSTAB */
 
+/*=============================================================================
+*
+*       The following structs are the Apache Arrow C Data Interface, used by
+*       fits_read_arrow() and fits_write_arrow() to exchange binary table
+*       columns with Arrow-based applications.  They are defined here exactly
+*       as given in the Arrow specification, guarded by the macro that the
+*       specification reserves for this purpose, so that fitsio.h may be
+*       included together with the Arrow headers without conflict.
+*===========================================================================*/
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#include <stdint.h>
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  const char* format;           /* Array type description                   */
+  const char* name;             /* Optional name of the field               */
+  const char* metadata;         /* Optional binary-encoded metadata         */
+  int64_t flags;                /* Optional ARROW_FLAG_xxx flags            */
+  int64_t n_children;           /* Number of children                       */
+  struct ArrowSchema** children;
+  struct ArrowSchema* dictionary;
+  void (*release)(struct ArrowSchema*); /* Release callback                 */
+  void* private_data;           /* Opaque producer-specific data            */
+};
+
+struct ArrowArray {
+  int64_t length;               /* Number of logical elements               */
+  int64_t null_count;           /* Number of null elements, or -1           */
+  int64_t offset;               /* Logical offset into the buffers          */
+  int64_t n_buffers;            /* Number of physical buffers               */
+  int64_t n_children;           /* Number of children                       */
+  const void** buffers;
+  struct ArrowArray** children;
+  struct ArrowArray* dictionary;
+  void (*release)(struct ArrowArray*);  /* Release callback                 */
+  void* private_data;           /* Opaque producer-specific data            */
+};
+
+#endif /* ARROW_C_DATA_INTERFACE */
+
 /* error status codes */
 
 #define CREATE_DISK_FILE -106 /* create disk file, without extended filename syntax */
@@ -791,6 +852,7 @@ int CFITS_API fftopn(fitsfile **fptr, const char *filename, int iomode, int *sta
 int CFITS_API ffiopn(fitsfile **fptr, const char *filename, int iomode, int *status);
 int CFITS_API ffdkopn(fitsfile **fptr, const char *filename, int iomode, int *status);
 int CFITS_API ffreopen(fitsfile *openfptr, fitsfile **newfptr, int *status); 
+int CFITS_API ffropn(fitsfile *openfptr, fitsfile **newfptr, int *status);
 int CFITS_API ffinit(  fitsfile **fptr, const char *filename, int *status);
 int CFITS_API ffdkinit(fitsfile **fptr, const char *filename, int *status);
 int CFITS_API ffimem(fitsfile **fptr,  void **buffptr,
@@ -817,6 +879,8 @@ void CFITS_API ffpmrk(void);
 int  CFITS_API ffgmsg(char *err_message);
 void CFITS_API ffcmsg(void);
 void CFITS_API ffcmrk(void);
+int  CFITS_API ffgmid(void);
+int  CFITS_API ffgmsi(int stackid, char *err_message);
 void CFITS_API ffrprt(FILE *stream, int status);
 void CFITS_API ffcmps(char *templt, char *colname, int  casesen, int *match,
            int *exact);
@@ -1119,6 +1183,7 @@ int CFITS_API ffghadll(fitsfile *fptr, LONGLONG *headstart, LONGLONG *datastart,
            LONGLONG *dataend, int *status);
 int CFITS_API ffghof(fitsfile *fptr, OFF_T *headstart, OFF_T *datastart, OFF_T *dataend,
            int *status);
+int CFITS_API ffghmc(fitsfile *fptr, long *nblocks, long *nallocs, int *status);
 int CFITS_API ffgipr(fitsfile *fptr, int maxaxis, int *imgtype, int *naxis,
            long *naxes, int *status);
 int CFITS_API ffgiprll(fitsfile *fptr, int maxaxis, int *imgtype, int *naxis,
@@ -1146,6 +1211,8 @@ int CFITS_API ffitab(fitsfile *fptr, LONGLONG naxis1, LONGLONG naxis2, int tfiel
            long *tbcol, char **tform, char **tunit, const char *extname, int *status);
 int CFITS_API ffibin(fitsfile *fptr, LONGLONG naxis2, int tfields, char **ttype, char **tform,
            char **tunit, const char *extname, LONGLONG pcount, int *status);
+int CFITS_API ffparw(fitsfile *fptr, const char *extname, struct ArrowSchema *schema,
+           struct ArrowArray *array, int *status);
 int CFITS_API ffrsim(fitsfile *fptr, int bitpix, int naxis, long *naxes, int *status);
 int CFITS_API ffrsimll(fitsfile *fptr, int bitpix, int naxis, LONGLONG *naxes, int *status);
 int CFITS_API ffdhdu(fitsfile *fptr, int *hdutype, int *status);
@@ -1447,11 +1514,23 @@ int CFITS_API ffgcv( fitsfile *fptr, int datatype, int colnum, LONGLONG firstrow
            int  *status);
 int CFITS_API ffgcvn (fitsfile *fptr, int ncols, int *datatype, int *colnum, LONGLONG firstrow,
 	    LONGLONG nrows, void **nulval, void **array, int *anynul, int *status);
+int CFITS_API ffgcvv(fitsfile *fptr, int datatype, int colnum, LONGLONG firstrow,
+           LONGLONG nrows, void *nulval, LONGLONG *offsets, void *array,
+           int *anynul, int *status);
+int CFITS_API ffgarw(fitsfile *fptr, int ncols, int *colnum, LONGLONG firstrow,
+           LONGLONG nrows, struct ArrowSchema *schema, struct ArrowArray *array,
+           int *status);
 int CFITS_API ffgcf( fitsfile *fptr, int datatype, int colnum, LONGLONG firstrow,
            LONGLONG firstelem, LONGLONG nelem, void *array, char *nullarray,
            int *anynul, int *status);
 int CFITS_API ffgcvs(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
            LONGLONG nelem, char *nulval, char **array, int *anynul, int *status);
+int CFITS_API ffgcsp(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
+           LONGLONG nelem, char *buffer, LONGLONG *offsets, char *nularray,
+           int *anynul, int *status);
+int CFITS_API ffgcsw(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
+           LONGLONG nelem, long width, char *buffer, long *lengths,
+           char *nularray, int *anynul, int *status);
 int CFITS_API ffgcl (fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
            LONGLONG nelem, char *array, int  *status);
 int CFITS_API ffgcvl (fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
@@ -1498,6 +1577,8 @@ int CFITS_API ffgcxui(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG nr
             long firstbit, int nbits, unsigned short *array, int *status);
 int CFITS_API ffgcxuk(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG nrows,
             long firstbit, int nbits, unsigned int *array, int *status);
+int CFITS_API ffgcxp(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG nrows,
+            long firstbit, long nbits, unsigned char *array, int *status);
 
 int CFITS_API ffgcfs(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem, 
       LONGLONG nelem, char **array, char *nularray, int *anynul, int *status);
@@ -1760,6 +1841,10 @@ int CFITS_API ffpcln(fitsfile *fptr, int ncols, int *datatype, int *colnum, LONG
 	   LONGLONG nrows, void **array, void **nulval, int *status);
 int CFITS_API ffpcls(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
            LONGLONG nelem, char **array, int *status);
+int CFITS_API ffpcsp(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
+           LONGLONG nelem, char *buffer, LONGLONG *offsets, int *status);
+int CFITS_API ffpcsw(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
+           LONGLONG nelem, long width, char *buffer, long *lengths, int *status);
 int CFITS_API ffpcll(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
            LONGLONG nelem, char *array, int *status);
 int CFITS_API ffpclb(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
@@ -1795,6 +1880,8 @@ int CFITS_API ffpclujj(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG f
            LONGLONG nelem, ULONGLONG *array, int *status);
 int CFITS_API ffpclx(fitsfile *fptr, int colnum, LONGLONG frow, long fbit, long nbit,
             char *larray, int *status);
+int CFITS_API ffpcxp(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG nrows,
+            long firstbit, long nbits, unsigned char *array, int *status);
 
 int CFITS_API ffpcn(fitsfile *fptr, int datatype, int colnum, LONGLONG firstrow, LONGLONG firstelem,
           LONGLONG nelem, void *array, void *nulval, int *status);
@@ -1844,6 +1931,7 @@ int CFITS_API fficls(fitsfile *fptr, int firstcol, int ncols, char **ttype,
            char **tform, int *status);
 int CFITS_API ffmvec(fitsfile *fptr, int colnum, LONGLONG newveclen, int *status);
 int CFITS_API ffdcol(fitsfile *fptr, int numcol, int *status);
+int CFITS_API ffdcls(fitsfile *fptr, int ncols, int *colnums, int *status);
 int CFITS_API ffcpcl(fitsfile *infptr, fitsfile *outfptr, int incol, int outcol, 
            int create_col, int *status);
 int CFITS_API ffccls(fitsfile *infptr, fitsfile *outfptr, int incol, int outcol, 
@@ -1887,6 +1975,16 @@ int CFITS_API fffrow( fitsfile *infptr, char *expr,
 
 int CFITS_API ffffrw( fitsfile *fptr, char *expr, long *rownum, int *status);
 
+int CFITS_API fffrwl( fitsfile *fptr, char *expr, long firstrow, long nrows,
+            long maxgood, long *n_good_rows, long *rownums, int *status);
+int CFITS_API fffrwb( fitsfile *fptr, char *expr, long firstrow, long nrows,
+            long maxgood, long *n_good_rows, unsigned char *bitmap,
+            int *status);
+int CFITS_API fffrwp( fitsfile *fptr, char *expr, long firstrow, long nrows,
+            long maxgood, int ncols, int *colnum, int *datatype,
+            void **nulval, void **array, long *n_good_rows, long *rownums,
+            int *anynul, int *status);
+
 int CFITS_API fffrwc( fitsfile *fptr, char *expr, char *timeCol,    
             char *parCol, char *valCol, long ntimes,      
             double *times, char *time_status, int  *status );
@@ -1904,6 +2002,21 @@ int CFITS_API ffcalc_rng( fitsfile *infptr, char *expr, fitsfile *outfptr,
 
 int CFITS_API ffcalc( fitsfile *infptr, char *expr, fitsfile *outfptr,
             char *parName, char *parInfo, int *status );
+int CFITS_API ffcalc_multi( fitsfile *infptr, int ndefs, char **defs,
+            fitsfile *outfptr, char **parInfo, int nRngs, long *start,
+            long *end, int *status );
+
+int CFITS_API ffcexp( fitsfile *fptr, char *expr, fitsexpr **cexpr, int *status );
+int CFITS_API ffbexp( fitsexpr *cexpr, fitsfile *fptr, int *status );
+int CFITS_API fftcex( fitsexpr *cexpr, int maxdim, int *datatype, long *nelem,
+            int *naxis, long *naxes, int *status );
+int CFITS_API fffrwx( fitsexpr *cexpr, long firstrow, long nrows,
+            long *n_good_rows, char *row_status, int *status );
+int CFITS_API ffsrwx( fitsexpr *cexpr, fitsfile *outfptr, int *status );
+int CFITS_API ffcrwx( fitsexpr *cexpr, int datatype, long firstrow,
+            long nelements, void *nulval, void *array, int *anynul,
+            int *status );
+int CFITS_API fffexp( fitsexpr *cexpr, int *status );
 
   /* ffhist is not really intended as a user-callable routine */
   /* but it may be useful for some specialized applications   */
@@ -2003,6 +2116,8 @@ int CFITS_API ffgtam(fitsfile *gfptr, fitsfile *mfptr, int hdupos, int *status);
 int CFITS_API ffgtnm(fitsfile *gfptr, long *nmembers, int *status);
 int CFITS_API ffgmng(fitsfile *mfptr, long *nmembers, int *status);
 int CFITS_API ffgmop(fitsfile *gfptr, long member, fitsfile **mfptr, int *status);
+int CFITS_API ffgmops(fitsfile *gfptr, long firstmember, long nmembers,
+          fitsfile **mfptr, int *mstatus, int *status);
 int CFITS_API ffgmcp(fitsfile *gfptr, fitsfile *mfptr, long member, int cpopt, 
 	   int *status);
 int CFITS_API ffgmtf(fitsfile *infptr, fitsfile *outfptr,	long member, int tfopt,	       
@@ -2012,6 +2127,9 @@ int CFITS_API ffgmrm(fitsfile *fptr, long member, int rmopt, int *status);
 /*--------------------- group template parser routines ------------------*/
 
 int CFITS_API fits_execute_template(fitsfile *ff, char *ngp_template, int *status);
+int CFITS_API fits_compile_template(char *ngp_template, fitstemplate **tplt, int *status);
+int CFITS_API fits_execute_compiled_template(fitsfile *ff, fitstemplate *tplt, int *status);
+int CFITS_API fits_free_template(fitstemplate *tplt, int *status);
 
 int CFITS_API fits_img_stats_short(short *array,long nx, long ny, int nullcheck,   
     short nullvalue,long *ngoodpix, short *minvalue, short *maxvalue, double *mean,  
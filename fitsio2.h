@@ -29,6 +29,8 @@ extern int Fitsio_Pthread_Status;
 #define ffstrtok(str, tok, save) strtok_r(str, tok, save)
 
 #else
+#define FFLOCK1(lockname)
+#define FFUNLOCK1(lockname)
 #define FFLOCK
 #define FFUNLOCK
 #define ffstrtok(str, tok, save) strtok(str, tok)
@@ -50,10 +52,35 @@ extern int Fitsio_Pthread_Status;
 
 #define DBUFFSIZE 28800 /* size of data buffer in bytes */
 
-#define NMAXFILES  10000   /* maximum number of FITS files that can be opened */
-        /* CFITSIO will allocate (NMAXFILES * 80) bytes of memory */
-	/* plus each file that is opened will use NIOBUF * 2880 bytes of memeory */
-	/* where NIOBUF is defined in fitio.h and has a default value of 40 */
+#define NMAXFILES  10000   /* maximum number of Fortran unit numbers */
+	/* (the number of open FITS files is only limited by memory; */
+	/* each file that is opened will use NIOBUF * 2880 bytes of memeory */
+	/* where NIOBUF is defined in fitio.h and has a default value of 40) */
+
+/*
+   Growable table of I/O driver handles (see ffhtalloc in fitscore.c).
+   Chunk k holds FFHT_CHUNK0 << k entries; the chunks are never moved,
+   so the entry of a handle may be used without locking the table.
+*/
+#define FFHT_CHUNK0  256   /* number of entries in the first chunk */
+#define FFHT_NCHUNK  20    /* maximum number of chunks */
+
+typedef struct {
+    size_t entsize;                  /* size of each entry, in bytes */
+    char *chunk[FFHT_NCHUNK];        /* the entries */
+    int  *nextfree[FFHT_NCHUNK];     /* free list links of the entries */
+    int   nhandles;                  /* number of handles ever allocated */
+    int   freehandle;                /* first released handle, or -1 */
+#ifdef _REENTRANT
+    pthread_mutex_t lock;            /* protects allocation and release */
+#endif
+} FFhandletable;
+
+#ifdef _REENTRANT
+#define FFHT_INIT(entsize) {entsize, {0}, {0}, 0, -1, PTHREAD_MUTEX_INITIALIZER}
+#else
+#define FFHT_INIT(entsize) {entsize, {0}, {0}, 0, -1}
+#endif
 
 #define MINDIRECT 8640   /* minimum size for direct reads and writes */
                          /* MINDIRECT must have a value >= 8640 */
@@ -414,6 +441,9 @@ int ffwhbf(fitsfile *fptr, int *nbuff);
 int ffbfeof(fitsfile *fptr, int *status);
 int ffbfwt(FITSfile *Fptr, int nbuff, int *status);
 int ffpxsz(int datatype);
+int ffhtalloc(FFhandletable *table, int *handle);
+void ffhtfree(FFhandletable *table, int handle);
+void *ffhtentry(FFhandletable *table, int handle);
 
 int ffourl(char *url, char *urltype, char *outfile, char *tmplfile,
             char *compspec, int *status);
@@ -451,6 +481,13 @@ int ffhist2e(fitsfile **fptr, char *outfile, int imagetype, int naxis,
 	     char binname[4][FLEN_VALUE], 
 	     double weightin, char wtcol[FLEN_VALUE], char *wtexpr,           
 	     int recip, char *selectrow, int *status);
+int ffhist2ef(fitsfile **fptr, char *outfile, int imagetype, int naxis,
+	     char colname[4][FLEN_VALUE], char *colexpr[4], 
+	     double *minin, double *maxin, double *binsizein, 
+	     char minname[4][FLEN_VALUE], char maxname[4][FLEN_VALUE], 
+	     char binname[4][FLEN_VALUE], 
+	     double weightin, char wtcol[FLEN_VALUE], char *wtexpr,
+	     int recip, char *selectrow, char *rowfilter, int *status);
 int fits_calc_binningde(fitsfile *, int, char colname[4][FLEN_VALUE],
 	  char *colexpr[4], double *minin, double *maxin, double *binsizein,
           char minname[4][FLEN_VALUE], char maxname[4][FLEN_VALUE], char binname[4][FLEN_VALUE],			       
@@ -468,6 +505,10 @@ int ffpinit(fitsfile *fptr, int *status);
 int ffainit(fitsfile *fptr, int *status);
 int ffbinit(fitsfile *fptr, int *status);
 int ffchdu(fitsfile *fptr, int *status);
+void *ffhdualloc(FITSfile *Fptr, size_t nbytes);
+void ffhdureset(FITSfile *Fptr);
+void ffhdufree(FITSfile *Fptr);
+void ffhcclone(FITSfile *newFptr, FITSfile *Fptr);
 int ffwend(fitsfile *fptr, int *status);
 int ffpdfl(fitsfile *fptr, int *status);
 int ffuptf(fitsfile *fptr, int *status);
@@ -506,6 +547,14 @@ int ffgcls(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
 int ffgcls2(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
            LONGLONG nelem, int nultyp, char *nulval,
            char **array, char *nularray, int *anynul, int  *status);
+int ffcxpchk(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG nrows,
+           long firstbit, long nbits, char *routine, int *status);
+int ffgcsbuf(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
+           LONGLONG nelem, long width, char *buffer, LONGLONG *offsets,
+           long *lengths, char *nularray, int *anynul, int *status);
+int ffpcsbuf(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
+           LONGLONG nelem, long width, char *buffer, LONGLONG *offsets,
+           long *lengths, int *status);
 int ffgclb(fitsfile *fptr, int colnum, LONGLONG firstrow, LONGLONG firstelem,
            LONGLONG nelem, long  elemincre, int nultyp, unsigned char nulval,
            unsigned char *array, char *nularray, int *anynul, int  *status);
@@ -569,6 +618,8 @@ int ffcins(fitsfile *fptr, LONGLONG naxis1, LONGLONG naxis2, LONGLONG nbytes,
            LONGLONG bytepos, int *status);
 int ffcdel(fitsfile *fptr, LONGLONG naxis1, LONGLONG naxis2, LONGLONG nbytes,
            LONGLONG bytepos, int *status);
+int ffrwlay(fitsfile *fptr, LONGLONG naxis1, LONGLONG naxis2, LONGLONG newlen,
+           int nseg, LONGLONG *srcpos, LONGLONG *seglen, int *status);
 int ffkshf(fitsfile *fptr, int firstcol, int tfields, int nshift, int *status);
 int fffvcl(fitsfile *fptr, int *nvarcols, int *colnums, int *status);
  
@@ -1236,6 +1287,10 @@ int mem_compress_open(char *filename, int rwmode, int *hdl);
 int mem_compress_stdin_open(char *filename, int rwmode, int *hdl);
 int mem_zuncompress_and_write(int hdl, void *buffer, long nbytes);
 int mem_iraf_open(char *filename, int rwmode, int *hdl);
+int mem_iraf_truncate(int handle, LONGLONG filesize);
+int mem_iraf_close(int handle);
+int mem_iraf_read(int hdl, void *buffer, long nbytes);
+int mem_iraf_write(int hdl, void *buffer, long nbytes);
 int mem_rawfile_open(char *filename, int rwmode, int *hdl);
 int mem_size(int handle, LONGLONG *filesize);
 int mem_truncate(int handle, LONGLONG filesize);
@@ -1249,6 +1304,11 @@ int mem_uncompress2mem(char *filename, FILE *diskfile, int hdl);
 
 int iraf2mem(char *filename, char **buffptr, size_t *buffsize, 
       size_t *filesize, int *status);
+int irafopenpix(char *filename, char **buffptr, size_t *buffsize,
+      size_t *headsize, size_t *filesize, void **pixfile, int *status);
+int irafreadpix(void *pixfile, LONGLONG offset, char *buffer, long nbytes,
+      int *status);
+void irafclosepix(void *pixfile);
 
 /* root driver I/O routines */
 
@@ -7,8 +7,24 @@
 /*  Goddard Space Flight Center.                                           */
 
 #include <stdlib.h>
+#include <string.h>
 #include "fitsio2.h"
 
+/* a contiguous extent of heap bytes belonging to one row (used by ffgcvv) */
+typedef struct {
+    LONGLONG addr;     /* heap address of the first byte               */
+    LONGLONG nbytes;   /* length of the extent, in bytes               */
+    LONGLONG outpos;   /* position of the first value in output array  */
+} VLAextent;
+
+/* maximum number of heap bytes that ffgcvv reads with a single call */
+#define VLA_MAX_SPAN (100 * (LONGLONG) DBUFFSIZE)
+
+static int ffcmpvlaext(const void *e1, const void *e2);
+static int ffcvtvla(int tcode, void *input, long ntodo, double scale,
+            double zero, int nulcheck, LONGLONG tnull, int datatype,
+            void *nulval, void *output, int *anynul, int *status);
+
 /*--------------------------------------------------------------------------*/
 int ffgpxv( fitsfile *fptr,   /* I - FITS file pointer                       */
             int  datatype,    /* I - datatype of the value                   */
@@ -1100,6 +1116,610 @@ int ffgcvn( fitsfile *fptr,   /* I - FITS file pointer                       */
     return *status;
 }
 
+/*--------------------------------------------------------------------------*/
+int ffgcvv( fitsfile *fptr,   /* I - FITS file pointer                       */
+            int  datatype,    /* I - datatype of the returned values         */
+            int  colnum,      /* I - number of column to read (1 = 1st col)  */
+            LONGLONG  firstrow,   /* I - first row to read (1 = 1st row)     */
+            LONGLONG nrows,       /* I - number of rows to read              */
+            void *nulval,     /* I - value for undefined pixels              */
+            LONGLONG *offsets, /* O - array of nrows+1 starting offsets      */
+            void *array,      /* O - flat array of all the returned values   */
+            int  *anynul,     /* O - set to 1 if any values are null; else 0 */
+            int  *status)     /* IO - error status                           */
+/*
+  Read the variable length arrays in NROWS consecutive rows of a column
+  into a single flat output array.  The values for row (firstrow + i) are
+  returned in array[offsets[i]] through array[offsets[i+1] - 1], so the
+  offsets array must have room for nrows+1 elements.  If array = NULL, then
+  only the offsets are returned; offsets[nrows] is then the total number of
+  elements that the array must be able to hold.
+
+  This is an optimization for reading many rows of a variable length column.
+  All the descriptors are read in one pass through the table, then the heap
+  extents are sorted by address and nearby extents are read from the heap
+  with large contiguous reads rather than one small read per row.  Data
+  conversion, scaling, and null value handling are the same as in ffgcv.
+*/
+{
+    LONGLONG *heapaddr = 0, rowlen, bytepos, ii, nlen, elemnum;
+    LONGLONG heapstart, spanstart, spanend, spanmax, maxspan, nspan = 0;
+    LONGLONG tnull;
+    long ntodo, ndesc, jj, kk, nextent = 0, esize, outsize;
+    int tcode, dsize, nulcheck, tanynul;
+    char *spanbuf = 0, message[FLEN_ERRMSG];
+    double cbuff[DBUFFSIZE / sizeof(double)]; /* align cbuff on word boundary */
+    unsigned char *dbuff = (unsigned char *) cbuff;
+    VLAextent *extent = 0;
+    tcolumn *colptr;
+
+    if (*status > 0)
+        return(*status);
+
+    if (anynul)
+        *anynul = 0;
+
+    /* reset position to the correct HDU if necessary */
+    if (fptr->HDUposition != (fptr->Fptr)->curhdu)
+        ffmahd(fptr, (fptr->HDUposition) + 1, NULL, status);
+    else if ((fptr->Fptr)->datastart == DATA_UNDEFINED)
+        if ( ffrdef(fptr, status) > 0)               /* rescan header */
+            return(*status);
+
+    if ((fptr->Fptr)->hdutype != BINARY_TBL)
+        return(*status = NOT_BTABLE);
+
+    if (colnum < 1 || colnum > (fptr->Fptr)->tfield)
+        return(*status = BAD_COL_NUM);
+
+    if (firstrow < 1 || nrows < 0 ||
+        firstrow + nrows - 1 > (fptr->Fptr)->numrows)
+    {
+        ffpmsg("Attempt to read past end of table (ffgcvv)");
+        return(*status = BAD_ROW_NUM);
+    }
+
+    colptr = (fptr->Fptr)->tableptr;  /* point to first column structure */
+    colptr += (colnum - 1);           /* offset to the correct column */
+
+    if (colptr->tdatatype >= 0)
+        return(*status = NOT_VARI_LEN);
+
+    offsets[0] = 0;
+    if (nrows == 0)
+        return(*status);
+
+    heapaddr = (LONGLONG *) malloc((size_t) nrows * sizeof(LONGLONG));
+    if (!heapaddr)
+    {
+        ffpmsg("malloc failed for heap address array (ffgcvv)");
+        return(*status = MEMORY_ALLOCATION);
+    }
+
+    /*--------------------------------------------------------------------*/
+    /*  Read all the descriptors, a buffer full of rows at a time.  The   */
+    /*  lengths are temporarily stored in offsets[1] - offsets[nrows].    */
+    /*--------------------------------------------------------------------*/
+    if (colptr->tform[0] == 'P' || colptr->tform[1] == 'P')
+        dsize = 8;
+    else
+        dsize = 16;
+
+    rowlen = (fptr->Fptr)->rowlength;
+    bytepos = (fptr->Fptr)->datastart + (rowlen * (firstrow - 1)) +
+              colptr->tbcol;
+
+    for (ii = 0; ii < nrows; ii += ndesc)
+    {
+        ndesc = (long) minvalue(nrows - ii, DBUFFSIZE / dsize);
+
+        ffmbyt(fptr, bytepos, REPORT_EOF, status);
+        ffgbytoff(fptr, dsize, ndesc, (long) (rowlen - dsize), dbuff, status);
+        if (*status > 0)
+        {
+            free(heapaddr);
+            return(*status);
+        }
+
+        if (dsize == 8)
+        {
+#if BYTESWAPPED
+            ffswap4((INT32BIT *) dbuff, ndesc * 2);
+#endif
+            for (jj = 0; jj < ndesc; jj++)
+            {
+                offsets[ii + jj + 1] = ((unsigned int *) dbuff)[jj * 2];
+                heapaddr[ii + jj]    = ((unsigned int *) dbuff)[jj * 2 + 1];
+            }
+        }
+        else
+        {
+#if BYTESWAPPED
+            ffswap8((double *) dbuff, ndesc * 2);
+#endif
+            for (jj = 0; jj < ndesc; jj++)
+            {
+                offsets[ii + jj + 1] = ((LONGLONG *) dbuff)[jj * 2];
+                heapaddr[ii + jj]    = ((LONGLONG *) dbuff)[jj * 2 + 1];
+            }
+        }
+        bytepos += rowlen * ndesc;
+    }
+
+    /* convert the lengths into starting offsets */
+    for (ii = 0; ii < nrows; ii++)
+    {
+        if (offsets[ii + 1] > 0)
+            nextent++;
+        offsets[ii + 1] += offsets[ii];
+    }
+
+    if (!array || nextent == 0)  /* caller only wants the offsets */
+    {
+        free(heapaddr);
+        return(*status);
+    }
+
+    /*--------------------------------------------------------------------*/
+    /*  The fast path below only handles numeric columns read into one of */
+    /*  the common numeric datatypes.  Everything else is read row by row */
+    /*  with ffgcv, which is slower but handles all the special cases.    */
+    /*--------------------------------------------------------------------*/
+    tcode = -(colptr->tdatatype);
+
+    switch (tcode)
+    {
+        case TBYTE:      esize = 1; break;
+        case TSHORT:     esize = 2; break;
+        case TLONG:
+        case TFLOAT:     esize = 4; break;
+        case TLONGLONG:
+        case TDOUBLE:    esize = 8; break;
+        default:         esize = 0;
+    }
+
+    switch (datatype)
+    {
+        case TBIT:
+        case TBYTE:
+        case TSBYTE:
+        case TLOGICAL:   outsize = 1; break;
+        case TUSHORT:
+        case TSHORT:     outsize = sizeof(short); break;
+        case TUINT:
+        case TINT:       outsize = sizeof(int); break;
+        case TULONG:
+        case TLONG:      outsize = sizeof(long); break;
+        case TULONGLONG:
+        case TLONGLONG:  outsize = sizeof(LONGLONG); break;
+        case TFLOAT:     outsize = sizeof(float); break;
+        case TDOUBLE:    outsize = sizeof(double); break;
+        case TCOMPLEX:   outsize = 2 * sizeof(float); break;
+        case TDBLCOMPLEX: outsize = 2 * sizeof(double); break;
+        default:
+            ffpmsg("Cannot read variable length arrays as TSTRING (ffgcvv)");
+            free(heapaddr);
+            return(*status = BAD_DATATYPE);
+    }
+
+    if (esize == 0 || (datatype != TBYTE && datatype != TSHORT &&
+        datatype != TINT && datatype != TLONG && datatype != TLONGLONG &&
+        datatype != TFLOAT && datatype != TDOUBLE))
+    {
+        free(heapaddr);
+
+        for (ii = 0; ii < nrows; ii++)
+        {
+            nlen = offsets[ii + 1] - offsets[ii];
+            if (nlen == 0)
+                continue;
+
+            tanynul = 0;
+            if (ffgcv(fptr, datatype, colnum, firstrow + ii, 1, nlen, nulval,
+                (char *) array + offsets[ii] * outsize, &tanynul, status) > 0)
+            {
+                snprintf(message, FLEN_ERRMSG,
+                  "Failed to read row %.0f of column %d (ffgcvv)",
+                   (double) (firstrow + ii), colnum);
+                ffpmsg(message);
+                return(*status);
+            }
+            if (anynul && tanynul)
+                *anynul = 1;
+        }
+        return(*status);
+    }
+
+    /*------------------------------------------------------------------*/
+    /*  Decide whether to check for null values in the input FITS file: */
+    /*------------------------------------------------------------------*/
+    tnull = colptr->tnull;
+    nulcheck = (nulval != 0);
+
+    if (tcode%10 == 1 &&             /* if reading an integer column, and  */
+        tnull == NULL_UNDEFINED)     /* if a null value is not defined,    */
+        nulcheck = 0;                /* then do not check for null values. */
+
+    else if (tcode == TSHORT && (tnull > SHRT_MAX || tnull < SHRT_MIN) )
+        nulcheck = 0;                /* Impossible null value */
+
+    else if (tcode == TBYTE && (tnull > 255 || tnull < 0) )
+        nulcheck = 0;                /* Impossible null value */
+
+    /*---------------------------------------------------------------------*/
+    /*  Sort the non-empty heap extents by address, so that the heap can   */
+    /*  be read sequentially and adjacent (or nearly adjacent) extents can */
+    /*  be merged into a single large read.                                */
+    /*---------------------------------------------------------------------*/
+    extent = (VLAextent *) malloc(nextent * sizeof(VLAextent));
+    if (!extent)
+    {
+        ffpmsg("malloc failed for heap extent array (ffgcvv)");
+        free(heapaddr);
+        return(*status = MEMORY_ALLOCATION);
+    }
+
+    for (ii = 0, jj = 0; ii < nrows; ii++)
+    {
+        nlen = offsets[ii + 1] - offsets[ii];
+        if (nlen == 0)
+            continue;
+
+        if (heapaddr[ii] < 0 ||
+            heapaddr[ii] + nlen * esize > (fptr->Fptr)->heapsize)
+        {
+            snprintf(message, FLEN_ERRMSG,
+             "Row %.0f of column %d points past the end of the heap (ffgcvv)",
+              (double) (firstrow + ii), colnum);
+            ffpmsg(message);
+            free(extent);
+            free(heapaddr);
+            return(*status = BAD_HEAP_PTR);
+        }
+
+        extent[jj].addr = heapaddr[ii];
+        extent[jj].nbytes = nlen * esize;
+        extent[jj].outpos = offsets[ii];
+        jj++;
+    }
+    free(heapaddr);
+
+    qsort(extent, nextent, sizeof(VLAextent), ffcmpvlaext);
+
+    heapstart = (fptr->Fptr)->datastart + (fptr->Fptr)->heapstart;
+    maxspan = VLA_MAX_SPAN;
+
+    for (jj = 0; jj < nextent; jj = kk)
+    {
+        /* merge the following extents into this span, as long as the gap */
+        /* is less than one FITS block and the span does not get too big   */
+        spanstart = extent[jj].addr;
+        spanend = spanstart + extent[jj].nbytes;
+        for (kk = jj + 1; kk < nextent; kk++)
+        {
+            if (extent[kk].addr > spanend + IOBUFLEN)
+                break;
+
+            spanmax = maxvalue(spanend, extent[kk].addr + extent[kk].nbytes);
+            if (spanmax - spanstart > maxspan)
+                break;
+
+            spanend = spanmax;
+        }
+
+        if (spanend - spanstart > nspan)
+        {
+            free(spanbuf);
+            nspan = maxvalue(spanend - spanstart, maxspan);
+            spanbuf = (char *) malloc((size_t) nspan);
+            if (!spanbuf)
+            {
+                ffpmsg("malloc failed for heap read buffer (ffgcvv)");
+                free(extent);
+                return(*status = MEMORY_ALLOCATION);
+            }
+        }
+
+        ffmbyt(fptr, heapstart + spanstart, REPORT_EOF, status);
+        if (ffgbyt(fptr, spanend - spanstart, spanbuf, status) > 0)
+        {
+            ffpmsg("Error reading variable length arrays from heap (ffgcvv)");
+            break;
+        }
+
+        /* convert each extent in this span, a buffer full at a time */
+        for (ii = jj; ii < kk && *status <= 0; ii++)
+        {
+            nlen = extent[ii].nbytes / esize;
+            for (elemnum = 0; elemnum < nlen; elemnum += ntodo)
+            {
+                ntodo = (long) minvalue(nlen - elemnum, DBUFFSIZE / esize);
+
+                /* copy to an aligned buffer; extents may also overlap */
+                memcpy(cbuff, spanbuf + (extent[ii].addr - spanstart) +
+                       elemnum * esize, ntodo * esize);
+
+#if BYTESWAPPED
+                if (esize == 2)
+                    ffswap2((short *) cbuff, ntodo);
+                else if (esize == 4)
+                    ffswap4((INT32BIT *) cbuff, ntodo);
+                else if (esize == 8)
+                    ffswap8(cbuff, ntodo);
+#endif
+                tanynul = 0;
+                ffcvtvla(tcode, cbuff, ntodo, colptr->tscale, colptr->tzero,
+                    nulcheck, tnull, datatype, nulval,
+                    (char *) array + (extent[ii].outpos + elemnum) * outsize,
+                    &tanynul, status);
+
+                if (anynul && tanynul)
+                    *anynul = 1;
+            }
+        }
+
+        if (*status > 0)
+            break;
+    }
+
+    free(spanbuf);
+    free(extent);
+
+    if (*status == OVERFLOW_ERR)
+    {
+        ffpmsg(
+        "Numerical overflow during type conversion while reading FITS data.");
+        *status = NUM_OVERFLOW;
+    }
+
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+static int ffcmpvlaext(const void *e1, const void *e2)
+/*
+  qsort comparison function: order heap extents by heap address
+*/
+{
+    const VLAextent *a = (const VLAextent *) e1;
+    const VLAextent *b = (const VLAextent *) e2;
+
+    if (a->addr < b->addr)
+        return(-1);
+    else if (a->addr > b->addr)
+        return(1);
+    else
+        return(0);
+}
+/*--------------------------------------------------------------------------*/
+static int ffcvtvla(int tcode,      /* I - datatype code of the heap values   */
+            void *input,            /* I - native byte order heap values      */
+            long ntodo,             /* I - number of values to convert        */
+            double scale,           /* I - FITS TSCALn value                  */
+            double zero,            /* I - FITS TZEROn value                  */
+            int nulcheck,           /* I - 1 = check for null values          */
+            LONGLONG tnull,         /* I - value of FITS TNULLn keyword       */
+            int datatype,           /* I - datatype of the output values      */
+            void *nulval,           /* I - value for undefined pixels         */
+            void *output,           /* O - converted values                   */
+            int *anynul,            /* O - set to 1 if any values are null    */
+            int *status)            /* IO - error status                      */
+/*
+  Convert a buffer of heap values to the output datatype with the fffXXYY
+  routines, applying the scaling and null value checks.  Only the numeric
+  column and output types that are accepted by the ffgcvv fast path are
+  supported here.
+*/
+{
+    char cdummy;
+
+    switch (datatype)
+    {
+      case TBYTE:
+      {
+        unsigned char nv = nulval ? *(unsigned char *) nulval : 0;
+        unsigned char *out = (unsigned char *) output;
+        int nc = nulcheck && nv != 0;
+
+        switch (tcode)
+        {
+          case TBYTE:  fffi1i1((unsigned char *) input, ntodo, scale, zero, nc,
+                         (unsigned char) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TSHORT: fffi2i1((short *) input, ntodo, scale, zero, nc,
+                         (short) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONG:  fffi4i1((INT32BIT *) input, ntodo, scale, zero, nc,
+                         (INT32BIT) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONGLONG: fffi8i1((LONGLONG *) input, ntodo, scale, zero, nc,
+                         tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TFLOAT: fffr4i1((float *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+          case TDOUBLE: fffr8i1((double *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+        }
+        break;
+      }
+      case TSHORT:
+      {
+        short nv = nulval ? *(short *) nulval : 0;
+        short *out = (short *) output;
+        int nc = nulcheck && nv != 0;
+
+        switch (tcode)
+        {
+          case TBYTE:  fffi1i2((unsigned char *) input, ntodo, scale, zero, nc,
+                         (unsigned char) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TSHORT: fffi2i2((short *) input, ntodo, scale, zero, nc,
+                         (short) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONG:  fffi4i2((INT32BIT *) input, ntodo, scale, zero, nc,
+                         (INT32BIT) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONGLONG: fffi8i2((LONGLONG *) input, ntodo, scale, zero, nc,
+                         tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TFLOAT: fffr4i2((float *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+          case TDOUBLE: fffr8i2((double *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+        }
+        break;
+      }
+      case TINT:
+      {
+        int nv = nulval ? *(int *) nulval : 0;
+        int *out = (int *) output;
+        int nc = nulcheck && nv != 0;
+
+        switch (tcode)
+        {
+          case TBYTE:  fffi1int((unsigned char *) input, ntodo, scale, zero, nc,
+                         (unsigned char) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TSHORT: fffi2int((short *) input, ntodo, scale, zero, nc,
+                         (short) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONG:  fffi4int((INT32BIT *) input, ntodo, scale, zero, nc,
+                         (INT32BIT) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONGLONG: fffi8int((LONGLONG *) input, ntodo, scale, zero, nc,
+                         tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TFLOAT: fffr4int((float *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+          case TDOUBLE: fffr8int((double *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+        }
+        break;
+      }
+      case TLONG:
+      {
+        long nv = nulval ? *(long *) nulval : 0;
+        long *out = (long *) output;
+        int nc = nulcheck && nv != 0;
+
+        switch (tcode)
+        {
+          case TBYTE:  fffi1i4((unsigned char *) input, ntodo, scale, zero, nc,
+                         (unsigned char) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TSHORT: fffi2i4((short *) input, ntodo, scale, zero, nc,
+                         (short) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONG:  fffi4i4((INT32BIT *) input, ntodo, scale, zero, nc,
+                         (INT32BIT) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONGLONG: fffi8i4((LONGLONG *) input, ntodo, scale, zero, nc,
+                         tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TFLOAT: fffr4i4((float *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+          case TDOUBLE: fffr8i4((double *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+        }
+        break;
+      }
+      case TLONGLONG:
+      {
+        LONGLONG nv = nulval ? *(LONGLONG *) nulval : 0;
+        LONGLONG *out = (LONGLONG *) output;
+        int nc = nulcheck && nv != 0;
+
+        switch (tcode)
+        {
+          case TBYTE:  fffi1i8((unsigned char *) input, ntodo, scale, zero, nc,
+                         (unsigned char) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TSHORT: fffi2i8((short *) input, ntodo, scale, zero, nc,
+                         (short) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONG:  fffi4i8((INT32BIT *) input, ntodo, scale, zero, nc,
+                         (INT32BIT) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONGLONG: fffi8i8((LONGLONG *) input, ntodo, scale, zero, nc,
+                         tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TFLOAT: fffr4i8((float *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+          case TDOUBLE: fffr8i8((double *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+        }
+        break;
+      }
+      case TFLOAT:
+      {
+        float nv = nulval ? *(float *) nulval : 0;
+        float *out = (float *) output;
+        int nc = nulcheck && nv != 0;
+
+        switch (tcode)
+        {
+          case TBYTE:  fffi1r4((unsigned char *) input, ntodo, scale, zero, nc,
+                         (unsigned char) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TSHORT: fffi2r4((short *) input, ntodo, scale, zero, nc,
+                         (short) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONG:  fffi4r4((INT32BIT *) input, ntodo, scale, zero, nc,
+                         (INT32BIT) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONGLONG: fffi8r4((LONGLONG *) input, ntodo, scale, zero, nc,
+                         tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TFLOAT: fffr4r4((float *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+          case TDOUBLE: fffr8r4((double *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+        }
+        break;
+      }
+      case TDOUBLE:
+      {
+        double nv = nulval ? *(double *) nulval : 0;
+        double *out = (double *) output;
+        int nc = nulcheck && nv != 0;
+
+        switch (tcode)
+        {
+          case TBYTE:  fffi1r8((unsigned char *) input, ntodo, scale, zero, nc,
+                         (unsigned char) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TSHORT: fffi2r8((short *) input, ntodo, scale, zero, nc,
+                         (short) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONG:  fffi4r8((INT32BIT *) input, ntodo, scale, zero, nc,
+                         (INT32BIT) tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TLONGLONG: fffi8r8((LONGLONG *) input, ntodo, scale, zero, nc,
+                         tnull, nv, &cdummy, anynul, out, status);
+                       break;
+          case TFLOAT: fffr4r8((float *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+          case TDOUBLE: fffr8r8((double *) input, ntodo, scale, zero, nc,
+                         nv, &cdummy, anynul, out, status);
+                       break;
+        }
+        break;
+      }
+    }
+    return(*status);
+}
 /*--------------------------------------------------------------------------*/
 int ffgcf(  fitsfile *fptr,   /* I - FITS file pointer                       */
             int  datatype,    /* I - datatype of the value                   */
@@ -362,10 +362,10 @@ int ffgcxui(fitsfile *fptr,   /* I - FITS file pointer                       */
   which ever is less.
 */
 {
-    int ii, firstbit, nbits, bytenum, startbit, numbits, endbit;
-    int firstbyte, lastbyte, nbytes, rshift, lshift;
-    unsigned short colbyte[5];
-    tcolumn *colptr;
+    int jj, nbytes;
+    LONGLONG ii, row, ntodo;
+    unsigned int value;
+    unsigned char packed[DBUFFSIZE];
     char message[FLEN_ERRMSG];
 
     if (*status > 0 || nrows == 0)
@@ -394,89 +394,28 @@ int ffgcxui(fitsfile *fptr,   /* I - FITS file pointer                       */
           return(*status = BAD_ELEM_NUM);
     }
 
-    /* position to the correct HDU */
-    if (fptr->HDUposition != (fptr->Fptr)->curhdu)
-        ffmahd(fptr, (fptr->HDUposition) + 1, NULL, status);
-
-    /* rescan header if data structure is undefined */
-    else if ((fptr->Fptr)->datastart == DATA_UNDEFINED)
-        if ( ffrdef(fptr, status) > 0)               
-            return(*status);
-
-    if ((fptr->Fptr)->hdutype != BINARY_TBL)
-    {
-        ffpmsg("This is not a binary table extension (ffgcxui)");
-        return(*status = NOT_BTABLE);
-    }
-
-    if (colnum > (fptr->Fptr)->tfield)
-    {
-      snprintf(message, FLEN_ERRMSG,"Specified column number is out of range: %d (ffgcxui)",
-                colnum);
-        ffpmsg(message);
-        snprintf(message, FLEN_ERRMSG,"  There are %d columns in this table.",
-                (fptr->Fptr)->tfield );
-        ffpmsg(message);
-
-        return(*status = BAD_COL_NUM);
-    }       
-
-    colptr  = (fptr->Fptr)->tableptr;   /* point to first column */
-    colptr += (colnum - 1);     /* offset to correct column structure */
-
-    if (abs(colptr->tdatatype) > TBYTE)
-    {
-        ffpmsg("Can only read bits from X or B type columns. (ffgcxui)");
-        return(*status = NOT_LOGICAL_COL); /* not correct datatype column */
-    }
-
-    firstbyte = (input_first_bit - 1              ) / 8 + 1;
-    lastbyte  = (input_first_bit + input_nbits - 2) / 8 + 1;
-    nbytes = lastbyte - firstbyte + 1;
+    nbytes = (input_nbits + 7) / 8;
 
-    if (colptr->tdatatype == TBIT && 
-        input_first_bit + input_nbits - 1 > (long) colptr->trepeat)
+    /* read the bits of many rows at once as packed bytes, then */
+    /* shift them down into the integer values                  */
+    for (row = 0; row < nrows; row += ntodo)
     {
-        ffpmsg("Too many bits. Tried to read past width of column (ffgcxui)");
-        return(*status = BAD_ELEM_NUM);
-    }
-    else if (colptr->tdatatype == TBYTE && lastbyte > (long) colptr->trepeat)
-    {
-        ffpmsg("Too many bits. Tried to read past width of column (ffgcxui)");
-        return(*status = BAD_ELEM_NUM);
-    }
+        ntodo = minvalue(nrows - row, DBUFFSIZE / 4);
 
-    for (ii = 0; ii < nrows; ii++)
-    {
-        /* read the relevant bytes from the row */
-        if (ffgcvui(fptr, colnum, firstrow+ii, firstbyte, nbytes, 0, 
-               colbyte, NULL, status) > 0)
+        if (input_nbits > 0 && ffgcxp(fptr, colnum, firstrow + row, ntodo,
+            input_first_bit, input_nbits, packed, status) > 0)
         {
              ffpmsg("Error reading bytes from column (ffgcxui)");
              return(*status);
         }
 
-        firstbit = (input_first_bit - 1) % 8; /* modulus operator */
-        nbits = input_nbits;
-
-        array[ii] = 0;
-
-        /* select and shift the bits from each byte into the output word */
-        while(nbits)
+        for (ii = 0; ii < ntodo; ii++)
         {
-            bytenum = firstbit / 8;
-
-            startbit = firstbit % 8;  
-            numbits = minvalue(nbits, 8 - startbit);
-            endbit = startbit + numbits - 1;
-
-            rshift = 7 - endbit;
-            lshift = nbits - numbits;
+            value = 0;
+            for (jj = 0; jj < nbytes; jj++)
+                value = (value << 8) | packed[ii * nbytes + jj];
 
-            array[ii] = ((colbyte[bytenum] >> rshift) << lshift) | array[ii];
-
-            nbits -= numbits;
-            firstbit += numbits;
+            array[row + ii] = (unsigned short) (nbytes ? value >> (nbytes * 8 - input_nbits) : 0);
         }
     }
 
@@ -499,10 +438,10 @@ int ffgcxuk(fitsfile *fptr,   /* I - FITS file pointer                       */
   which ever is less.
 */
 {
-    int ii, firstbit, nbits, bytenum, startbit, numbits, endbit;
-    int firstbyte, lastbyte, nbytes, rshift, lshift;
-    unsigned int colbyte[5];
-    tcolumn *colptr;
+    int jj, nbytes;
+    LONGLONG ii, row, ntodo;
+    unsigned int value;
+    unsigned char packed[DBUFFSIZE];
     char message[FLEN_ERRMSG];
 
     if (*status > 0 || nrows == 0)
@@ -531,6 +470,197 @@ int ffgcxuk(fitsfile *fptr,   /* I - FITS file pointer                       */
           return(*status = BAD_ELEM_NUM);
     }
 
+    nbytes = (input_nbits + 7) / 8;
+
+    /* read the bits of many rows at once as packed bytes, then */
+    /* shift them down into the integer values                  */
+    for (row = 0; row < nrows; row += ntodo)
+    {
+        ntodo = minvalue(nrows - row, DBUFFSIZE / 4);
+
+        if (input_nbits > 0 && ffgcxp(fptr, colnum, firstrow + row, ntodo,
+            input_first_bit, input_nbits, packed, status) > 0)
+        {
+             ffpmsg("Error reading bytes from column (ffgcxuk)");
+             return(*status);
+        }
+
+        for (ii = 0; ii < ntodo; ii++)
+        {
+            value = 0;
+            for (jj = 0; jj < nbytes; jj++)
+                value = (value << 8) | packed[ii * nbytes + jj];
+
+            array[row + ii] = (unsigned int) (nbytes ? value >> (nbytes * 8 - input_nbits) : 0);
+        }
+    }
+
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+int ffgcxp( fitsfile *fptr,   /* I - FITS file pointer                       */
+            int  colnum,      /* I - number of column to read (1 = 1st col)  */
+            LONGLONG  firstrow,   /* I - first row to read (1 = 1st row)         */
+            LONGLONG  nrows,      /* I - no. of rows to read                     */
+            long  firstbit,   /* I - first bit to read (1 = 1st)             */
+            long  nbits,      /* I - number of bits to read from each row    */
+            unsigned char *array, /* O - packed bits, (nbits+7)/8 bytes per row */
+            int  *status)     /* IO - error status                           */
+/*
+  Read a consecutive string of bits from each row of an 'X' or 'B' column
+  as packed bytes, without expanding them into one logical value per bit.
+  The bits for each row are returned in (nbits + 7) / 8 bytes, starting
+  with the most significant bit of the first byte (the same bit ordering
+  as in the FITS file); any unused bits in the last byte are set to 0.
+  If firstbit is 1, the bytes are read directly into the output array.
+*/
+{
+    LONGLONG bstart, rowlen, row, ntodo;
+    long ii, jj, span, outbytes, shift, chunk;
+    unsigned char tailmask, *inptr, *outptr, *tmp;
+    tcolumn *colptr;
+    char message[FLEN_ERRMSG];
+
+    double cbuff[DBUFFSIZE / sizeof(double)]; /* align cbuff on word boundary */
+
+    if (ffcxpchk(fptr, colnum, firstrow, nrows, firstbit, nbits, "ffgcxp",
+        status) > 0 || nrows == 0 || nbits < 1)
+        return(*status);
+
+    if (firstrow + nrows - 1 > (fptr->Fptr)->numrows)
+    {
+        ffpmsg("Attempt to read past end of table (ffgcxp)");
+        return(*status = BAD_ROW_NUM);
+    }
+
+    colptr  = (fptr->Fptr)->tableptr + (colnum - 1);
+    rowlen = (fptr->Fptr)->rowlength;
+
+    shift = (firstbit - 1) % 8;
+    span = (firstbit + nbits - 2) / 8 - (firstbit - 1) / 8 + 1;
+    outbytes = (nbits + 7) / 8;
+    tailmask = (unsigned char) (0xFF << (outbytes * 8 - nbits));
+
+    bstart = (fptr->Fptr)->datastart + rowlen * (firstrow - 1) +
+             colptr->tbcol + (firstbit - 1) / 8;
+
+    /* the input bytes go straight into the output array if they are */
+    /* aligned, otherwise through a work buffer, in chunks of rows    */
+    if (shift == 0)
+    {
+        tmp = 0;
+        chunk = (long) minvalue(nrows, 1000000L);
+    }
+    else if (span <= DBUFFSIZE)
+    {
+        tmp = (unsigned char *) cbuff;
+        chunk = DBUFFSIZE / span;
+    }
+    else
+    {
+        tmp = (unsigned char *) malloc(span);
+        if (!tmp)
+        {
+            ffpmsg("Could not allocate memory for bits (ffgcxp)");
+            return(*status = MEMORY_ALLOCATION);
+        }
+        chunk = 1;
+    }
+
+    for (row = 0; row < nrows; row += ntodo)
+    {
+        ntodo = minvalue(chunk, nrows - row);
+        inptr = tmp ? tmp : array + row * outbytes;
+
+        ffmbyt(fptr, bstart + row * rowlen, REPORT_EOF, status);
+
+        if (rowlen == span)
+            ffgbyt(fptr, ntodo * span, inptr, status);
+        else if (span <= IOBUFLEN)
+            ffgbytoff(fptr, span, (long) ntodo, (long) (rowlen - span), inptr,
+                      status);
+        else  /* ffgbytoff can't handle groups longer than a FITS block */
+        {
+            for (ii = 0; ii < ntodo; ii++)
+            {
+                ffmbyt(fptr, bstart + (row + ii) * rowlen, REPORT_EOF, status);
+                ffgbyt(fptr, span, inptr + ii * span, status);
+            }
+        }
+
+        if (*status > 0)
+        {
+            snprintf(message, FLEN_ERRMSG,
+              "Error reading bits in rows %.0f - %.0f (ffgcxp)",
+              (double) (firstrow + row), (double) (firstrow + row + ntodo - 1));
+            ffpmsg(message);
+            break;
+        }
+
+        outptr = array + row * outbytes;
+        for (ii = 0; ii < ntodo; ii++, outptr += outbytes)
+        {
+            if (shift)  /* shift the bits up to the start of each byte */
+            {
+                inptr = tmp + ii * span;
+                for (jj = 0; jj < outbytes; jj++)
+                {
+                    outptr[jj] = (unsigned char) (inptr[jj] << shift);
+                    if (jj + 1 < span)
+                        outptr[jj] |= inptr[jj + 1] >> (8 - shift);
+                }
+            }
+            outptr[outbytes - 1] &= tailmask;
+        }
+    }
+
+    if (tmp && tmp != (unsigned char *) cbuff)
+        free(tmp);
+
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+int ffcxpchk(fitsfile *fptr,  /* I - FITS file pointer                       */
+            int  colnum,      /* I - number of column (1 = 1st col)          */
+            LONGLONG  firstrow,   /* I - first row (1 = 1st row)                 */
+            LONGLONG  nrows,      /* I - no. of rows                             */
+            long  firstbit,   /* I - first bit (1 = 1st)                     */
+            long  nbits,      /* I - number of bits in each row              */
+            char *routine,    /* I - name of the calling routine             */
+            int  *status)     /* IO - error status                           */
+/*
+  Check the parameters of a packed bit read or write (ffgcxp, ffpcxp), and
+  make sure that the HDU is positioned and its structure is defined.
+*/
+{
+    tcolumn *colptr;
+    char message[FLEN_ERRMSG];
+
+    if (*status > 0)
+        return(*status);
+
+    if (firstrow < 1)
+    {
+          snprintf(message, FLEN_ERRMSG,"Starting row number is less than 1: %ld (%s)",
+                (long) firstrow, routine);
+          ffpmsg(message);
+          return(*status = BAD_ROW_NUM);
+    }
+    else if (nrows < 0)
+    {
+          snprintf(message, FLEN_ERRMSG,"Number of rows is less than 0: %ld (%s)",
+                (long) nrows, routine);
+          ffpmsg(message);
+          return(*status = BAD_ROW_NUM);
+    }
+    else if (firstbit < 1)
+    {
+          snprintf(message, FLEN_ERRMSG,"Starting bit number is less than 1: %ld (%s)",
+                firstbit, routine);
+          ffpmsg(message);
+          return(*status = BAD_ELEM_NUM);
+    }
+
     /* position to the correct HDU */
     if (fptr->HDUposition != (fptr->Fptr)->curhdu)
         ffmahd(fptr, (fptr->HDUposition) + 1, NULL, status);
@@ -542,80 +672,42 @@ int ffgcxuk(fitsfile *fptr,   /* I - FITS file pointer                       */
 
     if ((fptr->Fptr)->hdutype != BINARY_TBL)
     {
-        ffpmsg("This is not a binary table extension (ffgcxuk)");
+        snprintf(message, FLEN_ERRMSG,"This is not a binary table extension (%s)",
+                routine);
+        ffpmsg(message);
         return(*status = NOT_BTABLE);
     }
 
-    if (colnum > (fptr->Fptr)->tfield)
+    if (colnum < 1 || colnum > (fptr->Fptr)->tfield)
     {
-      snprintf(message, FLEN_ERRMSG,"Specified column number is out of range: %d (ffgcxuk)",
-                colnum);
+        snprintf(message, FLEN_ERRMSG,"Specified column number is out of range: %d (%s)",
+                colnum, routine);
         ffpmsg(message);
-        snprintf(message, FLEN_ERRMSG,"  There are %d columns in this table.",
-                (fptr->Fptr)->tfield );
-        ffpmsg(message);
-
         return(*status = BAD_COL_NUM);
-    }       
+    }
 
     colptr  = (fptr->Fptr)->tableptr;   /* point to first column */
     colptr += (colnum - 1);     /* offset to correct column structure */
 
-    if (abs(colptr->tdatatype) > TBYTE)
+    if (colptr->tdatatype != TBIT && colptr->tdatatype != TBYTE)
     {
-        ffpmsg("Can only read bits from X or B type columns. (ffgcxuk)");
+        snprintf(message, FLEN_ERRMSG,
+           "Can only access packed bits in fixed length X or B columns (%s)",
+           routine);
+        ffpmsg(message);
         return(*status = NOT_LOGICAL_COL); /* not correct datatype column */
     }
 
-    firstbyte = (input_first_bit - 1              ) / 8 + 1;
-    lastbyte  = (input_first_bit + input_nbits - 2) / 8 + 1;
-    nbytes = lastbyte - firstbyte + 1;
-
-    if (colptr->tdatatype == TBIT && 
-        input_first_bit + input_nbits - 1 > (long) colptr->trepeat)
-    {
-        ffpmsg("Too many bits. Tried to read past width of column (ffgcxuk)");
-        return(*status = BAD_ELEM_NUM);
-    }
-    else if (colptr->tdatatype == TBYTE && lastbyte > (long) colptr->trepeat)
+    if ((colptr->tdatatype == TBIT &&
+         firstbit + nbits - 1 > colptr->trepeat) ||
+        (colptr->tdatatype == TBYTE &&
+         (firstbit + nbits + 6) / 8 > colptr->trepeat))
     {
-        ffpmsg("Too many bits. Tried to read past width of column (ffgcxuk)");
+        snprintf(message, FLEN_ERRMSG,
+           "Too many bits. Tried to access past width of column (%s)", routine);
+        ffpmsg(message);
         return(*status = BAD_ELEM_NUM);
     }
 
-    for (ii = 0; ii < nrows; ii++)
-    {
-        /* read the relevant bytes from the row */
-        if (ffgcvuk(fptr, colnum, firstrow+ii, firstbyte, nbytes, 0, 
-               colbyte, NULL, status) > 0)
-        {
-             ffpmsg("Error reading bytes from column (ffgcxuk)");
-             return(*status);
-        }
-
-        firstbit = (input_first_bit - 1) % 8; /* modulus operator */
-        nbits = input_nbits;
-
-        array[ii] = 0;
-
-        /* select and shift the bits from each byte into the output word */
-        while(nbits)
-        {
-            bytenum = firstbit / 8;
-
-            startbit = firstbit % 8;  
-            numbits = minvalue(nbits, 8 - startbit);
-            endbit = startbit + numbits - 1;
-
-            rshift = 7 - endbit;
-            lshift = nbits - numbits;
-
-            array[ii] = ((colbyte[bytenum] >> rshift) << lshift) | array[ii];
-
-            nbits -= numbits;
-            firstbit += numbits;
-        }
-    }
-
     return(*status);
 }
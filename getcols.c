@@ -990,3 +990,311 @@ int ffgcls2 ( fitsfile *fptr,   /* I - FITS file pointer                       *
     return(*status);
 }
 
+/*--------------------------------------------------------------------------*/
+int ffgcsp( fitsfile *fptr,   /* I - FITS file pointer                       */
+            int  colnum,      /* I - number of column to read (1 = 1st col) */
+            LONGLONG  firstrow,   /* I - first row to read (1 = 1st row)        */
+            LONGLONG  firstelem,  /* I - first vector element to read (1 = 1st) */
+            LONGLONG  nelem,      /* I - number of strings to read              */
+            char *buffer,     /* O - packed characters of all the strings    */
+            LONGLONG *offsets, /* O - start of each string in buffer, plus  */
+                              /*     the total length in offsets[nelem]     */
+            char *nularray,   /* O - array of flags = 1 if null (or NULL)    */
+            int  *anynul,     /* O - set to 1 if any values are null; else 0 */
+            int  *status)     /* IO - error status                           */
+/*
+  Read an array of string values from a column in the current FITS HDU
+  into a single contiguous character buffer.  The strings are packed end
+  to end with trailing blanks removed and no terminating null characters;
+  string ii occupies buffer[offsets[ii]] through buffer[offsets[ii+1] - 1].
+  The offsets array must have room for nelem + 1 values.  The buffer must
+  be at least nelem times the width of the column (or, for variable length
+  columns, the sum of the string lengths given by the row descriptors).
+
+  If nularray is not NULL, it is set to 1 for each string that is equal to
+  the null string defined for the column, and such strings are returned
+  with a length of zero.
+*/
+{
+    if (!offsets)
+    {
+        ffpmsg("Null offsets array pointer (ffgcsp)");
+        return(*status = NULL_INPUT_PTR);
+    }
+
+    return(ffgcsbuf(fptr, colnum, firstrow, firstelem, nelem, 0L, buffer,
+           offsets, NULL, nularray, anynul, status));
+}
+/*--------------------------------------------------------------------------*/
+int ffgcsw( fitsfile *fptr,   /* I - FITS file pointer                       */
+            int  colnum,      /* I - number of column to read (1 = 1st col) */
+            LONGLONG  firstrow,   /* I - first row to read (1 = 1st row)        */
+            LONGLONG  firstelem,  /* I - first vector element to read (1 = 1st) */
+            LONGLONG  nelem,      /* I - number of strings to read              */
+            long  width,      /* I - size of each string slot in buffer      */
+            char *buffer,     /* O - fixed width string slots                */
+            long *lengths,    /* O - length of each string (or NULL)         */
+            char *nularray,   /* O - array of flags = 1 if null (or NULL)    */
+            int  *anynul,     /* O - set to 1 if any values are null; else 0 */
+            int  *status)     /* IO - error status                           */
+/*
+  Read an array of string values from a column in the current FITS HDU
+  into consecutive slots of 'width' characters in a single buffer.  The
+  length of each string, excluding trailing blanks, is returned in the
+  lengths array; the remaining characters in each slot are undefined and
+  the strings are not null terminated.  The width must be at least the
+  width of the column.  Null strings are flagged as in ffgcsp.
+*/
+{
+    if (width < 1)
+    {
+        ffpmsg("String slot width must be greater than 0 (ffgcsw)");
+        return(*status = COL_TOO_WIDE);
+    }
+
+    return(ffgcsbuf(fptr, colnum, firstrow, firstelem, nelem, width, buffer,
+           NULL, lengths, nularray, anynul, status));
+}
+/*--------------------------------------------------------------------------*/
+int ffgcsbuf( fitsfile *fptr, /* I - FITS file pointer                       */
+            int  colnum,      /* I - number of column to read (1 = 1st col) */
+            LONGLONG  firstrow,   /* I - first row to read (1 = 1st row)        */
+            LONGLONG  firstelem,  /* I - first vector element to read (1 = 1st) */
+            LONGLONG  nelem,      /* I - number of strings to read              */
+            long  width,      /* I - slot width, or 0 for packed strings     */
+            char *buffer,     /* O - output character buffer                 */
+            LONGLONG *offsets, /* O - string offsets if width = 0           */
+            long *lengths,    /* O - string lengths if width > 0 (or NULL)   */
+            char *nularray,   /* O - array of flags = 1 if null (or NULL)    */
+            int  *anynul,     /* O - set to 1 if any values are null; else 0 */
+            int  *status)     /* IO - error status                           */
+/*
+  Work routine for ffgcsp and ffgcsw.  The raw column bytes are read
+  straight into the caller's buffer, then shifted into place in a single
+  forward (packed) or backward (fixed width) pass, so that no per-string
+  copies or formatting is needed.
+*/
+{
+    long nullen, len;
+    int tcode, maxelem, hdutype, nulcheck;
+    long twidth, incre;
+    long ii, ntodo;
+    LONGLONG repeat, startpos, elemnum, readptr, tnull, rowlen, rownum, remain, next;
+    LONGLONG pos = 0;
+    double scale, zero;
+    char tform[20];
+    char message[FLEN_ERRMSG];
+    char snull[20];   /*  the FITS null value  */
+    char *dest, *cptr, *nulptr;
+    tcolumn *colptr;
+
+    if (offsets)
+        offsets[0] = 0;
+
+    if (anynul)
+        *anynul = 0;
+
+    if (*status > 0 || nelem == 0)  /* inherit input status value if > 0 */
+        return(*status);
+
+    if (!buffer)
+    {
+        ffpmsg("Null string buffer pointer (ffgcsbuf)");
+        return(*status = NULL_INPUT_PTR);
+    }
+
+    /* reset position to the correct HDU if necessary */
+    if (fptr->HDUposition != (fptr->Fptr)->curhdu)
+    {
+        ffmahd(fptr, (fptr->HDUposition) + 1, NULL, status);
+    }
+    else if ((fptr->Fptr)->datastart == DATA_UNDEFINED)
+    {
+        if ( ffrdef(fptr, status) > 0)               /* rescan header */
+            return(*status);
+    }
+
+    if (nularray)
+        memset(nularray, 0, (size_t) nelem);   /* initialize nullarray */
+
+    /*---------------------------------------------------*/
+    /*  Check input and get parameters about the column: */
+    /*---------------------------------------------------*/
+    if (colnum < 1 || colnum > (fptr->Fptr)->tfield)
+    {
+        snprintf(message, FLEN_ERRMSG,"Specified column number is out of range: %d",
+                colnum);
+        ffpmsg(message);
+        return(*status = BAD_COL_NUM);
+    }
+
+    colptr  = (fptr->Fptr)->tableptr;   /* point to first column */
+    colptr += (colnum - 1);     /* offset to correct column structure */
+    tcode = colptr->tdatatype;
+
+    if (tcode != TSTRING && tcode != -TSTRING)
+        return(*status = NOT_ASCII_COL);
+
+    if (tcode == TSTRING)
+    {
+      if (ffgcprll( fptr, colnum, firstrow, firstelem, nelem, 0, &scale, &zero,
+        tform, &twidth, &tcode, &maxelem, &startpos,  &elemnum, &incre,
+        &repeat, &rowlen, &hdutype, &tnull, snull, status) > 0)
+        return(*status);
+
+      if (width && width < twidth)
+      {
+        snprintf(message, FLEN_ERRMSG,
+          "Slot width %ld < column width %ld (ffgcsw)",
+          width, twidth);
+        ffpmsg(message);
+        return(*status = COL_TOO_WIDE);
+      }
+
+      /* ffgbytoff can't handle strings longer than a FITS block */
+      if (twidth > IOBUFLEN) {
+        incre = twidth;
+        repeat = 1;
+      }
+    }
+    else
+    {
+      /* only need the null string; the rows are located one at a time below */
+      if (ffgcprll( fptr, colnum, firstrow, 1, 1, 0, &scale, &zero,
+        tform, &twidth, &tcode, &maxelem, &startpos,  &elemnum, &incre,
+        &repeat, &rowlen, &hdutype, &tnull, snull, status) > 0)
+        return(*status);
+
+      tcode = -TSTRING;
+    }
+
+    nullen = (long) strlen(snull);   /* length of the undefined pixel string */
+    if (nullen == 0)
+        nullen = 1;   /* a string beginning with ASCII NUL is null */
+
+    nulcheck = (nularray != NULL);
+
+    if (snull[0] == ASCII_NULL_UNDEFINED)
+       nulcheck = 0;   /* null value string in ASCII table not defined */
+
+    /*---------------------------------------------------------------------*/
+    /*  Now read the strings from the FITS column.                         */
+    /*---------------------------------------------------------------------*/
+    next = 0;                 /* next element in array to be read  */
+    rownum = 0;               /* row number, relative to firstrow     */
+    remain = nelem;
+
+    while (remain)
+    {
+      if (tcode == -TSTRING)
+      {
+        /* each row of a variable length column holds a single string */
+        if (ffgcprll( fptr, colnum, firstrow + next, 1, 1, 0, &scale, &zero,
+          tform, &twidth, &tcode, &maxelem, &startpos,  &elemnum, &incre,
+          &repeat, &rowlen, &hdutype, &tnull, snull, status) > 0)
+          break;
+
+        tcode = -TSTRING;
+        twidth = (long) repeat;
+        ntodo = 1;
+
+        if (width && twidth > width)
+        {
+          snprintf(message, FLEN_ERRMSG,
+           "String in row %.0f is longer than the slot width %ld (ffgcsw)",
+           (double) (firstrow + next), width);
+          ffpmsg(message);
+          return(*status = COL_TOO_WIDE);
+        }
+
+        dest = width ? buffer + next * width : buffer + pos;
+        ffmbyt(fptr, startpos, REPORT_EOF, status);
+        if (twidth > 0)
+          ffgbyt(fptr, twidth, dest, status);
+      }
+      else
+      {
+        ntodo = (long) minvalue(remain, (repeat - elemnum));
+
+        /* read the raw field bytes straight into the output buffer.  In */
+        /* packed mode the read position is never before the next write  */
+        /* position, and in fixed mode the slots are at least as wide    */
+        /* as the field, so the strings can be moved in place.           */
+        dest = width ? buffer + next * width : buffer + pos;
+
+        readptr = startpos + ((LONGLONG)rownum * rowlen) + (elemnum * incre);
+        ffmbyt(fptr, readptr, REPORT_EOF, status);  /* move to read position */
+
+        if (incre == twidth)
+           ffgbyt(fptr, ntodo * twidth, dest, status);
+        else
+           ffgbytoff(fptr, twidth, ntodo, incre - twidth, dest, status);
+
+        if (width > twidth)  /* spread the fields out into the wider slots */
+        {
+          for (ii = ntodo - 1; ii > 0; ii--)
+            memmove(dest + ii * width, dest + ii * twidth, twidth);
+        }
+      }
+
+      if (*status > 0)  /* test for error during previous read operation */
+      {
+         snprintf(message,FLEN_ERRMSG,
+          "Error reading elements %.0f thru %.0f of data array (ffgcsbuf).",
+             (double) next + 1., (double) next + ntodo);
+         ffpmsg(message);
+         return(*status);
+      }
+
+      /* find the length of each string and compact the packed strings */
+      for (ii = 0; ii < ntodo; ii++)
+      {
+         cptr = width ? dest + ii * width : dest + ii * twidth;
+
+         /* a string ends at the first ASCII NUL, if present */
+         nulptr = memchr(cptr, 0, twidth);
+         len = nulptr ? (long) (nulptr - cptr) : twidth;
+
+         if (nulcheck && twidth >= nullen && !strncmp(snull, cptr, nullen))
+         {
+           if (anynul)
+             *anynul = 1;
+           nularray[next + ii] = 1;
+           len = 0;
+         }
+
+         while (len > 0 && cptr[len - 1] == ' ')  /* ignore trailing blanks */
+           len--;
+
+         if (width)
+         {
+           if (lengths)
+             lengths[next + ii] = len;
+         }
+         else
+         {
+           if (len && buffer + pos != cptr)
+             memmove(buffer + pos, cptr, len);
+           pos += len;
+           offsets[next + ii + 1] = pos;
+         }
+      }
+
+      /*--------------------------------------------*/
+      /*  increment the counters for the next loop  */
+      /*--------------------------------------------*/
+      next += ntodo;
+      remain -= ntodo;
+      if (remain && tcode == TSTRING)
+      {
+          elemnum += ntodo;
+          if (elemnum == repeat)  /* completed a row; start on next row */
+          {
+              elemnum = 0;
+              rownum++;
+          }
+      }
+    }  /*  End of main while Loop  */
+
+    return(*status);
+}
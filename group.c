@@ -567,6 +567,8 @@ int ffgtrm(fitsfile *gfptr,  /* FITS file pointer to group                   */
   long nmembers = 0;
 
   HDUtracker HDU;
+
+  grp_member_cache cache;
   
 
   if(*status != 0) return(*status);
@@ -614,7 +616,11 @@ int ffgtrm(fitsfile *gfptr,  /* FITS file pointer to group                   */
 
       /* call the recursive group remove function */
 
-      *status = ffgtrmr(gfptr,&HDU,status);
+      grp_cache_init(&cache);
+
+      *status = ffgtrmr(gfptr,&HDU,&cache,status);
+
+      grp_cache_free(&cache);
 
       /* free the memory allocated to the HDUtracker struct */
 
@@ -674,6 +680,8 @@ int ffgtcp(fitsfile *infptr,  /* input FITS file pointer                     */
 
   HDUtracker HDU;
 
+  grp_member_cache cache;
+
 
   if(*status != 0) return(*status);
 
@@ -695,7 +703,11 @@ int ffgtcp(fitsfile *infptr,  /* input FITS file pointer                     */
 	 performed
       */
 
-      *status = ffgtcpr(infptr,outfptr,cpopt,&HDU,status);
+      grp_cache_init(&cache);
+
+      *status = ffgtcpr(infptr,outfptr,cpopt,&HDU,&cache,status);
+
+      grp_cache_free(&cache);
   
       /* free memory allocated for the HDUtracker struct */
 
@@ -738,9 +750,13 @@ int ffgtmg(fitsfile *infptr,  /* FITS file ptr to source grouping table      */
 
   fitsfile *tmpfptr = NULL;
 
+  grp_member_cache cache;
+
 
   if(*status != 0) return(*status);
 
+  grp_cache_init(&cache);
+
   do
     {
 
@@ -748,7 +764,7 @@ int ffgtmg(fitsfile *infptr,  /* FITS file ptr to source grouping table      */
 
       for(i = 1; i <= nmembers && *status == 0; ++i)
 	{
-	  *status = fits_open_member(infptr,i,&tmpfptr,status);
+	  *status = ffgmopc(infptr,i,&cache,&tmpfptr,status);
 	  *status = fits_add_group_member(outfptr,tmpfptr,0,status);
 
 	  if(*status == HDU_ALREADY_MEMBER) *status = 0;
@@ -760,6 +776,8 @@ int ffgtmg(fitsfile *infptr,  /* FITS file ptr to source grouping table      */
 	    }
 	}
 
+      grp_cache_free(&cache);
+
       if(*status != 0) continue;
 
       if(mgopt == OPT_MRG_MOV) 
@@ -772,6 +790,8 @@ int ffgtmg(fitsfile *infptr,  /* FITS file ptr to source grouping table      */
       fits_close_file(tmpfptr,status);
     }
 
+  grp_cache_free(&cache);
+
   return(*status);
 }
 
@@ -803,9 +823,13 @@ int ffgtcm(fitsfile *gfptr,  /* FITS file pointer to grouping table          */
 
   fitsfile *mfptr = NULL;
 
+  grp_member_cache cache;
+
 
   if(*status != 0) return(*status);
 
+  grp_cache_init(&cache);
+
   do
     {
       if(cmopt != OPT_CMT_MBR && cmopt != OPT_CMT_MBR_DEL)
@@ -827,7 +851,7 @@ int ffgtcm(fitsfile *gfptr,  /* FITS file pointer to grouping table          */
 
       for(i = 1; i <= nmembers && *status == 0; ++i)
 	{
-	  *status = fits_open_member(gfptr,i,&mfptr,status);
+	  *status = ffgmopc(gfptr,i,&cache,&mfptr,status);
 
 	  if(*status != 0) continue;
 
@@ -864,7 +888,10 @@ int ffgtcm(fitsfile *gfptr,  /* FITS file pointer to grouping table          */
 	      if(cmopt == OPT_CMT_MBR)
 		*status = fits_remove_member(gfptr,i,OPT_RM_ENTRY,status);
 	      else
-		*status = fits_remove_member(gfptr,i,OPT_RM_MBR,status);
+		{
+		  *status = fits_remove_member(gfptr,i,OPT_RM_MBR,status);
+		  grp_cache_forget(&cache,NULL);
+		}
 	    }
 	  else
 	    {
@@ -877,6 +904,8 @@ int ffgtcm(fitsfile *gfptr,  /* FITS file pointer to grouping table          */
 
     }while(0);
 
+  grp_cache_free(&cache);
+
   return(*status);
 }
 
@@ -905,11 +934,15 @@ int ffgtvf(fitsfile *gfptr,       /* FITS file pointer to group             */
 
   fitsfile *fptr = NULL;
 
+  grp_member_cache cache;
+
 
   if(*status != 0) return(*status);
 
   *firstfailed = 0;
 
+  grp_cache_init(&cache);
+
   do
     {
       /*
@@ -922,10 +955,12 @@ int ffgtvf(fitsfile *gfptr,       /* FITS file pointer to group             */
 
       for(i = 1; i <= nmembers && *status == 0; ++i)
 	{
-	  *status = fits_open_member(gfptr,i,&fptr,status);
-	  fits_close_file(fptr,status);
+	  *status = ffgmopc(gfptr,i,&cache,&fptr,status);
+	  if(fptr != NULL) fits_close_file(fptr,status);
 	}
 
+      grp_cache_free(&cache);
+
       /*
 	if the status is non-zero from the above loop then record the
 	member index that caused the error
@@ -970,6 +1005,8 @@ int ffgtvf(fitsfile *gfptr,       /* FITS file pointer to group             */
 
     }while(0);
 
+  grp_cache_free(&cache);
+
   return(*status);
 }
 
@@ -2139,10 +2176,97 @@ int ffgmop(fitsfile *gfptr,  /* FITS file pointer to grouping table          */
   error FILE_NOT_FOUND is returned.
 */
 
+{
+  return(ffgmopc(gfptr,member,NULL,mfptr,status));
+}
+
+/*---------------------------------------------------------------------------*/
+int ffgmops(fitsfile *gfptr,  /* FITS file pointer to grouping table         */
+	    long  firstmember,/* first member ID (row num) to open           */
+	    long  nmembers,   /* number of members to open                   */
+	    fitsfile **mfptr, /* array of FITS file pointers to member HDUs  */
+	    int  *mstatus,    /* array of member open status codes, or NULL  */
+	    int  *status)     /* return status code                          */
+
+/*
+  open nmembers consecutive members of a grouping table, starting with
+  member firstmember, returning the FITS file pointers in the mfptr array.
+  Each member is opened as by ffgmop(), but each member file is located
+  and opened only once, and the HDUs of each member file are searched only
+  once, no matter how many of the members reside in it.
+
+  If mstatus is not NULL then the status of each member open is returned
+  in it, the mfptr element of any member that could not be opened is set
+  to NULL, and the remaining members are still opened. If mstatus is NULL
+  then the first member that cannot be opened is an error; any members
+  already opened are closed and its status is returned.
+*/
+
+{
+  long i;
+  int tstatus;
+
+  grp_member_cache cache;
+
+
+  if(*status != 0) return(*status);
+
+  for(i = 0; i < nmembers; ++i) mfptr[i] = NULL;
+
+  grp_cache_init(&cache);
+
+  for(i = 0; i < nmembers; ++i)
+    {
+      tstatus = 0;
+
+      ffgmopc(gfptr,firstmember+i,&cache,&mfptr[i],&tstatus);
+
+      if(tstatus != 0) mfptr[i] = NULL;
+
+      if(mstatus != NULL)
+	mstatus[i] = tstatus;
+      else if(tstatus != 0)
+	{
+	  *status = tstatus;
+	  break;
+	}
+    }
+
+  if(*status != 0)
+    {
+      for(i = 0; i < nmembers; ++i)
+	{
+	  if(mfptr[i] == NULL) continue;
+
+	  tstatus = 0;
+	  fits_close_file(mfptr[i],&tstatus);
+	  mfptr[i] = NULL;
+	}
+    }
+
+  grp_cache_free(&cache);
+
+  return(*status);
+}
+
+/*---------------------------------------------------------------------------*/
+int ffgmopc(fitsfile *gfptr,  /* FITS file pointer to grouping table         */
+	    long      member, /* member ID (row num) within grouping table   */
+	    grp_member_cache *cache, /* member resolution cache, or NULL     */
+	    fitsfile **mfptr, /* FITS file pointer to member HDU             */
+	    int      *status) /* return status code                          */
+
+/*
+  open a grouping table member as described for ffgmop(). If cache is not
+  NULL then the member file and the member HDU are looked up in it first,
+  and the cache is updated with the results of the search.
+*/
+
 {
   int xtensionCol,extnameCol,extverCol,positionCol,locationCol,uriCol;
   int grptype,hdutype;
   int dummy;
+  int tstatus;
 
   long hdupos = 0;
   long extver = 0;
@@ -2160,9 +2284,18 @@ int ffgmop(fitsfile *gfptr,  /* FITS file pointer to grouping table          */
   char  nstr[] = {'\0'};
   char *tmpPtr[1];
 
+  grp_member_file *mfile = NULL;
+
 
   if(*status != 0) return(*status);
 
+  /* 
+     so that a failed open does not close a file pointer left over from an
+     earlier call
+  */
+
+  *mfptr = NULL;
+
   do
     {
       /*
@@ -2294,6 +2427,30 @@ int ffgmop(fitsfile *gfptr,  /* FITS file pointer to grouping table          */
 		  continue;
 		}
 
+	      /*
+		if this member file has been looked for before in the
+		traversal then reuse the result of that search
+	      */
+
+	      if(cache != NULL)
+		{
+		  mfile = grp_find_file(cache,gfptr->Fptr,mbrLocation1,status);
+
+		  if(*status != 0) continue;
+
+		  if(mfile->fptr != NULL)
+		    {
+		      *status = fits_reopen_file(mfile->fptr,mfptr,status);
+		      break;
+		    }
+		  else if(mfile->status != 0)
+		    {
+		      *status = mfile->status;
+		      ffpmsg("Cannot open member HDU FITS file (ffgmop)");
+		      break;
+		    }
+		}
+
 	      /*
 		The location string for the member is not NULL, so it 
 		does not necessially reside in the same FITS file as the
@@ -2580,6 +2737,18 @@ int ffgmop(fitsfile *gfptr,  /* FITS file pointer to grouping table          */
 		  *status = MEMBER_NOT_FOUND;
 		  
 		}while(0);
+
+	      /* remember the outcome for the rest of the traversal */
+
+	      if(mfile != NULL)
+		{
+		  tstatus = 0;
+
+		  if(*status != 0)
+		    mfile->status = *status;
+		  else if(fits_reopen_file(*mfptr,&mfile->fptr,&tstatus) != 0)
+		    mfile->fptr = NULL;
+		}
 	    }
 
 	  break;
@@ -2624,7 +2793,8 @@ int ffgmop(fitsfile *gfptr,  /* FITS file pointer to grouping table          */
 	     values
 	  */
 
-	  *status = fits_movnam_hdu(*mfptr,hdutype,extname,extver,status);
+	  *status = grp_find_hdu(cache,*mfptr,hdutype,extname,(int)extver,
+				 status);
 
 	  if(*status == BAD_HDU_NUM) 
 	    {
@@ -2654,7 +2824,8 @@ int ffgmop(fitsfile *gfptr,  /* FITS file pointer to grouping table          */
 	      
 	      /* try to find the member hdu in the grouping table's file */
 
-	      *status = fits_movnam_hdu(*mfptr,hdutype,extname,extver,status);
+	      *status = grp_find_hdu(cache,*mfptr,hdutype,extname,
+				     (int)extver,status);
 
 	      if(*status == BAD_HDU_NUM) 
 		{
@@ -4399,6 +4570,7 @@ int ffgmf(fitsfile *gfptr, /* pointer to grouping table HDU to search       */
   --------------------------------------------------------------------------*/
 int ffgtrmr(fitsfile   *gfptr,  /* FITS file pointer to group               */
 	    HDUtracker *HDU,    /* list of processed HDUs                   */
+	    grp_member_cache *cache, /* member resolution cache             */
 	    int        *status) /* return status code                       */
 	    
 /*
@@ -4407,7 +4579,8 @@ int ffgtrmr(fitsfile   *gfptr,  /* FITS file pointer to group               */
   a grouping table then ffgtrmr() is recursively called to process all
   of its members. The HDUtracker struct *HDU is used to make sure a member
   is not processed twice, thus avoiding an infinite loop (e.g., a grouping
-  table contains itself as a member).
+  table contains itself as a member). The member resolution cache is
+  shared by all levels of the recursion.
 */
 
 {
@@ -4434,7 +4607,7 @@ int ffgtrmr(fitsfile   *gfptr,  /* FITS file pointer to group               */
     {
       /* open the member HDU */
 
-      *status = fits_open_member(gfptr,i,&mfptr,status);
+      *status = ffgmopc(gfptr,i,cache,&mfptr,status);
 
       /* if the member cannot be opened then just skip it and continue */
 
@@ -4485,7 +4658,7 @@ int ffgtrmr(fitsfile   *gfptr,  /* FITS file pointer to group               */
       */
 
       if(fits_strcasecmp(keyvalue,"GROUPING") == 0)
-	  *status = ffgtrmr(mfptr,HDU,status);  
+	  *status = ffgtrmr(mfptr,HDU,cache,status);  
 
       /* 
 	 unlink all the grouping tables that contain this HDU as a member 
@@ -4498,6 +4671,7 @@ int ffgtrmr(fitsfile   *gfptr,  /* FITS file pointer to group               */
 	  {
 	      *status = ffgmul(mfptr,0,status);
 	      *status = fits_delete_hdu(mfptr,&hdutype,status);
+	      grp_cache_forget(cache,mfptr->Fptr);
 	  }
 
       /* close the fitsfile pointer */
@@ -4515,6 +4689,7 @@ int ffgtcpr(fitsfile   *infptr,  /* input FITS file pointer                 */
 				    OPT_GCP_ALL (2) ==> recusrively copy 
 				    members and their members (if groups)   */
 	    HDUtracker *HDU,     /* list of already copied HDUs             */
+	    grp_member_cache *cache, /* member resolution cache             */
 	    int        *status)  /* return status code                      */
 
 /*
@@ -4528,7 +4703,8 @@ int ffgtcpr(fitsfile   *infptr,  /* input FITS file pointer                 */
 
   Note that this function is recursive. When copt is OPT_GCP_ALL it will call
   itself whenever a member HDU of the current grouping table is itself a
-  grouping table (i.e., EXTNAME = 'GROUPING').
+  grouping table (i.e., EXTNAME = 'GROUPING'). The member resolution cache
+  is shared by all levels of the recursion.
 */
 
 {
@@ -4579,6 +4755,10 @@ int ffgtcpr(fitsfile   *infptr,  /* input FITS file pointer                 */
       prepare_keyvalue(keyvalue);
 
       *status = fits_create_group(outfptr,keyvalue,GT_ID_ALL_URI,status);
+
+      /* the output file has a new HDU, so its HDU index is out of date */
+
+      grp_cache_forget(cache,outfptr->Fptr);
      
       /* save the new grouping table's HDU position for future use */
 
@@ -4606,7 +4786,7 @@ int ffgtcpr(fitsfile   *infptr,  /* input FITS file pointer                 */
 
 	  for(i = 1; i <= nmembers && *status == 0; ++i)
 	    {
-	      *status = fits_open_member(infptr,i,&mfptr,status);
+	      *status = ffgmopc(infptr,i,cache,&mfptr,status);
 	      *status = fits_add_group_member(outfptr,mfptr,0,status);
 
 	      fits_close_file(mfptr,status);
@@ -4627,7 +4807,7 @@ int ffgtcpr(fitsfile   *infptr,  /* input FITS file pointer                 */
 	    {
 	      /* open the ith member */
 
-	      *status = fits_open_member(infptr,i,&mfptr,status);
+	      *status = ffgmopc(infptr,i,cache,&mfptr,status);
 
 	      if(*status != 0) continue;
 
@@ -4668,10 +4848,13 @@ int ffgtcpr(fitsfile   *infptr,  /* input FITS file pointer                 */
 	      */
 
 	      if(fits_strcasecmp(keyvalue,"GROUPING") == 0)
-		*status = ffgtcpr(mfptr,outfptr,OPT_GCP_ALL,HDU,status);
+		*status = ffgtcpr(mfptr,outfptr,OPT_GCP_ALL,HDU,cache,status);
 	      else
-		*status = fits_copy_member(infptr,outfptr,i,OPT_MCP_NADD,
-					   status);
+		{
+		  *status = fits_copy_member(infptr,outfptr,i,OPT_MCP_NADD,
+					     status);
+		  grp_cache_forget(cache,outfptr->Fptr);
+		}
 
 	      /* retrieve the position of the newly copied member */
 
@@ -5005,6 +5188,396 @@ void prepare_keyvalue(char *keyvalue) /* string containing keyword value     */
     }
 }
 
+
+/*--------------------------------------------------------------------------
+                       Member Resolution Cache Functions
+  --------------------------------------------------------------------------*/
+void grp_cache_init(grp_member_cache *cache) /* cache to initialize          */
+
+/*
+  initialize an empty member resolution cache
+*/
+
+{
+  cache->nfiles  = 0;
+  cache->nfalloc = 0;
+  cache->file    = NULL;
+  cache->nindex  = 0;
+  cache->nialloc = 0;
+  cache->index   = NULL;
+}
+
+/*--------------------------------------------------------------------------*/
+void grp_cache_free(grp_member_cache *cache) /* cache to free                */
+
+/*
+  close all the member files held open by a member resolution cache and
+  free the memory allocated to it. The cache is left empty.
+*/
+
+{
+  int i;
+  int tstatus;
+
+
+  for(i = 0; i < cache->nfiles; ++i)
+    {
+      if(cache->file[i].fptr != NULL)
+	{
+	  tstatus = 0;
+	  fits_close_file(cache->file[i].fptr,&tstatus);
+	}
+
+      free(cache->file[i].location);
+    }
+
+  for(i = 0; i < cache->nindex; ++i) free(cache->index[i].hdu);
+
+  free(cache->file);
+  free(cache->index);
+
+  grp_cache_init(cache);
+}
+
+/*--------------------------------------------------------------------------*/
+void grp_cache_forget(grp_member_cache *cache, /* cache to update            */
+		      FITSfile *Fptr)          /* modified file, or NULL     */
+
+/*
+  discard the HDU index of a file whose HDUs have been inserted, deleted
+  or renamed, so that the file is searched again the next time a member
+  HDU is looked for in it. If Fptr is NULL then the HDU indexes of all
+  files are discarded.
+*/
+
+{
+  int i;
+
+
+  if(cache == NULL) return;
+
+  for(i = 0; i < cache->nindex; ++i)
+    {
+      if(Fptr != NULL && cache->index[i].Fptr != Fptr) continue;
+
+      cache->index[i].nhdu     = 0;
+      cache->index[i].complete = 0;
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+grp_member_file *grp_find_file(grp_member_cache *cache, /* member cache      */
+			       FITSfile *grpFptr, /* grouping table file     */
+			       char     *location,/* MEMBER_LOCATION value   */
+			       int      *status)  /* return status code      */
+
+/*
+  return the cache entry of the member file named by location in a grouping
+  table of the file grpFptr, adding a new (unopened) entry if the file has
+  not been looked for before. Relative locations are resolved against the
+  grouping table file, so the same location in different files names
+  different entries.
+*/
+
+{
+  int i;
+  int nalloc;
+
+  grp_member_file *file;
+
+
+  if(*status != 0) return(NULL);
+
+  for(i = 0; i < cache->nfiles; ++i)
+    {
+      if(cache->file[i].grpFptr == grpFptr &&
+	 strcmp(cache->file[i].location,location) == 0)
+	return(&cache->file[i]);
+    }
+
+  if(cache->nfiles == cache->nfalloc)
+    {
+      nalloc = (cache->nfalloc == 0 ? 16 : 2 * cache->nfalloc);
+
+      file = (grp_member_file*) realloc(cache->file,
+					nalloc * sizeof(grp_member_file));
+
+      if(file == NULL)
+	{
+	  ffpmsg("Cannot allocate member file cache (grp_find_file)");
+	  *status = MEMORY_ALLOCATION;
+	  return(NULL);
+	}
+
+      cache->file    = file;
+      cache->nfalloc = nalloc;
+    }
+
+  file = &cache->file[cache->nfiles];
+
+  file->location = (char*) malloc(strlen(location) + 1);
+
+  if(file->location == NULL)
+    {
+      ffpmsg("Cannot allocate member file cache (grp_find_file)");
+      *status = MEMORY_ALLOCATION;
+      return(NULL);
+    }
+
+  strcpy(file->location,location);
+
+  file->grpFptr = grpFptr;
+  file->fptr    = NULL;
+  file->status  = 0;
+
+  ++cache->nfiles;
+
+  return(file);
+}
+
+/*--------------------------------------------------------------------------*/
+grp_hdu_index *grp_find_index(grp_member_cache *cache, /* member cache   */
+			      FITSfile         *Fptr,  /* member file    */
+			      int              *status)/* return status  */
+
+/*
+  return the HDU index of the file Fptr, adding an empty index if the file
+  has not been searched before
+*/
+
+{
+  int i;
+  int nalloc;
+
+  grp_hdu_index *index;
+
+
+  if(*status != 0) return(NULL);
+
+  for(i = 0; i < cache->nindex; ++i)
+    if(cache->index[i].Fptr == Fptr) return(&cache->index[i]);
+
+  if(cache->nindex == cache->nialloc)
+    {
+      nalloc = (cache->nialloc == 0 ? 16 : 2 * cache->nialloc);
+
+      index = (grp_hdu_index*) realloc(cache->index,
+				       nalloc * sizeof(grp_hdu_index));
+
+      if(index == NULL)
+	{
+	  ffpmsg("Cannot allocate member HDU index (grp_find_index)");
+	  *status = MEMORY_ALLOCATION;
+	  return(NULL);
+	}
+
+      cache->index   = index;
+      cache->nialloc = nalloc;
+    }
+
+  index = &cache->index[cache->nindex];
+
+  index->Fptr     = Fptr;
+  index->nhdu     = 0;
+  index->nalloc   = 0;
+  index->complete = 0;
+  index->hdu      = NULL;
+
+  ++cache->nindex;
+
+  return(index);
+}
+
+/*--------------------------------------------------------------------------*/
+int grp_read_hdu(fitsfile      *mfptr,   /* member file, at the HDU         */
+		 int            hdutype, /* type of the HDU                 */
+		 grp_hdu_entry *entry,   /* returned HDU index entry        */
+		 int           *status)  /* return status code              */
+
+/*
+  read the keywords that identify the CHDU of mfptr into an HDU index entry
+*/
+
+{
+  int tstatus;
+
+
+  if(*status != 0) return(*status);
+
+  entry->hdutype = hdutype;
+  entry->alttype = -1;
+
+  if(fits_is_compressed_image(mfptr,status)) entry->alttype = BINARY_TBL;
+
+  /* reset to the 2nd keyword in the header */
+
+  ffmaky(mfptr,2,status);
+
+  tstatus = 0;
+  entry->hasextname = 
+    (ffgkys(mfptr,"EXTNAME",entry->extname,NULL,&tstatus) <= 0);
+  if(!entry->hasextname) entry->extname[0] = 0;
+
+  tstatus = 0;
+  entry->hashduname = 
+    (ffgkys(mfptr,"HDUNAME",entry->hduname,NULL,&tstatus) <= 0);
+  if(!entry->hashduname) entry->hduname[0] = 0;
+
+  /* assume the default EXTVER value if the keyword does not exist */
+
+  tstatus = 0;
+  if(ffgkyj(mfptr,"EXTVER",&entry->extver,NULL,&tstatus) > 0)
+    entry->extver = 1;
+
+  return(*status);
+}
+
+/*--------------------------------------------------------------------------*/
+int grp_match_hdu(grp_hdu_entry *entry,   /* HDU index entry                */
+		  int            hdutype, /* desired HDU type               */
+		  char          *extname, /* desired EXTNAME or HDUNAME     */
+		  int            extver)  /* desired EXTVER, or 0           */
+
+/*
+  return 1 if the HDU index entry matches the given HDU type, name and
+  version in the same way as ffmnhd() would match the HDU itself
+*/
+
+{
+  int match;
+  int exact = 0;
+
+
+  if(hdutype != ANY_HDU && entry->hdutype != hdutype &&
+     entry->alttype != hdutype) return(0);
+
+  if(entry->hasextname)
+    ffcmps(extname,entry->extname,CASEINSEN,&match,&exact);
+
+  if(!exact && entry->hashduname)
+    ffcmps(extname,entry->hduname,CASEINSEN,&match,&exact);
+
+  if(!exact) return(0);
+
+  if(extver && (int)entry->extver != extver) return(0);
+
+  return(1);
+}
+
+/*--------------------------------------------------------------------------*/
+int grp_find_hdu(grp_member_cache *cache,   /* member cache, or NULL         */
+		 fitsfile         *mfptr,   /* member file                   */
+		 int               hdutype, /* desired HDU type              */
+		 char             *extname, /* desired EXTNAME or HDUNAME    */
+		 int               extver,  /* desired EXTVER, or 0          */
+		 int              *status)  /* return status code            */
+
+/*
+  move to the first HDU of the member file with the given type, name and
+  version, as fits_movnam_hdu() does. If cache is not NULL then the HDU is
+  looked up in the HDU index of the file, and the file is only read as far
+  as is needed to extend the index to the first matching HDU. An indexed
+  HDU is checked again when it is moved to, and the index is discarded if
+  the HDU no longer matches. If no HDU matches then the CHDU is unchanged
+  and BAD_HDU_NUM is returned.
+*/
+
+{
+  int i;
+  int nalloc;
+  int extnum;
+  int type;
+  int tstatus;
+
+  grp_hdu_index *index;
+  grp_hdu_entry *hdu;
+  grp_hdu_entry  entry;
+
+
+  if(*status != 0) return(*status);
+
+  /* a hduname ending in # has special meaning to ffmnhd(); let it decide */
+
+  if(cache == NULL || (mfptr->Fptr)->only_one)
+    return(fits_movnam_hdu(mfptr,hdutype,extname,extver,status));
+
+  index = grp_find_index(cache,mfptr->Fptr,status);
+
+  if(*status != 0) return(*status);
+
+  extnum = mfptr->HDUposition + 1;  /* save the current HDU number */
+
+  for(i = 0; 1; ++i)
+    {
+      if(i == index->nhdu)
+	{
+	  /* all the indexed HDUs have been tried; index the next one */
+
+	  if(index->complete) break;
+
+	  tstatus = 0;
+	  if(ffmahd(mfptr,i + 1,&type,&tstatus) != 0)
+	    {
+	      index->complete = 1;
+	      break;
+	    }
+
+	  if(index->nhdu == index->nalloc)
+	    {
+	      nalloc = (index->nalloc == 0 ? 16 : 2 * index->nalloc);
+
+	      hdu = (grp_hdu_entry*) realloc(index->hdu,
+					     nalloc * sizeof(grp_hdu_entry));
+
+	      if(hdu == NULL)
+		{
+		  ffpmsg("Cannot allocate member HDU index (grp_find_hdu)");
+		  return(*status = MEMORY_ALLOCATION);
+		}
+
+	      index->hdu    = hdu;
+	      index->nalloc = nalloc;
+	    }
+
+	  if(grp_read_hdu(mfptr,type,&index->hdu[i],status) != 0)
+	    return(*status);
+
+	  ++index->nhdu;
+
+	  /* the CHDU is the newly indexed HDU, so no need to check it */
+
+	  if(grp_match_hdu(&index->hdu[i],hdutype,extname,extver))
+	    return(*status);
+
+	  continue;
+	}
+
+      if(!grp_match_hdu(&index->hdu[i],hdutype,extname,extver)) continue;
+
+      /* move to the matching HDU and make sure it is still the same one */
+
+      tstatus = 0;
+      if(ffmahd(mfptr,i + 1,&type,&tstatus) == 0             &&
+	 grp_read_hdu(mfptr,type,&entry,&tstatus) == 0        &&
+	 grp_match_hdu(&entry,hdutype,extname,extver))
+	return(*status);
+
+      /* the file has changed since it was indexed; search it directly */
+
+      grp_cache_forget(cache,mfptr->Fptr);
+
+      ffmahd(mfptr,extnum,NULL,status);
+
+      return(fits_movnam_hdu(mfptr,hdutype,extname,extver,status));
+    }
+
+  /* no matching HDU; restore the original file position */
+
+  ffmahd(mfptr,extnum,NULL,status);
+
+  return(*status = BAD_HDU_NUM);
+}
+
 /*---------------------------------------------------------------------------
         Host dependent directory path to/from URL functions
   --------------------------------------------------------------------------*/
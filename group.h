@@ -13,6 +13,51 @@ struct _HDUtracker
   int  newPosition[MAX_HDU_TRACKER];
 };
 
+/*
+  The member resolution cache, shared by all the member opens of a group
+  traversal.  Each member file named in a MEMBER_LOCATION column is located
+  and opened once, and the EXTNAME, HDUNAME and EXTVER values of the HDUs
+  in each member file are indexed, in file order, as they are first searched.
+*/
+
+typedef struct
+{
+  int  hdutype;             /* type of the HDU                              */
+  int  alttype;             /* BINARY_TBL if a compressed image, else -1    */
+  int  hasextname;          /* EXTNAME keyword exists                       */
+  int  hashduname;          /* HDUNAME keyword exists                       */
+  long extver;              /* EXTVER value, or 1 if it does not exist      */
+  char extname[FLEN_VALUE];
+  char hduname[FLEN_VALUE];
+} grp_hdu_entry;
+
+typedef struct
+{
+  FITSfile      *Fptr;      /* the indexed file                             */
+  int            nhdu;      /* number of HDUs indexed, starting at HDU 1    */
+  int            nalloc;    /* allocated length of hdu                      */
+  int            complete;  /* every HDU in the file has been indexed       */
+  grp_hdu_entry *hdu;
+} grp_hdu_index;
+
+typedef struct
+{
+  FITSfile *grpFptr;        /* file containing the grouping table           */
+  char     *location;       /* MEMBER_LOCATION value of the member          */
+  fitsfile *fptr;           /* open member file, or NULL                    */
+  int       status;         /* error status if the file could not be opened */
+} grp_member_file;
+
+typedef struct
+{
+  int              nfiles;  /* number of member files                       */
+  int              nfalloc; /* allocated length of file                     */
+  grp_member_file *file;
+  int              nindex;  /* number of indexed files                      */
+  int              nialloc; /* allocated length of index                    */
+  grp_hdu_index   *index;
+} grp_member_cache;
+
 /* functions used internally in the grouping convention module */
 
 int ffgtdc(int grouptype, int xtensioncol, int extnamecol, int extvercol,
@@ -31,10 +76,35 @@ int ffgmul(fitsfile *mfptr, int rmopt, int *status);
 int ffgmf(fitsfile *gfptr, char *xtension, char *extname, int extver,	   
 	  int position,	char *location,	long *member, int *status);
 
-int ffgtrmr(fitsfile *gfptr, HDUtracker *HDU, int *status);
+int ffgtrmr(fitsfile *gfptr, HDUtracker *HDU, grp_member_cache *cache,
+	    int *status);
 
 int ffgtcpr(fitsfile *infptr, fitsfile *outfptr, int cpopt, HDUtracker *HDU,
-	    int *status);
+	    grp_member_cache *cache, int *status);
+
+int ffgmopc(fitsfile *gfptr, long member, grp_member_cache *cache,
+	    fitsfile **mfptr, int *status);
+
+void grp_cache_init(grp_member_cache *cache);
+
+void grp_cache_free(grp_member_cache *cache);
+
+void grp_cache_forget(grp_member_cache *cache, FITSfile *Fptr);
+
+grp_member_file *grp_find_file(grp_member_cache *cache, FITSfile *grpFptr,
+			       char *location, int *status);
+
+grp_hdu_index *grp_find_index(grp_member_cache *cache, FITSfile *Fptr,
+			      int *status);
+
+int grp_read_hdu(fitsfile *mfptr, int hdutype, grp_hdu_entry *entry,
+		 int *status);
+
+int grp_match_hdu(grp_hdu_entry *entry, int hdutype, char *extname,
+		  int extver);
+
+int grp_find_hdu(grp_member_cache *cache, fitsfile *mfptr, int hdutype,
+		 char *extname, int extver, int *status);
 
 int fftsad(fitsfile *mfptr, HDUtracker *HDU, int *newPosition, 
 	   char *newFileName);
@@ -64,6 +64,11 @@
 16-Dec-2003 James Peachey: ngp_keyword_all_write was modified to apply
                 comments from the template file to the output file in
                 the case of reserved keywords (e.g. tform#, ttype# etcetera).
+18-Oct-2026: template is compiled into a list of NGP_NODEs (fitstemplate)
+                before any HDU is created, with non system keywords already
+                formatted, so that each header is written as one block.
+                Added fits_compile_template, fits_execute_compiled_template
+                and fits_free_template to create many files from one template.
 */
 
 
@@ -820,19 +825,32 @@ int     ngp_keyword_all_write(NGP_HDU *ngph, fitsfile *ffp, int mode)
                         break;
            }
         }
-      else if (NGP_BAD_ARG == r) /* enhancement 10 dec 2003, James Peachey: template comments replace defaults */
-        { r = NGP_OK;						/* update comments of special keywords like TFORM */
-          if (ngph->tok[i].comment && *ngph->tok[i].comment)	/* do not update with a blank comment */
-            { fits_modify_comment(ffp, ngph->tok[i].name, ngph->tok[i].comment, &r);
-            }
-        }
-      else /* other problem, typically a blank token */
+      else /* reserved keyword (see ngp_keyword_comments_write) or blank token */
         { r = NGP_OK;						/* skip this token, but continue */
         }
       if (r) return(r);
     }
      
-   fits_set_hdustruc(ffp, &r);				/* resync cfitsio */
+   return(r);
+ }
+
+	/* enhancement 10 dec 2003, James Peachey: template comments replace defaults */
+	/* of reserved keywords like TFORM, which cfitsio itself has written */
+
+int     ngp_keyword_comments_write(NGP_HDU *ngph, fitsfile *ffp)
+ { int		i, r;
+
+   if (NULL == ngph) return(NGP_NUL_PTR);
+   if (NULL == ffp) return(NGP_NUL_PTR);
+   r = NGP_OK;
+
+   for (i=0; i<ngph->tokcnt; i++)
+    { if (NGP_BAD_ARG != ngp_keyword_is_write(&(ngph->tok[i]))) continue;
+      if (ngph->tok[i].comment && *ngph->tok[i].comment)	/* do not update with a blank comment */
+        { fits_modify_comment(ffp, ngph->tok[i].name, ngph->tok[i].comment, &r);
+        }
+      if (r) return(r);
+    }
    return(r);
  }
 
@@ -899,17 +917,72 @@ int	ngp_hdu_insert_token(NGP_HDU *ngph, NGP_TOKEN *newtok)
  }
 
 
-int	ngp_append_columns(fitsfile *ff, NGP_HDU *ngph, int aftercol)
- { int		r, i, j, exitflg, ngph_i;
+	/* add new (empty) node to compiled template */
+
+int	ngp_node_add(fitstemplate *tplt, int kind, NGP_NODE **node)
+ { NGP_NODE	*np;
+   int		n;
+
+   if (NULL == tplt) return(NGP_NUL_PTR);
+   if (NULL == node) return(NGP_NUL_PTR);
+
+   if (tplt->nodecnt >= tplt->nodealloc)
+     { n = tplt->nodealloc ? (2 * tplt->nodealloc) : 16;
+       if (NULL == tplt->node)
+         np = (NGP_NODE *)ngp_alloc(n * sizeof(NGP_NODE));
+       else
+         np = (NGP_NODE *)ngp_realloc(tplt->node, n * sizeof(NGP_NODE));
+       if (NULL == np) return(NGP_NO_MEMORY);
+       tplt->node = np;
+       tplt->nodealloc = n;
+     }
+
+   np = &(tplt->node[tplt->nodecnt++]);
+   memset(np, 0, sizeof(NGP_NODE));
+   np->kind = kind;
+   np->type = NGP_NODE_INVALID;
+   ngp_hdu_init(&(np->hdu));
+   *node = np;
+   return(NGP_OK);
+ }
+
+	/* delete nodes from given index up to the end of compiled template */
+
+int	ngp_node_drop(fitstemplate *tplt, int first)
+ { NGP_NODE	*np;
+
+   if (NULL == tplt) return(NGP_NUL_PTR);
+
+   while (tplt->nodecnt > first)
+    { np = &(tplt->node[--tplt->nodecnt]);
+      if (NULL != np->naxes) ngp_free(np->naxes);
+      if (NULL != np->ttype) ngp_free(np->ttype);
+      if (NULL != np->tform) ngp_free(np->tform);
+      if (NULL != np->cards) ngp_free(np->cards);
+      ngp_hdu_clear(&(np->hdu));
+    }
+   return(NGP_OK);
+ }
+
+	/* find columns requested by template, they are created in one call */
+	/* (TTYPEn/TFORMn pointers point to strings held by node's tokens) */
+
+int	ngp_node_columns(NGP_NODE *node, int aftercol)
+ { int		i, j, exitflg, ngph_i;
    char 	*my_tform, *my_ttype;
    char		ngph_ctmp;
+   NGP_HDU	*ngph;
 
-
-   if (NULL == ff) return(NGP_NUL_PTR);
-   if (NULL == ngph) return(NGP_NUL_PTR);
+   if (NULL == node) return(NGP_NUL_PTR);
+   ngph = &(node->hdu);
+   node->aftercol = aftercol;
+   node->ncols = 0;
    if (0 == ngph->tokcnt) return(NGP_OK);	/* nothing to do ! */
 
-   r = NGP_OK;
+   node->ttype = (char **)ngp_alloc(ngph->tokcnt * sizeof(char *));
+   node->tform = (char **)ngp_alloc(ngph->tokcnt * sizeof(char *));
+   if ((NULL == node->ttype) || (NULL == node->tform)) return(NGP_NO_MEMORY);
+
    exitflg = 0;
 
    for (j=aftercol; j<NGP_MAX_ARRAY_DIM; j++)	/* 0 for table, 6 for group */
@@ -935,24 +1008,127 @@ int	ngp_append_columns(fitsfile *ff, NGP_HDU *ngph, int aftercol)
          exitflg = 1;
          break;
        }
-      if ((NGP_OK == r) && (NULL != my_tform))
-        fits_insert_col(ff, j + 1, my_ttype, my_tform, &r);
+      if ((NULL != my_tform) && (node->ncols < ngph->tokcnt))
+        { node->ttype[node->ncols] = my_ttype;
+          node->tform[node->ncols] = my_tform;
+          node->ncols++;
+        }
 
-      if ((NGP_OK != r) || exitflg) break;
+      if (exitflg) break;
+    }
+   return(NGP_OK);
+ }
+
+	/* create columns of node in the CHDU. Binary table columns are inserted */
+	/* at once, ASCII ones one by one as fits_insert_cols would place them */
+	/* differently (with no extra space before 2nd and following column) */
+
+int	ngp_node_columns_write(fitsfile *ff, NGP_NODE *node)
+ { int		r, i;
+
+   if (NULL == ff) return(NGP_NUL_PTR);
+   if (NULL == node) return(NGP_NUL_PTR);
+   if (0 == node->ncols) return(NGP_OK);	/* nothing to do ! */
+
+   r = NGP_OK;
+   if (NGP_NODE_ATABLE != node->type)		/* GROUP table is binary too */
+     { fits_insert_cols(ff, node->aftercol + 1, node->ncols, node->ttype, node->tform, &r);
+       return(r);
+     }
+
+   for (i=0; i<node->ncols; i++)
+    { fits_insert_col(ff, node->aftercol + i + 1, node->ttype[i], node->tform[i], &r);
+      if (NGP_OK != r) break;
     }
    return(r);
  }
 
+	/* format non system keywords of node into 80 byte header records. */
+	/* They are written with the usual cfitsio routines to an empty HDU */
+	/* of a scratch memory file and read back as one block. */
+
+int	ngp_node_format(fitstemplate *tplt, NGP_NODE *node)
+ { int		r, nbefore, nafter, more, tmp0;
+   fitsfile	*sf;
+
+   if (NULL == tplt) return(NGP_NUL_PTR);
+   if (NULL == node) return(NGP_NUL_PTR);
+
+   r = NGP_OK;
+   if (NULL == tplt->scratch)
+     { fits_create_file(&(tplt->scratch), "mem://", &r);
+       fits_create_img(tplt->scratch, 8, 0, NULL, &r);
+       if (NGP_OK != r) return(r);
+     }
+   sf = tplt->scratch;
+
+   fits_create_img(sf, 8, 0, NULL, &r);
+   fits_get_hdrspace(sf, &nbefore, &more, &r);
+   if (NGP_OK == r) r = ngp_keyword_all_write(&(node->hdu), sf, NGP_NON_SYSTEM_ONLY);
+   fits_get_hdrspace(sf, &nafter, &more, &r);
+
+   if ((NGP_OK == r) && (nafter > nbefore))
+     { node->ncards = nafter - nbefore;
+       node->cards = (char *)ngp_alloc(node->ncards * 80);
+       if (NULL == node->cards) r = NGP_NO_MEMORY;
+       ffmbyt(sf, (sf->Fptr)->headstart[(sf->Fptr)->curhdu] + nbefore * 80, REPORT_EOF, &r);
+       ffgbyt(sf, node->ncards * 80, node->cards, &r);
+     }
+
+   tmp0 = 0;
+   fits_delete_hdu(sf, NULL, &tmp0);		/* scratch HDU no more needed */
+   return(r);
+ }
+
+	/* append preformatted records of node to the CHDU, in one write */
+
+int	ngp_node_cards_write(fitsfile *ff, NGP_NODE *node)
+ { int		r;
+   long		nblocks;
+   LONGLONG	nbytes, room;
+
+   if (NULL == ff) return(NGP_NUL_PTR);
+   if (NULL == node) return(NGP_NUL_PTR);
+   if (0 == node->ncards) return(NGP_OK);	/* nothing to do ! */
+
+   r = NGP_OK;
+   if (ff->HDUposition != (ff->Fptr)->curhdu)
+     ffmahd(ff, (ff->HDUposition) + 1, NULL, &r);
+
+   nbytes = (LONGLONG)node->ncards * 80;
+   room = (ff->Fptr)->datastart - (ff->Fptr)->headend - 80;	/* keep space for END */
+   if (((ff->Fptr)->datastart != DATA_UNDEFINED) && (nbytes > room))
+     { 						/* insert all needed blocks at once */
+       nblocks = (long)((nbytes - room + 2879) / 2880);
+       if (ffiblk(ff, nblocks, 0, &r) > 0) return(r);
+     }
+
+   ffmbyt(ff, (ff->Fptr)->headend, IGNORE_EOF, &r);
+   ffpbyt(ff, nbytes, node->cards, &r);
+   if (NGP_OK == r) (ff->Fptr)->headend += nbytes;
+   return(r);
+ }
+
+	/* write keywords of node to the CHDU, columns already exist */
+
+int	ngp_node_write(fitsfile *ff, NGP_NODE *node)
+ { int		r;
+
+   r = ngp_keyword_comments_write(&(node->hdu), ff);
+   if (NGP_OK == r) r = ngp_node_cards_write(ff, node);
+   fits_set_hdustruc(ff, &r);				/* resync cfitsio */
+   return(r);
+ }
+
 	/* read complete HDU */
 
-int	ngp_read_xtension(fitsfile *ff, int parent_hn, int simple_mode)
- { int		r, exflg, l, my_hn, tmp0, incrementor_index, i, j;
-   int		ngph_dim, ngph_bitpix, ngph_node_type, my_version;
+int	ngp_read_xtension(fitstemplate *tplt, int simple_mode)
+ { int		r, exflg, l, incrementor_index, i, j;
+   int		ngph_dim, ngph_bitpix, ngph_node_type;
    char		incrementor_name[NGP_MAX_STRING], ngph_ctmp;
-   char 	*ngph_extname = 0;
    long		ngph_size[NGP_MAX_ARRAY_DIM];
    NGP_HDU	ngph;
-   long		lv;
+   NGP_NODE	*node;
 
    incrementor_name[0] = 0;			/* signal no keyword+'#' found yet */
    incrementor_index = 0;
@@ -971,7 +1147,7 @@ int	ngp_read_xtension(fitsfile *ff, int parent_hn, int simple_mode)
    if (NGP_OK != (r = ngp_hdu_insert_token(&ngph, &ngp_linkey))) return(r);
 
    for (;;)
-    { if (NGP_OK != (r = ngp_read_line(0))) return(r);	/* EOF always means error here */
+    { if (NGP_OK != (r = ngp_read_line(0))) break;	/* EOF always means error here */
       exflg = 0;
       switch (ngp_keyidx)
        { 
@@ -1006,135 +1182,100 @@ int	ngp_read_xtension(fitsfile *ff, int parent_hn, int simple_mode)
       if ((NGP_OK != r) || exflg) break;
     }
 
-   if (NGP_OK == r)
-     { 				/* we should scan keywords, and calculate HDU's */
+   if (NGP_OK != r)
+     { ngp_hdu_clear(&ngph);
+       return(r);
+     }
+
+				/* we should scan keywords, and calculate HDU's */
 				/* structure ourselves .... */
 
-       ngph_node_type = NGP_NODE_INVALID;	/* init variables */
-       ngph_bitpix = 0;
-       ngph_extname = NULL;
-       for (i=0; i<NGP_MAX_ARRAY_DIM; i++) ngph_size[i] = 0;
-       ngph_dim = 0;
-
-       for (i=0; i<ngph.tokcnt; i++)
-        { if (!strcmp("XTENSION", ngph.tok[i].name))
-            { if (NGP_TTYPE_STRING == ngph.tok[i].type)
-                { if (!fits_strncasecmp("BINTABLE", ngph.tok[i].value.s,8)) ngph_node_type = NGP_NODE_BTABLE;
-                  if (!fits_strncasecmp("TABLE", ngph.tok[i].value.s,5)) ngph_node_type = NGP_NODE_ATABLE;
-                  if (!fits_strncasecmp("IMAGE", ngph.tok[i].value.s,5)) ngph_node_type = NGP_NODE_IMAGE;
-                }
-            }
-          else if (!strcmp("SIMPLE", ngph.tok[i].name))
-            { if (NGP_TTYPE_BOOL == ngph.tok[i].type)
-                { if (ngph.tok[i].value.b) ngph_node_type = NGP_NODE_IMAGE;
-                }
-            }
-          else if (!strcmp("BITPIX", ngph.tok[i].name))
-            { if (NGP_TTYPE_INT == ngph.tok[i].type)  ngph_bitpix = ngph.tok[i].value.i;
-            }
-          else if (!strcmp("NAXIS", ngph.tok[i].name))
-            { if (NGP_TTYPE_INT == ngph.tok[i].type)  ngph_dim = ngph.tok[i].value.i;
-            }
-          else if (!strcmp("EXTNAME", ngph.tok[i].name))	/* assign EXTNAME, I hope struct does not move */
-            { if (NGP_TTYPE_STRING == ngph.tok[i].type)  ngph_extname = ngph.tok[i].value.s;
+   ngph_node_type = NGP_NODE_INVALID;	/* init variables */
+   ngph_bitpix = 0;
+   for (i=0; i<NGP_MAX_ARRAY_DIM; i++) ngph_size[i] = 0;
+   ngph_dim = 0;
+
+   for (i=0; i<ngph.tokcnt; i++)
+    { if (!strcmp("XTENSION", ngph.tok[i].name))
+        { if (NGP_TTYPE_STRING == ngph.tok[i].type)
+            { if (!fits_strncasecmp("BINTABLE", ngph.tok[i].value.s,8)) ngph_node_type = NGP_NODE_BTABLE;
+              if (!fits_strncasecmp("TABLE", ngph.tok[i].value.s,5)) ngph_node_type = NGP_NODE_ATABLE;
+              if (!fits_strncasecmp("IMAGE", ngph.tok[i].value.s,5)) ngph_node_type = NGP_NODE_IMAGE;
             }
-          else if (1 == sscanf(ngph.tok[i].name, "NAXIS%d%c", &j, &ngph_ctmp))
-            { if (NGP_TTYPE_INT == ngph.tok[i].type)
-		if ((j>=1) && (j <= NGP_MAX_ARRAY_DIM))
-		  { ngph_size[j - 1] = ngph.tok[i].value.i;
-		  }
+        }
+      else if (!strcmp("SIMPLE", ngph.tok[i].name))
+        { if (NGP_TTYPE_BOOL == ngph.tok[i].type)
+            { if (ngph.tok[i].value.b) ngph_node_type = NGP_NODE_IMAGE;
             }
         }
+      else if (!strcmp("BITPIX", ngph.tok[i].name))
+        { if (NGP_TTYPE_INT == ngph.tok[i].type)  ngph_bitpix = ngph.tok[i].value.i;
+        }
+      else if (!strcmp("NAXIS", ngph.tok[i].name))
+        { if (NGP_TTYPE_INT == ngph.tok[i].type)  ngph_dim = ngph.tok[i].value.i;
+        }
+      else if (1 == sscanf(ngph.tok[i].name, "NAXIS%d%c", &j, &ngph_ctmp))
+        { if (NGP_TTYPE_INT == ngph.tok[i].type)
+	    if ((j>=1) && (j <= NGP_MAX_ARRAY_DIM))
+	      { ngph_size[j - 1] = ngph.tok[i].value.i;
+	      }
+        }
+    }
 
-       switch (ngph_node_type)
-        { case NGP_NODE_IMAGE:
-			if (NGP_XTENSION_FIRST == ((NGP_XTENSION_FIRST | NGP_XTENSION_SIMPLE) & simple_mode))
-			  { 		/* if caller signals that this is 1st HDU in file */
-					/* and it is IMAGE defined with XTENSION, then we */
-					/* need create dummy Primary HDU */			  
-			    fits_create_img(ff, 16, 0, NULL, &r);
-			  }
-					/* create image */
-			fits_create_img(ff, ngph_bitpix, ngph_dim, ngph_size, &r);
-
-					/* update keywords */
-			if (NGP_OK == r)  r = ngp_keyword_all_write(&ngph, ff, NGP_NON_SYSTEM_ONLY);
-			break;
-
-          case NGP_NODE_ATABLE:
-          case NGP_NODE_BTABLE:
-					/* create table, 0 rows and 0 columns for the moment */
-			fits_create_tbl(ff, ((NGP_NODE_ATABLE == ngph_node_type)
-					     ? ASCII_TBL : BINARY_TBL),
-					0, 0, NULL, NULL, NULL, NULL, &r);
-			if (NGP_OK != r) break;
-
-					/* add columns ... */
-			r = ngp_append_columns(ff, &ngph, 0);
-			if (NGP_OK != r) break;
-
-					/* add remaining keywords */
-			r = ngp_keyword_all_write(&ngph, ff, NGP_NON_SYSTEM_ONLY);
-			if (NGP_OK != r) break;
+   if ((NGP_NODE_INVALID == ngph_node_type) || (ngph_dim > NGP_MAX_ARRAY_DIM))
+     { ngp_hdu_clear(&ngph);
+       return(NGP_BAD_ARG);
+     }
 
-					/* if requested add rows */
-			if (ngph_size[1] > 0) fits_insert_rows(ff, 0, ngph_size[1], &r);
-			break;
+   if (NGP_OK != (r = ngp_node_add(tplt, (NGP_XTENSION_SIMPLE & simple_mode)
+				      ? NGP_TOKEN_SIMPLE : NGP_TOKEN_XTENSION, &node)))
+     { ngp_hdu_clear(&ngph);
+       return(r);
+     }
 
-	  default:	r = NGP_BAD_ARG;
-	  		break;
-	}
+   node->hdu = ngph;				/* node owns tokens from now on */
+   node->type = ngph_node_type;
+   node->bitpix = ngph_bitpix;
+   node->naxis = ngph_dim;
+   node->nrows = ngph_size[1];
 
-     }
+   for (i=0; i<node->hdu.tokcnt; i++)		/* assign EXTNAME, tokens do not move any more */
+    { if (!strcmp("EXTNAME", node->hdu.tok[i].name))
+        { if (NGP_TTYPE_STRING == node->hdu.tok[i].type)  node->extname = node->hdu.tok[i].value.s;
+        }
+    }
 
-   if ((NGP_OK == r) && (NULL != ngph_extname))
-     { r = ngp_get_extver(ngph_extname, &my_version);	/* write correct ext version number */
-       lv = my_version;		/* bugfix - 22-Jan-99, BO - nonalignment of OSF/Alpha */
-       fits_write_key(ff, TLONG, "EXTVER", &lv, "auto assigned by template parser", &r); 
+   if ((NGP_NODE_IMAGE == ngph_node_type) && (ngph_dim > 0))
+     { node->naxes = (long *)ngp_alloc(ngph_dim * sizeof(long));
+       if (NULL == node->naxes) r = NGP_NO_MEMORY;
+       else memcpy(node->naxes, ngph_size, ngph_dim * sizeof(long));
      }
-
-   if (NGP_OK == r)
-     { if (parent_hn > 0)
-         { fits_get_hdu_num(ff, &my_hn);
-           fits_movabs_hdu(ff, parent_hn, &tmp0, &r);	/* link us to parent */
-           fits_add_group_member(ff, NULL, my_hn, &r);
-           fits_movabs_hdu(ff, my_hn, &tmp0, &r);
-           if (NGP_OK != r) return(r);
-         }
+   else if (NGP_NODE_IMAGE != ngph_node_type)
+     { r = ngp_node_columns(node, 0);
      }
 
-   if (NGP_OK != r)					/* in case of error - delete hdu */
-     { tmp0 = 0;
-       fits_delete_hdu(ff, NULL, &tmp0);
-     }
+   if (NGP_OK == r) r = ngp_node_format(tplt, node);
 
-   ngp_hdu_clear(&ngph);
+   if (NGP_OK != r) ngp_node_drop(tplt, tplt->nodecnt - 1);
    return(r);
  }
 
 	/* read complete GROUP */
 
-int	ngp_read_group(fitsfile *ff, char *grpname, int parent_hn)
- { int		r, exitflg, l, my_hn, tmp0, incrementor_index;
+int	ngp_read_group(fitstemplate *tplt, char *grpname)
+ { int		r, exitflg, l, my_idx, incrementor_index;
    char		grnm[NGP_MAX_STRING];			/* keyword holding group name */
    char		incrementor_name[NGP_MAX_STRING];
-   NGP_HDU	ngph;
+   NGP_NODE	*node;
 
    incrementor_name[0] = 0;			/* signal no keyword+'#' found yet */
    incrementor_index = 6;			/* first 6 cols are used by group */
 
    ngp_grplevel++;
-   if (NGP_OK != (r = ngp_hdu_init(&ngph))) return(r);
-
-   r = NGP_OK;
-   if (NGP_OK != (r = fits_create_group(ff, grpname, GT_ID_ALL_URI, &r))) return(r);
-   fits_get_hdu_num(ff, &my_hn);
-   if (parent_hn > 0)
-     { fits_movabs_hdu(ff, parent_hn, &tmp0, &r);	/* link us to parent */
-       fits_add_group_member(ff, NULL, my_hn, &r);
-       fits_movabs_hdu(ff, my_hn, &tmp0, &r);
-       if (NGP_OK != r) return(r);
-     }
+   if (NGP_OK != (r = ngp_node_add(tplt, NGP_TOKEN_GROUP, &node))) return(r);
+   strncpy(node->grpname, grpname, NGP_MAX_STRING);
+   node->grpname[NGP_MAX_STRING - 1] = 0;
+   my_idx = tplt->nodecnt - 1;		/* nodes may move, so remember index only */
 
    for (exitflg = 0; 0 == exitflg;)
     { if (NGP_OK != (r = ngp_read_line(0))) break;	/* EOF always means error here */
@@ -1158,13 +1299,13 @@ int	ngp_read_group(fitsfile *ff, char *grpname, int parent_hn)
 			  { snprintf(grnm, NGP_MAX_STRING,"DEFAULT_GROUP_%d", master_grp_idx++);
 			  }
 			grnm[NGP_MAX_STRING - 1] = 0;
-			r = ngp_read_group(ff, grnm, my_hn);
+			r = ngp_read_group(tplt, grnm);
 			break;			/* we can have many subsequent GROUP defs */
 
          case NGP_TOKEN_XTENSION:
          		r = ngp_unread_line();
          		if (NGP_OK != r) break;
-         		r = ngp_read_xtension(ff, my_hn, 0);
+         		r = ngp_read_xtension(tplt, 0);
 			break;			/* we can have many subsequent HDU defs */
 
          default:	l = strlen(ngp_linkey.name);
@@ -1180,108 +1321,41 @@ int	ngp_read_group(fitsfile *ff, char *grpname, int parent_hn)
 			        snprintf(ngp_linkey.name + l - 1, NGP_MAX_NAME-l+1,"%d", incrementor_index);
 			      }
 			  }
-         		r = ngp_hdu_insert_token(&ngph, &ngp_linkey); 
+         		r = ngp_hdu_insert_token(&(tplt->node[my_idx].hdu), &ngp_linkey); 
 			break;			/* here we can add keyword */
        }
       if (NGP_OK != r) break;
     }
 
-   fits_movabs_hdu(ff, my_hn, &tmp0, &r);	/* back to our HDU */
+   node = &(tplt->node[my_idx]);
+   node->members = tplt->nodecnt - my_idx - 1;
 
-   if (NGP_OK == r)				/* create additional columns, if requested */
-     r = ngp_append_columns(ff, &ngph, 6);
+   if (NGP_OK == r)				/* find additional columns, if requested */
+     r = ngp_node_columns(node, 6);
 
-   if (NGP_OK == r)				/* and write keywords */
-     r = ngp_keyword_all_write(&ngph, ff, NGP_NON_SYSTEM_ONLY);
+   if (NGP_OK == r)				/* and format keywords */
+     r = ngp_node_format(tplt, node);
 
-   if (NGP_OK != r)			/* delete group in case of error */
-     { tmp0 = 0;
-       fits_remove_group(ff, OPT_RM_GPT, &tmp0);
-     }
+   if (NGP_OK != r)			/* delete group and its members in case of error */
+     ngp_node_drop(tplt, my_idx);
 
-   ngp_hdu_clear(&ngph);		/* we are done with this HDU, so delete it */
    return(r);
  }
 
-		/* top level API functions */
-
-/* read whole template. ff should point to the opened empty fits file. */
+	/* compile whole template, nodes are appended to tplt. In case of error */
+	/* all complete top level blocks before the faulty one are kept. */
 
-int	fits_execute_template(fitsfile *ff, char *ngp_template, int *status)
- { int		r, exit_flg, first_extension, i, my_hn, tmp0, keys_exist, more_keys, used_ver;
-   char		grnm[NGP_MAX_STRING], used_name[NGP_MAX_STRING];
-   long		luv;
-
-   if (NULL == status) return(NGP_NUL_PTR);
-   if (NGP_OK != *status) return(*status);
-
-   /* This function uses many global variables (local to this file) and
-      therefore is not thread-safe. */
-   FFLOCK;
-   
-   if ((NULL == ff) || (NULL == ngp_template))
-     { *status = NGP_NUL_PTR;
-       FFUNLOCK;
-       return(*status);
-     }
+int	ngp_compile_template(fitstemplate *tplt, char *ngp_template)
+ { int		r, exit_flg, i, tmp0;
+   char		grnm[NGP_MAX_STRING];
 
    ngp_inclevel = 0;				/* initialize things, not all should be zero */
    ngp_grplevel = 0;
    master_grp_idx = 1;
    exit_flg = 0;
    ngp_master_dir[0] = 0;			/* this should be before 1st call to ngp_include_file */
-   first_extension = 1;				/* we need to create PHDU */
 
-   if (NGP_OK != (r = ngp_delete_extver_tab()))
-     { *status = r;
-       FFUNLOCK;
-       return(r);
-     }
-
-   fits_get_hdu_num(ff, &my_hn);		/* our HDU position */
-   if (my_hn <= 1)				/* check whether we really need to create PHDU */
-     { fits_movabs_hdu(ff, 1, &tmp0, status);
-       fits_get_hdrspace(ff, &keys_exist, &more_keys, status);
-       fits_movabs_hdu(ff, my_hn, &tmp0, status);
-       if (NGP_OK != *status) /* error here means file is corrupted */
-       {
-          FFUNLOCK;
-          return(*status);	
-       }
-       if (keys_exist > 0) first_extension = 0;	/* if keywords exist assume PHDU already exist */
-     }
-   else
-     { first_extension = 0;			/* PHDU (followed by 1+ extensions) exist */
-
-       for (i = 2; i<= my_hn; i++)
-        { *status = NGP_OK;
-          fits_movabs_hdu(ff, 1, &tmp0, status);
-          if (NGP_OK != *status) break;
-
-          fits_read_key(ff, TSTRING, "EXTNAME", used_name, NULL, status);
-          if (NGP_OK != *status)  continue;
-
-          fits_read_key(ff, TLONG, "EXTVER", &luv, NULL, status);
-          used_ver = luv;			/* bugfix - 22-Jan-99, BO - nonalignment of OSF/Alpha */
-          if (VALUE_UNDEFINED == *status)
-            { used_ver = 1;
-              *status = NGP_OK;
-            }
-
-          if (NGP_OK == *status) *status = ngp_set_extver(used_name, used_ver);
-        }
-
-       fits_movabs_hdu(ff, my_hn, &tmp0, status);
-     }
-     
-   if (NGP_OK != *status) {
-      FFUNLOCK;
-      return(*status);
-   }                                                                       
-   if (NGP_OK != (*status = ngp_include_file(ngp_template))) {
-      FFUNLOCK;
-      return(*status);
-   }
+   if (NGP_OK != (r = ngp_include_file(ngp_template))) return(r);
    
    for (i = strlen(ngp_template) - 1; i >= 0; i--) /* strlen is > 0, otherwise fopen failed */
     { 
@@ -1306,19 +1380,17 @@ int	fits_execute_template(fitsfile *ff, char *ngp_template, int *status)
       switch (ngp_keyidx)
        {
          case NGP_TOKEN_SIMPLE:
-			if (0 == first_extension)	/* simple only allowed in first HDU */
+			if (0 != tplt->nodecnt)		/* simple only allowed in first HDU */
 			  { r = NGP_TOKEN_NOT_EXPECT;
 			    break;
 			  }
 			if (NGP_OK != (r = ngp_unread_line())) break;
-			r = ngp_read_xtension(ff, 0, NGP_XTENSION_SIMPLE | NGP_XTENSION_FIRST);
-			first_extension = 0;
+			r = ngp_read_xtension(tplt, NGP_XTENSION_SIMPLE);
 			break;
 
          case NGP_TOKEN_XTENSION:
 			if (NGP_OK != (r = ngp_unread_line())) break;
-			r = ngp_read_xtension(ff, 0, (first_extension ? NGP_XTENSION_FIRST : 0));
-			first_extension = 0;
+			r = ngp_read_xtension(tplt, 0);
 			break;
 
          case NGP_TOKEN_GROUP:
@@ -1327,8 +1399,7 @@ int	fits_execute_template(fitsfile *ff, char *ngp_template, int *status)
 			else
 			  { snprintf(grnm,NGP_MAX_STRING, "DEFAULT_GROUP_%d", master_grp_idx++); }
 			grnm[NGP_MAX_STRING - 1] = 0;
-			r = ngp_read_group(ff, grnm, 0);
-			first_extension = 0;
+			r = ngp_read_group(tplt, grnm);
 			break;
 
 	 case NGP_TOKEN_EOF:
@@ -1341,15 +1412,307 @@ int	fits_execute_template(fitsfile *ff, char *ngp_template, int *status)
       if (exit_flg || (NGP_OK != r)) break;
     }
 
+   ngp_free_line();		/* deallocate last line (if any) */
+   ngp_free_prevline();		/* deallocate cached line (if any) */
+
+   if (NULL != tplt->scratch)	/* scratch file is not needed once compiled */
+     { tmp0 = 0;
+       fits_close_file(tplt->scratch, &tmp0);
+       tplt->scratch = NULL;
+     }
+   return(r);
+ }
+
+	/* create HDU described by node */
+
+int	ngp_write_xtension(fitsfile *ff, NGP_NODE *node, int parent_hn, int simple_mode)
+ { int		r, my_hn, tmp0, my_version;
+   long		lv;
+
+   r = NGP_OK;
+   switch (node->type)
+    { case NGP_NODE_IMAGE:
+			if (NGP_XTENSION_FIRST == ((NGP_XTENSION_FIRST | NGP_XTENSION_SIMPLE) & simple_mode))
+			  { 		/* if caller signals that this is 1st HDU in file */
+					/* and it is IMAGE defined with XTENSION, then we */
+					/* need create dummy Primary HDU */			  
+			    fits_create_img(ff, 16, 0, NULL, &r);
+			  }
+					/* create image */
+			fits_create_img(ff, node->bitpix, node->naxis, node->naxes, &r);
+
+					/* update keywords */
+			if (NGP_OK == r)  r = ngp_node_write(ff, node);
+			break;
+
+      case NGP_NODE_ATABLE:
+      case NGP_NODE_BTABLE:
+					/* create table, 0 rows and 0 columns for the moment */
+			fits_create_tbl(ff, ((NGP_NODE_ATABLE == node->type)
+					     ? ASCII_TBL : BINARY_TBL),
+					0, 0, NULL, NULL, NULL, NULL, &r);
+			if (NGP_OK != r) break;
+
+					/* add columns ... */
+			r = ngp_node_columns_write(ff, node);
+			if (NGP_OK != r) break;
+
+					/* add remaining keywords */
+			r = ngp_node_write(ff, node);
+			if (NGP_OK != r) break;
+
+					/* if requested add rows */
+			if (node->nrows > 0) fits_insert_rows(ff, 0, node->nrows, &r);
+			break;
+
+      default:		r = NGP_BAD_ARG;
+	  		break;
+    }
+
+   if ((NGP_OK == r) && (NULL != node->extname))
+     { r = ngp_get_extver(node->extname, &my_version);	/* write correct ext version number */
+       lv = my_version;		/* bugfix - 22-Jan-99, BO - nonalignment of OSF/Alpha */
+       fits_write_key(ff, TLONG, "EXTVER", &lv, "auto assigned by template parser", &r); 
+     }
+
+   if (NGP_OK == r)
+     { if (parent_hn > 0)
+         { fits_get_hdu_num(ff, &my_hn);
+           fits_movabs_hdu(ff, parent_hn, &tmp0, &r);	/* link us to parent */
+           fits_add_group_member(ff, NULL, my_hn, &r);
+           fits_movabs_hdu(ff, my_hn, &tmp0, &r);
+           if (NGP_OK != r) return(r);
+         }
+     }
+
+   if (NGP_OK != r)					/* in case of error - delete hdu */
+     { tmp0 = 0;
+       fits_delete_hdu(ff, NULL, &tmp0);
+     }
+
+   return(r);
+ }
+
+	/* create GROUP described by node at given index, and all its members */
+
+int	ngp_write_group(fitsfile *ff, fitstemplate *tplt, int idx, int parent_hn)
+ { int		r, i, my_hn, tmp0;
+   NGP_NODE	*node;
+
+   node = &(tplt->node[idx]);
+   r = NGP_OK;
+   if (NGP_OK != (r = fits_create_group(ff, node->grpname, GT_ID_ALL_URI, &r))) return(r);
+   fits_get_hdu_num(ff, &my_hn);
+   if (parent_hn > 0)
+     { fits_movabs_hdu(ff, parent_hn, &tmp0, &r);	/* link us to parent */
+       fits_add_group_member(ff, NULL, my_hn, &r);
+       fits_movabs_hdu(ff, my_hn, &tmp0, &r);
+       if (NGP_OK != r) return(r);
+     }
+
+   for (i = idx + 1; i <= idx + node->members; )
+    { if (NGP_TOKEN_GROUP == tplt->node[i].kind)
+        { r = ngp_write_group(ff, tplt, i, my_hn);
+          i += tplt->node[i].members + 1;
+        }
+      else
+        { r = ngp_write_xtension(ff, &(tplt->node[i]), my_hn, 0);
+          i++;
+        }
+      if (NGP_OK != r) break;
+    }
+
+   fits_movabs_hdu(ff, my_hn, &tmp0, &r);	/* back to our HDU */
+
+   if (NGP_OK == r)				/* create additional columns, if requested */
+     r = ngp_node_columns_write(ff, node);
+
+   if (NGP_OK == r)				/* and write keywords */
+     r = ngp_node_write(ff, node);
+
+   if (NGP_OK != r)			/* delete group in case of error */
+     { tmp0 = 0;
+       fits_remove_group(ff, OPT_RM_GPT, &tmp0);
+     }
+
+   return(r);
+ }
+
+	/* create all HDUs of compiled template. ff should point to the opened */
+	/* empty fits file, or to the last HDU of existing file. */
+
+int	ngp_write_template(fitsfile *ff, fitstemplate *tplt)
+ { int		r, first_extension, i, my_hn, tmp0, keys_exist, more_keys, used_ver;
+   char		used_name[NGP_MAX_STRING];
+   long		luv;
+
+   first_extension = 1;				/* we need to create PHDU */
+
+   if (NGP_OK != (r = ngp_delete_extver_tab())) return(r);
+
+   fits_get_hdu_num(ff, &my_hn);		/* our HDU position */
+   if (my_hn <= 1)				/* check whether we really need to create PHDU */
+     { fits_movabs_hdu(ff, 1, &tmp0, &r);
+       fits_get_hdrspace(ff, &keys_exist, &more_keys, &r);
+       fits_movabs_hdu(ff, my_hn, &tmp0, &r);
+       if (NGP_OK != r) return(r);		/* error here means file is corrupted */
+       if (keys_exist > 0) first_extension = 0;	/* if keywords exist assume PHDU already exist */
+     }
+   else
+     { first_extension = 0;			/* PHDU (followed by 1+ extensions) exist */
+
+       for (i = 2; i<= my_hn; i++)
+        { r = NGP_OK;
+          fits_movabs_hdu(ff, 1, &tmp0, &r);
+          if (NGP_OK != r) break;
+
+          fits_read_key(ff, TSTRING, "EXTNAME", used_name, NULL, &r);
+          if (NGP_OK != r)  continue;
+
+          fits_read_key(ff, TLONG, "EXTVER", &luv, NULL, &r);
+          used_ver = luv;			/* bugfix - 22-Jan-99, BO - nonalignment of OSF/Alpha */
+          if (VALUE_UNDEFINED == r)
+            { used_ver = 1;
+              r = NGP_OK;
+            }
+
+          if (NGP_OK == r) r = ngp_set_extver(used_name, used_ver);
+        }
+
+       fits_movabs_hdu(ff, my_hn, &tmp0, &r);
+     }
+     
+   for (i = 0; (NGP_OK == r) && (i < tplt->nodecnt); )
+    { switch (tplt->node[i].kind)
+       {
+         case NGP_TOKEN_SIMPLE:
+			if (0 == first_extension)	/* simple only allowed in first HDU */
+			  { r = NGP_TOKEN_NOT_EXPECT;
+			    break;
+			  }
+			r = ngp_write_xtension(ff, &(tplt->node[i]), 0, NGP_XTENSION_SIMPLE | NGP_XTENSION_FIRST);
+			i++;
+			break;
+
+         case NGP_TOKEN_XTENSION:
+			r = ngp_write_xtension(ff, &(tplt->node[i]), 0, (first_extension ? NGP_XTENSION_FIRST : 0));
+			i++;
+			break;
+
+         case NGP_TOKEN_GROUP:
+			r = ngp_write_group(ff, tplt, i, 0);
+			i += tplt->node[i].members + 1;
+			break;
+
+         default:	r = NGP_TOKEN_NOT_EXPECT;
+			break;
+       }
+      first_extension = 0;
+    }
+
 /* all top level HDUs up to faulty one are left intact in case of i/o error. It is up
    to the caller to call fits_close_file or fits_delete_file when this function returns
    error. */
 
-   ngp_free_line();		/* deallocate last line (if any) */
-   ngp_free_prevline();		/* deallocate cached line (if any) */
    ngp_delete_extver_tab();	/* delete extver table (if present), error ignored */
+   return(r);
+ }
+
+		/* top level API functions */
+
+/* read whole template. ff should point to the opened empty fits file. */
+
+int	fits_execute_template(fitsfile *ff, char *ngp_template, int *status)
+ { int		r;
+   fitstemplate	tplt;
+
+   if (NULL == status) return(NGP_NUL_PTR);
+   if (NGP_OK != *status) return(*status);
+
+   /* This function uses many global variables (local to this file) and
+      therefore is not thread-safe. */
+   FFLOCK;
    
-   *status = r;
+   if ((NULL == ff) || (NULL == ngp_template))
+     { *status = NGP_NUL_PTR;
+       FFUNLOCK;
+       return(*status);
+     }
+
+   memset(&tplt, 0, sizeof(tplt));
+
+				/* the template is compiled first, so an HDU or */
+				/* GROUP with syntax error is never created */
+   r = ngp_compile_template(&tplt, ngp_template);
+
+   if (tplt.nodecnt > 0)	/* create blocks compiled before any error */
+     { *status = ngp_write_template(ff, &tplt);
+       if (NGP_OK == *status) *status = r;
+     }
+   else
+     *status = r;
+
+   ngp_node_drop(&tplt, 0);
+   if (NULL != tplt.node) ngp_free(tplt.node);
+
    FFUNLOCK;
-   return(r);
+   return(*status);
+ }
+
+/* compile template once, so that it can be executed many times later */
+
+int	fits_compile_template(char *ngp_template, fitstemplate **tplt, int *status)
+ { fitstemplate	*tp;
+
+   if (NULL == status) return(NGP_NUL_PTR);
+   if (NULL != tplt) *tplt = NULL;
+   if (NGP_OK != *status) return(*status);
+
+   if ((NULL == tplt) || (NULL == ngp_template)) return(*status = NGP_NUL_PTR);
+
+   tp = (fitstemplate *)ngp_alloc(sizeof(fitstemplate));
+   if (NULL == tp) return(*status = NGP_NO_MEMORY);
+   memset(tp, 0, sizeof(fitstemplate));
+
+   FFLOCK;					/* parser uses global variables */
+   *status = ngp_compile_template(tp, ngp_template);
+   FFUNLOCK;
+
+   if (NGP_OK != *status)			/* compiled template must be complete */
+     { fits_free_template(tp, status);
+       return(*status);
+     }
+
+   *tplt = tp;
+   return(*status);
+ }
+
+/* create HDUs of compiled template. ff should point to the opened empty
+   fits file, or to the last HDU of an existing file. */
+
+int	fits_execute_compiled_template(fitsfile *ff, fitstemplate *tplt, int *status)
+ {
+   if (NULL == status) return(NGP_NUL_PTR);
+   if (NGP_OK != *status) return(*status);
+
+   if ((NULL == ff) || (NULL == tplt)) return(*status = NGP_NUL_PTR);
+
+   FFLOCK;					/* extver table is global */
+   *status = ngp_write_template(ff, tplt);
+   FFUNLOCK;
+
+   return(*status);
+ }
+
+/* release compiled template. This is executed even if *status is non-zero. */
+
+int	fits_free_template(fitstemplate *tplt, int *status)
+ {
+   if (NULL == tplt) return(status ? *status : NGP_OK);
+
+   ngp_node_drop(tplt, 0);
+   if (NULL != tplt->node) ngp_free(tplt->node);
+   ngp_free(tplt);
+
+   return(status ? *status : NGP_OK);
  }
@@ -16,6 +16,8 @@
 22-Jan-99: prototype for ngp_set_extver() function added.
 20-Jun-2002 Wm Pence, added support for the HIERARCH keyword convention
             (changed NGP_MAX_NAME from (20) to FLEN_KEYWORD)
+18-Oct-2026: added NGP_NODE and struct fitstemplate_struct, which hold
+            a compiled template.
 */
 
 #ifndef	GRPARSER_H_INCLUDED
@@ -143,6 +145,35 @@ typedef struct NGP_EXTVER_TAB_STRUCT
       } NGP_EXTVER_TAB;
 
 
+typedef struct NGP_NODE_STRUCT			/* HDU or GROUP of compiled template */
+      {	int		kind;		/* NGP_TOKEN_SIMPLE, NGP_TOKEN_XTENSION or NGP_TOKEN_GROUP */
+	int		type;		/* NGP_NODE_xxx, for HDUs only */
+	int		bitpix;
+	int		naxis;
+	long		*naxes;		/* image dimensions, naxis elements */
+	long		nrows;		/* number of rows of table */
+	int		aftercol;	/* template columns are inserted after this one */
+	int		ncols;
+	char		**ttype;	/* ttype/tform point to token values */
+	char		**tform;
+	char		*extname;	/* points to token value too */
+	char		grpname[NGP_MAX_STRING];
+	int		members;	/* number of following nodes belonging to GROUP */
+	NGP_HDU		hdu;		/* keywords as read from template */
+	int		ncards;		/* non system keywords, formatted into */
+	char		*cards;		/* 80 byte header records */
+      } NGP_NODE;
+
+
+struct fitstemplate_struct			/* compiled template, see fits_compile_template */
+      {	int		nodecnt;
+	int		nodealloc;
+	NGP_NODE	*node;		/* nodes in order of creation, GROUP members */
+					/* follow their GROUP node */
+	fitsfile	*scratch;	/* used to format keywords while compiling */
+      };
+
+
 	/* globally visible variables declarations */
 
 extern	NGP_RAW_LINE	ngp_curline;
@@ -167,12 +198,23 @@ int	ngp_include_file(char *fname);
 int	ngp_read_line(int ignore_blank_lines);
 int	ngp_keyword_is_write(NGP_TOKEN *ngp_tok);
 int     ngp_keyword_all_write(NGP_HDU *ngph, fitsfile *ffp, int mode);
+int     ngp_keyword_comments_write(NGP_HDU *ngph, fitsfile *ffp);
 int	ngp_hdu_init(NGP_HDU *ngph);
 int	ngp_hdu_clear(NGP_HDU *ngph);
 int	ngp_hdu_insert_token(NGP_HDU *ngph, NGP_TOKEN *newtok);
-int	ngp_append_columns(fitsfile *ff, NGP_HDU *ngph, int aftercol);
-int	ngp_read_xtension(fitsfile *ff, int parent_hn, int simple_mode);
-int	ngp_read_group(fitsfile *ff, char *grpname, int parent_hn);
+int	ngp_node_add(fitstemplate *tplt, int kind, NGP_NODE **node);
+int	ngp_node_drop(fitstemplate *tplt, int first);
+int	ngp_node_columns(NGP_NODE *node, int aftercol);
+int	ngp_node_columns_write(fitsfile *ff, NGP_NODE *node);
+int	ngp_node_format(fitstemplate *tplt, NGP_NODE *node);
+int	ngp_node_cards_write(fitsfile *ff, NGP_NODE *node);
+int	ngp_node_write(fitsfile *ff, NGP_NODE *node);
+int	ngp_read_xtension(fitstemplate *tplt, int simple_mode);
+int	ngp_read_group(fitstemplate *tplt, char *grpname);
+int	ngp_compile_template(fitstemplate *tplt, char *ngp_template);
+int	ngp_write_xtension(fitsfile *ff, NGP_NODE *node, int parent_hn, int simple_mode);
+int	ngp_write_group(fitsfile *ff, fitstemplate *tplt, int idx, int parent_hn);
+int	ngp_write_template(fitsfile *ff, fitstemplate *tplt);
 
 		/* top level API function - now defined in fitsio.h */
 
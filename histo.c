@@ -27,15 +27,58 @@ typedef struct {  /*  Structure holding all the histogramming information   */
    char *wtexpr;
    double weight;
    char  *rowselector;
-   char *rowselector_cur;
+   char  *rowfilter;   /*  optional row filter expression, evaluated with   */
+   int   norows;       /*  the binning values; norows if it is always FALSE */
    long repeat;
-   int startCols[5];
+   int startCols[6];   /*  axes 1-4, then the weight, then the row filter   */
    int numIterCols;
    iteratorCol *iterCols;
-   ParseData *parsers;
-   parseInfo *infos;
+   ParseData parsers[6];
+   parseInfo infos[6];
+   double nulval;      /*  null value of the parsers' TemporaryCol results  */
+
+   int    findrange[4];          /*  the range pass finds the data limits   */
+   int    isexpr[4];             /*  of these axes                          */
+   double datamin[4], datamax[4];
+   int    buffering;   /*  the range pass also keeps the binning values of  */
+   long   nbufrows;    /*  the selected rows, so that the histogram can be  */
+   long   nbufalloc;   /*  filled without a second pass through the table   */
+   double *buf[5];
 } histType;
 
+/*  Largest amount of memory used to keep the binning values between the   */
+/*  range pass and the filling of the histogram                            */
+#define HISTO_MAX_BUFFER (128L*1024L*1024L)
+
+static int calc_binning(fitsfile *fptr, int naxis, char colname[4][FLEN_VALUE],
+	  char *colexpr[4], double *minin, double *maxin, double *binsizein,
+          char minname[4][FLEN_VALUE], char maxname[4][FLEN_VALUE],
+          char binname[4][FLEN_VALUE], int *colnum, int *datatypes,
+          long *haxes, double *amin, double *amax, double *binsize,
+          long *repeat, histType *pass, int *status);
+static int make_hist(fitsfile *fptr, fitsfile *histptr, int *datatypes,
+          int bitpix, int naxis, long *naxes, int *colnum, char *colexpr[4],
+          double *amin, double *amax, double *binsize, double weight,
+          int wtcolnum, char *wtexpr, int recip, char *selectrow,
+          histType *pass, int *status);
+static int histo_init_inputs(fitsfile *fptr, histType *histData, int naxis,
+          int *colnum, char *colexpr[4], int *useaxis, int *status);
+static int histo_add_cols(histType *histData, iteratorCol *cols, int ncols,
+          int *status);
+static int histo_add_expr(fitsfile *fptr, histType *histData, int ii,
+          char *expr, long nrows, int *datatype, long *nelem, int *status);
+static void histo_free_inputs(histType *histData);
+static int histo_eval_chunk(histType *histData, long totalrows, long offset,
+          long firstrow, long nrows, double **colptr);
+static void histo_bin_chunk(histType *histData, double **colptr, long nrows,
+          char *rowselect);
+static int histo_find_ranges(histType *histData, int *status);
+static int histo_range_workfn(long totalrows, long offset, long firstrow,
+          long nrows, int ncols, iteratorCol *colpars, void *userPointer);
+static void histo_keep_rows(histType *histData, double **colptr, long nrows,
+          char *rowselect);
+static void histo_drop_buffer(histType *histData);
+
 /*--------------------------------------------------------------------------*/
 int ffbinse(char *binspec,   /* I - binning specification */
                    int *imagetype,      /* O - image type, TINT or TSHORT */
@@ -704,20 +747,64 @@ int ffhist2e(fitsfile **fptr,  /* IO - pointer to table with X and Y cols;    */
                              /* row will be skipped.  Ingnored if *selectrow*/
                              /* is equal to NULL.                           */
            int *status)
+{
+    return ffhist2ef(fptr, outfile, imagetype, naxis, colname, colexpr,
+		     minin, maxin, binsizein, minname, maxname, binname,
+		     weightin, wtcol, wtexpr, recip, selectrow, 0, status);
+}
+
+/*--------------------------------------------------------------------------*/
+int ffhist2ef(fitsfile **fptr,  /* IO - pointer to table with X and Y cols;    */
+                             /*     on output, points to histogram image    */
+           char *outfile,    /* I - name for the output histogram file      */
+           int imagetype,    /* I - datatype for image: TINT, TSHORT, etc   */
+           int naxis,        /* I - number of axes in the histogram image   */
+           char colname[4][FLEN_VALUE],   /* I - column names               */
+	   char *colexpr[4], /* I - optionally, expression intead of colum  */
+           double *minin,     /* I - minimum histogram value, for each axis */
+           double *maxin,     /* I - maximum histogram value, for each axis */
+           double *binsizein, /* I - bin size along each axis               */
+           char minname[4][FLEN_VALUE], /* I - optional keywords for min    */
+           char maxname[4][FLEN_VALUE], /* I - optional keywords for max    */
+           char binname[4][FLEN_VALUE], /* I - optional keywords for binsize */
+           double weightin,        /* I - binning weighting factor          */
+           char wtcol[FLEN_VALUE], /* I - optional keyword or col for weight*/
+	   char *wtexpr,           /* I - optionally, weight expression     */
+           int recip,              /* I - use reciprocal of the weight?     */
+           char *selectrow,        /* I - optional array (length = no. of   */
+                             /* rows in the table).  If the element is true */
+                             /* then the corresponding row of the table will*/
+                             /* be included in the histogram, otherwise the */
+                             /* row will be skipped.  Ingnored if *selectrow*/
+                             /* is equal to NULL.                           */
+           char *rowfilter,        /* I - optional row filter expression;   */
+                             /* only rows for which it is TRUE are binned.  */
+                             /* It is evaluated in the same pass through    */
+                             /* the table as the binning values.            */
+           int *status)
+/*
+   Bin the table into a new histogram image.  The binning values, weights
+   and row filter are all evaluated together, one chunk of rows at a time.
+   When axis limits have to be found from the data, one pass finds all of
+   them at once and keeps the selected binning values, so that the image
+   is then filled without reading the table again.
+*/
 {
     fitsfile *histptr;
-    int   bitpix, colnum[4], wtcolnum;
+    int   bitpix, colnum[4], wtcolnum = 0;
     long haxes[4];
     double amin[4], amax[4], binsize[4],  weight;
-    int numIterCols = 0;
     int datatypes[4], wtdatatype = 0;
-    long *repeat, wtrepeat = 0;
-    char errmsg[FLEN_ERRMSG];
+    long wtrepeat = 0;
     long vectorRepeat;
+    histType histData;    /* binning inputs, shared by the range pass */
+                          /* and the filling of the histogram image   */
 
     if (*status > 0)
         return(*status);
 
+    memset(&histData, 0, sizeof(histData));
+
     if (naxis > 4)
     {
         ffpmsg("histogram has more than 4 dimensions");
@@ -744,19 +831,6 @@ int ffhist2e(fitsfile **fptr,  /* IO - pointer to table with X and Y cols;    */
       	goto cleanup;
     }
     
-    /*    Calculate the binning parameters:    */
-    /*   columm numbers, axes length, min values,  max values, and binsizes.  */
-
-    if (fits_calc_binningde(
-      *fptr, naxis, colname, colexpr, 
-      minin, maxin, binsizein, minname, maxname, binname,
-      colnum, datatypes, haxes, amin, amax, binsize, 
-      &vectorRepeat, status) > 0)
-    {
-        ffpmsg("failed to determine binning parameters");
-      	goto cleanup;
-    }
- 
     /* get the histogramming weighting factor, if any */
     if (*wtcol)
     {
@@ -792,8 +866,7 @@ int ffhist2e(fitsfile **fptr,  /* IO - pointer to table with X and Y cols;    */
     {     
       /* Initialize the parser so that we can determine the datatype
 	 of the returned type as well as the vector dimensions.  The
-	 parsers is kept allocated so we can assemble an iterator that
-	 uses it below.
+	 parser for the binning pass is set up by calc_binning below.
       */
       int naxis1;
       long int nelem, naxes[MAXDIMS];
@@ -806,13 +879,12 @@ int ffhist2e(fitsfile **fptr,  /* IO - pointer to table with X and Y cols;    */
 
       weight = DOUBLENULLVALUE;
       wtrepeat = nelem;
-      wtdatatype = wtdatatype;
-
     }
     else
     {
+        /* a constant weight agrees with any vector dimension */
         weight = (double) weightin;
-	wtrepeat = vectorRepeat;
+	wtrepeat = 0;
 	wtdatatype = TDOUBLE;
     }
 
@@ -824,13 +896,6 @@ int ffhist2e(fitsfile **fptr,  /* IO - pointer to table with X and Y cols;    */
       goto cleanup;
     }
 
-    /* And dimensions of weighting must agree with input column data */
-    if (wtrepeat != vectorRepeat) {
-      ffpmsg("Vector dimensions of weighting do not agree with binning columns");
-      *status = BAD_DIMEN;
-      goto cleanup;
-    }      
-
     if (weight <= 0. && weight != DOUBLENULLVALUE)
     {
         ffpmsg("Illegal histogramming weighting factor <= 0.");
@@ -843,6 +908,36 @@ int ffhist2e(fitsfile **fptr,  /* IO - pointer to table with X and Y cols;    */
        weight = (double) (1.0 / weight);
     }
 
+    /* Resolve the conflict between wtexpr, wtcolnum, and weight */
+    if ( ((wtcolnum > 0) || (wtexpr && wtexpr[0])) && weight == 0 ) weight = DOUBLENULLVALUE;
+    histData.weight      = weight;
+    histData.wtcolnum    = wtcolnum;
+    histData.wtexpr      = wtexpr;
+    histData.wtrecip     = recip;
+    histData.tblptr      = *fptr;
+    histData.haxis       = naxis;
+    histData.rowselector = selectrow;
+    histData.rowfilter   = rowfilter;
+
+    /*    Calculate the binning parameters:    */
+    /*   columm numbers, axes length, min values,  max values, and binsizes.  */
+
+    if (calc_binning(
+      *fptr, naxis, colname, colexpr, 
+      minin, maxin, binsizein, minname, maxname, binname,
+      colnum, datatypes, haxes, amin, amax, binsize, 
+      &vectorRepeat, &histData, status) > 0)
+    {
+        ffpmsg("failed to determine binning parameters");
+      	goto cleanup;
+    }
+ 
+    /* And dimensions of weighting must agree with input column data */
+    if (wtrepeat != 0 && wtrepeat != vectorRepeat) {
+      ffpmsg("Vector dimensions of weighting do not agree with binning columns");
+      *status = BAD_DIMEN;
+      goto cleanup;
+    }      
 
     /* size of histogram is now known, so create temp output file */
     if (fits_create_file(&histptr, outfile, status) > 0)
@@ -872,10 +967,10 @@ int ffhist2e(fitsfile **fptr,  /* IO - pointer to table with X and Y cols;    */
     fits_rebin_wcsd(histptr, naxis, amin, binsize,  status);      
     
     /* now compute the output image by binning the column values */
-    if (fits_make_histde(*fptr, histptr, datatypes, bitpix, naxis, haxes, 
+    if (make_hist(*fptr, histptr, datatypes, bitpix, naxis, haxes, 
 			 colnum, colexpr, amin, amax, binsize,
 			 weight, wtcolnum, wtexpr, recip, 
-			 selectrow, status) > 0)
+			 selectrow, &histData, status) > 0)
     {
         ffpmsg("failed to calculate new histogram values");
 	goto cleanup;
@@ -886,6 +981,7 @@ int ffhist2e(fitsfile **fptr,  /* IO - pointer to table with X and Y cols;    */
     *fptr = histptr;
 
  cleanup:
+    histo_free_inputs(&histData);
     return(*status);
 }
 
@@ -1110,6 +1206,8 @@ int ffhist(fitsfile **fptr,  /* IO - pointer to table with X and Y cols;    */
     if (*status > 0)
         return(*status);
 
+    memset(&histData, 0, sizeof(histData));
+
     if (naxis > 4)
     {
         ffpmsg("histogram has more than 4 dimensions");
@@ -1791,6 +1889,44 @@ int fits_calc_binningde(
 
     Note: caller is responsible to free parsers[*] upon return using ffcprs()
 */
+{
+    return calc_binning(fptr, naxis, colname, colexpr, minin, maxin, binsizein,
+			minname, maxname, binname, colnum, datatypes, haxes,
+			amin, amax, binsize, repeat, 0, status);
+}
+
+/*--------------------------------------------------------------------------*/
+static int calc_binning(
+      fitsfile *fptr,  /* IO - pointer to table to be binned      ;       */
+      int naxis,       /* I - number of axes/columns in the binned image  */
+      char colname[4][FLEN_VALUE],   /* I - optional column names         */
+      char *colexpr[4],  /* I - optional column expression instead of name*/
+      double *minin,     /* I - optional lower bound value for each axis  */
+      double *maxin,     /* I - optional upper bound value, for each axis */
+      double *binsizein, /* I - optional bin size along each axis         */
+      char minname[4][FLEN_VALUE], /* I - optional keywords for min       */
+      char maxname[4][FLEN_VALUE], /* I - optional keywords for max       */
+      char binname[4][FLEN_VALUE], /* I - optional keywords for binsize   */
+      int *colnum,     /* O - column numbers, to be binned */
+      int *datatypes,  /* O - datatypes of each output column */
+      long *haxes,     /* O - number of bins in each histogram axis */
+      double *amin,     /* O - lower bound of the histogram axes */
+      double *amax,     /* O - upper bound of the histogram axes */
+      double *binsize,  /* O - width of histogram bins/pixels on each axis */
+      long *repeat,     /* O - vector repeat of input columns */
+      histType *pass,   /* IO - optional; weight and row filter already set */
+      int *status)
+/*
+   The body of fits_calc_binningde.  The limits which must come from the
+   data are found for all of the axes in a single pass through the table.
+
+   If pass is not NULL, the parsers and iterator columns for all of the
+   binning inputs (axes, weight and row filter) are set up in it, ready for
+   make_hist.  Then, if a range pass is needed at all, it also keeps the
+   binning values of the selected rows, so that make_hist can fill the
+   histogram from them without a second pass through the table.  The
+   caller frees pass with histo_free_inputs().
+*/
 {
     tcolumn *colptr;
     char *cptr, cpref[4][FLEN_VALUE];
@@ -1800,6 +1936,10 @@ int fits_calc_binningde(
     long repeat1;
     double datamin, datamax;
     int ncols;
+    int isexpr[4], findmin[4], findmax[4], findrange[4], anyrange = 0;
+    int axistype[4];
+    long axisrepeat[4];
+    histType localData, *rangeData = 0;
 
     /* check inputs */
     
@@ -1883,7 +2023,8 @@ int fits_calc_binningde(
     }
 
     /* ============================================================= */
-    /* Main Loop for calculating parameters for each column          */
+    /* Determine the column or expression, datatype and repeat of    */
+    /* each axis                                                     */
 
     for (ii = 0; ii < naxis; ii++)
     {
@@ -1984,13 +2125,18 @@ int fits_calc_binningde(
       }
 
       if (datatypes) datatypes[ii] = datatype;
+      axistype[ii] = datatype;
+      axisrepeat[ii] = repeat1;
+    }
 
-      /* ================================================================ */
-      /* get the minimum value */
+    /* ============================================================= */
+    /* Decide which limits must be found from the data values.       */
+    /* Read the keywords that give limits, or that may give them.    */
+
+    for (ii = 0; ii < naxis; ii++)
+    {
+      isexpr[ii] = (colexpr && colexpr[ii] && colexpr[ii][0]);
 
-      datamin = DOUBLENULLVALUE;
-      datamax = DOUBLENULLVALUE;
-      
       if (*minname[ii])
       {
          if (ffgky(fptr, TDOUBLE, minname[ii], &minin[ii], NULL, status) )
@@ -2001,64 +2147,154 @@ int fits_calc_binningde(
          }
       }
 
+      if (*maxname[ii])
+      {
+         if (ffgky(fptr, TDOUBLE, maxname[ii], &maxin[ii], NULL, status) )
+         {
+             ffpmsg("error reading histogramming maximum keyword");
+             ffpmsg(maxname[ii]);
+             return(*status);
+         }
+      }
+
+      findmin[ii] = findmax[ii] = 0;
+      if (minin[ii] == DOUBLENULLVALUE)
+      {
+        if (isexpr[ii])
+          findmin[ii] = 1;
+        else
+        {
+          tstatus = 0;
+          ffkeyn("TLMIN", colnum[ii], keyname, &tstatus);
+          if (ffgky(fptr, TDOUBLE, keyname, amin+ii, NULL, &tstatus) > 0)
+            findmin[ii] = 1;
+        }
+      }
+
+      if (maxin[ii] == DOUBLENULLVALUE)
+      {
+        if (isexpr[ii])
+          findmax[ii] = 1;
+        else
+        {
+          tstatus = 0;
+          ffkeyn("TLMAX", colnum[ii], keyname, &tstatus);
+          if (ffgky(fptr, TDOUBLE, keyname, amax+ii, NULL, &tstatus) > 0)
+            findmax[ii] = 1;
+        }
+      }
+
+      /* vector columns are still scanned by fits_get_col_minmax, below */
+      findrange[ii] = (findmin[ii] || findmax[ii]) &&
+                      (isexpr[ii] || axisrepeat[ii] == 1);
+      if (findrange[ii]) anyrange = 1;
+    }
+
+    /* ============================================================= */
+    /* One pass through the table for the data limits of every axis  */
+
+    if (pass)
+    {
+      /* set up all the binning inputs, for this pass and for make_hist */
+      if (histo_init_inputs(fptr, pass, naxis, colnum, colexpr, 0, status))
+        return(*status);
+      rangeData = pass;
+      pass->buffering = anyrange;
+    }
+    else if (anyrange)
+    {
+      /* set up only the axes whose limits are needed */
+      rangeData = &localData;
+      memset(rangeData, 0, sizeof(histType));
+      rangeData->weight = 1.;
+      rangeData->haxis = naxis;
+      if (histo_init_inputs(fptr, rangeData, naxis, colnum, colexpr,
+                            findrange, status))
+      {
+        histo_free_inputs(rangeData);
+        return(*status);
+      }
+    }
+
+    if (anyrange)
+    {
+      for (ii = 0; ii < 4; ii++)
+      {
+        rangeData->findrange[ii] = (ii < naxis && findrange[ii]);
+        rangeData->isexpr[ii] = (ii < naxis && isexpr[ii]);
+      }
+
+      histo_find_ranges(rangeData, status);
+      if (!pass) histo_free_inputs(rangeData);
+
+      if (*status > 0)
+      {
+        ffpmsg("Error calculating datamin and datamax for histogram axes");
+        return(*status);
+      }
+    }
+
+    /* ============================================================= */
+    /* Finally, the limits, bin sizes and image size of each axis    */
+
+    for (ii = 0; ii < naxis; ii++)
+    {
+      datatype = axistype[ii];
+
+      /* ================================================================ */
+      /* get the minimum value */
+
+      datamin = DOUBLENULLVALUE;
+      datamax = DOUBLENULLVALUE;
+
       if (minin[ii] != DOUBLENULLVALUE)
       {
         amin[ii] = (double) minin[ii];
       }
-      else if (colexpr == 0 || colexpr[ii] == 0 || colexpr[ii][0] == '\0')
+      else if (!isexpr[ii])
       {
-        ffkeyn("TLMIN", colnum[ii], keyname, status);
-        if (ffgky(fptr, TDOUBLE, keyname, amin+ii, NULL, status) > 0)
+        if (findmin[ii])
         {
-            /* use actual data minimum value for the histogram minimum */
-            *status = 0;
-            if (fits_get_col_minmax(fptr, colnum[ii], amin+ii, &datamax, status) > 0)
+            /* no TLMIN keyword; use actual data minimum value */
+            if (findrange[ii])
+            {
+                amin[ii] = rangeData->datamin[ii];
+                datamax = rangeData->datamax[ii];
+            }
+            else if (fits_get_col_minmax(fptr, colnum[ii], amin+ii, &datamax, status) > 0)
             {
                 strcpy(errmsg, "Error calculating datamin and datamax for column: ");
                 strncat(errmsg, colname[ii],FLEN_ERRMSG-strlen(errmsg)-1);
                 ffpmsg(errmsg);
                 return(*status);
             }
-         }
+        }
       } else { /* it's an expression */
-	if (fits_get_expr_minmax(fptr, colexpr[ii], amin+ii, &datamax, 0, status) > 0)
-            {
-                strcpy(errmsg, "Error calculating datamin and datamax for expression: ");
-                ffpmsg(errmsg);
-		ffpmsg(colexpr[ii]);
-                return(*status);
-            }
+        amin[ii] = rangeData->datamin[ii];
+        datamax = rangeData->datamax[ii];
 	if (amin[ii] == DOUBLENULLVALUE) amin[ii] = 0.0;
-	
       }
 
       /* ================================================================ */
       /* get the maximum value */
 
-      if (*maxname[ii])
-      {
-         if (ffgky(fptr, TDOUBLE, maxname[ii], &maxin[ii], NULL, status) )
-         {
-             ffpmsg("error reading histogramming maximum keyword");
-             ffpmsg(maxname[ii]);
-             return(*status);
-         }
-      }
-
       if (maxin[ii] != DOUBLENULLVALUE)
       {
         amax[ii] = (double) maxin[ii];
       }
-      else if (colexpr == 0 || colexpr[ii] == 0 || colexpr[ii][0] == '\0')
+      else if (!isexpr[ii])
       {
-        ffkeyn("TLMAX", colnum[ii], keyname, status);
-        if (ffgky(fptr, TDOUBLE, keyname, &amax[ii], NULL, status) > 0)
+        if (findmax[ii])
         {
-          *status = 0;
+          /* no TLMAX keyword */
           if(datamax != DOUBLENULLVALUE)  /* already computed max value */
           {
              amax[ii] = datamax;
           }
+          else if (findrange[ii])
+          {
+             amax[ii] = rangeData->datamax[ii];
+          }
           else
           {
              /* use actual data maximum value for the histogram maximum */
@@ -2076,18 +2312,13 @@ int fits_calc_binningde(
 
       } else { /* it's an expression */
 
-	if (fits_get_expr_minmax(fptr, colexpr[ii], &datamin, &amax[ii], 0, status) > 0)
-	{
-	  strcpy(errmsg, "Error calculating datamin and datamax for expression: ");
-	  ffpmsg(errmsg);
-	  ffpmsg(colexpr[ii]);
-	  return(*status);
-	}
+        amax[ii] = rangeData->datamax[ii];
 	if (amax[ii] == DOUBLENULLVALUE) amin[ii] = 1.0;
         use_datamax = 1;  
       }
 
 
+
       /* ================================================================ */
       /* determine binning size and range                                 */
 
@@ -2200,6 +2431,7 @@ int fits_calc_binningde(
     return(*status);
 }
 
+
 /* Double precision version, with non-extended syntax */
 int fits_calc_binningd(
       fitsfile *fptr,  /* IO - pointer to table to be binned      ;       */
@@ -2531,6 +2763,37 @@ int fits_make_histde(fitsfile *fptr, /* IO - pointer to table with X and Y cols;
                              /* row will be skipped.  Ingnored if *selectrow*/
                              /* is equal to NULL.                           */
     int *status)
+{
+    return make_hist(fptr, histptr, datatypes, bitpix, naxis, naxes,
+		     colnum, colexpr, amin, amax, binsize,
+		     weight, wtcolnum, wtexpr, recip, selectrow, 0, status);
+}
+
+/*--------------------------------------------------------------------------*/
+static int make_hist(fitsfile *fptr, /* IO - pointer to table with X and Y cols; */
+    fitsfile *histptr, /* I - pointer to output FITS image      */
+    int *datatypes,   /*  I - datatype of input (or 0 for auto) */
+    int bitpix,       /* I - datatype for image: 16, 32, -32, etc    */
+    int naxis,        /* I - number of axes in the histogram image   */
+    long *naxes,      /* I - size of axes in the histogram image   */
+    int *colnum,      /* I - column numbers (array length = naxis)   */
+    char *colexpr[4], /* I - optional expression instead of column */
+    double *amin,     /* I - minimum histogram value, for each axis */
+    double *amax,     /* I - maximum histogram value, for each axis */
+    double *binsize,  /* I - bin size along each axis               */
+    double weight,    /* I - binning weighting factor (0 or DOUBLENULLVALUE means null) */
+    int wtcolnum,     /* I - optional keyword or col for weight*/
+    char *wtexpr,     /* I - optional weighting expression */
+    int recip,        /* I - use reciprocal of the weight?     */
+    char *selectrow,  /* I - optional array of row selection flags */
+    histType *pass,   /* IO - binning inputs already set up by calc_binning, */
+                      /*      or NULL to set them up here                   */
+    int *status)
+/*
+   The body of fits_make_histde.  When called by ffhist2ef, the parsers and
+   iterator columns which supply the binning values were set up by
+   calc_binning, and the range pass may already hold the values to bin.
+*/
 {		  
     int ii, imagetype;
     int n_cols = 1;
@@ -2538,27 +2801,15 @@ int fits_make_histde(fitsfile *fptr, /* IO - pointer to table with X and Y cols;
     long  offset = 0;
     long n_per_loop = -1;  /* force whole array to be passed at one time */
     double taxes[4], tmin[4], tmax[4], tbin[4], maxbin[4];
-    histType histData;    /* Structure holding histogram info for iterator */
+    histType localData;   /* Structure holding histogram info for iterator */
+    histType *histData = pass;
     iteratorCol imagepars[1];
-    long nrows = -1;
-    ParseData parsers[5];
-    parseInfo infos[5];
-    int numAllocCols = 0, startCol = -1, numIterCols = 0;
-    iteratorCol *iterCols = 0;
-    double double_nulval = DOUBLENULLVALUE;
-    long repeat = 0, wtrepeat = 0;
 
     /* check inputs */
     
     if (*status > 0)
         return(*status);
 
-    /* Make sure the parser information is initialized because we will
-       use this to determine what needs to be deallocated at the end */
-    memset(infos, 0, sizeof(infos));
-    memset(parsers, 0, sizeof(parsers));
-    memset(&histData, 0, sizeof(histData));
-
     if (naxis > 4)
     {
         ffpmsg("histogram has more than 4 dimensions");
@@ -2582,37 +2833,32 @@ int fits_make_histde(fitsfile *fptr, /* IO - pointer to table with X and Y cols;
     if ((fptr)->HDUposition != ((fptr)->Fptr)->curhdu)
         ffmahd(fptr, ((fptr)->HDUposition) + 1, NULL, status);
 
-    /* Resolve the conflict between wtexpr, wtcolnum, and weight */
-    if ( ((wtcolnum > 0) || (wtexpr && wtexpr[0])) && weight == 0 ) weight = DOUBLENULLVALUE;
-    histData.weight     = weight;
-    histData.wtcolnum   = wtcolnum;
-    histData.wtexpr     = wtexpr;
-    histData.wtrecip    = recip;
-    histData.tblptr     = fptr;
-    histData.himagetype = imagetype;
-    histData.haxis      = naxis;
-    histData.rowselector = selectrow;
-
-    /* Now make iterator columns for input, as well as any calculated values */
-    numAllocCols = 5;
-    iterCols = fits_recalloc(0, 0, numAllocCols, sizeof(iteratorCol));
-    if (!iterCols) {
-      ffpmsg("memory allocation failure (fits_make_histde)");
-      *status = MEMORY_ALLOCATION;
-      goto cleanup;
+    if (!histData)
+    {
+      histData = &localData;
+      memset(histData, 0, sizeof(histType));
+
+      /* Resolve the conflict between wtexpr, wtcolnum, and weight */
+      if ( ((wtcolnum > 0) || (wtexpr && wtexpr[0])) && weight == 0 ) weight = DOUBLENULLVALUE;
+      histData->weight     = weight;
+      histData->wtcolnum   = wtcolnum;
+      histData->wtexpr     = wtexpr;
+      histData->wtrecip    = recip;
+      histData->tblptr     = fptr;
+      histData->haxis      = naxis;
+      histData->rowselector = selectrow;
+
+      /* Now make iterator columns for input, as well as any calculated values */
+      if (histo_init_inputs(fptr, histData, naxis, colnum, colexpr, 0, status))
+	goto cleanup;
     }
-
-    /* We fill the iterCols in order, starting from column 1 through 4, and 
-       then moving on to the weighting column */
-    for (ii = 0; ii < 5; ii++)  histData.startCols[ii] = -1;
-    startCol = 0;
+    histData->himagetype = imagetype;
 
     /* Loop through each axis and recheck the binning parameters */
     for (ii = 0; ii < naxis; ii++)
     {
       long colrepeat = 0;
       int datatype;
-      histData.startCols[ii] = startCol;
 
       taxes[ii] = (double) naxes[ii];
       tmin[ii] = amin[ii];
@@ -2660,156 +2906,45 @@ int fits_make_histde(fitsfile *fptr, /* IO - pointer to table with X and Y cols;
       } else {  /* not an integer column with integer limits */
           maxbin[ii] = (tmax[ii] - tmin[ii]) / tbin[ii]; 
       }
-
-      /* This is a column expression.  Here is where we allocate the 
-	 parser for it during the actual evaluation. */
-      if (colexpr && colexpr[ii] && colexpr[ii][0]) {
-	int datatype, naxis1;
-	long nelem, naxes[MAXDIMS];
-	int jj;
-
-	/* Initialize the parser for this binning expression */
-	ffiprs( fptr, 0, colexpr[ii], MAXDIMS, &datatype, &nelem, &naxis1,
-		naxes, &(parsers[ii]), status );
-	if (*status) goto cleanup;
-	if (nelem < 0) nelem = 1; /* If it's a constant expression */
-
-	colrepeat = nelem;
-
-	/* Set up the parser data for evaluation to a TemporaryCol */
-	fits_get_num_rows(fptr, &nrows, status);
-	if (fits_parser_set_temporary_col(&(parsers[ii]), &(infos[ii]), nrows,
-					  (void *) &(double_nulval), status)) goto cleanup;
-
-	/* Copy iterator columns from the parser to the master iterator columns */
-	iterCols = fits_recalloc(iterCols, numAllocCols, numAllocCols+parsers[ii].nCols,
-			    sizeof(iteratorCol));
-	if (!iterCols) {
-	  *status = MEMORY_ALLOCATION;
-	  goto cleanup;
-	}
-	numAllocCols += parsers[ii].nCols;
-	for (jj = 0; jj < parsers[ii].nCols; jj++) iterCols[startCol++] = parsers[ii].colData[jj];
-
-      } else {
-
-	/* Just a "regular" column name, we already have enough allocated for these */
-	fits_iter_set_by_num(&(iterCols[startCol]), fptr, colnum[ii], TDOUBLE, InputCol);
-	startCol ++;
-      }
-
-      /* Check that all the vector dimensions agree */
-      if (repeat == 0) {
-	repeat = colrepeat;
-      } else {
-	if (repeat != colrepeat) {
-	  ffpmsg("vector dimensions of binning values do not agree");
-	  *status = BAD_DIMEN;
-	  goto cleanup;
-	}
-      }
-
     } /* End of loop over columns */
 
-    /* Now initialize the iterator column data for the weighting */
-    if (wtexpr && wtexpr[0] && weight == DOUBLENULLVALUE) {
-      int wtdatatype, wtnaxis;
-      long wtnaxes[MAXDIMS];
-      int jj;
-
-      histData.startCols[4] = startCol;
-      ffiprs( fptr, 0, wtexpr, MAXDIMS, &wtdatatype, &wtrepeat, &wtnaxis,
-	      wtnaxes, &(parsers[4]), status );
-      if (*status) goto cleanup;
-      if (wtrepeat < 0) wtrepeat = 1; /* If it's a constant expression */
-
-      /* Set up the parser data for evaluation to a TemporaryCol */
-      /* It's a weighting expression, set that up and ... */
-      fits_get_num_rows(fptr, &nrows, status);
-      if (fits_parser_set_temporary_col(&(parsers[4]), &(infos[4]), nrows,
-					(void *) &(double_nulval), status)) goto cleanup;
-
-      /* Copy iterator columns from the parser to the master iterator columns */
-      iterCols = fits_recalloc(iterCols, numAllocCols, numAllocCols+parsers[4].nCols,
-			  sizeof(iteratorCol));
-      if (!iterCols) {
-	*status = MEMORY_ALLOCATION;
-	goto cleanup;
-      }
-      numAllocCols += parsers[ii].nCols;
-      for (jj = 0; jj < parsers[4].nCols; jj++) iterCols[startCol++] = parsers[4].colData[jj];
-
-    } else if (weight == DOUBLENULLVALUE) {
-      int wtdatatype;
-
-      /* It's a "regular" weighting column */
-      fits_get_eqcoltype(fptr, wtcolnum, &wtdatatype, &wtrepeat, NULL, status);
-
-      histData.startCols[4] = startCol;
-      fits_iter_set_by_num(&(iterCols[startCol]), fptr, wtcolnum, TDOUBLE, InputCol);
-      startCol ++;
-    } else {
-
-      /* In case of explicit numerical value, we can just use that number
-	 in the vector expression, so the vector repeat of the weighting can
-	 be set to that of the input */
-      wtrepeat = repeat;
-    }
-
-    /* Vector dimension of weighting must agree with binning */
-    if (wtrepeat != 0 && repeat != 0 && wtrepeat != repeat) {
-      ffpmsg("vector dimensions of weights do not agree with bins");
-      *status = BAD_DIMEN;
-      goto cleanup;
-    }
-
-    /* We now know he number of iterator columns */
-    numIterCols = startCol;
-
-    /* Fill in iterator information for the parser*/
-    histData.numIterCols = numIterCols;
-    histData.iterCols = iterCols;
-    histData.parsers = parsers;
-    histData.infos = infos;
-    histData.repeat = repeat;
-
     /* Set global variables with histogram parameter values.    */
     /* Use separate scalar variables rather than arrays because */
     /* it is more efficient when computing the histogram.       */
 
-    histData.hcolnum[0]  = colnum[0];
-    histData.amin1 = tmin[0];
-    histData.maxbin1 = maxbin[0];
-    histData.binsize1 = tbin[0];
-    histData.haxis1 = (long) taxes[0];
-    histData.incr[0] = 1;
+    histData->hcolnum[0]  = colnum[0];
+    histData->amin1 = tmin[0];
+    histData->maxbin1 = maxbin[0];
+    histData->binsize1 = tbin[0];
+    histData->haxis1 = (long) taxes[0];
+    histData->incr[0] = 1;
 
-    if (histData.haxis > 1)
+    if (histData->haxis > 1)
     {
-      histData.hcolnum[1]  = colnum[1];
-      histData.amin2 = tmin[1];
-      histData.maxbin2 = maxbin[1];
-      histData.binsize2 = tbin[1];
-      histData.haxis2 = (long) taxes[1];
-      histData.incr[1] = histData.incr[0] * histData.haxis1;
-
-      if (histData.haxis > 2)
+      histData->hcolnum[1]  = colnum[1];
+      histData->amin2 = tmin[1];
+      histData->maxbin2 = maxbin[1];
+      histData->binsize2 = tbin[1];
+      histData->haxis2 = (long) taxes[1];
+      histData->incr[1] = histData->incr[0] * histData->haxis1;
+
+      if (histData->haxis > 2)
       {
-        histData.hcolnum[2]  = colnum[2];
-        histData.amin3 = tmin[2];
-        histData.maxbin3 = maxbin[2];
-        histData.binsize3 = tbin[2];
-        histData.haxis3 = (long) taxes[2];
-	histData.incr[2] = histData.incr[1] * histData.haxis2;
-
-        if (histData.haxis > 3)
+        histData->hcolnum[2]  = colnum[2];
+        histData->amin3 = tmin[2];
+        histData->maxbin3 = maxbin[2];
+        histData->binsize3 = tbin[2];
+        histData->haxis3 = (long) taxes[2];
+	histData->incr[2] = histData->incr[1] * histData->haxis2;
+
+        if (histData->haxis > 3)
         {
-          histData.hcolnum[3]  = colnum[3];
-          histData.amin4 = tmin[3];
-          histData.maxbin4 = maxbin[3];
-          histData.binsize4 = tbin[3];
-          histData.haxis4 = (long) taxes[3];
-	  histData.incr[3] = histData.incr[2] * histData.haxis3;
+          histData->hcolnum[3]  = colnum[3];
+          histData->amin4 = tmin[3];
+          histData->maxbin4 = maxbin[3];
+          histData->binsize4 = tbin[3];
+          histData->haxis4 = (long) taxes[3];
+	  histData->incr[3] = histData->incr[2] * histData->haxis3;
         }
       }
     }
@@ -2821,15 +2956,11 @@ int fits_make_histde(fitsfile *fptr, /* IO - pointer to table with X and Y cols;
 
     /* call the iterator function to write out the histogram image */
     fits_iterate_data(n_cols, imagepars, offset, n_per_loop,
-                          ffwritehisto, (void*)&histData, status);
+                          ffwritehisto, (void*)histData, status);
        
  cleanup:
-    /* Free any allocated memory ... */
-    if (iterCols) free(iterCols);
-    /* ... and parsers */
-    for (ii = 0; ii <= 4; ii ++) {
-      if (parsers[ii].nCols > 0) ffcprs(&(parsers[ii]));
-    }
+    /* Free any allocated memory and parsers we set up */
+    if (histData == &localData) histo_free_inputs(histData);
     return(*status);
 }
 
@@ -3056,6 +3187,17 @@ int ffwritehisto(long totaln, long pixoffset, long firstn, long nvalues,
        break;
     }
 
+    if (histData->buffering) {
+       /* The range pass already kept the binning values of the selected */
+       /* rows, so bin those instead of reading the table again          */
+       double *colptr[6];
+
+       for (ii = 0; ii < 5; ii++) colptr[ii] = histData->buf[ii];
+       colptr[5] = 0;
+       histo_bin_chunk(histData, colptr, histData->nbufrows, 0);
+       return(status);
+    }
+
     /* call iterator function to calc the histogram pixel values */
 
     /* must lock this call in multithreaded environoments because */
@@ -3074,53 +3216,81 @@ int ffcalchist(long totalrows, long offset, long firstrow, long nrows,
    Interator work function that calculates values for the 2D histogram.
 */
 {
-    long ii, ipix, iaxisbin;
-    double pix, axisbin;
-    char *rowselect;
     histType *histData = (histType*)userPointer;
-    double *colptr[MAXDIMS] = {0};
-    int status = 0;
-    long irow;
+    double *colptr[6];
+    int status;
 
-    if (firstrow == 1) {
-      histData->rowselector_cur = histData->rowselector;
-    }
-    rowselect = histData->rowselector_cur;
+    status = histo_eval_chunk(histData, totalrows, offset, firstrow, nrows,
+			      colptr);
+    if (status) return status;
 
-    for (ii=0; ii<=4; ii++) {
+    histo_bin_chunk(histData, colptr, nrows, (histData->rowselector ?
+		    histData->rowselector + (firstrow - 1) : 0));
+
+    return(status);
+}
+/*--------------------------------------------------------------------------*/
+static int histo_eval_chunk(histType *histData, /* I - histogram inputs    */
+                long totalrows,   /* I - Total rows to be processed         */
+                long offset,      /* I - Number of rows skipped at start    */
+                long firstrow,    /* I - First row of this iteration        */
+                long nrows,       /* I - Number of rows in this iteration   */
+                double **colptr)  /* O - values of axes, weight and filter  */
+/*
+   Evaluate the binning expressions, weight expression and row filter of
+   histData for one chunk of rows, and return pointers to the iterator
+   arrays which hold each of the binning inputs (NULL for unused inputs).
+*/
+{
+    int ii, status = 0;
+
+    for (ii = 0; ii < 6; ii++) {
       int startCol = histData->startCols[ii];
       iteratorCol *outcol = 0;
-      /* Call calculator work function.  Result is put in final column of colData as a TemporaryCol */
       colptr[ii] = 0;
 
-      /* Do not process unspecified axes (but do process weight column) */
-      if ( (ii >= histData->haxis && ii != 4) || histData->startCols[ii] < 0) continue;
+      /* Do not process unspecified axes (but do process the weight and filter) */
+      if ( (ii < 4 && ii >= histData->haxis) || startCol < 0) continue;
 
       /* We have a parser for this, evaluate it */
       if (histData->parsers[ii].nCols > 0) {
-	struct ParseStatusVariables *pv = &(histData->infos[ii].parseVariables);
 	iteratorCol *colData = &(histData->iterCols[startCol]);
 	int nCols = histData->parsers[ii].nCols;
 
+	/* Result is put in final column of colData as a TemporaryCol */
 	status = fits_parser_workfn(totalrows, offset, firstrow, nrows, 
 				    nCols, colData, (void *) &(histData->infos[ii]));
 	if (status) return status;
-	/* Output column is last iterator column, which better be a TemporaryCol */
 	outcol = &(colData[nCols-1]);
 
       } else {
 	outcol = &(histData->iterCols[startCol]);
       }
 
-      if (outcol) {
-	/* Note that the 0th array element returned by the iterator is
-	   actually the null value!  This is actually rather a big
-	   undocumented "feature" of the iterator. However, "ii" below
-	   starts at a value of 1 which skips over the null value */
-	colptr[ii] = ((double *) fits_iter_get_array(outcol));
-      }
+      /* Note that the 0th array element returned by the iterator is
+	 actually the null value!  This is actually rather a big
+	 undocumented "feature" of the iterator. However, the binning
+	 loops start at element 1, which skips over the null value */
+      colptr[ii] = ((double *) fits_iter_get_array(outcol));
     }
 
+    return status;
+}
+/*--------------------------------------------------------------------------*/
+static void histo_bin_chunk(histType *histData, /* IO - histogram            */
+                double **colptr,  /* I - values of axes, weight and filter  */
+                long nrows,       /* I - number of rows in the arrays       */
+                char *rowselect)  /* I - optional row selection flags       */
+/*
+   Add one chunk of rows to the histogram.
+*/
+{
+    long ii, ipix, iaxisbin, irow;
+    double pix, axisbin;
+    double *rowfilt = colptr[5];
+
+    if (histData->norows) return;  /* the row filter is always FALSE */
+
     /*  Main loop over rows */
     /* irow = row counter (1 .. nrows) */
     /* elem = counter of element (1 .. histData->repeat) for each row */
@@ -3144,6 +3314,12 @@ int ffcalchist(long totalrows, long offset, long firstrow, long nrows,
            }
         }
 
+        /* rows for which the row filter is FALSE or undefined are excluded */
+        if (rowfilt && (rowfilt[irow] == DOUBLENULLVALUE || rowfilt[irow] == 0.))
+        {
+	    ii += histData->repeat;
+	    continue;
+        }
 
 	/* Loop over elements in each row, increment ii after each element */
 
@@ -3245,8 +3421,349 @@ int ffcalchist(long totalrows, long offset, long firstrow, long nrows,
 	} /* end of loop over elements per row */
 
     }  /* end of main loop over all rows */
+}
+/*--------------------------------------------------------------------------*/
+static int histo_init_inputs(fitsfile *fptr, /* I - table to be binned      */
+    histType *histData, /* IO - weight and row filter set by the caller     */
+    int naxis,          /* I - number of axes in the histogram image        */
+    int *colnum,        /* I - column numbers (array length = naxis)        */
+    char *colexpr[4],   /* I - optional expression instead of column        */
+    int *useaxis,       /* I - optional flags; only set up these axes       */
+    int *status)
+/*
+   Set up the iterator columns, and a parser for each expression, which
+   supply the binning values of each axis, the weights and the row filter.
+   Free them with histo_free_inputs().
+*/
+{
+    int ii, datatype, naxis1;
+    long nrows = 0, colrepeat = 0, repeat = 0, wtrepeat = 0;
+    long naxes[MAXDIMS];
+    iteratorCol col;
 
-    histData->rowselector_cur = rowselect; /* Save row pointer for next go-round */
-    return(status);
+    if (*status > 0)
+        return(*status);
+
+    for (ii = 0; ii < 6; ii++)  histData->startCols[ii] = -1;
+    histData->nulval = DOUBLENULLVALUE;
+    fits_get_num_rows(fptr, &nrows, status);
+
+    for (ii = 0; ii < naxis; ii++)
+    {
+      if (useaxis && !useaxis[ii]) continue;
+
+      if (colexpr && colexpr[ii] && colexpr[ii][0]) {
+	/* This is a column expression, evaluated by its own parser */
+	if (histo_add_expr(fptr, histData, ii, colexpr[ii], nrows,
+			   &datatype, &colrepeat, status)) return(*status);
+
+      } else {
+	/* Just a "regular" column name */
+	fits_get_eqcoltype(fptr, colnum[ii], &datatype, &colrepeat, NULL, status);
+	histData->startCols[ii] = histData->numIterCols;
+	fits_iter_set_by_num(&col, fptr, colnum[ii], TDOUBLE, InputCol);
+	if (histo_add_cols(histData, &col, 1, status)) return(*status);
+      }
+
+      /* Check that all the vector dimensions agree */
+      if (repeat == 0) {
+	repeat = colrepeat;
+      } else if (repeat != colrepeat) {
+	ffpmsg("vector dimensions of binning values do not agree");
+	return(*status = BAD_DIMEN);
+      }
+    }
+
+    /* Now initialize the iterator column data for the weighting */
+    if (histData->wtexpr && histData->wtexpr[0] &&
+	histData->weight == DOUBLENULLVALUE) {
+
+      if (histo_add_expr(fptr, histData, 4, histData->wtexpr, nrows,
+			 &datatype, &wtrepeat, status)) return(*status);
+
+    } else if (histData->weight == DOUBLENULLVALUE) {
+
+      /* It's a "regular" weighting column */
+      fits_get_eqcoltype(fptr, histData->wtcolnum, &datatype, &wtrepeat,
+			 NULL, status);
+      histData->startCols[4] = histData->numIterCols;
+      fits_iter_set_by_num(&col, fptr, histData->wtcolnum, TDOUBLE, InputCol);
+      if (histo_add_cols(histData, &col, 1, status)) return(*status);
+
+    } else {
+
+      /* In case of explicit numerical value, we can just use that number
+	 in the vector expression, so the vector repeat of the weighting can
+	 be set to that of the input */
+      wtrepeat = repeat;
+    }
+
+    /* Vector dimension of weighting must agree with binning */
+    if (wtrepeat != 0 && repeat != 0 && wtrepeat != repeat) {
+      ffpmsg("vector dimensions of weights do not agree with bins");
+      return(*status = BAD_DIMEN);
+    }
+
+    /* And finally the row filter, which must give one logical per row */
+    if (histData->rowfilter && histData->rowfilter[0]) {
+      ParseData *lParse = &(histData->parsers[5]);
+      long nelem;
+
+      if (ffiprs(fptr, 0, histData->rowfilter, MAXDIMS, &datatype, &nelem,
+		 &naxis1, naxes, lParse, status)) return(*status);
+
+      if (datatype != TLOGICAL || lParse->nElements != 1) {
+	ffpmsg("Row filter expression does not evaluate to a logical scalar.");
+	return(*status = PARSE_BAD_TYPE);
+      }
+
+      if (lParse->Nodes[lParse->resultNode].operation == CONST_OP) {
+	/* The same for every row: either bin all rows or none */
+	histData->norows = !lParse->Nodes[lParse->resultNode].value.data.log;
+	ffcprs(lParse);
+	memset(lParse, 0, sizeof(ParseData));
+
+      } else {
+	histData->startCols[5] = histData->numIterCols;
+	if (fits_parser_set_temporary_col(lParse, &(histData->infos[5]),
+	      nrows, (void *) &(histData->nulval), status)) return(*status);
+	if (histo_add_cols(histData, lParse->colData, lParse->nCols,
+			   status)) return(*status);
+      }
+    }
+
+    histData->repeat = repeat;
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+static int histo_add_expr(fitsfile *fptr, /* I - table to be binned         */
+    histType *histData, /* IO - histogram inputs                            */
+    int ii,             /* I - input: axis 0-3, weight 4                    */
+    char *expr,         /* I - expression giving the values of this input   */
+    long nrows,         /* I - number of rows in the table                  */
+    int *datatype,      /* O - datatype of the expression                   */
+    long *nelem,        /* O - vector length of the expression              */
+    int *status)
+/*
+   Parse an expression which supplies one of the binning inputs, and add
+   its iterator columns, including the TemporaryCol which receives its
+   values, to the histogram's iterator columns.
+*/
+{
+    int naxis1;
+    long naxes[MAXDIMS];
+    ParseData *lParse = &(histData->parsers[ii]);
+
+    if (ffiprs(fptr, 0, expr, MAXDIMS, datatype, nelem, &naxis1,
+	       naxes, lParse, status)) return(*status);
+    if (*nelem < 0) *nelem = 1; /* If it's a constant expression */
+
+    /* Set up the parser data for evaluation to a TemporaryCol */
+    histData->startCols[ii] = histData->numIterCols;
+    if (fits_parser_set_temporary_col(lParse, &(histData->infos[ii]), nrows,
+	  (void *) &(histData->nulval), status)) return(*status);
+
+    /* Copy iterator columns from the parser to the master iterator columns */
+    return(histo_add_cols(histData, lParse->colData, lParse->nCols, status));
+}
+/*--------------------------------------------------------------------------*/
+static int histo_add_cols(histType *histData, /* IO - histogram inputs      */
+    iteratorCol *cols,  /* I - iterator columns to append                   */
+    int ncols,          /* I - number of columns                            */
+    int *status)
+{
+    iteratorCol *iterCols;
+
+    if (ncols <= 0) return(*status);
+
+    iterCols = fits_recalloc(histData->iterCols, histData->numIterCols,
+			     histData->numIterCols + ncols, sizeof(iteratorCol));
+    if (!iterCols) {
+      ffpmsg("memory allocation failure (histo_add_cols)");
+      histData->iterCols = 0;
+      histData->numIterCols = 0;
+      return(*status = MEMORY_ALLOCATION);
+    }
+
+    memcpy(iterCols + histData->numIterCols, cols, ncols * sizeof(iteratorCol));
+    histData->iterCols = iterCols;
+    histData->numIterCols += ncols;
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+static void histo_free_inputs(histType *histData)
+/*
+   Free the iterator columns, parsers and kept values of histData.
+*/
+{
+    int ii;
+
+    if (histData->iterCols) free(histData->iterCols);
+    histData->iterCols = 0;
+    histData->numIterCols = 0;
+
+    for (ii = 0; ii < 6; ii++) {
+      ffcprs(&(histData->parsers[ii]));
+      memset(&(histData->parsers[ii]), 0, sizeof(ParseData));
+    }
+
+    histo_drop_buffer(histData);
 }
+/*--------------------------------------------------------------------------*/
+static int histo_find_ranges(histType *histData, /* IO - histogram inputs   */
+    int *status)
+/*
+   Make one pass through the table which finds the data range of each axis
+   flagged in findrange[], for all of those axes at once.  If buffering is
+   set, the binning values of the selected rows are also kept, so that the
+   histogram can then be filled without reading the table again.
+*/
+{
+    int ii;
+
+    if (*status > 0)
+        return(*status);
 
+    for (ii = 0; ii < 4; ii++) {
+      if (histData->isexpr[ii]) {
+	/* as in fits_get_expr_minmax */
+	histData->datamin[ii] = DOUBLENULLVALUE;
+	histData->datamax[ii] = DOUBLENULLVALUE;
+      } else {
+	/* as in fits_get_col_minmax */
+	histData->datamin[ii] =  9.0E36;
+	histData->datamax[ii] = -9.0E36;
+      }
+    }
+    histData->nbufrows = 0;
+
+    if (fits_iterate_data(histData->numIterCols, histData->iterCols, 0, 0,
+	    histo_range_workfn, (void *) histData, status) == -1)
+      *status = 0;  /* -1 indicates exitted without error before end... OK */
+
+    if (*status) histo_drop_buffer(histData);
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+static int histo_range_workfn(long totalrows, long offset, long firstrow,
+             long nrows, int ncols, iteratorCol *colpars, void *userPointer)
+/*
+   Iterator work function of the range pass.
+*/
+{
+    histType *histData = (histType *) userPointer;
+    double *colptr[6], *data, dmin, dmax;
+    long ii, nvals;
+    int iaxis, status;
+
+    status = histo_eval_chunk(histData, totalrows, offset, firstrow, nrows,
+			      colptr);
+    if (status) return status;
+
+    nvals = nrows * histData->repeat;
+    for (iaxis = 0; iaxis < histData->haxis; iaxis++) {
+      if (!histData->findrange[iaxis] || !colptr[iaxis]) continue;
+
+      data = colptr[iaxis];
+      dmin = histData->datamin[iaxis];
+      dmax = histData->datamax[iaxis];
+
+      if (histData->isexpr[iaxis]) {
+	for (ii = 1; ii <= nvals; ii++) {
+	  if (data[ii] == DOUBLENULLVALUE) continue;
+	  if (data[ii] < dmin || dmin == DOUBLENULLVALUE) dmin = data[ii];
+	  if (data[ii] > dmax || dmax == DOUBLENULLVALUE) dmax = data[ii];
+	}
+      } else {
+	/* integer columns flag nulls with their TNULL value, which the */
+	/* iterator copies into data[0] when this chunk has any nulls   */
+	for (ii = 1; ii <= nvals; ii++) {
+	  if (data[ii] != DOUBLENULLVALUE &&
+	      (data[0] == 0. || data[ii] != data[0])) {
+	    dmin = minvalue(dmin, data[ii]);
+	    dmax = maxvalue(dmax, data[ii]);
+	  }
+	}
+      }
+
+      histData->datamin[iaxis] = dmin;
+      histData->datamax[iaxis] = dmax;
+    }
+
+    if (histData->buffering)
+      histo_keep_rows(histData, colptr, nrows, (histData->rowselector ?
+		      histData->rowselector + (firstrow - 1) : 0));
+
+    return status;
+}
+/*--------------------------------------------------------------------------*/
+static void histo_keep_rows(histType *histData, /* IO - histogram inputs    */
+                double **colptr,  /* I - values of axes, weight and filter  */
+                long nrows,       /* I - number of rows in the arrays       */
+                char *rowselect)  /* I - optional row selection flags       */
+/*
+   Append the binning values of the selected rows of one chunk to the kept
+   values.  If they would need more than HISTO_MAX_BUFFER bytes, or memory
+   runs out, the kept values are dropped instead and the histogram will be
+   filled by a second pass through the table.
+*/
+{
+    long irow, need, nalloc, repeat = histData->repeat;
+    double *rowfilt = colptr[5], *newbuf;
+    int ii, nbuf = 0;
+
+    if (histData->norows) return;
+
+    for (ii = 0; ii < 5; ii++)
+      if (colptr[ii]) nbuf++;
+
+    /* Element 0 of each array holds the null value, as in iterator arrays */
+    need = (histData->nbufrows + nrows) * repeat + 1;
+    if (need > histData->nbufalloc) {
+      nalloc = maxvalue(2 * histData->nbufalloc, need);
+      if ((double) nalloc * nbuf * sizeof(double) > HISTO_MAX_BUFFER)
+	nalloc = need;
+      if ((double) nalloc * nbuf * sizeof(double) > HISTO_MAX_BUFFER) {
+	histo_drop_buffer(histData);
+	return;
+      }
+
+      for (ii = 0; ii < 5; ii++) {
+	if (!colptr[ii]) continue;
+	newbuf = (double *) realloc(histData->buf[ii], nalloc * sizeof(double));
+	if (!newbuf) {
+	  histo_drop_buffer(histData);
+	  return;
+	}
+	newbuf[0] = DOUBLENULLVALUE;
+	histData->buf[ii] = newbuf;
+      }
+      histData->nbufalloc = nalloc;
+    }
+
+    for (irow = 1; irow <= nrows; irow++) {
+      if (rowselect && !rowselect[irow - 1]) continue;
+      if (rowfilt && (rowfilt[irow] == DOUBLENULLVALUE || rowfilt[irow] == 0.))
+	continue;
+
+      for (ii = 0; ii < 5; ii++) {
+	if (colptr[ii])
+	  memcpy(histData->buf[ii] + 1 + histData->nbufrows * repeat,
+		 colptr[ii] + 1 + (irow - 1) * repeat, repeat * sizeof(double));
+      }
+      histData->nbufrows++;
+    }
+}
+/*--------------------------------------------------------------------------*/
+static void histo_drop_buffer(histType *histData)
+{
+    int ii;
+
+    for (ii = 0; ii < 5; ii++) {
+      if (histData->buf[ii]) free(histData->buf[ii]);
+      histData->buf[ii] = 0;
+    }
+    histData->buffering = 0;
+    histData->nbufrows = 0;
+    histData->nbufalloc = 0;
+}
@@ -5909,12 +5909,18 @@ int imcomp_decompress_tile (fitsfile *infptr,
      if ((infptr->Fptr)->znaxis[0]   != (infptr->Fptr)->tilesize[0] ||
         (infptr->Fptr)->tilesize[1] != 1 ) {   /* don't cache the tile if only single row of the image */
 
-        (infptr->Fptr)->tilerow = (int *) calloc (ntilebins, sizeof(int));
-        (infptr->Fptr)->tiledata = (void**) calloc (ntilebins, sizeof(void*));
-        (infptr->Fptr)->tilenullarray = (void **) calloc (ntilebins, sizeof(char*));
-        (infptr->Fptr)->tiledatasize = (long *) calloc (ntilebins, sizeof(long));
-        (infptr->Fptr)->tiletype = (int *) calloc (ntilebins, sizeof(int));
-        (infptr->Fptr)->tileanynull = (int *) calloc (ntilebins, sizeof(int));
+        /* the cache index arrays live in the HDU arena of the file */
+        (infptr->Fptr)->tiledata = (void**) ffhdualloc(infptr->Fptr, ntilebins * sizeof(void*));
+        (infptr->Fptr)->tilenullarray = (void **) ffhdualloc(infptr->Fptr, ntilebins * sizeof(char*));
+        (infptr->Fptr)->tiledatasize = (long *) ffhdualloc(infptr->Fptr, ntilebins * sizeof(long));
+        (infptr->Fptr)->tiletype = (int *) ffhdualloc(infptr->Fptr, ntilebins * sizeof(int));
+        (infptr->Fptr)->tileanynull = (int *) ffhdualloc(infptr->Fptr, ntilebins * sizeof(int));
+
+        /* tilerow is set last, since it flags that the cache exists */
+        if ((infptr->Fptr)->tiledata && (infptr->Fptr)->tilenullarray &&
+            (infptr->Fptr)->tiledatasize && (infptr->Fptr)->tiletype &&
+            (infptr->Fptr)->tileanynull)
+            (infptr->Fptr)->tilerow = (int *) ffhdualloc(infptr->Fptr, ntilebins * sizeof(int));
       }
     }
  
@@ -18,7 +18,7 @@
  *		Put filename and header path together
  * Subroutine:	iraf2fits (hdrname, irafheader, nbiraf, nbfits)
  *		Convert IRAF image header to FITS image header
- * Subroutine:  irafgeti4 (irafheader, offset)
+ * Subroutine:  irafgeti4 (irafheader, offset, swaphead)
  *		Get 4-byte integer from arbitrary part of IRAF header
  * Subroutine:  irafgetc2 (irafheader, offset)
  *		Get character string from arbitrary part of IRAF v.1 header
@@ -50,6 +50,14 @@
 #include <stddef.h>  /* stddef.h is apparently needed to define size_t */
 #include <string.h>
 
+#if defined(unix) || defined(__unix__)  || defined(__unix) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#define IRAF_MMAP     /* map the IRAF pixel files into memory */
+#endif
+
 #define FILE_NOT_OPENED 104
 
 /* Parameters from iraf/lib/imhdr.h for IRAF version 1 images */
@@ -113,21 +121,37 @@
 #define LEN_PIXHDR	1024
 #define MAXINT  2147483647 /* Biggest number that can fit in long */
 
+/* An open IRAF pixel file, read as the data unit of a FITS image.  The  */
+/* pixels are copied from the file (or from its mapped pages) only when  */
+/* they are read, and each line of the image is located separately if    */
+/* the stored lines are longer than the image lines.                     */
+typedef struct {
+    FILE *fd;           /* the pixel file, if it is not mapped */
+    char *map;          /* the mapped pixel file, or NULL */
+    size_t mapsize;     /* size of the mapped pixel file */
+    LONGLONG pixoff;    /* offset of the first pixel in the file */
+    LONGLONG nbimage;   /* number of bytes in the image */
+    LONGLONG nbaxis;    /* number of bytes in an image line */
+    LONGLONG nbphys;    /* number of bytes in a stored (physical) line */
+    int bitpix;         /* FITS BITPIX of the pixels */
+    int bytepix;        /* number of bytes per pixel */
+    int swap;           /* =1 to swap bytes in IRAF data pixels */
+} irafpixfile;
+
 static int isirafswapped(char *irafheader, int offset);
-static int irafgeti4(char *irafheader, int offset);
+static int irafgeti4(char *irafheader, int offset, int swaphead);
 static char *irafgetc2(char *irafheader, int offset, int nc);
 static char *irafgetc(char *irafheader,	int offset, int	nc);
 static char *iraf2str(char *irafstring, int nchar);
 static char *irafrdhead(const char *filename, int *lihead);
-static int irafrdimage (char **buffptr, size_t *buffsize,
-    size_t *filesize, int *status);
+static int irafrdpixhead (irafpixfile *pix, char *fitsheader, int *status);
+static int irafgetbytes (irafpixfile *pix, LONGLONG offset, char *buffer,
+    LONGLONG nbytes, int *status);
 static int iraftofits (char *hdrname, char *irafheader, int nbiraf,
-    char **buffptr, size_t *nbfits, size_t *fitssize, int *status);
+    char **buffptr, size_t *nbfits, size_t *fitssize, int *swapdata,
+    int *status);
 static char *same_path(char *pixname, const char *hdrname);
 
-static int swaphead=0;	/* =1 to swap data bytes of IRAF header values */
-static int swapdata=0;  /* =1 to swap bytes in IRAF data pixels */
-
 static void irafswap(int bitpix, char *string, int nbytes);
 static void irafswap2(char *string, int nbytes);
 static void irafswap4(char *string, int nbytes);
@@ -151,6 +175,11 @@ static void hputc(char* hstring,char* keyword,char* cval);
 static int getirafpixname (const char *hdrname, char *irafheader, char *pixfilename, int *status);
 int iraf2mem(char *filename, char **buffptr, size_t *buffsize, 
       size_t *filesize, int *status);
+int irafopenpix(char *filename, char **buffptr, size_t *buffsize,
+      size_t *headsize, size_t *filesize, void **pixfile, int *status);
+int irafreadpix(void *pixfile, LONGLONG offset, char *buffer, long nbytes,
+      int *status);
+void irafclosepix(void *pixfile);
 
 void ffpmsg(const char *err_message);
 
@@ -220,13 +249,62 @@ int iraf2mem(char *filename,     /* name of input file                 */
    Driver routine that reads an IRAF image into memory, also converting
    it into FITS format.
 */
+{
+    void *pixfile;
+    char *fitsfile;
+    size_t headsize;
+
+    /* convert the header and open the pixel file */
+    if (irafopenpix(filename, buffptr, buffsize, &headsize, filesize,
+                    &pixfile, status) > 0)
+       return(*status);
+
+    /* append the image data onto the FITS header */
+    if (*filesize > *buffsize)
+    {
+        fitsfile = (char *) realloc (*buffptr, *filesize);
+        if (fitsfile == NULL) {
+            ffpmsg("IRAF2MEM Cannot allocate memory for the image");
+            ffpmsg(filename);
+            irafclosepix(pixfile);
+            return (*status = FILE_NOT_OPENED);
+        }
+        *buffptr = fitsfile;
+        *buffsize = *filesize;
+    }
+
+    irafreadpix(pixfile, 0, *buffptr + headsize,
+                (long) (*filesize - headsize), status);
+    irafclosepix(pixfile);
+
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+int irafopenpix(char *filename,  /* name of input file                     */
+             char **buffptr,     /* O - FITS header (initially NULL)        */
+             size_t *buffsize,   /* O - size of header buffer, in bytes     */
+             size_t *headsize,   /* O - size of FITS header, in bytes       */
+             size_t *filesize,   /* O - size of FITS file, in bytes         */
+             void **pixfile,     /* O - open IRAF pixel file                */
+             int *status)        /* IO - error status                       */
+
+/*
+   Convert the header of an IRAF image into a FITS header in memory, and
+   open the IRAF pixel file, so that the image pixels can be read as the
+   FITS data unit with irafreadpix.  The pixel file is mapped into memory
+   where possible, instead of being read into a copy of the whole image.
+   The pixel file must be closed with irafclosepix.
+*/
 {
     char *irafheader;
-    int lenirafhead;
+    int lenirafhead, swapdata = 0;
+    irafpixfile *pix;
 
     *buffptr = NULL;
     *buffsize = 0;
+    *headsize = 0;
     *filesize = 0;
+    *pixfile = NULL;
 
     /* read IRAF header into dynamically created char array (free it later!) */
     irafheader = irafrdhead(filename, &lenirafhead);
@@ -237,8 +315,8 @@ int iraf2mem(char *filename,     /* name of input file                 */
     }
 
     /* convert IRAF header to FITS header in memory */
-    iraftofits(filename, irafheader, lenirafhead, buffptr, buffsize, filesize,
-               status);
+    iraftofits(filename, irafheader, lenirafhead, buffptr, buffsize, headsize,
+               &swapdata, status);
 
     /* don't need the IRAF header any more */
     free(irafheader);
@@ -246,13 +324,114 @@ int iraf2mem(char *filename,     /* name of input file                 */
     if (*status > 0)
        return(*status);
 
-    *filesize = (((*filesize - 1) / 2880 ) + 1 ) * 2880; /* multiple of 2880 */
+    *headsize = (((*headsize - 1) / 2880 ) + 1 ) * 2880; /* multiple of 2880 */
 
-    /* append the image data onto the FITS header */
-    irafrdimage(buffptr, buffsize, filesize, status);
+    pix = (irafpixfile *) calloc (1, sizeof (irafpixfile));
+    if (pix == NULL) {
+        ffpmsg("IRAFOPENPIX Cannot allocate memory for pixel file");
+        return (*status = FILE_NOT_OPENED);
+	}
+    pix->swap = swapdata;
+
+    /* open the pixel file and check its header */
+    if (irafrdpixhead(pix, *buffptr, status) > 0)
+    {
+        irafclosepix(pix);
+        return(*status);
+    }
+
+    *filesize = *headsize;
+    if (pix->nbimage > 0)   /* header + data */
+        *filesize += (size_t) (((pix->nbimage - 1) / 2880 ) + 1 ) * 2880;
 
+    *pixfile = pix;
     return(*status);
 }
+/*--------------------------------------------------------------------------*/
+int irafreadpix(void *pixfile,   /* I - open IRAF pixel file               */
+             LONGLONG offset,    /* I - offset in the FITS data unit        */
+             char *buffer,       /* O - FITS data bytes                     */
+             long nbytes,        /* I - number of bytes to read             */
+             int *status)        /* IO - error status                       */
+
+/*
+   Read bytes of the FITS data unit of an IRAF image, starting at the
+   given offset from the start of the data unit, by copying the pixels
+   from the IRAF pixel file.  The bytes of each pixel are reversed while
+   they are copied if the IRAF and FITS byte orders differ.  The fill
+   bytes that follow the image in the last FITS block are zero.
+*/
+{
+    irafpixfile *pix = (irafpixfile *) pixfile;
+    LONGLONG fileoff, nread, col, first;
+    char pixel[8];
+
+    while (nbytes > 0)
+    {
+        if (offset >= pix->nbimage)
+        {
+            memset(buffer, 0, nbytes);   /* fill the last FITS block */
+            break;
+        }
+
+        /* locate the byte in the stored line, and read to the line end */
+        col = offset % pix->nbaxis;
+        fileoff = pix->pixoff + (offset / pix->nbaxis) * pix->nbphys + col;
+        nread = minvalue(pix->nbaxis - col, nbytes);
+
+        if (!pix->swap || pix->bytepix == 1)
+        {
+            if (irafgetbytes(pix, fileoff, buffer, nread, status) > 0)
+                return(*status);
+        }
+        else if ((first = col % pix->bytepix) != 0 || nread < pix->bytepix)
+        {
+            /* part of a pixel; reverse the whole pixel, then copy the part */
+            if (irafgetbytes(pix, fileoff - first, pixel, pix->bytepix,
+                status) > 0)
+                return(*status);
+
+            irafswap (pix->bitpix, pixel, pix->bytepix);
+            nread = minvalue(nread, pix->bytepix - first);
+            memcpy(buffer, pixel + first, (size_t) nread);
+        }
+        else
+        {
+            nread -= nread % pix->bytepix;   /* whole pixels */
+            if (irafgetbytes(pix, fileoff, buffer, nread, status) > 0)
+                return(*status);
+
+            irafswap (pix->bitpix, buffer, (int) nread);
+        }
+
+        buffer += nread;
+        offset += nread;
+        nbytes -= (long) nread;
+    }
+
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+void irafclosepix(void *pixfile)  /* I - open IRAF pixel file */
+
+/*
+   Close an IRAF pixel file opened by irafopenpix.
+*/
+{
+    irafpixfile *pix = (irafpixfile *) pixfile;
+
+    if (!pix)
+        return;
+
+#ifdef IRAF_MMAP
+    if (pix->map)
+        munmap (pix->map, pix->mapsize);
+#endif
+    if (pix->fd)
+        fclose (pix->fd);
+
+    free (pix);
+}
 
 /*--------------------------------------------------------------------------*/
 /* Subroutine:	irafrdhead  (was irafrhead in D. Mink's original code)
@@ -335,26 +514,22 @@ static char *irafrdhead (
     return (irafheader);
 }
 /*--------------------------------------------------------------------------*/
-static int irafrdimage (
-    char **buffptr,	/* FITS image header (filled) */
-    size_t *buffsize,      /* allocated size of the buffer */
-    size_t *filesize,      /* actual size of the FITS file */
+static int irafrdpixhead (
+    irafpixfile *pix,	/* IRAF pixel file (filled) */
+    char *fitsheader,	/* FITS image header */
     int *status)
 {
-    FILE *fd;
     char *bang;
-    int nax = 1, naxis1 = 1, naxis2 = 1, naxis3 = 1, naxis4 = 1, npaxis1 = 1, npaxis2;
-    int bitpix, bytepix, i;
-    char *fitsheader, *image;
-    int nbr, nbimage, nbaxis, nbl, nbdiff;
-    char *pixheader;
-    char *linebuff;
-    int imhver, lpixhead = 0;
+    int nax = 1, naxis1 = 1, naxis2 = 1, naxis3 = 1, naxis4 = 1, npaxis1 = 1;
+    int bitpix, imhver, lpixhead = 0;
+    char pixheader[10];
     char pixname[SZ_IM2PIXFILE+1];
     char errmsg[FLEN_ERRMSG];
-    size_t newfilesize;
- 
-    fitsheader = *buffptr;           /* pointer to start of header */
+    LONGLONG pixsize, nlines;
+#ifdef IRAF_MMAP
+    int fdes;
+    struct stat statbuf;
+#endif
 
     /* Convert pixel file name to character string */
     hgets (fitsheader, "PIXFILE", SZ_IM2PIXFILE, pixname);
@@ -362,125 +537,119 @@ static int irafrdimage (
 
     /* Open pixel file, ignoring machine name if present */
     if ((bang = strchr (pixname, '!')) != NULL )
-	fd = fopen (bang + 1, "rb");
+	bang++;
     else
-	fd = fopen (pixname, "rb");
+	bang = pixname;
+
+    pixsize = -1;
+#ifdef IRAF_MMAP
+    /* map the whole pixel file, if possible */
+    fdes = open (bang, O_RDONLY);
+    if (fdes >= 0) {
+	if (fstat (fdes, &statbuf) == 0 && statbuf.st_size > 0) {
+	    pix->map = (char *) mmap (NULL, (size_t) statbuf.st_size,
+	                              PROT_READ, MAP_PRIVATE, fdes, 0);
+	    if (pix->map == (char *) MAP_FAILED)
+	        pix->map = NULL;
+	    else {
+	        pix->mapsize = (size_t) statbuf.st_size;
+	        pixsize = statbuf.st_size;
+	        }
+	    }
+	close (fdes);
+	}
+#endif
+
+    /* otherwise read the pixels from the open file when they are needed */
+    if (!pix->map) {
+	pix->fd = fopen (bang, "rb");
+	if (pix->fd && fseek (pix->fd, 0, 2) == 0)
+	    pixsize = ftell (pix->fd);
+	}
 
     /* Print error message and exit if pixel file is not found */
-    if (!fd) {
+    if (pixsize < 0) {
         ffpmsg("IRAFRIMAGE: Cannot open IRAF pixel file:");
         ffpmsg(pixname);
 	return (*status = FILE_NOT_OPENED);
 	}
 
-    /* Read pixel header */
-    pixheader = (char *) calloc (lpixhead, 1);
-    if (pixheader == NULL) {
-            ffpmsg("IRAFRIMAGE: Cannot alloc memory for pixel header");
-            ffpmsg(pixname);
-            fclose (fd);
-	    return (*status = FILE_NOT_OPENED);
-	}
-    nbr = fread (pixheader, 1, lpixhead, fd);
-
     /* Check size of pixel header */
-    if (nbr < lpixhead) {
+    if (pixsize < lpixhead) {
 	snprintf(errmsg, FLEN_ERRMSG,"IRAF pixel file: %d / %d bytes read.",
-		      nbr,LEN_PIXHDR);
+		      (int) pixsize, LEN_PIXHDR);
         ffpmsg(errmsg);
-	free (pixheader);
-	fclose (fd);
 	return (*status = FILE_NOT_OPENED);
 	}
 
     /* check pixel header magic word */
+    memset (pixheader, 0, 10);
+    irafgetbytes (pix, 0, pixheader, minvalue(pixsize, 10), status);
     imhver = pix_version (pixheader);
     if (imhver < 1) {
         ffpmsg("File not valid IRAF pixel file:");
         ffpmsg(pixname);
-	free (pixheader);
-	fclose (fd);
 	return (*status = FILE_NOT_OPENED);
 	}
-    free (pixheader);
 
     /* Find number of bytes to read */
     hgeti4 (fitsheader,"NAXIS",&nax);
     hgeti4 (fitsheader,"NAXIS1",&naxis1);
     hgeti4 (fitsheader,"NPAXIS1",&npaxis1);
-    if (nax > 1) {
+    if (nax > 1)
         hgeti4 (fitsheader,"NAXIS2",&naxis2);
-        hgeti4 (fitsheader,"NPAXIS2",&npaxis2);
-	}
     if (nax > 2)
         hgeti4 (fitsheader,"NAXIS3",&naxis3);
     if (nax > 3)
         hgeti4 (fitsheader,"NAXIS4",&naxis4);
 
     hgeti4 (fitsheader,"BITPIX",&bitpix);
+    pix->bitpix = bitpix;
     if (bitpix < 0)
-	bytepix = -bitpix / 8;
+	pix->bytepix = -bitpix / 8;
     else
-	bytepix = bitpix / 8;
-
-    nbimage = naxis1 * naxis2 * naxis3 * naxis4 * bytepix;
-    
-    newfilesize = *filesize + nbimage;  /* header + data */
-    newfilesize = (((newfilesize - 1) / 2880 ) + 1 ) * 2880;
-
-    if (newfilesize > *buffsize)   /* need to allocate more memory? */
-    {
-      fitsheader =  (char *) realloc (*buffptr, newfilesize);
-      if (fitsheader == NULL) {
-	snprintf(errmsg, FLEN_ERRMSG,"IRAFRIMAGE Cannot allocate %d-byte image buffer",
-		(int) (*filesize));
-        ffpmsg(errmsg);
-        ffpmsg(pixname);
-	fclose (fd);
-	return (*status = FILE_NOT_OPENED);
+	pix->bytepix = bitpix / 8;
+
+    pix->pixoff = lpixhead;
+    pix->nbaxis = (LONGLONG) naxis1 * pix->bytepix;
+    pix->nbphys = (LONGLONG) npaxis1 * pix->bytepix;
+    pix->nbimage = pix->nbaxis * naxis2 * naxis3 * naxis4;
+
+    /* Check size of image; the stored lines may be longer than the */
+    /* image lines, in which case the image is read one line at a time */
+    if (pix->nbimage > 0) {
+	nlines = pix->nbimage / pix->nbaxis;
+	if (pix->nbphys < pix->nbaxis ||
+	    pixsize < pix->pixoff + (nlines - 1) * pix->nbphys + pix->nbaxis) {
+	    snprintf(errmsg, FLEN_ERRMSG,"IRAF pixel file: %.0f / %.0f bytes read.",
+		      (double) (pixsize - pix->pixoff), (double) pix->nbimage);
+	    ffpmsg(errmsg);
+	    ffpmsg(pixname);
+	    return (*status = FILE_NOT_OPENED);
+	    }
 	}
-    }
-
-    *buffptr = fitsheader;
-    *buffsize = newfilesize;
-
-    image = fitsheader + *filesize;
-    *filesize = newfilesize;
 
-    /* Read IRAF image all at once if physical and image dimensions are the same */
-    if (npaxis1 == naxis1)
-	nbr = fread (image, 1, nbimage, fd);
+    return (*status);
+}
+/*--------------------------------------------------------------------------*/
+/* Copy bytes from an open IRAF pixel file */
 
-    /* Read IRAF image one line at a time if physical and image dimensions differ */
-    else {
-	nbdiff = (npaxis1 - naxis1) * bytepix;
-	nbaxis = naxis1 * bytepix;
-	linebuff = image;
-	nbr = 0;
-	if (naxis2 == 1 && naxis3 > 1)
-	    naxis2 = naxis3;
-	for (i = 0; i < naxis2; i++) {
-	    nbl = fread (linebuff, 1, nbaxis, fd);
-	    nbr = nbr + nbl;
-	    fseek (fd, nbdiff, 1);
-	    linebuff = linebuff + nbaxis;
-	    }
+static int irafgetbytes (
+    irafpixfile *pix,	/* IRAF pixel file */
+    LONGLONG offset,	/* offset of the first byte in the file */
+    char *buffer,	/* bytes (returned) */
+    LONGLONG nbytes,	/* number of bytes to copy */
+    int *status)
+{
+    if (pix->map) {
+	memcpy (buffer, pix->map + offset, (size_t) nbytes);
 	}
-    fclose (fd);
-
-    /* Check size of image */
-    if (nbr < nbimage) {
-	snprintf(errmsg, FLEN_ERRMSG,"IRAF pixel file: %d / %d bytes read.",
-		      nbr,nbimage);
-        ffpmsg(errmsg);
-        ffpmsg(pixname);
-	return (*status = FILE_NOT_OPENED);
+    else if (fseek (pix->fd, (long) offset, 0) != 0 ||
+	     fread (buffer, 1, (size_t) nbytes, pix->fd) != (size_t) nbytes) {
+        ffpmsg("IRAFREADPIX: error reading IRAF pixel file");
+	return (*status = READ_ERROR);
 	}
 
-    /* Byte-reverse image, if necessary */
-    if (swapdata)
-	irafswap (bitpix, image, nbimage);
-
     return (*status);
 }
 /*--------------------------------------------------------------------------*/
@@ -556,6 +725,7 @@ static int iraftofits (
     size_t  *nbfits,      /* allocated size of the FITS header buffer */
     size_t  *fitssize,  /* Number of bytes in FITS header (returned) */
                         /*  = number of bytes to the end of the END keyword */
+    int     *swapdata,  /* =1 to swap bytes in IRAF data pixels (returned) */
     int     *status)
 {
     char *objname;	/* object name from FITS file */
@@ -570,6 +740,7 @@ static int iraftofits (
     int imhver, n, imu, pixoff, impixoff;
 /*    int immax, immin, imtime;  */
     int imndim, imlen, imphyslen, impixtype;
+    int swaphead;	/* =1 to swap data bytes of IRAF header values */
     char errmsg[FLEN_ERRMSG];
 
     /* Set up last line of FITS header */
@@ -634,12 +805,12 @@ static int iraftofits (
 
     swaphead = isirafswapped(irafheader, impixtype);
     if (imhver == 1)
-        swapdata = swaphead; /* vers 1 data has same swapness as header */
+        *swapdata = swaphead; /* vers 1 data has same swapness as header */
     else
-        swapdata = irafgeti4 (irafheader, IM2_SWAPPED); 
+        *swapdata = irafgeti4 (irafheader, IM2_SWAPPED, swaphead); 
 
     /*  Set pixel size in FITS header */
-    pixtype = irafgeti4 (irafheader, impixtype);
+    pixtype = irafgeti4 (irafheader, impixtype, swaphead);
     switch (pixtype) {
 	case TY_CHAR:
 	    nbits = 8;
@@ -674,30 +845,30 @@ static int iraftofits (
     fhead = fhead + 80;
 
     /*  Set image dimensions in FITS header */
-    nax = irafgeti4 (irafheader, imndim);
+    nax = irafgeti4 (irafheader, imndim, swaphead);
     hputi4 (fitsheader,"NAXIS",nax);
     hputcom (fitsheader,"NAXIS", "IRAF .imh naxis");
     fhead = fhead + 80;
 
-    n = irafgeti4 (irafheader, imlen);
+    n = irafgeti4 (irafheader, imlen, swaphead);
     hputi4 (fitsheader, "NAXIS1", n);
     hputcom (fitsheader,"NAXIS1", "IRAF .imh image naxis[1]");
     fhead = fhead + 80;
 
     if (nax > 1) {
-	n = irafgeti4 (irafheader, imlen+4);
+	n = irafgeti4 (irafheader, imlen+4, swaphead);
 	hputi4 (fitsheader, "NAXIS2", n);
 	hputcom (fitsheader,"NAXIS2", "IRAF .imh image naxis[2]");
         fhead = fhead + 80;
 	}
     if (nax > 2) {
-	n = irafgeti4 (irafheader, imlen+8);
+	n = irafgeti4 (irafheader, imlen+8, swaphead);
 	hputi4 (fitsheader, "NAXIS3", n);
 	hputcom (fitsheader,"NAXIS3", "IRAF .imh image naxis[3]");
 	fhead = fhead + 80;
 	}
     if (nax > 3) {
-	n = irafgeti4 (irafheader, imlen+12);
+	n = irafgeti4 (irafheader, imlen+12, swaphead);
 	hputi4 (fitsheader, "NAXIS4", n);
 	hputcom (fitsheader,"NAXIS4", "IRAF .imh image naxis[4]");
 	fhead = fhead + 80;
@@ -719,24 +890,24 @@ static int iraftofits (
     fhead = fhead + 80;
 
     /* Save physical axis lengths so image file can be read */
-    n = irafgeti4 (irafheader, imphyslen);
+    n = irafgeti4 (irafheader, imphyslen, swaphead);
     hputi4 (fitsheader, "NPAXIS1", n);
     hputcom (fitsheader,"NPAXIS1", "IRAF .imh physical naxis[1]");
     fhead = fhead + 80;
     if (nax > 1) {
-	n = irafgeti4 (irafheader, imphyslen+4);
+	n = irafgeti4 (irafheader, imphyslen+4, swaphead);
 	hputi4 (fitsheader, "NPAXIS2", n);
 	hputcom (fitsheader,"NPAXIS2", "IRAF .imh physical naxis[2]");
 	fhead = fhead + 80;
 	}
     if (nax > 2) {
-	n = irafgeti4 (irafheader, imphyslen+8);
+	n = irafgeti4 (irafheader, imphyslen+8, swaphead);
 	hputi4 (fitsheader, "NPAXIS3", n);
 	hputcom (fitsheader,"NPAXIS3", "IRAF .imh physical naxis[3]");
 	fhead = fhead + 80;
 	}
     if (nax > 3) {
-	n = irafgeti4 (irafheader, imphyslen+12);
+	n = irafgeti4 (irafheader, imphyslen+12, swaphead);
 	hputi4 (fitsheader, "NPAXIS4", n);
 	hputcom (fitsheader,"NPAXIS4", "IRAF .imh physical naxis[4]");
 	fhead = fhead + 80;
@@ -776,7 +947,7 @@ static int iraftofits (
     fhead = fhead + 80;
 
     /* Save image offset from star of pixel file */
-    pixoff = irafgeti4 (irafheader, impixoff);
+    pixoff = irafgeti4 (irafheader, impixoff, swaphead);
     pixoff = (pixoff - 1) * 2;
     hputi4 (fitsheader, "PIXOFF", pixoff);
     hputcom (fitsheader,"PIXOFF", "IRAF .pix pixel offset (Do not change!)");
@@ -788,7 +959,7 @@ static int iraftofits (
     fhead = fhead + 80;
 
     /* Save flag as to whether to swap IRAF data for this file and machine */
-    if (swapdata)
+    if (*swapdata)
 	hputl (fitsheader, "PIXSWAP", 1);
     else
 	hputl (fitsheader, "PIXSWAP", 0);
@@ -1044,7 +1215,8 @@ int	offset)		/* Number of bytes to skip before number */
 static int irafgeti4 (
 
 char	*irafheader,	/* IRAF image header */
-int	offset)		/* Number of bytes to skip before number */
+int	offset,		/* Number of bytes to skip before number */
+int	swaphead)	/* =1 if the IRAF header values are little endian */
 
 {
     char *ctemp, *cheader;
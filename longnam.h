@@ -27,6 +27,7 @@
 #define fits_open_image     ffiopn
 #define fits_open_diskfile  ffdkopn
 #define fits_reopen_file    ffreopen
+#define fits_open_reader    ffropn
 #define fits_create_file    ffinit
 #define fits_create_diskfile ffdkinit
 #define fits_create_memfile ffimem
@@ -47,6 +48,8 @@
 #define fits_read_errmsg    ffgmsg
 #define fits_clear_errmsg   ffcmsg
 #define fits_clear_errmark  ffcmrk
+#define fits_get_errstack_id ffgmid
+#define fits_read_errmsg_id ffgmsi
 #define fits_report_error   ffrprt
 #define fits_compare_str    ffcmps
 #define fits_test_keyword   fftkey
@@ -223,6 +226,7 @@
 #define fits_get_hduaddr    ffghad
 #define fits_get_hduaddrll    ffghadll
 #define fits_get_hduoff     ffghof
+#define fits_get_hdu_alloc_count  ffghmc
 
 #define fits_get_img_param  ffgipr
 #define fits_get_img_paramll  ffgiprll
@@ -245,6 +249,7 @@
 #define fits_insert_imgll   ffiimgll
 #define fits_insert_atbl    ffitab
 #define fits_insert_btbl    ffibin
+#define fits_write_arrow    ffparw
 #define fits_resize_img     ffrsim
 #define fits_resize_imgll   ffrsimll
 
@@ -392,8 +397,12 @@
 
 #define fits_read_col        ffgcv
 #define fits_read_cols       ffgcvn
+#define fits_read_col_vlas   ffgcvv
+#define fits_read_arrow      ffgarw
 #define fits_read_colnull    ffgcf
 #define fits_read_col_str    ffgcvs
+#define fits_read_col_strbuf ffgcsp
+#define fits_read_col_strfix ffgcsw
 #define fits_read_col_log    ffgcvl
 #define fits_read_col_byt    ffgcvb
 #define fits_read_col_sbyt    ffgcvsb
@@ -412,6 +421,7 @@
 #define fits_read_col_bit    ffgcx
 #define fits_read_col_bit_usht ffgcxui
 #define fits_read_col_bit_uint ffgcxuk
+#define fits_read_col_bitpack ffgcxp
 
 #define fits_read_colnull_str    ffgcfs
 #define fits_read_colnull_log    ffgcfl
@@ -527,6 +537,8 @@
 #define fits_write_col         ffpcl
 #define fits_write_cols        ffpcln
 #define fits_write_col_str     ffpcls
+#define fits_write_col_strbuf  ffpcsp
+#define fits_write_col_strfix  ffpcsw
 #define fits_write_col_log     ffpcll
 #define fits_write_col_byt     ffpclb
 #define fits_write_col_sbyt     ffpclsb
@@ -544,6 +556,7 @@
 #define fits_write_col_dblcmp  ffpclm
 #define fits_write_col_null    ffpclu
 #define fits_write_col_bit     ffpclx
+#define fits_write_col_bitpack ffpcxp
 #define fits_write_nulrows     ffprwu
 #define fits_write_nullrows    ffprwu
 
@@ -579,6 +592,7 @@
 #define fits_insert_col   fficol
 #define fits_insert_cols  fficls
 #define fits_delete_col   ffdcol
+#define fits_delete_cols  ffdcls
 #define fits_copy_col     ffcpcl
 #define fits_copy_cols    ffccls
 #define fits_copy_rows    ffcprw
@@ -596,12 +610,23 @@
 
 #define fits_find_rows          fffrow
 #define fits_find_first_row     ffffrw
+#define fits_find_rows_list     fffrwl
+#define fits_find_rows_bitmap   fffrwb
+#define fits_find_rows_cols     fffrwp
 #define fits_find_rows_cmp      fffrwc
 #define fits_select_rows        ffsrow
 #define fits_calc_rows          ffcrow
 #define fits_calculator         ffcalc
 #define fits_calculator_rng     ffcalc_rng
+#define fits_calculator_multi   ffcalc_multi
 #define fits_test_expr          fftexp
+#define fits_compile_expr       ffcexp
+#define fits_bind_expr          ffbexp
+#define fits_test_compiled_expr fftcex
+#define fits_find_rows_expr     fffrwx
+#define fits_select_rows_expr   ffsrwx
+#define fits_calc_rows_expr     ffcrwx
+#define fits_free_expr          fffexp
 
 #define fits_create_group       ffgtcr 
 #define fits_insert_group       ffgtis 
@@ -617,6 +642,7 @@
 
 #define fits_get_num_groups     ffgmng 
 #define fits_open_member        ffgmop 
+#define fits_open_members       ffgmops 
 #define fits_copy_member        ffgmcp 
 #define fits_transfer_member    ffgmtf 
 #define fits_remove_member      ffgmrm
@@ -370,3 +370,153 @@ int ffpclx( fitsfile *fptr,  /* I - FITS file pointer                       */
     }
 }
 
+/*--------------------------------------------------------------------------*/
+int ffpcxp( fitsfile *fptr,  /* I - FITS file pointer                       */
+            int  colnum,     /* I - number of column to write (1 = 1st col) */
+            LONGLONG  firstrow,  /* I - first row to write (1 = 1st row)        */
+            LONGLONG  nrows,     /* I - no. of rows to write                    */
+            long  firstbit,  /* I - first bit to write (1 = 1st)            */
+            long  nbits,     /* I - number of bits to write in each row     */
+            unsigned char *array, /* I - packed bits, (nbits+7)/8 bytes per row */
+            int  *status)    /* IO - error status                           */
+/*
+  Write a consecutive string of bits in each row of an 'X' or 'B' column
+  from packed bytes, in the layout returned by ffgcxp.  If the bits start
+  and end on byte boundaries, the bytes are written directly from the input
+  array; otherwise the existing bytes are read, the new bits are merged
+  in, and the bytes are written back, one chunk of rows at a time.
+*/
+{
+    LONGLONG bstart, rowlen, row, ntodo, tnull, repeat, elemnum;
+    long ii, jj, span, outbytes, shift, chunk, twidth, incre;
+    int tcode, maxelem, hdutype;
+    double dummyd;
+    char tform[12], snull[12];
+    unsigned char tailmask, mask, value, *inptr, *tmp;
+    tcolumn *colptr;
+    char message[FLEN_ERRMSG];
+
+    double cbuff[DBUFFSIZE / sizeof(double)]; /* align cbuff on word boundary */
+
+    if (ffcxpchk(fptr, colnum, firstrow, nrows, firstbit, nbits, "ffpcxp",
+        status) > 0 || nrows < 1 || nbits < 1)
+        return(*status);
+
+    shift = (firstbit - 1) % 8;
+    span = (firstbit + nbits - 2) / 8 - (firstbit - 1) / 8 + 1;
+    outbytes = (nbits + 7) / 8;
+    tailmask = (unsigned char) (0xFF << (outbytes * 8 - nbits));
+
+    /* call ffgcprll for the last row, in case we are writing beyond the */
+    /* current end of the table; it will allocate more space and shift  */
+    /* any following HDUs.                                               */
+    if (ffgcprll( fptr, colnum, firstrow + nrows - 1, (firstbit - 1) / 8 + 1,
+        span, 1, &dummyd, &dummyd, tform, &twidth, &tcode, &maxelem, &bstart,
+        &elemnum, &incre, &repeat, &rowlen, &hdutype, &tnull, snull,
+        status) > 0)
+        return(*status);
+
+    colptr  = (fptr->Fptr)->tableptr + (colnum - 1);
+    rowlen = (fptr->Fptr)->rowlength;
+    bstart = (fptr->Fptr)->datastart + rowlen * (firstrow - 1) +
+             colptr->tbcol + (firstbit - 1) / 8;
+
+    if (shift == 0 && tailmask == 0xFF && span <= IOBUFLEN)
+    {
+        /* whole bytes: write them directly from the input array */
+        if (rowlen == span)
+        {
+            ffmbyt(fptr, bstart, IGNORE_EOF, status);
+            ffpbyt(fptr, nrows * span, array, status);
+        }
+        else
+        {
+            for (row = 0; row < nrows; row += ntodo)
+            {
+                /* ffpbytoff stops right after the last group it writes, */
+                /* so move to the start of each chunk of rows             */
+                ntodo = minvalue(nrows - row, 1000000L);
+                ffmbyt(fptr, bstart + row * rowlen, IGNORE_EOF, status);
+                ffpbytoff(fptr, span, (long) ntodo, (long) (rowlen - span),
+                          array + row * span, status);
+            }
+        }
+
+        if (*status > 0)
+            ffpmsg("Error writing bits to column (ffpcxp)");
+
+        return(*status);
+    }
+
+    if (span <= DBUFFSIZE)
+    {
+        tmp = (unsigned char *) cbuff;
+        chunk = DBUFFSIZE / span;
+    }
+    else
+    {
+        tmp = (unsigned char *) malloc(span);
+        if (!tmp)
+        {
+            ffpmsg("Could not allocate memory for bits (ffpcxp)");
+            return(*status = MEMORY_ALLOCATION);
+        }
+        chunk = 1;
+    }
+
+    for (row = 0; row < nrows; row += ntodo)
+    {
+        ntodo = minvalue(chunk, nrows - row);
+
+        /* read the existing bytes, since only some bits may be modified */
+        for (ii = 0; ii < ntodo; ii++)
+        {
+            ffmbyt(fptr, bstart + (row + ii) * rowlen, IGNORE_EOF, status);
+            if (ffgbyt(fptr, span, tmp + ii * span, status) == END_OF_FILE)
+            {
+                /* hit end of file trying to read the bytes, so use 0 */
+                *status = 0;
+                memset(tmp + ii * span, 0, span);
+            }
+        }
+
+        /* merge in the new bits */
+        for (ii = 0; ii < ntodo; ii++)
+        {
+            inptr = array + (row + ii) * outbytes;
+            for (jj = 0; jj < outbytes; jj++)
+            {
+                mask = (jj == outbytes - 1) ? tailmask : 0xFF;
+                value = inptr[jj] & mask;
+
+                tmp[ii * span + jj] = (tmp[ii * span + jj] & ~(mask >> shift)) |
+                                      (value >> shift);
+                if (shift && jj + 1 < span)
+                    tmp[ii * span + jj + 1] =
+                        (tmp[ii * span + jj + 1] & ~(mask << (8 - shift))) |
+                        (unsigned char) (value << (8 - shift));
+            }
+        }
+
+        /* write the modified bytes back */
+        for (ii = 0; ii < ntodo; ii++)
+        {
+            ffmbyt(fptr, bstart + (row + ii) * rowlen, IGNORE_EOF, status);
+            ffpbyt(fptr, span, tmp + ii * span, status);
+        }
+
+        if (*status > 0)
+        {
+            snprintf(message, FLEN_ERRMSG,
+              "Error writing bits in rows %.0f - %.0f (ffpcxp)",
+              (double) (firstrow + row), (double) (firstrow + row + ntodo - 1));
+            ffpmsg(message);
+            break;
+        }
+    }
+
+    if (tmp != (unsigned char *) cbuff)
+        free(tmp);
+
+    return(*status);
+}
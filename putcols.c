@@ -302,3 +302,258 @@ int ffpcns( fitsfile *fptr,  /* I - FITS file pointer                       */
 
     return(*status);
 }
+/*--------------------------------------------------------------------------*/
+int ffpcsp( fitsfile *fptr,  /* I - FITS file pointer                       */
+            int  colnum,     /* I - number of column to write (1 = 1st col) */
+            LONGLONG  firstrow,  /* I - first row to write (1 = 1st row)        */
+            LONGLONG  firstelem, /* I - first vector element to write (1 = 1st) */
+            LONGLONG  nelem,     /* I - number of strings to write              */
+            char  *buffer,   /* I - packed characters of all the strings    */
+            LONGLONG *offsets, /* I - start of each string in buffer, plus  */
+                             /*     the end of the last string             */
+            int  *status)    /* IO - error status                           */
+/*
+  Write an array of string values to a column in the current FITS HDU from
+  a single contiguous character buffer, in the layout returned by ffgcsp.
+  String ii occupies buffer[offsets[ii]] through buffer[offsets[ii+1] - 1]
+  and need not be null terminated; it ends early at an ASCII NUL, if one
+  is present.  Strings that are longer than the column width are truncated.
+*/
+{
+    if (!offsets)
+    {
+        ffpmsg("Null offsets array pointer (ffpcsp)");
+        return(*status = NULL_INPUT_PTR);
+    }
+
+    return(ffpcsbuf(fptr, colnum, firstrow, firstelem, nelem, 0L, buffer,
+           offsets, NULL, status));
+}
+/*--------------------------------------------------------------------------*/
+int ffpcsw( fitsfile *fptr,  /* I - FITS file pointer                       */
+            int  colnum,     /* I - number of column to write (1 = 1st col) */
+            LONGLONG  firstrow,  /* I - first row to write (1 = 1st row)        */
+            LONGLONG  firstelem, /* I - first vector element to write (1 = 1st) */
+            LONGLONG  nelem,     /* I - number of strings to write              */
+            long  width,     /* I - size of each string slot in buffer      */
+            char  *buffer,   /* I - fixed width string slots                */
+            long  *lengths,  /* I - length of each string (or NULL)         */
+            int  *status)    /* IO - error status                           */
+/*
+  Write an array of string values to a column in the current FITS HDU from
+  consecutive slots of 'width' characters in a single buffer, in the layout
+  returned by ffgcsw.  If lengths is NULL, each string fills its slot or
+  ends at the first ASCII NUL.  Strings that are longer than the column
+  width are truncated.
+*/
+{
+    if (width < 1)
+    {
+        ffpmsg("String slot width must be greater than 0 (ffpcsw)");
+        return(*status = COL_TOO_WIDE);
+    }
+
+    return(ffpcsbuf(fptr, colnum, firstrow, firstelem, nelem, width, buffer,
+           NULL, lengths, status));
+}
+/*--------------------------------------------------------------------------*/
+int ffpcsbuf( fitsfile *fptr, /* I - FITS file pointer                      */
+            int  colnum,     /* I - number of column to write (1 = 1st col) */
+            LONGLONG  firstrow,  /* I - first row to write (1 = 1st row)        */
+            LONGLONG  firstelem, /* I - first vector element to write (1 = 1st) */
+            LONGLONG  nelem,     /* I - number of strings to write              */
+            long  width,     /* I - slot width, or 0 for packed strings     */
+            char  *buffer,   /* I - input character buffer                  */
+            LONGLONG *offsets, /* I - string offsets if width = 0           */
+            long  *lengths,  /* I - string lengths if width > 0 (or NULL)   */
+            int  *status)    /* IO - error status                           */
+/*
+  Work routine for ffpcsp and ffpcsw.
+*/
+{
+    int tcode, maxelem, hdutype;
+    long twidth, incre;
+    long ii, ntodo, len;
+    LONGLONG repeat, startpos, elemnum, wrtptr, rowlen, rownum, remain, next, tnull;
+    double scale, zero;
+    char tform[20];
+    char message[FLEN_ERRMSG];
+    char snull[20];   /*  the FITS null value  */
+    char *cptr, *nulptr, *bufptr;
+    tcolumn *colptr;
+
+    double cbuff[DBUFFSIZE / sizeof(double)]; /* align cbuff on word boundary */
+
+    if (*status > 0 || nelem == 0)  /* inherit input status value if > 0 */
+        return(*status);
+
+    if (!buffer)
+    {
+        ffpmsg("Null string buffer pointer (ffpcsbuf)");
+        return(*status = NULL_INPUT_PTR);
+    }
+
+    /* reset position to the correct HDU if necessary */
+    if (fptr->HDUposition != (fptr->Fptr)->curhdu)
+    {
+        ffmahd(fptr, (fptr->HDUposition) + 1, NULL, status);
+    }
+    else if ((fptr->Fptr)->datastart == DATA_UNDEFINED)
+    {
+        if ( ffrdef(fptr, status) > 0)               /* rescan header */
+            return(*status);
+    }
+
+    /*---------------------------------------------------*/
+    /*  Check input and get parameters about the column: */
+    /*---------------------------------------------------*/
+    if (colnum < 1 || colnum > (fptr->Fptr)->tfield)
+    {
+        snprintf(message, FLEN_ERRMSG,"Specified column number is out of range: %d",
+                colnum);
+        ffpmsg(message);
+        return(*status = BAD_COL_NUM);
+    }
+
+    colptr  = (fptr->Fptr)->tableptr;   /* point to first column */
+    colptr += (colnum - 1);     /* offset to correct column structure */
+    tcode = colptr->tdatatype;
+
+    if (tcode == -TSTRING) /* variable length column in a binary table? */
+    {
+      /* write one string per row; ignore value of firstelem */
+      for (next = 0; next < nelem; next++)
+      {
+        if (width)
+        {
+          cptr = buffer + next * width;
+          len = lengths ? minvalue(lengths[next], width) : width;
+        }
+        else
+        {
+          cptr = buffer + offsets[next];
+          len = (long) (offsets[next + 1] - offsets[next]);
+        }
+
+        nulptr = len > 0 ? memchr(cptr, 0, len) : NULL;
+        if (nulptr)
+          len = (long) (nulptr - cptr);
+
+        /* write at least 1 char, even if the input string is empty */
+        if (ffgcprll( fptr, colnum, firstrow + next, 1, maxvalue(1, len), 1,
+          &scale, &zero, tform, &twidth, &tcode, &maxelem, &startpos,
+          &elemnum, &incre, &repeat, &rowlen, &hdutype, &tnull, snull,
+          status) > 0)
+          return(*status);
+
+        ffmbyt(fptr, startpos, IGNORE_EOF, status);
+        if (len > 0)
+          ffpbyt(fptr, len, cptr, status);
+        else
+          ffpbyt(fptr, 1, "", status);
+
+        if (*status > 0)  /* test for error during previous write operation */
+        {
+          ffpmsg("Error writing to variable length string column (ffpcsbuf).");
+          return(*status);
+        }
+      }
+
+      return(*status);
+    }
+    else if (tcode != TSTRING)
+      return(*status = NOT_ASCII_COL);
+
+    if (ffgcprll( fptr, colnum, firstrow, firstelem, nelem, 1, &scale, &zero,
+        tform, &twidth, &tcode, &maxelem, &startpos,  &elemnum, &incre,
+        &repeat, &rowlen, &hdutype, &tnull, snull, status) > 0)
+        return(*status);
+
+    /* ffpbytoff can't handle strings longer than a FITS block */
+    if (twidth > IOBUFLEN) {
+      maxelem = 1;
+      incre = twidth;
+      repeat = 1;
+    }
+
+    /*-------------------------------------------------------*/
+    /*  Now write the strings to the FITS column.            */
+    /*-------------------------------------------------------*/
+
+    next = 0;                 /* next element in array to be written  */
+    rownum = 0;               /* row number, relative to firstrow     */
+    remain = nelem;           /* remaining number of values to write  */
+
+    while (remain)
+    {
+      /* limit the number of pixels to process at one time to the number that
+         will fit in the buffer space or to the number of pixels that remain
+         in the current vector, which ever is smaller.
+      */
+      ntodo = (long) minvalue(remain, maxelem);
+      ntodo = (long) minvalue(ntodo, (repeat - elemnum));
+
+      wrtptr = startpos + (rownum * rowlen) + (elemnum * incre);
+      ffmbyt(fptr, wrtptr, IGNORE_EOF, status);  /* move to write position */
+
+      /* copy the strings into the buffer, padded with blanks to the width */
+      bufptr = (char *) cbuff;
+      for (ii = 0; ii < ntodo; ii++, next++, bufptr += twidth)
+      {
+        if (width)
+        {
+          cptr = buffer + next * width;
+          len = lengths ? minvalue(lengths[next], width) : width;
+        }
+        else
+        {
+          cptr = buffer + offsets[next];
+          len = (long) (offsets[next + 1] - offsets[next]);
+        }
+
+        if (len > twidth)
+          len = twidth;
+        else if (len < 0)
+          len = 0;
+
+        nulptr = memchr(cptr, 0, len);
+        if (nulptr)
+          len = (long) (nulptr - cptr);
+
+        memcpy(bufptr, cptr, len);
+        if (len < twidth)
+          memset(bufptr + len, ' ', twidth - len);
+      }
+
+      /* write the buffer full of strings to the FITS file */
+      if (incre == twidth)
+         ffpbyt(fptr, ntodo * twidth, cbuff, status);
+      else
+         ffpbytoff(fptr, twidth, ntodo, incre - twidth, cbuff, status);
+
+      if (*status > 0)  /* test for error during previous write operation */
+      {
+         snprintf(message,FLEN_ERRMSG,
+          "Error writing elements %.0f thru %.0f of input data array (ffpcsbuf).",
+             (double) (next - ntodo + 1), (double) next);
+         ffpmsg(message);
+         return(*status);
+      }
+
+      /*--------------------------------------------*/
+      /*  increment the counters for the next loop  */
+      /*--------------------------------------------*/
+      remain -= ntodo;
+      if (remain)
+      {
+          elemnum += ntodo;
+          if (elemnum == repeat)  /* completed a row; start on next row */
+          {
+              elemnum = 0;
+              rownum++;
+          }
+       }
+    }  /*  End of main while Loop  */
+
+    return(*status);
+}
@@ -7,6 +7,19 @@
 #include "region.h"
 static int Pt_in_Poly( double x, double y, int nPts, double *Pts );
 
+/*  Three-valued logic for the lookup grid: 0 = false, 1 = true, -1 = unknown  */
+#define RGN_OR(a,b)   ( (a)==1 || (b)==1 ? 1 : (a)==0 && (b)==0 ? 0 : -1 )
+#define RGN_AND(a,b)  ( (a)==0 || (b)==0 ? 0 : (a)==1 && (b)==1 ? 1 : -1 )
+#define RGN_NOT(a)    ( (a)<0 ? -1 : !(a) )
+static int Rgn_Shape_Extent( RgnShape *shape, double *xmin, double *xmax,
+                             double *ymin, double *ymax );
+static int Rgn_Mask_Grid( SAORegion *Rgn );
+static int Rgn_Mask_Fill( SAORegion *Rgn );
+static int Rgn_Cell_Test( RgnShape *shape, double x0, double x1,
+                          double y0, double y1 );
+static int Rgn_Segment_In_Box( double ax, double ay, double bx, double by,
+                               double x0, double x1, double y0, double y1 );
+
 /*---------------------------------------------------------------------------*/
 int fits_read_rgnfile( const char *filename,
             WCSdata    *wcs,
@@ -68,6 +81,7 @@ int fits_read_ascii_region( const char *filename,
    }
    aRgn->nShapes    =    0;
    aRgn->Shapes     = NULL;
+   memset( &aRgn->mask, 0, sizeof(RgnMask) );
    if( wcs && wcs->exists )
       aRgn->wcs = *wcs;
    else
@@ -654,6 +668,18 @@ int fits_in_region( double    X,
    int i, cur_comp;
    int result, comp_result;
 
+   /*  Answer from the lookup grid if the point's cell is not ambiguous  */
+
+   if( Rgn->mask.cells ) {
+      x = ( X - Rgn->mask.xmin ) * Rgn->mask.scale;
+      y = ( Y - Rgn->mask.ymin ) * Rgn->mask.scale;
+      if( x >= 0.0 && y >= 0.0
+          && x < Rgn->mask.nx && y < Rgn->mask.ny ) {
+         i = Rgn->mask.cells[ (long)y * Rgn->mask.nx + (long)x ];
+         if( i < 2 ) return( i );
+      }
+   }
+
    Shapes = Rgn->Shapes;
 
    result = 0;
@@ -1029,11 +1055,378 @@ void fits_free_region( SAORegion *Rgn )
       }
    if( Rgn->Shapes )
       free( Rgn->Shapes );
+   if( Rgn->mask.cells )
+      free( Rgn->mask.cells );
    free( Rgn );
    
    free(freedPolyPtrs);
 }
 
+/*---------------------------------------------------------------------------*/
+void fits_prepare_region( SAORegion *Rgn,
+                          long      nPoints )
+/*  Tell the region that about nPoints more points are about to be tested.   */
+/*  Once testing them exactly would have cost about as much as filling a     */
+/*  one-pixel grid covering the region, the grid is built: each cell wholly  */
+/*  inside or wholly outside the region is marked as such, so that           */
+/*  fits_in_region can answer points falling in it by a single lookup.       */
+/*  Cells crossed by a shape boundary, and points off the grid, are still    */
+/*  tested exactly, so the results never change.                             */
+/*---------------------------------------------------------------------------*/
+{
+   RgnMask *mask = &Rgn->mask;
+
+   if( mask->cells || mask->nTested<0 ) return;
+
+   if( !mask->nx && Rgn_Mask_Grid( Rgn ) ) {
+      mask->nTested = -1;
+      return;
+   }
+
+   mask->nTested += nPoints;
+   if( mask->nTested >= mask->nNeeded && Rgn_Mask_Fill( Rgn ) )
+      mask->nTested = -1;
+}
+
+/*---------------------------------------------------------------------------*/
+static int Rgn_Shape_Extent( RgnShape *shape,
+                             double *xmin, double *xmax,
+                             double *ymin, double *ymax )
+/*  Internal routine returning a box which certainly contains every point    */
+/*  of the shape (the bounding boxes set by fits_setup_shape are too small   */
+/*  for some shapes).  Returns 0 if the shape is unbounded.                  */
+/*---------------------------------------------------------------------------*/
+{
+   double *p = shape->param.gen.p;
+   double X = p[0], Y = p[1], R;
+   int i;
+
+   switch( shape->shape ) {
+   case circle_rgn:        R = p[2];                                  break;
+   case annulus_rgn:       R = p[3];                                  break;
+   case ellipse_rgn:       R = maxvalue( fabs(p[2]), fabs(p[3]) );    break;
+   case elliptannulus_rgn: R = maxvalue( fabs(p[4]), fabs(p[5]) );    break;
+   case box_rgn:           R = 0.5 * sqrt( p[2]*p[2] + p[3]*p[3] );   break;
+   case boxannulus_rgn:    R = 0.5 * sqrt( p[4]*p[4] + p[5]*p[5] );   break;
+   case diamond_rgn:       R = maxvalue( fabs(p[2]), fabs(p[3]) )/2;  break;
+   case panda_rgn:         R = p[6];                                  break;
+   case epanda_rgn:        R = maxvalue( fabs(p[7]), fabs(p[8]) );    break;
+   case bpanda_rgn:        R = 0.5 * sqrt( p[7]*p[7] + p[8]*p[8] );   break;
+   case point_rgn:         R = 1.0;                                   break;
+   case line_rgn:          R = shape->param.gen.a + 1.0;              break;
+   case rectangle_rgn:
+      X = p[5];
+      Y = p[6];
+      R = sqrt( shape->param.gen.a * shape->param.gen.a
+                + shape->param.gen.b * shape->param.gen.b );
+      break;
+   case poly_rgn:
+      p = shape->param.poly.Pts;
+      *xmin = *xmax = p[0];
+      *ymin = *ymax = p[1];
+      for( i=2; i<shape->param.poly.nPts; i+=2 ) {
+         if( p[i]   < *xmin ) *xmin = p[i];
+         if( p[i]   > *xmax ) *xmax = p[i];
+         if( p[i+1] < *ymin ) *ymin = p[i+1];
+         if( p[i+1] > *ymax ) *ymax = p[i+1];
+      }
+      return( 1 );
+   default:  /*  sector_rgn  */
+      return( 0 );
+   }
+
+   R = fabs( R );
+   *xmin = X - R;
+   *xmax = X + R;
+   *ymin = Y - R;
+   *ymax = Y + R;
+   return( R==R && X==X && Y==Y );   /*  Reject NaNs  */
+}
+
+/*---------------------------------------------------------------------------*/
+static int Rgn_Mask_Grid( SAORegion *Rgn )
+/*  Internal routine choosing the lookup grid: it covers every bounded       */
+/*  include shape, its cells are pixels centred on integer coordinates, and  */
+/*  the cell size is doubled until the grid has at most 4M cells.  Returns   */
+/*  nonzero if there is nothing to grid, or the region is too simple to      */
+/*  gain from one.                                                           */
+/*---------------------------------------------------------------------------*/
+{
+   RgnMask *mask = &Rgn->mask;
+   double xmin=0., xmax=0., ymin=0., ymax=0., x0, x1, y0, y1, size;
+   int i, any = 0;
+   long cost = 0;
+
+   /*  A few simple shapes are tested faster than the grid is read  */
+
+   for( i=0; i<Rgn->nShapes; i++ )
+      cost += ( Rgn->Shapes[i].shape==poly_rgn ?
+                Rgn->Shapes[i].param.poly.nPts/2 : 1 );
+   if( cost < 5 ) return( 1 );
+
+   for( i=0; i<Rgn->nShapes; i++ ) {
+      if( !Rgn->Shapes[i].sign ) continue;
+      if( !Rgn_Shape_Extent( Rgn->Shapes+i, &x0, &x1, &y0, &y1 ) ) continue;
+      if( !any || x0 < xmin ) xmin = x0;
+      if( !any || x1 > xmax ) xmax = x1;
+      if( !any || y0 < ymin ) ymin = y0;
+      if( !any || y1 > ymax ) ymax = y1;
+      any = 1;
+   }
+   if( !any || xmax-xmin > 1e9 || ymax-ymin > 1e9 ) return( 1 );
+
+   size = 1.0;
+   do {
+      mask->xmin = size * floor( (xmin - 0.5) / size ) + 0.5;
+      mask->ymin = size * floor( (ymin - 0.5) / size ) + 0.5;
+      mask->nx   = (long)ceil( (xmax - mask->xmin) / size ) + 1;
+      mask->ny   = (long)ceil( (ymax - mask->ymin) / size ) + 1;
+      size += size;
+   } while( (double)mask->nx * (double)mask->ny > 4194304.0 );
+   mask->scale = 2.0 / size;
+
+   /*  Filling a cell costs about as much as testing a point against one  */
+   /*  shape, so build once the exact tests would have cost as much       */
+
+   mask->nNeeded = mask->nx * mask->ny / cost;
+   return( 0 );
+}
+
+/*---------------------------------------------------------------------------*/
+static int Rgn_Cell_Test( RgnShape *shape,
+                          double x0, double x1,
+                          double y0, double y1 )
+/*  Internal routine: 1 if every point of the box [x0,x1]x[y0,y1] is inside  */
+/*  the (include) shape, 0 if none is, -1 if it cannot tell cheaply.         */
+/*---------------------------------------------------------------------------*/
+{
+   double dx, dy, dmin, dmax, cx, cy, u[4], v[4], *p;
+   int i, n, nIn, nOut[4];
+
+   p = shape->param.gen.p;
+   switch( shape->shape ) {
+
+   case circle_rgn:
+   case annulus_rgn:
+      /*  Nearest and farthest squared distances from the centre  */
+      dx = ( p[0] < x0 ? x0-p[0] : p[0] > x1 ? p[0]-x1 : 0.0 );
+      dy = ( p[1] < y0 ? y0-p[1] : p[1] > y1 ? p[1]-y1 : 0.0 );
+      dmin = dx*dx + dy*dy;
+      dx = maxvalue( fabs(p[0]-x0), fabs(p[0]-x1) );
+      dy = maxvalue( fabs(p[1]-y0), fabs(p[1]-y1) );
+      dmax = dx*dx + dy*dy;
+      if( shape->shape==circle_rgn ) {
+         if( dmax < shape->param.gen.a ) return( 1 );
+         if( dmin > shape->param.gen.a ) return( 0 );
+      } else {
+         if( dmin > shape->param.gen.a && dmax < shape->param.gen.b )
+            return( 1 );
+         if( dmax < shape->param.gen.a || dmin > shape->param.gen.b )
+            return( 0 );
+      }
+      return( -1 );
+
+   case box_rgn:
+   case rectangle_rgn:
+   case diamond_rgn:
+   case ellipse_rgn:
+      /*  Corners of the box in the shape's own frame, scaled so that the  */
+      /*  shape becomes |u|,|v|<=1, |u|+|v|<=1 or u*u+v*v<=1               */
+      if( shape->shape==rectangle_rgn ) {
+         cx = p[5];  dx = shape->param.gen.a;
+         cy = p[6];  dy = shape->param.gen.b;
+      } else if( shape->shape==ellipse_rgn ) {
+         cx = p[0];  dx = p[2];
+         cy = p[1];  dy = p[3];
+      } else {
+         cx = p[0];  dx = 0.5 * p[2];
+         cy = p[1];  dy = 0.5 * p[3];
+      }
+      if( dx==0.0 || dy==0.0 ) return( -1 );
+      for( i=0; i<4; i++ ) {
+         double xp = ( i&1 ? x1 : x0 ) - cx;
+         double yp = ( i&2 ? y1 : y0 ) - cy;
+         u[i] = (  xp * shape->param.gen.cosT + yp * shape->param.gen.sinT ) / dx;
+         v[i] = ( -xp * shape->param.gen.sinT + yp * shape->param.gen.cosT ) / dy;
+      }
+      if( shape->shape!=ellipse_rgn && ( dx<0.0 || dy<0.0 ) ) return( -1 );
+
+      nIn = 0;
+      nOut[0] = nOut[1] = nOut[2] = nOut[3] = 0;
+      for( i=0; i<4; i++ ) {
+         switch( shape->shape ) {
+         case diamond_rgn:
+            nIn += ( fabs(u[i]) + fabs(v[i]) <= 1.0 );
+            nOut[0] += (  u[i] + v[i] > 1.0 );
+            nOut[1] += (  u[i] - v[i] > 1.0 );
+            nOut[2] += ( -u[i] + v[i] > 1.0 );
+            nOut[3] += ( -u[i] - v[i] > 1.0 );
+            break;
+         case ellipse_rgn:
+            nIn += ( u[i]*u[i] + v[i]*v[i] <= 1.0 );
+            break;
+         default:
+            nIn += ( fabs(u[i]) <= 1.0 && fabs(v[i]) <= 1.0 );
+            nOut[0] += ( u[i] >  1.0 );
+            nOut[1] += ( u[i] < -1.0 );
+            nOut[2] += ( v[i] >  1.0 );
+            nOut[3] += ( v[i] < -1.0 );
+            break;
+         }
+      }
+      if( nIn==4 ) return( 1 );   /*  Shape is convex  */
+
+      if( shape->shape==ellipse_rgn ) {
+         /*  The box maps into the bounding box of its corners; does that  */
+         /*  miss the unit circle?                                         */
+         dmin = minvalue( minvalue(u[0],u[1]), minvalue(u[2],u[3]) );
+         dmax = maxvalue( maxvalue(u[0],u[1]), maxvalue(u[2],u[3]) );
+         dx = ( dmin > 0.0 ? dmin : dmax < 0.0 ? -dmax : 0.0 );
+         dmin = minvalue( minvalue(v[0],v[1]), minvalue(v[2],v[3]) );
+         dmax = maxvalue( maxvalue(v[0],v[1]), maxvalue(v[2],v[3]) );
+         dy = ( dmin > 0.0 ? dmin : dmax < 0.0 ? -dmax : 0.0 );
+         if( dx*dx + dy*dy > 1.0 ) return( 0 );
+      } else {
+         /*  All corners beyond one edge of the shape  */
+         for( i=0; i<4; i++ )
+            if( nOut[i]==4 ) return( 0 );
+      }
+      return( -1 );
+
+   case poly_rgn:
+      /*  If no edge touches the box, all of it lies on one side  */
+      p = shape->param.poly.Pts;
+      n = shape->param.poly.nPts;
+      for( i=0; i<n; i+=2 )
+         if( Rgn_Segment_In_Box( p[(i+n-2)%n], p[(i+n-1)%n], p[i], p[i+1],
+                                 x0, x1, y0, y1 ) )
+            return( -1 );
+      return( Pt_in_Poly( 0.5*(x0+x1), 0.5*(y0+y1), n, p ) != 0 );
+
+   default:
+      return( -1 );
+   }
+}
+
+/*---------------------------------------------------------------------------*/
+static int Rgn_Segment_In_Box( double ax, double ay, double bx, double by,
+                               double x0, double x1, double y0, double y1 )
+/*  Internal routine: does the segment from a to b meet the box?  (Liang-    */
+/*  Barsky clipping.)                                                        */
+/*---------------------------------------------------------------------------*/
+{
+   double t0 = 0.0, t1 = 1.0, d[2], q[4], dd, t;
+   int i;
+
+   d[0] = bx - ax;
+   d[1] = by - ay;
+   q[0] = ax - x0;  q[1] = x1 - ax;
+   q[2] = ay - y0;  q[3] = y1 - ay;
+
+   for( i=0; i<4; i++ ) {
+      dd = ( i&1 ? d[i/2] : -d[i/2] );
+      if( dd==0.0 ) {
+         if( q[i] < 0.0 ) return( 0 );
+      } else {
+         t = q[i] / dd;
+         if( dd < 0.0 ) {
+            if( t > t1 ) return( 0 );
+            if( t > t0 ) t0 = t;
+         } else {
+            if( t < t0 ) return( 0 );
+            if( t < t1 ) t1 = t;
+         }
+      }
+   }
+   return( 1 );
+}
+
+/*---------------------------------------------------------------------------*/
+static int Rgn_Mask_Fill( SAORegion *Rgn )
+/*  Internal routine classifying every cell of the lookup grid.  Shapes are  */
+/*  combined exactly as in fits_in_region, but with a third "unknown" value: */
+/*  a cell is marked in or out only when that follows from what is known of  */
+/*  each shape over the whole cell (slightly enlarged against rounding).     */
+/*  A shape can only change the cells within its extent, so each one is     */
+/*  applied to just those.  Returns nonzero if memory runs out.              */
+/*---------------------------------------------------------------------------*/
+{
+   RgnMask *mask = &Rgn->mask;
+   RgnShape *shape;
+   signed char *result, *comp;
+   double size, margin, x0, x1, y0, y1;
+   long ix, iy, ix0, ix1, iy0, iy1, nCells, cell;
+   int i, test;
+
+   nCells = mask->nx * mask->ny;
+   mask->cells = (unsigned char *)malloc( nCells );
+   result      = (signed char *)malloc( 2*nCells );
+   if( !mask->cells || !result ) {
+      if( mask->cells ) free( mask->cells );
+      if( result ) free( result );
+      mask->cells = NULL;
+      return( 1 );
+   }
+   comp = result + nCells;
+
+   size   = 1.0 / mask->scale;
+   margin = 1e-6 * ( 1.0 + size + fabs(mask->xmin) + fabs(mask->ymin)
+                     + size * ( mask->nx + mask->ny ) );
+
+   /*  0 = false, 1 = true, -1 = unknown  */
+
+   memset( result, 0, nCells );
+   shape = Rgn->Shapes;
+   for( i=0; i<Rgn->nShapes; i++, shape++ ) {
+
+      if( i==0 || shape->comp != shape[-1].comp ) {
+         for( cell=0; cell<nCells; cell++ ) {
+            if( i ) result[cell] = RGN_OR( result[cell], comp[cell] );
+            comp[cell] = !shape->sign;
+         }
+      }
+
+      ix0 = iy0 = 0;
+      ix1 = mask->nx - 1;
+      iy1 = mask->ny - 1;
+      if( Rgn_Shape_Extent( shape, &x0, &x1, &y0, &y1 ) ) {
+         x0 = floor( (x0 - margin - mask->xmin) * mask->scale );
+         x1 = floor( (x1 + margin - mask->xmin) * mask->scale );
+         y0 = floor( (y0 - margin - mask->ymin) * mask->scale );
+         y1 = floor( (y1 + margin - mask->ymin) * mask->scale );
+         if( x1 < 0.0 || y1 < 0.0 || x0 > ix1 || y0 > iy1 ) continue;
+         if( x0 > 0.0 ) ix0 = (long)x0;
+         if( y0 > 0.0 ) iy0 = (long)y0;
+         if( x1 < ix1 ) ix1 = (long)x1;
+         if( y1 < iy1 ) iy1 = (long)y1;
+      }
+
+      for( iy=iy0; iy<=iy1; iy++ ) {
+         y0 = mask->ymin + iy * size;
+         for( ix=ix0; ix<=ix1; ix++ ) {
+            cell = iy*mask->nx + ix;
+            /*  Include shapes cannot change TRUE, nor exclude shapes FALSE  */
+            if( comp[cell] == ( shape->sign ? 1 : 0 ) ) continue;
+
+            x0 = mask->xmin + ix * size;
+            test = Rgn_Cell_Test( shape, x0-margin, x0+size+margin,
+                                  y0-margin, y0+size+margin );
+            if( shape->sign )
+               comp[cell] = RGN_OR( comp[cell], test );
+            else
+               comp[cell] = RGN_AND( comp[cell], RGN_NOT(test) );
+         }
+      }
+   }
+
+   for( cell=0; cell<nCells; cell++ ) {
+      test = ( Rgn->nShapes ? RGN_OR( result[cell], comp[cell] ) : 0 );
+      mask->cells[cell] = ( test<0 ? 2 : test );
+   }
+   free( result );
+   return( 0 );
+}
+
 /*---------------------------------------------------------------------------*/
 static int Pt_in_Poly( double x,
                        double y,
@@ -1481,6 +1874,7 @@ int fits_read_fits_region ( fitsfile *fptr,
   }
   aRgn->nShapes    =    0;
   aRgn->Shapes     = NULL;
+  memset( &aRgn->mask, 0, sizeof(RgnMask) );
   if( wcs && wcs->exists )
     aRgn->wcs = *wcs;
   else
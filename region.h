@@ -64,16 +64,27 @@ typedef struct {
 
 } RgnShape;
 
+typedef struct {           /*  Lookup grid, see fits_prepare_region   */
+   double xmin, ymin;      /*  Lower left corner of the grid (pixels)  */
+   double scale;           /*  Grid cells per pixel                    */
+   long   nx, ny;          /*  Size of the grid                        */
+   long   nTested;         /*  Points tested so far, -1 = never build  */
+   long   nNeeded;         /*  Points to test before building the grid */
+   unsigned char *cells;   /*  0 = out, 1 = in, 2 = test exactly       */
+} RgnMask;
+
 typedef struct {
    int       nShapes;
    RgnShape  *Shapes;
    WCSdata   wcs;
+   RgnMask   mask;
 } SAORegion;
 
 /*  SAO region file routines */
 int  fits_read_rgnfile( const char *filename, WCSdata *wcs, SAORegion **Rgn, int *status );
 int  fits_in_region( double X, double Y, SAORegion *Rgn );
 void fits_free_region( SAORegion *Rgn );
+void fits_prepare_region( SAORegion *Rgn, long nPoints );
 void fits_set_region_components ( SAORegion *Rgn );
 void fits_setup_shape ( RgnShape *shape);
 int fits_read_fits_region ( fitsfile *fptr, WCSdata * wcs, SAORegion **Rgn, int *status);
@@ -16,24 +16,31 @@
      2. keep only uniform, gaussian and poisson deviates
      3. state variables are module static instead of class variables
      4. provide an srand() equivalent to initialize the state
+     5. provide _r variants which keep all of their state in a
+        caller-supplied simplerng_state, so that independent streams
+        can be used concurrently from different threads
 */
 #include <math.h>
 #include <stdlib.h>
+#include "simplerng.h"
 
 #define PI 3.1415926535897932384626433832795
 
 /* Use the standard system rand() library routine if it provides
    enough bits of information, since it probably has better randomness
-   than the toy algorithm in this module. */
+   than the toy algorithm in this module.  The _r routines always use
+   the algorithm in this module, since rand() has hidden global state. */
 #if defined(RAND_MAX) && RAND_MAX > 1000000000
 #define USE_SYSTEM_RAND
 #endif
 
-int simplerng_poisson_small(double lambda);
-int simplerng_poisson_large(double lambda);
 double simplerng_getuniform_pr(unsigned int *u, unsigned int *v);
 unsigned int simplerng_getuint_pr(unsigned int *u, unsigned int *v);
 double simplerng_logfactorial(int n);
+static double simplerng_uniform_st(simplerng_state *st);
+static double simplerng_norm_st(simplerng_state *st, simplerng_state *cache);
+static int simplerng_poisson_st(simplerng_state *st, simplerng_state *cache,
+                                double lambda);
 
 /*
   These values are not magical, just the default values Marsaglia used.
@@ -41,6 +48,10 @@ double simplerng_logfactorial(int n);
 */
 static unsigned int m_u = 521288629, m_v = 362436069;
 
+/* Cached values used by the module static getnorm/getpoisson routines */
+static simplerng_state m_cache = { 521288629, 362436069, 0, 0.0,
+                                   -999999., 0.0, 0.0, 0.0 };
+
 /* Set u and v state variables */
 void simplerng_setstate(unsigned int u, unsigned int v)
 {
@@ -65,6 +76,29 @@ void simplerng_srand(unsigned int seed)
 #endif
 }
 
+/* Seed an independent stream.  The seed is scrambled first so that
+   nearby seeds (consecutive integers, successive clock readings) give
+   unrelated streams, and the MWC state words are kept away from the
+   degenerate values 0 and 0xffffffff */
+void simplerng_srand_r(simplerng_state *st, unsigned int seed)
+{
+  unsigned int h = seed;
+
+  h = (h ^ (h >> 16)) * 0x45d9f3b;
+  h = (h ^ (h >> 16)) * 0x45d9f3b;
+  h = h ^ (h >> 16);
+
+  st->u = (h ^ 521288629) & 0x7fffffff;
+  st->v = (h * 69069 + 362436069) & 0x7fffffff;
+  if (st->u == 0) st->u = 521288629;
+  if (st->v == 0) st->v = 362436069;
+
+  st->saved  = 0;
+  st->y      = 0.0;
+  st->lambda = -999999.;
+  st->alpha  = st->beta = st->k = 0.0;
+}
+
 /* Private routine to get uniform deviate */
 double simplerng_getuniform_pr(unsigned int *u, unsigned int *v)
 {
@@ -93,6 +127,19 @@ double simplerng_getuniform(void)
 #endif
 }
 
+/* Get uniform deviate [0,1] from stream st */
+double simplerng_getuniform_r(simplerng_state *st)
+{
+  return simplerng_getuniform_pr(&st->u, &st->v);
+}
+
+/* Uniform deviate from stream st, or from the module stream if st is NULL */
+static double simplerng_uniform_st(simplerng_state *st)
+{
+  return (st ? simplerng_getuniform_pr(&st->u, &st->v)
+	     : simplerng_getuniform());
+}
+
 /* Get unsigned integer [0, UINT_MAX] */
 unsigned int simplerng_getuint()
 {
@@ -103,29 +150,38 @@ unsigned int simplerng_getuint()
     
 /* Get normal (Gaussian) random sample with mean=0, stddev=1 */
 double simplerng_getnorm()
+{
+  return simplerng_norm_st(NULL, &m_cache);
+}
+
+/* Get normal (Gaussian) random sample from stream st */
+double simplerng_getnorm_r(simplerng_state *st)
+{
+  return simplerng_norm_st(st, st);
+}
+
+static double simplerng_norm_st(simplerng_state *st, simplerng_state *cache)
 {
   double u1, u2, r, theta;
-  static int saved = 0;
-  static double y;
 
   /* Since you get two deviates for "free" with each calculation, save
      one of them for later */
 
-  if (saved == 0) {
+  if (cache->saved == 0) {
     /* Use Box-Muller algorithm */
-    u1 = simplerng_getuniform();
-    u2 = simplerng_getuniform();
+    u1 = simplerng_uniform_st(st);
+    u2 = simplerng_uniform_st(st);
     r = sqrt( -2.0*log(u1) );
     theta = 2.0*PI*u2;
     /* save second value for next call */
-    y = r*cos(theta);
-    saved = 1;
+    cache->y = r*cos(theta);
+    cache->saved = 1;
     return r*sin(theta);
 
   } else {
     /* We already saved a value from the last call so use it */
-    saved = 0;
-    return y;
+    cache->saved = 0;
+    return cache->y;
   }
 }
 
@@ -137,55 +193,58 @@ double simplerng_getnorm()
 */
 int simplerng_getpoisson(double lambda)
 {
-  if (lambda < 0) lambda = 0;
-  return ((lambda < 15.0) 
-	  ? simplerng_poisson_small(lambda) 
-	  : simplerng_poisson_large(lambda));
+  return simplerng_poisson_st(NULL, &m_cache, lambda);
 }
 
-int simplerng_poisson_small(double lambda)
+/* Poisson deviate from stream st */
+int simplerng_getpoisson_r(simplerng_state *st, double lambda)
 {
-  /* Algorithm due to Donald Knuth, 1969. */
-  double p = 1.0, L = exp(-lambda);
-  int k = 0;
-  do {
-    k++;
-    p *= simplerng_getuniform();
-  }
-  while (p > L);
-  return k - 1;
+  return simplerng_poisson_st(st, st, lambda);
 }
 
-int simplerng_poisson_large(double lambda)
+static int simplerng_poisson_st(simplerng_state *st, simplerng_state *cache,
+                                double lambda)
 {
+  if (lambda < 0) lambda = 0;
+
+  if (lambda < 15.0) {
+    /* Algorithm due to Donald Knuth, 1969. */
+    double p = 1.0, L = exp(-lambda);
+    int k = 0;
+    do {
+      k++;
+      p *= simplerng_uniform_st(st);
+    }
+    while (p > L);
+    return k - 1;
+  }
+
   /* "Rejection method PA" from "The Computer Generation of Poisson Random Variables" by A. C. Atkinson
      Journal of the Royal Statistical Society Series C (Applied Statistics) Vol. 28, No. 1. (1979)
      The article is on pages 29-35. The algorithm given here is on page 32. */
-  static double beta, alpha, k;
-  static double old_lambda = -999999.;
 
-  if (lambda != old_lambda) {
+  if (lambda != cache->lambda) {
     double c = 0.767 - 3.36/lambda;
-    beta = PI/sqrt(3.0*lambda);
-    alpha = beta*lambda;
-    k = log(c) - lambda - log(beta);
-    old_lambda = lambda;
+    cache->beta = PI/sqrt(3.0*lambda);
+    cache->alpha = cache->beta*lambda;
+    cache->k = log(c) - lambda - log(cache->beta);
+    cache->lambda = lambda;
   }
 
   for(;;) { /* forever */
     double u, x, v, y, temp, lhs, rhs;
     int n;
 
-    u = simplerng_getuniform();
-    x = (alpha - log((1.0 - u)/u))/beta;
+    u = simplerng_uniform_st(st);
+    x = (cache->alpha - log((1.0 - u)/u))/cache->beta;
     n = (int) floor(x + 0.5);
     if (n < 0) continue;
 
-    v = simplerng_getuniform();
-    y = alpha - beta*x;
+    v = simplerng_uniform_st(st);
+    y = cache->alpha - cache->beta*x;
     temp = 1.0 + exp(y);
     lhs = y + log(v/(temp*temp));
-    rhs = k + n*log(lambda) - simplerng_logfactorial(n);
+    rhs = cache->k + n*log(lambda) - simplerng_logfactorial(n);
     if (lhs <= rhs) return n;
   }
 
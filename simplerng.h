@@ -16,7 +16,20 @@
      2. keep only uniform, gaussian and poisson deviates
      3. state variables are module static instead of class variables
      4. provide an srand() equivalent to initialize the state
+     5. provide _r variants which keep all of their state in a
+        caller-supplied simplerng_state
 */
+#ifndef _SIMPLERNG_H
+#define _SIMPLERNG_H
+
+/* State of one independent random number stream */
+typedef struct {
+  unsigned int u, v;           /* multiply-with-carry state words        */
+  int    saved;                /* getnorm: a second deviate is in y      */
+  double y;
+  double lambda;               /* getpoisson: constants for this lambda  */
+  double alpha, beta, k;
+} simplerng_state;
 
 extern void simplerng_setstate(unsigned int u, unsigned int v);
 extern void simplerng_getstate(unsigned int *u, unsigned int *v);
@@ -25,3 +38,10 @@ extern double simplerng_getuniform(void);
 extern double simplerng_getnorm(void);
 extern int simplerng_getpoisson(double lambda);
 extern double simplerng_logfactorial(int n);
+
+extern void simplerng_srand_r(simplerng_state *st, unsigned int seed);
+extern double simplerng_getuniform_r(simplerng_state *st);
+extern double simplerng_getnorm_r(simplerng_state *st);
+extern int simplerng_getpoisson_r(simplerng_state *st, double lambda);
+
+#endif
@@ -84,6 +84,26 @@ int main()
     short imgarray[30][19], imgarray2[20][10];
     long fpixels[2], lpixels[2], inc[2];
 
+    char *xttype[2] = {"X", "L"}, *xtform[2] = {"1J", "1L"};
+    long  xvalues[5] = {1, -99, 3, -2, -99};
+    char  lvalues[5] = {1, 0, 2, 1, 0}, lnul = 2, loutarray[5];
+    char *dblexpr[3] = {"(X+1)*(X+1) + sqrt(abs(X+1))", "X**2", "X*X"};
+    char *logexpr[4] = {"X > 0 && L", "L && X > 0", "X > 0 || L", "L || X > 0"};
+    char *bttype[2] = {"I", "B"}, *btform[2] = {"1J", "16X"};
+    char  bvalues[16], bitoutarray[20];
+    char *bitexpr[4] = {"I > 6 && B[3] == b1", "B[3] == b1 && I > 6",
+                        "I > 2 || B[1] == b1", "B[1] == b1 || I > 2"};
+    char *pttype[2] = {"P", "J"}, *ptform[2] = {"8X", "1J"};
+    unsigned char *pbits;
+    long *pvalues, npbits, npvals, atnull;
+    char *attype[4] = {"U", "V", "B", "S"}, *atform[4] = {"1U", "1V", "1B", "1S"};
+    double avalues[4][6] = {{0, 7, -999, 0, 65535, 2},
+                            {0, -999, 4294967295., 0, 3, 4},
+                            {255, 0, -999, 255, 1, 2},
+                            {-999, 127, -128, 127, 0, 5}};
+    struct ArrowSchema aschema;
+    struct ArrowArray aarray;
+
     status = 0;
     strcpy(tblname, "Test-ASCII");
 
@@ -2544,6 +2564,150 @@ int main()
     ffdkey(fptr, "CHECKSUM", &status);
     ffdkey(fptr, "DATASUM",  &status);
 
+    /*
+      ####################################################
+      #  test expressions with repeated terms and nulls  #
+      ####################################################
+    */
+    printf("\nEvaluate expressions with repeated terms and null values:\n");
+    ffinit(&tmpfptr, "mem://", &status);
+    ffcrtb(tmpfptr, BINARY_TBL, 5, 2, xttype, xtform, NULL, "EXPR", &status);
+    ffpkyj(tmpfptr, "TNULL1", -99, "undefined value", &status);
+    ffrdef(tmpfptr, &status);
+    ffpcnj(tmpfptr, 1, 1, 1, 5, xvalues, -99, &status);
+    ffpcnl(tmpfptr, 2, 1, 1, 5, lvalues, 2, &status);
+
+    dnul = -999.;
+    for (jj = 0; jj < 3; jj++)
+    {
+      ffcrow(tmpfptr, TDOUBLE, dblexpr[jj], 1, 5, &dnul, doutarray, &anynull,
+             &status);
+      for (ii = 0; ii < 5; ii++)
+        printf(" %7.3f", doutarray[ii]);
+      printf("  %d  %s\n", anynull, dblexpr[jj]);
+    }
+    for (jj = 0; jj < 4; jj++)
+    {
+      ffcrow(tmpfptr, TLOGICAL, logexpr[jj], 1, 5, &lnul, loutarray, &anynull,
+             &status);
+      for (ii = 0; ii < 5; ii++)
+        printf(" %2d", loutarray[ii]);
+      printf("  %d  %s\n", anynull, logexpr[jj]);
+    }
+    ffclos(tmpfptr, &status);
+    printf("ffcrow status = %d\n", status);
+
+    /*
+      a selective first operand of && and || leaves the second one to be
+      evaluated on just a few rows; check elements of a bit column there
+    */
+    printf("\nEvaluate bit column elements in && and || expressions:\n");
+    ffinit(&tmpfptr, "mem://", &status);
+    ffcrtb(tmpfptr, BINARY_TBL, 20, 2, bttype, btform, NULL, "BITS", &status);
+    ffpkyj(tmpfptr, "TNULL1", -99, "undefined value", &status);
+    ffrdef(tmpfptr, &status);
+    for (ii = 0; ii < 20; ii++)
+    {
+      /* I runs 0 to 9, with every 7th row null */
+      jj = (ii % 7 == 6 ? -99 : ii % 10);
+      ffpclj(tmpfptr, 1, ii + 1, 1, 1, &jj, &status);
+      for (jj = 0; jj < 16; jj++)
+        bvalues[jj] = ((ii * 37 + jj * 11) % 5) < 2;
+      ffpclx(tmpfptr, 2, ii + 1, 1, 16, bvalues, &status);
+    }
+    for (jj = 0; jj < 4; jj++)
+    {
+      ffcrow(tmpfptr, TLOGICAL, bitexpr[jj], 1, 20, &lnul, bitoutarray,
+             &anynull, &status);
+      for (ii = 0; ii < 20; ii++)
+        printf("%d", bitoutarray[ii]);
+      printf("  %d  %s\n", anynull, bitexpr[jj]);
+    }
+    ffclos(tmpfptr, &status);
+    printf("ffcrow status = %d\n", status);
+
+    /*
+      write packed bits to more rows than are done in one chunk, and check
+      that neither they nor the following column are out of place
+    */
+    printf("\nWrite and read packed bits in 1000005 rows:\n");
+    pbits = (unsigned char *) malloc(1000005);
+    pvalues = (long *) malloc(1000005 * sizeof(long));
+    if (!pbits || !pvalues)
+    {
+      printf("Could not allocate memory for packed bits\n");
+      goto errstatus;
+    }
+    ffinit(&tmpfptr, "mem://", &status);
+    ffcrtb(tmpfptr, BINARY_TBL, 1000005, 2, pttype, ptform, NULL, "PACKED",
+           &status);
+    for (ii = 0; ii < 1000005; ii++)
+    {
+      pbits[ii] = (unsigned char) (ii * 7);
+      pvalues[ii] = ii + 1;
+    }
+    ffpclj(tmpfptr, 2, 1, 1, 1000005, pvalues, &status);
+    ffpcxp(tmpfptr, 1, 1, 1000005, 1, 8, pbits, &status);
+
+    memset(pbits, 0, 1000005);
+    memset(pvalues, 0, 1000005 * sizeof(long));
+    ffgcxp(tmpfptr, 1, 1, 1000005, 1, 8, pbits, &status);
+    ffgcvj(tmpfptr, 2, 1, 1, 1000005, 0, pvalues, &anynull, &status);
+    npbits = npvals = 0;
+    for (ii = 0; ii < 1000005; ii++)
+    {
+      if (pbits[ii] != (unsigned char) (ii * 7))
+        npbits++;
+      if (pvalues[ii] != ii + 1)
+        npvals++;
+    }
+    ffclos(tmpfptr, &status);
+    free(pbits);
+    free(pvalues);
+    printf("%ld bit rows and %ld J values wrong\n", npbits, npvals);
+    printf("ffpcxp status = %d\n", status);
+
+    /*
+      copy unsigned and byte columns with null values through Arrow; the
+      new TNULLn values must not be mistaken for any of the valid values
+    */
+    printf("\nCopy columns with null values through Arrow:\n");
+    ffinit(&tmpfptr, "mem://", &status);
+    ffcrtb(tmpfptr, BINARY_TBL, 6, 4, attype, atform, NULL, "NULLS", &status);
+    for (ii = 0; ii < 4; ii++)
+    {
+      ffkeyn("TNULL", ii + 1, keyword, &status);
+      ffpkyj(tmpfptr, keyword, ii < 2 ? 1 : 9, "undefined value", &status);
+    }
+    ffrdef(tmpfptr, &status);
+    for (ii = 0; ii < 4; ii++)
+      ffpcnd(tmpfptr, ii + 1, 1, 1, 6, avalues[ii], -999., &status);
+
+    ffgarw(tmpfptr, 0, NULL, 1, 6, &aschema, &aarray, &status);
+    ffparw(tmpfptr, "NULLS2", &aschema, &aarray, &status);
+    if (aarray.release)
+      aarray.release(&aarray);
+    if (aschema.release)
+      aschema.release(&aschema);
+
+    for (ii = 0; ii < 4 && status <= 0; ii++)
+    {
+      ffgcfd(tmpfptr, ii + 1, 1, 1, 6, doutarray, larray, &anynull, &status);
+      ffkeyn("TNULL", ii + 1, keyword, &status);
+      ffgkyj(tmpfptr, keyword, &atnull, NULL, &status);
+      printf(" %s:", attype[ii]);
+      for (jj = 0; jj < 6; jj++)
+      {
+        if (larray[jj])
+          printf("       null");
+        else
+          printf(" %10.0f", doutarray[jj]);
+      }
+      printf("  TNULL%ld = %ld\n", ii + 1, atnull);
+    }
+    ffclos(tmpfptr, &status);
+    printf("ffparw status = %d\n", status);
+
     /*
       ############################
       #  close file and quit     #
@@ -0,0 +1,252 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "fitsio.h"
+
+/*
+  Stress test for a thread-safe (USE_PTHREADS) build of CFITSIO.
+
+  Several threads each build their own in-memory table and call
+  fits_select_rows on it over and over, all at the same time: first
+  with a plain filter, which must select exactly the expected rows, and
+  then with a filter using random().  Each parsed expression draws from
+  its own random number stream, seeded from CFITSIO_RANDOM_SEED and the
+  number of expressions parsed before it, so the whole run is repeated
+  in two child processes with that variable set and their results must
+  agree.
+*/
+
+#define NTHREADS  8        /* Number of concurrent threads          */
+#define NCALLS   20        /* fits_select_rows calls per thread     */
+#define NROWS  2000        /* Rows in each thread's table           */
+
+typedef struct {
+    int  id;               /* Thread number                         */
+    int  userandom;        /* Use the random() filter?              */
+    long count[NCALLS];    /* Rows kept by each random filter       */
+    long rowsum[NCALLS];   /* Sum of the row numbers kept           */
+    int  status;           /* CFITSIO status, or -1 on a mismatch   */
+} threadinfo;
+
+char *ttype[] = { "N", "X" };
+char *tform[] = { "1J", "1D" };
+
+int main( int argc, char *argv[] );
+int runthreads( void );
+int startthreads( threadinfo *info, int userandom );
+void *selectloop( void *arg );
+int selectonce( fitsfile *infptr, char *expr, long *count, long *rowsum,
+                int *status );
+int cmplong( const void *a, const void *b );
+
+int main( int argc, char *argv[] )
+{
+/*************************************************************************
+   Without arguments, run this program twice more with "child" as its
+   argument and CFITSIO_RANDOM_SEED set, and compare what they print.
+   With "child", run the threads and print the results of the random
+   filters, which must not depend on which thread ran which call.
+**************************************************************************/
+    char command[FLEN_FILENAME+10], line[2][1000];
+    FILE *pipe;
+    int ii;
+
+    if (argc > 1 && !strcmp(argv[1], "child"))
+        return( runthreads() );
+
+    if (!fits_is_reentrant()) {
+        printf("CFITSIO was not built thread-safe\n");
+        return(1);
+    }
+
+    setenv("CFITSIO_RANDOM_SEED", "20240817", 1);
+    snprintf(command, sizeof(command), "\"%s\" child", argv[0]);
+
+    for (ii = 0; ii < 2; ii++) {
+        line[ii][0] = '\0';
+        pipe = popen(command, "r");
+        if (!pipe) {
+            printf("Unable to run %s\n", command);
+            return(1);
+        }
+        if (!fgets(line[ii], sizeof(line[ii]), pipe))
+            line[ii][0] = '\0';
+        if (pclose(pipe) != 0) {
+            printf("Run %d failed: %s", ii + 1, line[ii]);
+            return(1);
+        }
+    }
+
+    if (!line[0][0] || strcmp(line[0], line[1])) {
+        printf("Random filters are not reproducible:\n%s%s",
+               line[0], line[1]);
+        return(1);
+    }
+
+    printf("%d threads x %d fits_select_rows calls: OK\n", NTHREADS, NCALLS);
+    return(0);
+}
+/*--------------------------------------------------------------------------*/
+int runthreads( void )
+
+    /*********************************************************/
+    /* Run the threads and print the sorted results of their */
+    /* random filters on one line                            */
+    /*********************************************************/
+{
+    threadinfo info[NTHREADS];
+    long counts[NTHREADS*NCALLS], sums[NTHREADS*NCALLS];
+    int ii, jj, nn = 0;
+
+    /* Initialize CFITSIO before there are several threads to race */
+    /* to do it on their first call                                 */
+
+    if (fits_init_cfitsio()) {
+        printf("Unable to initialize CFITSIO\n");
+        return(1);
+    }
+
+    /* The random filters run only once all the plain ones are done, so */
+    /* that they are always parsed after the same number of expressions */
+
+    if (startthreads(info, 0) || startthreads(info, 1))
+        return(1);
+
+    for (ii = 0; ii < NTHREADS; ii++) {
+        for (jj = 0; jj < NCALLS; jj++) {
+            counts[nn] = info[ii].count[jj];
+            sums[nn++] = info[ii].rowsum[jj];
+        }
+    }
+
+    /* Each thread filters identical data with the same expression, so */
+    /* the set of results is fixed even though the order is not        */
+
+    qsort(counts, nn, sizeof(long), cmplong);
+    qsort(sums, nn, sizeof(long), cmplong);
+    for (ii = 0; ii < nn; ii++)
+        printf("%ld/%ld ", counts[ii], sums[ii]);
+    printf("\n");
+    return(0);
+}
+/*--------------------------------------------------------------------------*/
+int startthreads( threadinfo *info, int userandom )
+
+    /*****************************************************/
+    /* Run selectloop in NTHREADS threads at once and    */
+    /* wait for all of them to finish                    */
+    /*****************************************************/
+{
+    pthread_t thread[NTHREADS];
+    int ii, nthreads;
+
+    for (nthreads = 0; nthreads < NTHREADS; nthreads++) {
+        memset(&info[nthreads], 0, sizeof(threadinfo));
+        info[nthreads].id = nthreads;
+        info[nthreads].userandom = userandom;
+        if (pthread_create(&thread[nthreads], NULL, selectloop,
+                           &info[nthreads])) {
+            printf("Unable to create thread %d\n", nthreads);
+            break;
+        }
+    }
+    for (ii = 0; ii < nthreads; ii++)
+        pthread_join(thread[ii], NULL);
+    if (nthreads < NTHREADS)
+        return(1);
+
+    for (ii = 0; ii < NTHREADS; ii++) {
+        if (info[ii].status) {
+            printf("Thread %d failed, status = %d\n", ii, info[ii].status);
+            return(1);
+        }
+    }
+    return(0);
+}
+/*--------------------------------------------------------------------------*/
+void *selectloop( void *arg )
+
+    /**********************************************************/
+    /* Build a table in memory and filter it NCALLS times     */
+    /**********************************************************/
+{
+    threadinfo *info = (threadinfo *) arg;
+    fitsfile *fptr;
+    long nvalue[NROWS], count, rowsum, expcount, expsum;
+    double xvalue[NROWS];
+    int ii, status = 0;
+
+    fits_create_file(&fptr, "mem://", &status);
+    fits_create_tbl(fptr, BINARY_TBL, NROWS, 2, ttype, tform, NULL,
+                    "STRESS", &status);
+    expcount = expsum = 0;
+    for (ii = 0; ii < NROWS; ii++) {
+        nvalue[ii] = ii + 1;
+        xvalue[ii] = (ii * 37 % 101) / 10.;
+        if (nvalue[ii] % 3 == 0 && xvalue[ii] > 5.0) {
+            expcount++;
+            expsum += nvalue[ii];
+        }
+    }
+    fits_write_col(fptr, TLONG, 1, 1, 1, NROWS, nvalue, &status);
+    fits_write_col(fptr, TDOUBLE, 2, 1, 1, NROWS, xvalue, &status);
+
+    for (ii = 0; ii < NCALLS && !status; ii++) {
+        if (info->userandom) {
+            selectonce(fptr, "random() < 0.25 || randomn() > 1.5",
+                       &info->count[ii], &info->rowsum[ii], &status);
+        } else {
+            selectonce(fptr, "N % 3 == 0 && X > 5.0", &count, &rowsum,
+                       &status);
+            if (!status && (count != expcount || rowsum != expsum)) {
+                printf("Thread %d, call %d: kept %ld rows, expected %ld\n",
+                       info->id, ii, count, expcount);
+                status = -1;
+            }
+        }
+    }
+
+    if (status > 0)
+        fits_clear_errmsg();
+    info->status = status;
+    status = 0;
+    fits_close_file(fptr, &status);
+    return(NULL);
+}
+/*--------------------------------------------------------------------------*/
+int selectonce( fitsfile *infptr, char *expr, long *count, long *rowsum,
+                int *status )
+
+    /*******************************************************/
+    /* Copy the rows of infptr which satisfy expr into a   */
+    /* new, empty in-memory table, and count and sum them  */
+    /*******************************************************/
+{
+    fitsfile *outfptr;
+    long nvalue[NROWS];
+    int ii, anynul, tstatus = 0;
+
+    if (fits_create_file(&outfptr, "mem://", status))
+        return(*status);
+    fits_create_tbl(outfptr, BINARY_TBL, 0, 2, ttype, tform, NULL,
+                    "STRESS", status);
+    fits_select_rows(infptr, outfptr, expr, status);
+    fits_get_num_rows(outfptr, count, status);
+    fits_read_col(outfptr, TLONG, 1, 1, 1, *count, NULL, nvalue, &anynul,
+                  status);
+
+    *rowsum = 0;
+    for (ii = 0; ii < *count && !*status; ii++)
+        *rowsum += nvalue[ii];
+
+    fits_close_file(outfptr, &tstatus);
+    return(*status);
+}
+/*--------------------------------------------------------------------------*/
+int cmplong( const void *a, const void *b )
+{
+    long la = *(const long *) a, lb = *(const long *) b;
+
+    return( la < lb ? -1 : la > lb );
+}